@@ -28,6 +28,9 @@ limitations under the License.
 
 namespace kanzi {
 
+   class BlockStats;
+   class Dictionary;
+
    #if __cplusplus >= 201703L
     // C++17+ version using std::variant
     typedef std::variant<int64, std::string> ContextVal;
@@ -48,16 +51,40 @@ namespace kanzi {
 
    class Context {
    public:
+       // Integer keys accessed for every block by the streams, the factories
+       // and the codecs. They are stored in a flat array rather than in the map
+       // and can be accessed without string comparisons. The string API maps
+       // the corresponding names ("blockId", "size", ...) to the same slots.
+       enum Key {
+           BLOCK_ID,       // "blockId"
+           BLOCK_SIZE,     // "blockSize"
+           BS_VERSION,     // "bsVersion"
+           CHECKSUM,       // "checksum"
+           DATA_TYPE,      // "dataType"
+           ENTROPY_TYPE,   // "eType"
+           FROM,           // "from"
+           JOBS,           // "jobs"
+           LZ_TYPE,        // "lz"
+           PACK_ONLY_DNA,  // "packOnlyDNA"
+           SIZE,           // "size"
+           SKIP_BLOCKS,    // "skipBlocks"
+           TASKS,          // "tasks"
+           TEXT_CODEC,     // "textcodec"
+           TO,             // "to"
+           TRANSFORM_TYPE, // "tType"
+           VERBOSITY,      // "verbosity"
+           NB_KEYS
+       };
 
    #ifdef CONCURRENCY_ENABLED
-       Context(ThreadPool* p = nullptr) : _pool(p) {}
-       Context(const Context& c) : _map(c._map), _pool(c._pool) {}
-       Context(const Context& c, ThreadPool* p) : _map(c._map), _pool(p) {}
+       Context(ThreadPool* p = nullptr) : _keys(0), _dict(nullptr), _stats(nullptr), _pool(p) { clearValues(); }
+       Context(const Context& c) : _map(c._map), _keys(c._keys), _dict(c._dict), _stats(c._stats), _pool(c._pool) { copyValues(c); }
+       Context(const Context& c, ThreadPool* p) : _map(c._map), _keys(c._keys), _dict(c._dict), _stats(c._stats), _pool(p) { copyValues(c); }
        Context& operator=(const Context& c) = default;
    #else
-       Context() {}
-       Context(const Context& c) : _map(c._map) {}
-       Context& operator=(const Context& c) { _map = c._map; return *this; }
+       Context() : _keys(0), _dict(nullptr), _stats(nullptr) { clearValues(); }
+       Context(const Context& c) : _map(c._map), _keys(c._keys), _dict(c._dict), _stats(c._stats) { copyValues(c); }
+       Context& operator=(const Context& c) { _map = c._map; _keys = c._keys; _dict = c._dict; _stats = c._stats; copyValues(c); return *this; }
    #endif
 
        ~Context() {}
@@ -73,21 +100,148 @@ namespace kanzi {
        void putLong(const std::string& key, int64 value);
        void putString(const std::string& key, const std::string& value);
 
+       bool has(Key key) const { return (_keys & (uint32(1) << key)) != 0; }
+
+       int getInt(Key key, int defValue = 0) const { return has(key) ? int(_values[key]) : defValue; }
+       int64 getLong(Key key, int64 defValue = 0) const { return has(key) ? _values[key] : defValue; }
+
+       void putInt(Key key, int value) { putLong(key, int64(value)); }
+       void putLong(Key key, int64 value) { _values[key] = value; _keys |= (uint32(1) << key); }
+
    #ifdef CONCURRENCY_ENABLED
        ThreadPool* getPool() const { return _pool; }
    #endif
 
+       // Pre-trained dictionary shared by all the blocks (not owned), null if none
+       const Dictionary* getDictionary() const { return _dict; }
+       void setDictionary(const Dictionary* dict) { _dict = dict; }
+
+       // Statistics of the current block (not owned), null if none.
+       // See BlockStats::get to check that they describe a given input.
+       BlockStats* getBlockStats() const { return _stats; }
+       void setBlockStats(BlockStats* stats) { _stats = stats; }
+
+       // Return the Key matching a name or -1 if the name is not a Key
+       static int getKey(const std::string& name);
+
    private:
        std::map<std::string, ContextVal> _map;
+       int64 _values[NB_KEYS];
+       uint32 _keys; // bit set of keys with a value
+       const Dictionary* _dict;
+       BlockStats* _stats;
 
    #ifdef CONCURRENCY_ENABLED
        ThreadPool* _pool;
    #endif
+
+       void clearValues();
+
+       void copyValues(const Context& c);
    };
 
 
+   inline void Context::clearValues()
+   {
+       for (int i = 0; i < NB_KEYS; i++)
+           _values[i] = 0;
+   }
+
+
+   inline void Context::copyValues(const Context& c)
+   {
+       for (int i = 0; i < NB_KEYS; i++)
+           _values[i] = c._values[i];
+   }
+
+
+   inline int Context::getKey(const std::string& name)
+   {
+       static const char* NAMES[NB_KEYS] = {
+           "blockId", "blockSize", "bsVersion", "checksum", "dataType", "eType",
+           "from", "jobs", "lz", "packOnlyDNA", "size", "skipBlocks", "tasks",
+           "textcodec", "to", "tType", "verbosity"
+       };
+
+       // Select the candidate from the first character and the length so that
+       // a lookup costs at most one string comparison
+       const size_t len = name.length();
+
+       if (len < 2)
+           return -1;
+
+       int k = -1;
+
+       switch (name[0]) {
+           case 'b':
+               if (len == 7)
+                   k = BLOCK_ID;
+               else if (len == 9)
+                   k = (name[1] == 'l') ? BLOCK_SIZE : BS_VERSION;
+
+               break;
+
+           case 'c':
+               k = CHECKSUM;
+               break;
+
+           case 'd':
+               k = DATA_TYPE;
+               break;
+
+           case 'e':
+               k = ENTROPY_TYPE;
+               break;
+
+           case 'f':
+               k = FROM;
+               break;
+
+           case 'j':
+               k = JOBS;
+               break;
+
+           case 'l':
+               k = LZ_TYPE;
+               break;
+
+           case 'p':
+               k = PACK_ONLY_DNA;
+               break;
+
+           case 's':
+               k = (len == 4) ? SIZE : SKIP_BLOCKS;
+               break;
+
+           case 't':
+               if (len == 2)
+                   k = TO;
+               else if (len == 9)
+                   k = TEXT_CODEC;
+               else if (len == 5)
+                   k = (name[1] == 'a') ? TASKS : TRANSFORM_TYPE;
+
+               break;
+
+           case 'v':
+               k = VERBOSITY;
+               break;
+
+           default:
+               break;
+       }
+
+       return ((k >= 0) && (name == NAMES[k])) ? k : -1;
+   }
+
+
    inline bool Context::has(const std::string& key) const
    {
+       const int k = getKey(key);
+
+       if ((k >= 0) && (has(Key(k)) == true))
+           return true;
+
        return _map.find(key) != _map.end();
    }
 
@@ -100,6 +254,11 @@ namespace kanzi {
 
    inline int64 Context::getLong(const std::string& key, int64 defValue) const
    {
+       const int k = getKey(key);
+
+       if ((k >= 0) && (has(Key(k)) == true))
+           return _values[k];
+
        const std::map<std::string, ContextVal>::const_iterator it = _map.find(key);
 
        if (it == _map.end())
@@ -137,16 +296,20 @@ namespace kanzi {
 
    inline void Context::putInt(const std::string& key, int value)
    {
-   #if __cplusplus >= 201703L
-       _map[key] = int64(value);
-   #else
-       _map[key] = ContextVal((int64)value);
-   #endif
+       putLong(key, int64(value));
    }
 
 
    inline void Context::putLong(const std::string& key, int64 value)
    {
+       const int k = getKey(key);
+
+       if (k >= 0) {
+           _map.erase(key);
+           putLong(Key(k), value);
+           return;
+       }
+
    #if __cplusplus >= 201703L
        _map[key] = value;
    #else
@@ -156,6 +319,12 @@ namespace kanzi {
 
    inline void Context::putString(const std::string& key, const std::string& value)
    {
+       const int k = getKey(key);
+
+       // A string value replaces any integer value stored for this key
+       if (k >= 0)
+           _keys &= ~(uint32(1) << k);
+
    #if __cplusplus >= 201703L
        _map[key] = value;
    #else
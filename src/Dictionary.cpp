@@ -0,0 +1,268 @@
+/*
+Copyright 2011-2026 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "Dictionary.hpp"
+#include "Memory.hpp"
+#include "transform/TransformFactory.hpp"
+#include "util/XXHash.hpp"
+
+using namespace kanzi;
+using namespace std;
+
+const int Dictionary::MAX_SIZE;
+const int Dictionary::DEFAULT_SIZE;
+const int Dictionary::FILE_MAGIC;
+const int Dictionary::FILE_VERSION;
+const int Dictionary::PRIME_SIZE;
+
+// Training parameters: length of the substrings counted (dmers) and of the
+// segments copied to the dictionary.
+static const int TRAIN_DMER_LENGTH = 8;
+static const int TRAIN_SEGMENT_LENGTH = 64;
+static const int TRAIN_LOG_HASH = 20;
+
+
+Dictionary::Dictionary(const byte data[], int length)
+{
+    if ((data == nullptr) || (length <= 0) || (length > MAX_SIZE)) {
+        stringstream ss;
+        ss << "Invalid dictionary size: " << length << " (must be in [1.." << MAX_SIZE << "])";
+        throw invalid_argument(ss.str());
+    }
+
+    _data = new byte[length];
+    memcpy(&_data[0], &data[0], size_t(length));
+    _size = length;
+    _id = XXHash32(FILE_MAGIC).hash(_data, _size);
+}
+
+
+// Dictionary file: magic (32 bits), version (8 bits), ID (32 bits),
+// size (32 bits), content. Integers are big endian.
+Dictionary* Dictionary::read(istream& is)
+{
+    byte header[13];
+    is.read(reinterpret_cast<char*>(&header[0]), sizeof(header));
+
+    if (is.gcount() != streamsize(sizeof(header)))
+        throw invalid_argument("Invalid dictionary file: truncated header");
+
+    if (BigEndian::readInt32(&header[0]) != FILE_MAGIC)
+        throw invalid_argument("Invalid dictionary file: not a dictionary");
+
+    if (int(header[4]) != FILE_VERSION) {
+        stringstream ss;
+        ss << "Invalid dictionary file: unsupported version " << int(header[4]);
+        throw invalid_argument(ss.str());
+    }
+
+    const uint32 id = uint32(BigEndian::readInt32(&header[5]));
+    const int size = BigEndian::readInt32(&header[9]);
+
+    if ((size <= 0) || (size > MAX_SIZE)) {
+        stringstream ss;
+        ss << "Invalid dictionary file: incorrect size " << size;
+        throw invalid_argument(ss.str());
+    }
+
+    byte* buf = new byte[size];
+    is.read(reinterpret_cast<char*>(&buf[0]), size);
+
+    if (is.gcount() != streamsize(size)) {
+        delete[] buf;
+        throw invalid_argument("Invalid dictionary file: truncated content");
+    }
+
+    Dictionary* dict = new Dictionary(buf, size);
+    delete[] buf;
+
+    if (dict->getId() != id) {
+        delete dict;
+        throw invalid_argument("Invalid dictionary file: ID mismatch (corrupted content)");
+    }
+
+    return dict;
+}
+
+
+Dictionary* Dictionary::load(const string& fileName)
+{
+    ifstream is(fileName.c_str(), ifstream::in | ifstream::binary);
+
+    if (!is.is_open())
+        throw invalid_argument("Cannot open dictionary file '" + fileName + "'");
+
+    try {
+        return read(is);
+    }
+    catch (const invalid_argument& e) {
+        throw invalid_argument(string(e.what()) + " ('" + fileName + "')");
+    }
+}
+
+
+void Dictionary::write(ostream& os) const
+{
+    byte header[13];
+    BigEndian::writeInt32(&header[0], FILE_MAGIC);
+    header[4] = byte(FILE_VERSION);
+    BigEndian::writeInt32(&header[5], int32(_id));
+    BigEndian::writeInt32(&header[9], _size);
+    os.write(reinterpret_cast<const char*>(&header[0]), sizeof(header));
+    os.write(reinterpret_cast<const char*>(&_data[0]), _size);
+}
+
+
+bool Dictionary::isPrimingUseful(uint64 transformType)
+{
+    // 8 transforms of 6 bits each
+    for (int i = 0; i < 8; i++) {
+        const uint64 t = (transformType >> (6 * i)) & 0x3F;
+
+        if ((t == TransformFactory<byte>::BWT_TYPE) || (t == TransformFactory<byte>::BWTS_TYPE))
+            return false;
+    }
+
+    return true;
+}
+
+
+static inline uint32 hashDmer(const byte* p)
+{
+    return uint32((uint64(LittleEndian::readLong64(p)) * 0x9E3779B97F4A7C15ULL) >> (64 - TRAIN_LOG_HASH));
+}
+
+
+// The score of a dmer is the number of other samples (or other positions if
+// there is only one sample) where it appears. The samples are split into
+// epochs and the segment with the best score of each epoch is copied to the
+// dictionary, from the end to the start. The dmers of a selected segment
+// are not counted anymore, so the next segments bring new content. The
+// epochs are visited again until the dictionary is full.
+Dictionary* Dictionary::train(const byte samples[], const int sizes[], int nbSamples, int maxSize)
+{
+    if ((samples == nullptr) || (sizes == nullptr) || (nbSamples <= 0))
+        throw invalid_argument("Invalid training samples");
+
+    if ((maxSize <= 0) || (maxSize > MAX_SIZE)) {
+        stringstream ss;
+        ss << "Invalid dictionary size: " << maxSize << " (must be in [1.." << MAX_SIZE << "])";
+        throw invalid_argument(ss.str());
+    }
+
+    int64 total = 0;
+
+    for (int i = 0; i < nbSamples; i++)
+        total += int64(sizes[i]);
+
+    if (total > int64(1) << 30)
+        throw invalid_argument("Invalid training samples: at most 1 GB of samples");
+
+    const int length = int(total);
+
+    if (length < TRAIN_SEGMENT_LENGTH)
+        return nullptr;
+
+    const int hashSize = 1 << TRAIN_LOG_HASH;
+    int* scores = new int[hashSize];
+    int* last = new int[hashSize];
+    memset(&scores[0], 0, sizeof(int) * hashSize);
+    memset(&last[0], 0xFF, sizeof(int) * hashSize);
+    int start = 0;
+
+    for (int s = 0; s < nbSamples; s++) {
+        const int end = start + sizes[s] - TRAIN_DMER_LENGTH;
+
+        for (int i = start; i <= end; i++) {
+            const uint32 h = hashDmer(&samples[i]);
+
+            // Count each dmer once per sample, except with a single sample
+            if ((last[h] != s) || (nbSamples == 1)) {
+                last[h] = s;
+                scores[h]++;
+            }
+        }
+
+        start += sizes[s];
+    }
+
+    // A dmer seen once brings nothing
+    for (int i = 0; i < hashSize; i++)
+        scores[i] = (scores[i] > 1) ? scores[i] - 1 : 0;
+
+    delete[] last;
+    const int dmers = length - TRAIN_DMER_LENGTH + 1;
+    const int nbSegments = max(maxSize / TRAIN_SEGMENT_LENGTH, 1);
+    const int epochSize = max(dmers / nbSegments, TRAIN_SEGMENT_LENGTH);
+    const int nbEpochs = max(dmers / epochSize, 1);
+    const int window = TRAIN_SEGMENT_LENGTH - TRAIN_DMER_LENGTH + 1;
+    byte* dict = new byte[maxSize];
+    int tail = maxSize;
+    bool progress = true;
+
+    while ((tail > 0) && (progress == true)) {
+        progress = false;
+
+        for (int e = 0; (e < nbEpochs) && (tail > 0); e++) {
+            const int eStart = e * epochSize;
+            const int eEnd = (e == nbEpochs - 1) ? dmers : eStart + epochSize;
+
+            if (eEnd - eStart < window)
+                continue;
+
+            // Slide a window of 'window' dmers over the epoch
+            int score = 0;
+            int bestScore = 0;
+            int bestIdx = -1;
+
+            for (int i = eStart; i < eStart + window; i++)
+                score += scores[hashDmer(&samples[i])];
+
+            for (int i = eStart; ; i++) {
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestIdx = i;
+                }
+
+                if (i + window >= eEnd)
+                    break;
+
+                score += scores[hashDmer(&samples[i + window])];
+                score -= scores[hashDmer(&samples[i])];
+            }
+
+            if (bestIdx < 0)
+                continue;
+
+            // Copy the segment before the previous ones
+            const int segLength = min(TRAIN_SEGMENT_LENGTH, tail);
+            tail -= segLength;
+            memcpy(&dict[tail], &samples[bestIdx + TRAIN_SEGMENT_LENGTH - segLength], size_t(segLength));
+            progress = true;
+
+            for (int i = bestIdx; i < bestIdx + window; i++)
+                scores[hashDmer(&samples[i])] = 0;
+        }
+    }
+
+    delete[] scores;
+    Dictionary* res = (tail < maxSize) ? new Dictionary(&dict[tail], maxSize - tail) : nullptr;
+    delete[] dict;
+    return res;
+}
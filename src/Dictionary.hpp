@@ -0,0 +1,124 @@
+/*
+Copyright 2011-2026 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef knz_Dictionary
+#define knz_Dictionary
+
+#include <iostream>
+#include <string>
+#include "Context.hpp"
+#include "types.hpp"
+
+
+namespace kanzi {
+
+   // A pre-trained dictionary shared by the compressor and the decompressor.
+   // It is the content of typical data (EG. sample messages), with the most
+   // useful content at the end. The streams advertise its ID in the header
+   // and every block starts with the dictionary as history: LZX/ROLZ matches
+   // may refer to it, TextCodec adds its words to the static dictionary and
+   // the CM/TPAQ models learn it before coding the block.
+   // Small blocks (EG. messages of a few KB) that share little context with
+   // each other compress much better.
+   class Dictionary {
+   public:
+       static const int MAX_SIZE = 1 << 20;
+       static const int DEFAULT_SIZE = 64 * 1024;
+
+       // Copy 'length' bytes of content. The ID is a hash of the content.
+       Dictionary(const byte data[], int length);
+
+       ~Dictionary() { delete[] _data; }
+
+       const byte* data() const { return _data; }
+
+       int size() const { return _size; }
+
+       uint32 getId() const { return _id; }
+
+       // Read a dictionary file (see write). Throw an invalid_argument on error.
+       static Dictionary* read(std::istream& is);
+
+       // Read the dictionary file with the given name. Throw an invalid_argument on error.
+       static Dictionary* load(const std::string& fileName);
+
+       void write(std::ostream& os) const;
+
+       // Build a dictionary of at most 'maxSize' bytes from 'nbSamples' samples
+       // stored one after the other in 'samples'. The dictionary is made of the
+       // segments of the samples with the most substrings found in other samples
+       // (derived from the COVER algorithm). Return null if the samples have
+       // nothing in common.
+       static Dictionary* train(const byte samples[], const int sizes[], int nbSamples, int maxSize);
+
+       // Feed the end of the dictionary to a bit predictor (CM, TPAQ) so that
+       // the first bytes of a block are coded with warm statistics. The
+       // encoder and the decoder must prime the same predictors.
+       template <class P>
+       void prime(P& predictor) const;
+
+       // Prime a new predictor with the dictionary of the context, if any,
+       // and return it. Nothing is learnt after a BWT/BWTS since the block
+       // content is then in a different order than in the dictionary.
+       template <class P>
+       static P* primePredictor(const Context& ctx, P* predictor);
+
+       // Return true if the entropy models learn the dictionary for blocks
+       // processed by the given transform sequence.
+       static bool isPrimingUseful(uint64 transformType);
+
+   private:
+       static const int FILE_MAGIC = 0x4B4E5A44; // "KNZD"
+       static const int FILE_VERSION = 1;
+       static const int PRIME_SIZE = 32 * 1024; // bytes learnt by the predictors
+
+       byte* _data;
+       int _size;
+       uint32 _id;
+
+       Dictionary(const Dictionary&); // not copyable
+       Dictionary& operator=(const Dictionary&);
+   };
+
+
+   template <class P>
+   inline void Dictionary::prime(P& predictor) const
+   {
+       const int start = (_size > PRIME_SIZE) ? _size - PRIME_SIZE : 0;
+
+       for (int i = start; i < _size; i++) {
+           const int val = int(_data[i]);
+
+           for (int shift = 7; shift >= 0; shift--) {
+               predictor.get();
+               predictor.update((val >> shift) & 1);
+           }
+       }
+   }
+
+
+   template <class P>
+   inline P* Dictionary::primePredictor(const Context& ctx, P* predictor)
+   {
+       const Dictionary* dict = ctx.getDictionary();
+
+       if ((dict != nullptr) && (isPrimingUseful(uint64(ctx.getLong(Context::TRANSFORM_TYPE))) == true))
+           dict->prime(*predictor);
+
+       return predictor;
+   }
+}
+#endif
@@ -44,6 +44,7 @@ namespace kanzi
            ERR_INVALID_PARAM = 18,
            ERR_CRC_CHECK = 19,
            ERR_RESERVED_NAME = 20,
+           ERR_WOULD_BLOCK = 21,
            ERR_UNKNOWN = 127
        };
    };
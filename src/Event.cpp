@@ -252,6 +252,8 @@ std::string Event::getTypeAsString() const
           return "COMPRESSION_START";
        case BLOCK_INFO:
           return "BLOCK_INFO";
+       case MEMORY_INFO:
+          return "MEMORY_INFO";
        default:
           return "Unknown Type";
     }
@@ -38,7 +38,8 @@ namespace kanzi
               DECOMPRESSION_START,
               DECOMPRESSION_END,
               AFTER_HEADER_DECODING,
-              BLOCK_INFO
+              BLOCK_INFO,
+              MEMORY_INFO // estimated peak memory (bytes) of a block
           };
 
           enum HashType {
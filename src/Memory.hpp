@@ -209,7 +209,7 @@ static KANZI_ALWAYS_INLINE uint64 knz_bswap64(uint64 x) {
     {
         const __m128i a = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(x));
         const __m128i b = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(y));
-        return _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xFF;
+        return (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) & 0xFF) == 0xFF; // upper 8 bytes are 0
     }
 
     static KANZI_ALWAYS_INLINE void memCp8(byte* dst, const byte* src)
@@ -61,15 +61,20 @@ struct cContext {
 
 
 namespace kanzi {
-   // Utility classes to map C FILEs to C++ streams
+   // Utility classes to map C FILEs (or write callbacks) to C++ streams
     class ofstreambuf FINAL : public streambuf
     {
     public:
-        ofstreambuf(int fd) : _fd(fd), _buffer(65536) {
+        ofstreambuf(int fd) : _fd(fd), _write(nullptr), _userData(nullptr), _buffer(65536) {
             // Initialize put pointers to the beginning of the buffer
             setp(&_buffer[0], &_buffer[0] + _buffer.size());
         }
 
+        ofstreambuf(kanziWriteCallback write, void* userData)
+            : _fd(-1), _write(write), _userData(userData), _buffer(65536) {
+            setp(&_buffer[0], &_buffer[0] + _buffer.size());
+        }
+
         virtual ~ofstreambuf() {
             // Call the non-virtual implementation directly instead of the virtual sync()
             flush();
@@ -123,7 +128,7 @@ namespace kanzi {
                     streamsize toWrite = remaining;
 
                     while (toWrite > 0) {
-                        const ptrdiff_t written = ptrdiff_t(WRITE(_fd, src, toWrite));
+                        const ptrdiff_t written = writeChunk(src, ptrdiff_t(toWrite));
 
                         if (written <= 0)
                             return n - remaining; // Error
@@ -141,8 +146,18 @@ namespace kanzi {
 
     private:
         int _fd;
+        kanziWriteCallback _write;
+        void* _userData;
         std::vector<char> _buffer;
 
+        ptrdiff_t writeChunk(const char* data, ptrdiff_t length) {
+            if (_write == nullptr)
+                return ptrdiff_t(WRITE(_fd, data, length));
+
+            const size_t written = _write(_userData, reinterpret_cast<const unsigned char*>(data), size_t(length));
+            return (written > size_t(length)) ? -1 : ptrdiff_t(written);
+        }
+
         int flush() {
             ptrdiff_t n = pptr() - pbase();
             if (n > 0) {
@@ -150,7 +165,7 @@ namespace kanzi {
                 ptrdiff_t remaining = n;
 
                 while (remaining > 0) {
-                    const ptrdiff_t written = ptrdiff_t(WRITE(_fd, dst, remaining));
+                    const ptrdiff_t written = writeChunk(dst, remaining);
 
                     if (written <= 0)
                         return EOF;
@@ -175,58 +190,48 @@ namespace kanzi {
           FileOutputStream(int fd) : ostream(nullptr), _buf(fd) {
               rdbuf(&_buf);
           }
+
+          FileOutputStream(kanziWriteCallback write, void* userData) : ostream(nullptr), _buf(write, userData) {
+              rdbuf(&_buf);
+          }
     };
 }
 
 
-// Create internal cContext and CompressedOutputStream
-KANZI_API int CDECL initCompressor(struct cData* pData, FILE* dst, struct cContext** pCtx) KANZI_NOEXCEPT
+// Validate and rewrite transform and entropy names, round block size
+// May throw on invalid names
+static int checkParams(struct cData* pData)
 {
-    if ((pData == nullptr) || (pCtx == nullptr) || (dst == nullptr))
+    if ((memchr(pData->transform, 0, sizeof(pData->transform)) == nullptr) ||
+        (memchr(pData->entropy, 0, sizeof(pData->entropy)) == nullptr)) {
         return Error::ERR_INVALID_PARAM;
+    }
 
-    FileOutputStream* fos = nullptr;
-    cContext* cctx = nullptr;
-
-    try {
-        // Process params
-        const int fd = FILENO(dst);
-
-        if (fd == -1)
-           return Error::ERR_CREATE_COMPRESSOR;
-
-        if ((memchr(pData->transform, 0, sizeof(pData->transform)) == nullptr) ||
-            (memchr(pData->entropy, 0, sizeof(pData->entropy)) == nullptr)) {
-            return Error::ERR_INVALID_PARAM;
-        }
+    string transform = TransformFactory<kanzi::byte>::getName(TransformFactory<kanzi::byte>::getType(pData->transform));
+    string entropy = EntropyEncoderFactory::getName(EntropyEncoderFactory::getType(pData->entropy));
 
-        string transform = TransformFactory<kanzi::byte>::getName(TransformFactory<kanzi::byte>::getType(pData->transform));
-        string entropy = EntropyEncoderFactory::getName(EntropyEncoderFactory::getType(pData->entropy));
+    if ((transform.length() >= sizeof(pData->transform)) ||
+        (entropy.length() >= sizeof(pData->entropy))) {
+        return Error::ERR_INVALID_PARAM;
+    }
 
-        if ((transform.length() >= sizeof(pData->transform)) ||
-            (entropy.length() >= sizeof(pData->entropy))) {
-            return Error::ERR_INVALID_PARAM;
-        }
+    memset(pData->transform, 0, sizeof(pData->transform));
+    strncpy(pData->transform, transform.c_str(), sizeof(pData->transform) - 1);
+    memset(pData->entropy, 0, sizeof(pData->entropy));
+    strncpy(pData->entropy, entropy.c_str(), sizeof(pData->entropy) - 1);
 
-        memset(pData->transform, 0, sizeof(pData->transform));
-        strncpy(pData->transform, transform.c_str(), sizeof(pData->transform) - 1);
-        memset(pData->entropy, 0, sizeof(pData->entropy));
-        strncpy(pData->entropy, entropy.c_str(), sizeof(pData->entropy) - 1);
+    pData->blockSize = (pData->blockSize + 15) & -16;
+    return 0;
+}
 
-        pData->blockSize = (pData->blockSize + 15) & -16;
+// Create internal cContext and CompressedOutputStream (fos is owned by the context)
+static int createCompressor(struct cData* pData, FileOutputStream* fos, size_t fileSize, struct cContext** pCtx)
+{
+    cContext* cctx = nullptr;
 
+    try {
         *pCtx = nullptr;
-        size_t fileSize = 0;
-        struct STAT sbuf;
-
-        if (FSTAT(fd, &sbuf) == 0) {
-           fileSize = size_t(sbuf.st_size);
-        }
-
-        // Create compression stream and update context
-        fos = new FileOutputStream(fd);
         cctx = new cContext();
-
         cctx->pCos = new CompressedOutputStream(*fos, pData->jobs,
                                                 pData->entropy, pData->transform,
                                                 int(pData->blockSize), pData->checksum,
@@ -241,8 +246,7 @@ KANZI_API int CDECL initCompressor(struct cData* pData, FILE* dst, struct cConte
         *pCtx = cctx;
     }
     catch (const exception&) {
-        if (fos != nullptr)
-           delete fos;
+        delete fos;
 
         if (cctx != nullptr)
            delete cctx;
@@ -253,7 +257,59 @@ KANZI_API int CDECL initCompressor(struct cData* pData, FILE* dst, struct cConte
     return 0;
 }
 
-KANZI_API int CDECL compress(struct cContext* pCtx, const unsigned char* src, size_t inSize, size_t* outSize) KANZI_NOEXCEPT
+KANZI_API int CDECL initCompressor(struct cData* pData, FILE* dst, struct cContext** pCtx) KANZI_NOEXCEPT
+{
+    if ((pData == nullptr) || (pCtx == nullptr) || (dst == nullptr))
+        return Error::ERR_INVALID_PARAM;
+
+    try {
+        // Process params
+        const int fd = FILENO(dst);
+
+        if (fd == -1)
+           return Error::ERR_CREATE_COMPRESSOR;
+
+        const int err = checkParams(pData);
+
+        if (err != 0)
+            return err;
+
+        size_t fileSize = 0;
+        struct STAT sbuf;
+
+        if (FSTAT(fd, &sbuf) == 0) {
+           fileSize = size_t(sbuf.st_size);
+        }
+
+        return createCompressor(pData, new FileOutputStream(fd), fileSize, pCtx);
+    }
+    catch (const exception&) {
+        return Error::ERR_CREATE_COMPRESSOR;
+    }
+}
+
+KANZI_API int CDECL initCompressorWithCallback(struct cData* pData, kanziWriteCallback write,
+                                               void* userData, struct cContext** pCtx) KANZI_NOEXCEPT
+{
+    if ((pData == nullptr) || (pCtx == nullptr) || (write == nullptr))
+        return Error::ERR_INVALID_PARAM;
+
+    try {
+        const int err = checkParams(pData);
+
+        if (err != 0)
+            return err;
+
+        return createCompressor(pData, new FileOutputStream(write, userData), 0, pCtx);
+    }
+    catch (const exception&) {
+        return Error::ERR_CREATE_COMPRESSOR;
+    }
+}
+
+// Compress one block of data. If 'wait' is false, return ERR_WOULD_BLOCK (no data
+// consumed) instead of waiting for a block slot.
+static int compressBlock(struct cContext* pCtx, const unsigned char* src, size_t inSize, size_t* outSize, bool wait)
 {
     if ((pCtx == nullptr) || (outSize == nullptr)) {
         return Error::ERR_INVALID_PARAM;
@@ -276,6 +332,9 @@ KANZI_API int CDECL compress(struct cContext* pCtx, const unsigned char* src, si
     }
 
     try {
+        if ((wait == false) && (pCos->wouldBlock(streamsize(inSize)) == true))
+            return Error::ERR_WOULD_BLOCK;
+
         const uint64 w = pCos->getWritten();
         pCos->write((const char*)src, streamsize(inSize));
         res = pCos->good() ? 0 : Error::ERR_WRITE_FILE;
@@ -291,6 +350,16 @@ KANZI_API int CDECL compress(struct cContext* pCtx, const unsigned char* src, si
     return res;
 }
 
+KANZI_API int CDECL compress(struct cContext* pCtx, const unsigned char* src, size_t inSize, size_t* outSize) KANZI_NOEXCEPT
+{
+    return compressBlock(pCtx, src, inSize, outSize, true);
+}
+
+KANZI_API int CDECL tryCompress(struct cContext* pCtx, const unsigned char* src, size_t inSize, size_t* outSize) KANZI_NOEXCEPT
+{
+    return compressBlock(pCtx, src, inSize, outSize, false);
+}
+
 // Cleanup allocated internal data structures
 KANZI_API int CDECL disposeCompressor(struct cContext** ppCtx, size_t* outSize) KANZI_NOEXCEPT
 {
@@ -350,6 +419,55 @@ KANZI_API int CDECL disposeCompressor(struct cContext** ppCtx, size_t* outSize)
     return 0;
 }
 
+KANZI_API size_t CDECL compressBound(size_t srcSize, size_t blockSize) KANZI_NOEXCEPT
+{
+    blockSize = (blockSize + 15) & -16;
+
+    if ((blockSize == 0) || (blockSize > size_t(1024 * 1024 * 1024)) || (uint64(srcSize) >= (uint64(1) << 62)))
+        return 0;
+
+    return size_t(CompressedOutputStream::getMaxCompressedLength(int64(srcSize), int(blockSize)));
+}
+
+// One shot compression: no context, no intermediate stream
+KANZI_API int CDECL compressBuffer(struct cData* pData, const unsigned char* src, size_t srcSize,
+                                   unsigned char* dst, size_t* dstSize) KANZI_NOEXCEPT
+{
+    if ((pData == nullptr) || (dst == nullptr) || (dstSize == nullptr))
+        return Error::ERR_INVALID_PARAM;
+
+    if ((src == nullptr) && (srcSize != 0))
+        return Error::ERR_INVALID_PARAM;
+
+    try {
+        const int err = checkParams(pData);
+
+        if (err != 0)
+            return err;
+
+        Context ctx;
+        ctx.putString("transform", pData->transform);
+        ctx.putString("entropy", pData->entropy);
+        ctx.putInt(Context::BLOCK_SIZE, int(pData->blockSize));
+        ctx.putInt(Context::CHECKSUM, pData->checksum);
+        ctx.putInt(Context::JOBS, int(pData->jobs));
+        *dstSize = size_t(CompressedOutputStream::compressBuffer(reinterpret_cast<const kanzi::byte*>(src),
+            int64(srcSize), reinterpret_cast<kanzi::byte*>(dst),
+            int64(*dstSize), ctx, pData->headerless != 0));
+    }
+    catch (const IOException& ioe) {
+        return ioe.error();
+    }
+    catch (const invalid_argument&) {
+        return Error::ERR_INVALID_PARAM;
+    }
+    catch (const exception&) {
+        return Error::ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
 KANZI_API unsigned int CDECL getCompressorVersion(void) KANZI_NOEXCEPT
 {
     return  (KANZI_COMP_VERSION_MAJOR << 16) |
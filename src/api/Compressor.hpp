@@ -45,7 +45,7 @@ limitations under the License.
 
 
 #define KANZI_COMP_VERSION_MAJOR 1
-#define KANZI_COMP_VERSION_MINOR 0
+#define KANZI_COMP_VERSION_MINOR 2
 #define KANZI_COMP_VERSION_PATCH 0
 
 
@@ -65,7 +65,7 @@ limitations under the License.
    struct cData {
        char transform[64];          /* name of transforms [None|PACK|BWT|BWTS|LZ|LZX|LZP|ROLZ|ROLZX]
                                                           [RLT|ZRLT|MTFT|RANK|SRT|TEXT|MM|EXE|UTF|DNA] */
-       char entropy[16];            /* name of entropy codec [None|Huffman|ANS0|ANS1|Range|FPAQ|TPAQ|TPAQX|CM] */
+       char entropy[16];            /* name of entropy codec [None|Huffman|ANS0|ANS0X|ANS1|Range|FPAQ|TPAQ|TPAQX|CM] */
        size_t blockSize;            /* size of block in bytes */
        unsigned int jobs;           /* max number of concurrent tasks */
        int checksum;                /* 0, 32 or 64 to indicate size of block checksum */
@@ -73,6 +73,19 @@ limitations under the License.
    };
 
 
+   /**
+    *  Write callback: receives the compressed data (used instead of a FILE*).
+    *  Called from the thread invoking compress() or disposeCompressor().
+    *
+    *  @param userData [IN] - the pointer provided at initialization
+    *  @param data [IN] - the compressed data
+    *  @param size [IN] - the size of the compressed data
+    *
+    *  @return the number of bytes consumed, less than size in case of error
+    */
+   typedef size_t (CDECL *kanziWriteCallback)(void* userData, const unsigned char* data, size_t size);
+
+
    /**
     * @return the version number of the library.
     * Useful for checking for compatibility at runtime.
@@ -91,6 +104,20 @@ limitations under the License.
     */
    KANZI_API int CDECL initCompressor(struct cData* cParam, FILE* dst, struct cContext** ctx) KANZI_NOEXCEPT;
 
+   /**
+    *  Initialize the compressor internal states. Same as initCompressor but the
+    *  compressed data is handed to a callback (eg. socket, memory arena).
+    *
+    *  @param cParam [IN|OUT] - the compression parameters, transform and enropy are validated and rewritten
+    *  @param write [IN] - the callback receiving the compressed data
+    *  @param userData [IN] - a pointer passed to the callback
+    *  @param ctx [IN|OUT] - pointer to the compression context created by the call
+    *
+    *  @return 0 in case of success, else see error code in Error.hpp
+    */
+   KANZI_API int CDECL initCompressorWithCallback(struct cData* cParam, kanziWriteCallback write,
+                                                  void* userData, struct cContext** ctx) KANZI_NOEXCEPT;
+
     /**
     *  Compress a block of data. The compressor must have been initialized.
     *
@@ -100,10 +127,24 @@ limitations under the License.
     *  @param outSize [IN|OUT] - the size of the compressed data
                               Updated to reflect the number bytes written to the destination.
     *
+    *  With several jobs, the call returns once the full blocks have been submitted
+    *  to the block tasks. It only waits when all block slots hold pending blocks.
+    *
     *  @return 0 in case of success, else see error code in Error.hpp
     */
    KANZI_API int CDECL compress(struct cContext* ctx, const unsigned char* src, size_t inSize, size_t* outSize) KANZI_NOEXCEPT;
 
+   /**
+    *  Same as compress() but never waits for a block slot: if all the slots
+    *  needed by the data hold blocks still being encoded, nothing is consumed
+    *  and ERR_WOULD_BLOCK is returned (call again later with the same data).
+    *  The destination (FILE* or callback) may still block.
+    *
+    *  @return 0 in case of success, ERR_WOULD_BLOCK if the call would wait,
+    *          else see error code in Error.hpp
+    */
+   KANZI_API int CDECL tryCompress(struct cContext* ctx, const unsigned char* src, size_t inSize, size_t* outSize) KANZI_NOEXCEPT;
+
    /**
     *  Dispose the compressor and cleanup memory resources.
     *
@@ -115,6 +156,33 @@ limitations under the License.
     */
    KANZI_API int CDECL disposeCompressor(struct cContext** ctx, size_t* outSize) KANZI_NOEXCEPT;
 
+   /**
+    *  Return the size of the destination buffer required by compressBuffer.
+    *
+    *  @param srcSize [IN] - the size of the data to compress
+    *  @param blockSize [IN] - the size of block in bytes (see cData)
+    *
+    *  @return the maximum size of the compressed data, 0 in case of invalid parameters
+    */
+   KANZI_API size_t CDECL compressBound(size_t srcSize, size_t blockSize) KANZI_NOEXCEPT;
+
+   /**
+    *  Compress a buffer in one call, without compression context.
+    *  The source is split into blocks encoded in place (up to 'jobs' blocks in parallel)
+    *  and the compressed data is written to the destination buffer.
+    *
+    *  @param cParam [IN|OUT] - the compression parameters, transform and enropy are validated and rewritten
+    *  @param src [IN] - the data to compress
+    *  @param srcSize [IN] - the size of the data to compress
+    *  @param dst [IN] - the destination buffer (see compressBound)
+    *  @param dstSize [IN|OUT] - the capacity of the destination buffer.
+    *                            Updated to reflect the size of the compressed data.
+    *
+    *  @return 0 in case of success, else see error code in Error.hpp
+    */
+   KANZI_API int CDECL compressBuffer(struct cData* cParam, const unsigned char* src, size_t srcSize,
+                                      unsigned char* dst, size_t* dstSize) KANZI_NOEXCEPT;
+
 #ifdef __cplusplus
    }
 #endif
@@ -45,21 +45,29 @@ struct dContext {
     kanzi::CompressedInputStream* pCis;
     size_t bufferSize;
     void* fis;
+    void* feed;
 };
 
 
 namespace kanzi {
 
+   // Utility classes to map C FILEs (or read callbacks) to C++ streams
    class ifstreambuf FINAL : public streambuf {
      public:
-       ifstreambuf(int fd) : _fd(fd) {
+       ifstreambuf(int fd) : _fd(fd), _read(nullptr), _userData(nullptr) {
           // gptr() = egptr() initially forces underflow() on first read
           setg(_buffer + 4, _buffer + 4, _buffer + 4);
        }
 
+       ifstreambuf(kanziReadCallback read, void* userData) : _fd(-1), _read(read), _userData(userData) {
+          setg(_buffer + 4, _buffer + 4, _buffer + 4);
+       }
+
      private:
        static const int BUF_SIZE = 1024 + 4;
        int _fd;
+       kanziReadCallback _read;
+       void* _userData;
        char _buffer[BUF_SIZE];
 
        virtual int_type underflow() {
@@ -77,7 +85,8 @@ namespace kanzi {
            }
 
            // Read new data
-           const int n = int(READ(_fd, _buffer + 4, BUF_SIZE - 4));
+           const int n = (_read == nullptr) ? int(READ(_fd, _buffer + 4, BUF_SIZE - 4)) :
+               int(min(_read(_userData, reinterpret_cast<unsigned char*>(_buffer + 4), size_t(BUF_SIZE - 4)), size_t(BUF_SIZE - 4)));
 
            if (n <= 0)
                return EOF;
@@ -100,41 +109,211 @@ namespace kanzi {
          FileInputStream(int fd) : istream(nullptr), _buf(fd) {
             rdbuf(&_buf);
          }
+
+         FileInputStream(kanziReadCallback read, void* userData) : istream(nullptr), _buf(read, userData) {
+            rdbuf(&_buf);
+         }
    };
-}
 
+#ifdef CONCURRENCY_ENABLED
+   // Feed mode: the compressed data provided by feedDecompressor() is queued and
+   // decoded by a dedicated thread, so that decompress() never waits for input.
+   class FeedState FINAL {
+     public:
+       FeedState(size_t capacity)
+          : _inputPos(0), _outputPos(0), _capacity(capacity), _consumed(0)
+          , _last(false), _done(false), _stop(false), _error(0) {
+       }
 
-// Create internal dContext and CompressedInputStream
-KANZI_API int CDECL initDecompressor(struct dData* pData, FILE* src, struct dContext** pCtx) KANZI_NOEXCEPT
-{
-    if ((pData == nullptr) || (pCtx == nullptr) || (src == nullptr))
-        return Error::ERR_INVALID_PARAM;
+       // Stop the decoding thread (pending compressed data is dropped)
+       ~FeedState() {
+          {
+             lock_guard<mutex> lock(_mutex);
+             _stop = true;
+          }
 
-    // Validate buffer size (sanity check against huge allocations, e.g., > 2GB)
-    if (pData->bufferSize > size_t(2) * 1024 * 1024 * 1024)
-        return Error::ERR_INVALID_PARAM;
+          _cond.notify_all();
 
-    dContext* dctx = nullptr;
-    FileInputStream* fis = nullptr;
+          if (_decoder.joinable())
+             _decoder.join();
+       }
 
-    try {
-        const int fd = FILENO(src);
+       void start(CompressedInputStream* pCis) {
+          _decoder = thread(&FeedState::run, this, pCis);
+       }
 
-        if (fd == -1)
-           return Error::ERR_CREATE_DECOMPRESSOR;
+       // Queue the compressed data, ERR_WOULD_BLOCK if it does not fit (nothing queued)
+       int feed(const kanzi::byte* src, size_t srcSize, bool last) {
+          {
+             lock_guard<mutex> lock(_mutex);
+
+             if (_last == true)
+                return Error::ERR_INVALID_PARAM;
+
+             // At most _capacity bytes queued, unless the queue is empty
+             const size_t queued = _input.size() - _inputPos;
+
+             if ((srcSize > 0) && (queued > 0) && (queued + srcSize > _capacity))
+                return Error::ERR_WOULD_BLOCK;
+
+             if (_inputPos > 0) {
+                _input.erase(_input.begin(), _input.begin() + _inputPos);
+                _inputPos = 0;
+             }
+
+             _input.insert(_input.end(), src, src + srcSize);
+             _last = last;
+          }
+
+          _cond.notify_all();
+          return 0;
+       }
+
+       // Return the decompressed data available, ERR_WOULD_BLOCK if there is none yet
+       int get(kanzi::byte* dst, size_t* inSize, size_t* outSize) {
+          size_t n;
+
+          {
+             lock_guard<mutex> lock(_mutex);
+             n = min(*outSize, _output.size() - _outputPos);
+
+             if (n > 0)
+                memcpy(dst, &_output[_outputPos], n);
+
+             _outputPos += n;
+
+             if (inSize)
+                *inSize = size_t(_consumed);
+
+             _consumed = 0;
+             *outSize = n;
+
+             if ((n == 0) && (_done == false))
+                return Error::ERR_WOULD_BLOCK;
+
+             if ((n == 0) && (_error != 0))
+                return _error;
+          }
+
+          _cond.notify_all();
+          return 0;
+       }
+
+       // Read callback of the decoding thread: waits for compressed data
+       static size_t read(void* userData, unsigned char* buffer, size_t size) {
+          FeedState* fs = static_cast<FeedState*>(userData);
+          unique_lock<mutex> lock(fs->_mutex);
+
+          while ((fs->_inputPos == fs->_input.size()) && (fs->_last == false) && (fs->_stop == false))
+             fs->_cond.wait(lock);
+
+          if (fs->_stop == true)
+             return 0;
+
+          const size_t n = min(size, fs->_input.size() - fs->_inputPos);
+          memcpy(buffer, &fs->_input[fs->_inputPos], n);
+          fs->_inputPos += n;
+          fs->_consumed += n;
+          return n;
+       }
+
+     private:
+       mutex _mutex;
+       condition_variable _cond;
+       vector<kanzi::byte> _input; // compressed data not read by the decoder yet
+       size_t _inputPos;
+       vector<kanzi::byte> _output; // decompressed data not returned yet
+       size_t _outputPos;
+       size_t _capacity; // bound of the queued compressed data and of the buffered decompressed data
+       uint64 _consumed; // compressed bytes read since the last get()
+       bool _last;
+       bool _done;
+       bool _stop;
+       int _error;
+       thread _decoder;
+
+       void run(CompressedInputStream* pCis) {
+          vector<kanzi::byte> buf(_capacity);
+          int error = 0;
+
+          try {
+             while (true) {
+                {
+                   unique_lock<mutex> lock(_mutex);
+
+                   while ((_output.size() - _outputPos >= _capacity) && (_stop == false))
+                      _cond.wait(lock);
+
+                   if (_stop == true)
+                      break;
+                }
+
+                // Block here (not in decompress()) until the next block is decoded
+                pCis->readsome(reinterpret_cast<char*>(&buf[0]), streamsize(buf.size()));
+
+                if (!pCis->good() && !pCis->eof()) {
+                   error = Error::ERR_READ_FILE;
+                   break;
+                }
+
+                const size_t n = size_t(pCis->gcount());
+
+                if (n == 0)
+                   break;
+
+                {
+                   lock_guard<mutex> lock(_mutex);
+
+                   if (_outputPos > 0) {
+                      _output.erase(_output.begin(), _output.begin() + _outputPos);
+                      _outputPos = 0;
+                   }
+
+                   _output.insert(_output.end(), buf.begin(), buf.begin() + n);
+                }
+
+                _cond.notify_all();
+             }
+          }
+          catch (const IOException& ioe) {
+             error = ioe.error();
+          }
+          catch (const exception&) {
+             error = Error::ERR_UNKNOWN;
+          }
+
+          {
+             lock_guard<mutex> lock(_mutex);
+             _error = error;
+             _done = true;
+          }
+
+          _cond.notify_all();
+       }
+   };
+#endif
+}
+
+
+// Create internal dContext and CompressedInputStream (fis is owned by the context)
+static int createDecompressor(struct dData* pData, FileInputStream* fis, struct dContext** pCtx)
+{
+    dContext* dctx = nullptr;
 
+    try {
         if ((pData->headerless != 0) &&
             ((memchr(pData->transform, 0, sizeof(pData->transform)) == nullptr) ||
              (memchr(pData->entropy, 0, sizeof(pData->entropy)) == nullptr))) {
+            delete fis;
             return Error::ERR_INVALID_PARAM;
         }
 
         // Create decompression stream and context
         *pCtx = nullptr;
-        fis = new FileInputStream(fd);
         dctx = new dContext();
         dctx->pCis = nullptr;
         dctx->fis = nullptr;
+        dctx->feed = nullptr;
 
         if (pData->headerless != 0) {
            // Headerless mode: process params
@@ -184,15 +363,112 @@ KANZI_API int CDECL initDecompressor(struct dData* pData, FILE* src, struct dCon
             dctx = nullptr;
         }
 
-        if (fis != nullptr) {
-           delete fis;
-           fis = nullptr;
+        delete fis;
+        return Error::ERR_CREATE_DECOMPRESSOR;
+    }
+
+    return 0;
+}
+
+KANZI_API int CDECL initDecompressor(struct dData* pData, FILE* src, struct dContext** pCtx) KANZI_NOEXCEPT
+{
+    if ((pData == nullptr) || (pCtx == nullptr) || (src == nullptr))
+        return Error::ERR_INVALID_PARAM;
+
+    // Validate buffer size (sanity check against huge allocations, e.g., > 2GB)
+    if (pData->bufferSize > size_t(2) * 1024 * 1024 * 1024)
+        return Error::ERR_INVALID_PARAM;
+
+    try {
+        const int fd = FILENO(src);
+
+        if (fd == -1)
+           return Error::ERR_CREATE_DECOMPRESSOR;
+
+        return createDecompressor(pData, new FileInputStream(fd), pCtx);
+    }
+    catch (const exception&) {
+        return Error::ERR_CREATE_DECOMPRESSOR;
+    }
+}
+
+KANZI_API int CDECL initDecompressorWithCallback(struct dData* pData, kanziReadCallback read,
+                                                 void* userData, struct dContext** pCtx) KANZI_NOEXCEPT
+{
+    if ((pData == nullptr) || (pCtx == nullptr) || (read == nullptr))
+        return Error::ERR_INVALID_PARAM;
+
+    // Validate buffer size (sanity check against huge allocations, e.g., > 2GB)
+    if (pData->bufferSize > size_t(2) * 1024 * 1024 * 1024)
+        return Error::ERR_INVALID_PARAM;
+
+    try {
+        return createDecompressor(pData, new FileInputStream(read, userData), pCtx);
+    }
+    catch (const exception&) {
+        return Error::ERR_CREATE_DECOMPRESSOR;
+    }
+}
+
+KANZI_API int CDECL initDecompressorWithFeed(struct dData* pData, struct dContext** pCtx) KANZI_NOEXCEPT
+{
+    if ((pData == nullptr) || (pCtx == nullptr))
+        return Error::ERR_INVALID_PARAM;
+
+    // Validate buffer size (sanity check against huge allocations, e.g., > 2GB)
+    if (pData->bufferSize > size_t(2) * 1024 * 1024 * 1024)
+        return Error::ERR_INVALID_PARAM;
+
+#ifdef CONCURRENCY_ENABLED
+    FeedState* fs = nullptr;
+    *pCtx = nullptr;
+
+    try {
+        fs = new FeedState(max(pData->bufferSize, size_t(1024)));
+        const int res = createDecompressor(pData, new FileInputStream(FeedState::read, fs), pCtx);
+
+        if (res != 0) {
+            delete fs;
+            return res;
         }
 
+        (*pCtx)->feed = fs;
+        fs->start((*pCtx)->pCis);
+        return 0;
+    }
+    catch (const exception&) {
+        if (*pCtx != nullptr)
+            disposeDecompressor(pCtx); // also deletes fs
+        else
+            delete fs;
+
         return Error::ERR_CREATE_DECOMPRESSOR;
     }
+#else
+    // No thread to decode the blocks in the background
+    return Error::ERR_CREATE_DECOMPRESSOR;
+#endif
+}
 
-    return 0;
+KANZI_API int CDECL feedDecompressor(struct dContext* pCtx, const unsigned char* src,
+                                     size_t srcSize, int last) KANZI_NOEXCEPT
+{
+    if ((pCtx == nullptr) || (pCtx->feed == nullptr))
+        return Error::ERR_INVALID_PARAM;
+
+    if ((src == nullptr) && (srcSize != 0))
+        return Error::ERR_INVALID_PARAM;
+
+#ifdef CONCURRENCY_ENABLED
+    try {
+        return static_cast<FeedState*>(pCtx->feed)->feed((const kanzi::byte*)src, srcSize, last != 0);
+    }
+    catch (const exception&) {
+        return Error::ERR_UNKNOWN;
+    }
+#else
+    return Error::ERR_INVALID_PARAM;
+#endif
 }
 
 
@@ -224,6 +500,18 @@ KANZI_API int CDECL decompress(struct dContext* pCtx, unsigned char* dst,
         return Error::ERR_INVALID_PARAM;
     }
 
+#ifdef CONCURRENCY_ENABLED
+    if (pCtx->feed != nullptr) {
+        try {
+            return static_cast<FeedState*>(pCtx->feed)->get((kanzi::byte*)dst, inSize, outSize);
+        }
+        catch (const exception&) {
+            *outSize = 0;
+            return Error::ERR_UNKNOWN;
+        }
+    }
+#endif
+
     try {
         const uint64 r = pCis->getRead();
         pCis->read((char*)dst, std::streamsize(*outSize));
@@ -257,6 +545,12 @@ KANZI_API int CDECL disposeDecompressor(struct dContext** ppCtx) KANZI_NOEXCEPT
     dContext* pCtx = *ppCtx;
     CompressedInputStream* pCis = static_cast<CompressedInputStream*>(pCtx->pCis);
 
+#ifdef CONCURRENCY_ENABLED
+    // Stop the decoding thread before the stream is released
+    delete static_cast<FeedState*>(pCtx->feed);
+#endif
+    pCtx->feed = nullptr;
+
     try {
         if (pCis != nullptr) {
             pCis->close();
@@ -305,6 +599,67 @@ KANZI_API int CDECL disposeDecompressor(struct dContext** ppCtx) KANZI_NOEXCEPT
     return 0;
 }
 
+// One shot decompression: no context, no intermediate stream
+KANZI_API int CDECL decompressBuffer(struct dData* pData, const unsigned char* src, size_t srcSize,
+                                     unsigned char* dst, size_t* dstSize) KANZI_NOEXCEPT
+{
+    if ((pData == nullptr) || (src == nullptr) || (dstSize == nullptr))
+        return Error::ERR_INVALID_PARAM;
+
+    if ((dst == nullptr) && (*dstSize != 0))
+        return Error::ERR_INVALID_PARAM;
+
+    try {
+        Context ctx;
+        ctx.putInt(Context::JOBS, int(pData->jobs));
+
+        if (pData->headerless != 0) {
+           if ((memchr(pData->transform, 0, sizeof(pData->transform)) == nullptr) ||
+               (memchr(pData->entropy, 0, sizeof(pData->entropy)) == nullptr)) {
+               return Error::ERR_INVALID_PARAM;
+           }
+
+           string transform = TransformFactory<kanzi::byte>::getName(TransformFactory<kanzi::byte>::getType(pData->transform));
+           string entropy = EntropyDecoderFactory::getName(EntropyDecoderFactory::getType(pData->entropy));
+
+           if ((transform.length() >= sizeof(pData->transform)) ||
+               (entropy.length() >= sizeof(pData->entropy))) {
+               return Error::ERR_INVALID_PARAM;
+           }
+
+           memset(pData->transform, 0, sizeof(pData->transform));
+           strncpy(pData->transform, transform.c_str(), sizeof(pData->transform) - 1);
+           memset(pData->entropy, 0, sizeof(pData->entropy));
+           strncpy(pData->entropy, entropy.c_str(), sizeof(pData->entropy) - 1);
+
+           pData->blockSize = (pData->blockSize + 15) & -16;
+           ctx.putString("transform", transform);
+           ctx.putString("entropy", entropy);
+           ctx.putInt(Context::BLOCK_SIZE, int(pData->blockSize));
+           ctx.putInt(Context::CHECKSUM, pData->checksum);
+           ctx.putInt(Context::BS_VERSION, pData->bsVersion);
+
+           if (pData->originalSize != 0)
+               ctx.putLong("outputSize", int64(pData->originalSize));
+        }
+
+        *dstSize = size_t(CompressedInputStream::decompressBuffer(reinterpret_cast<const kanzi::byte*>(src),
+            int64(srcSize), reinterpret_cast<kanzi::byte*>(dst),
+            int64(*dstSize), ctx, pData->headerless != 0));
+    }
+    catch (const IOException& ioe) {
+        return ioe.error();
+    }
+    catch (const invalid_argument&) {
+        return Error::ERR_INVALID_PARAM;
+    }
+    catch (const exception&) {
+        return Error::ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
 KANZI_API unsigned int CDECL getDecompressorVersion(void) KANZI_NOEXCEPT
 {
     return  (KANZI_DECOMP_VERSION_MAJOR << 16) |
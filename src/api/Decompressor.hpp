@@ -45,7 +45,7 @@ limitations under the License.
 
 
 #define KANZI_DECOMP_VERSION_MAJOR 1
-#define KANZI_DECOMP_VERSION_MINOR 0
+#define KANZI_DECOMP_VERSION_MINOR 2
 #define KANZI_DECOMP_VERSION_PATCH 0
 
 
@@ -69,13 +69,27 @@ limitations under the License.
        // Optional fields: only required if headerless is true
        char transform[64];           /* name of transforms [None|PACK|BWT|BWTS|LZ|LZX|LZP|ROLZ|ROLZX]
                                                        [RLT|ZRLT|MTFT|RANK|SRT|TEXT|MM|EXE|UTF|DNA] */
-       char entropy[16];             /* name of entropy codec [None|Huffman|ANS0|ANS1|Range|FPAQ|TPAQ|TPAQX|CM] */
+       char entropy[16];             /* name of entropy codec [None|Huffman|ANS0|ANS0X|ANS1|Range|FPAQ|TPAQ|TPAQX|CM] */
        unsigned int blockSize;       /* size of block in bytes */
        size_t originalSize;          /* size of original file in bytes */
        int checksum;                 /* 0, 32 or 64 to indicate size of block checksum */
        int bsVersion;                /* version of the bitstream */
    };
 
+   /**
+    *  Read callback: provides the compressed data (used instead of a FILE*).
+    *  Called from the thread invoking decompress(). Like read(2) on a blocking
+    *  descriptor, it must wait for data: returning 0 ends the compressed stream.
+    *  Use initDecompressorWithFeed() if no data may be available yet (event loop).
+    *
+    *  @param userData [IN] - the pointer provided at initialization
+    *  @param buffer [IN] - the buffer receiving the compressed data
+    *  @param size [IN] - the capacity of the buffer
+    *
+    *  @return the number of bytes read, 0 at the end of the compressed data
+    */
+   typedef size_t (CDECL *kanziReadCallback)(void* userData, unsigned char* buffer, size_t size);
+
    /**
     * @return the version number of the library.
     * Useful for checking for compatibility at runtime.
@@ -94,6 +108,54 @@ limitations under the License.
     */
    KANZI_API int CDECL initDecompressor(struct dData* dParam, FILE* src, struct dContext** ctx) KANZI_NOEXCEPT;
 
+   /**
+    *  Initialize the decompressor internal states. Same as initDecompressor but the
+    *  compressed data is provided by a callback (eg. socket, memory arena).
+    *
+    *  @param dParam [IN|OUT] - the decompression parameters. Transform and entropy are
+    *                           validated and rewritten.
+    *  @param read [IN] - the callback providing the compressed data
+    *  @param userData [IN] - a pointer passed to the callback
+    *  @param ctx [IN|OUT] - a pointer to the decompression context created by the call
+    *
+    *  @return 0 in case of success, else see error code in Error.hpp
+    */
+   KANZI_API int CDECL initDecompressorWithCallback(struct dData* dParam, kanziReadCallback read,
+                                                    void* userData, struct dContext** ctx) KANZI_NOEXCEPT;
+
+   /**
+    *  Initialize the decompressor internal states in feed mode: the compressed data
+    *  is pushed with feedDecompressor() and the blocks are decoded by a background
+    *  thread. decompress() never waits: it returns ERR_WOULD_BLOCK if no decompressed
+    *  data is available yet. Not available in builds without concurrency support.
+    *
+    *  @param dParam [IN|OUT] - the decompression parameters. Transform and entropy are
+    *                           validated and rewritten.
+    *  @param ctx [IN|OUT] - a pointer to the decompression context created by the call
+    *
+    *  @return 0 in case of success, else see error code in Error.hpp
+    */
+   KANZI_API int CDECL initDecompressorWithFeed(struct dData* dParam, struct dContext** ctx) KANZI_NOEXCEPT;
+
+   /**
+    *  Provide compressed data to a decompressor initialized in feed mode.
+    *  The data is copied, the call does not wait for the decoder. At most
+    *  bufferSize compressed bytes are queued: if the data does not fit, nothing
+    *  is copied and ERR_WOULD_BLOCK is returned (read decompressed data with
+    *  decompress() to let the decoder progress, then feed the data again).
+    *  A call on an empty queue always succeeds.
+    *
+    *  @param ctx [IN] - the decompression context created by initDecompressorWithFeed()
+    *  @param src [IN] - the compressed data
+    *  @param srcSize [IN] - the size of the compressed data (may be 0)
+    *  @param last [IN] - bool to indicate the end of the compressed data
+    *
+    *  @return 0 in case of success, ERR_WOULD_BLOCK if the queue is full,
+    *          else see error code in Error.hpp
+    */
+   KANZI_API int CDECL feedDecompressor(struct dContext* ctx, const unsigned char* src,
+                                        size_t srcSize, int last) KANZI_NOEXCEPT;
+
    /**
     *  Decompress a block of data. The decompressor must have been initialized.
     *
@@ -101,9 +163,13 @@ limitations under the License.
     *  @param dst [IN] - the destination block of decompressed data
     *  @param inSize [OUT] - the number of bytes read from source.
     *  @param outSize [IN|OUT] - the size of the block to decompress.
-    *                            Updated to reflect the number of decompressed bytes
+    *                            Updated to reflect the number of decompressed bytes.
+    *                            In feed mode, fewer bytes than requested may be
+    *                            returned (data decoded so far).
+    *                            0 means that the end of stream has been reached.
     *
-    *  @return 0 in case of success, else see error code in Error.hpp
+    *  @return 0 in case of success, ERR_WOULD_BLOCK in feed mode if no data is
+    *          available yet (the stream is not ended), else see error code in Error.hpp
     */
    KANZI_API int CDECL decompress(struct dContext* ctx, unsigned char* dst, size_t* inSize, size_t* outSize) KANZI_NOEXCEPT;
 
@@ -116,6 +182,24 @@ limitations under the License.
     */
    KANZI_API int CDECL disposeDecompressor(struct dContext** ctx) KANZI_NOEXCEPT;
 
+   /**
+    *  Decompress a buffer in one call, without decompression context.
+    *  The blocks are decoded (up to 'jobs' blocks in parallel) to the destination buffer.
+    *
+    *  @param dParam [IN|OUT] - the decompression parameters (bufferSize is ignored).
+    *                           Transform and entropy are validated and rewritten
+    *                           in headerless mode.
+    *  @param src [IN] - the compressed data
+    *  @param srcSize [IN] - the size of the compressed data
+    *  @param dst [IN] - the destination buffer
+    *  @param dstSize [IN|OUT] - the capacity of the destination buffer.
+    *                            Updated to reflect the size of the decompressed data.
+    *
+    *  @return 0 in case of success, else see error code in Error.hpp
+    */
+   KANZI_API int CDECL decompressBuffer(struct dData* dParam, const unsigned char* src, size_t srcSize,
+                                        unsigned char* dst, size_t* dstSize) KANZI_NOEXCEPT;
+
 #ifdef __cplusplus
    }
 #endif
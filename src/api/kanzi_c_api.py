@@ -95,6 +95,21 @@ _lib.initCompressor.argtypes = [
 ]
 _lib.initCompressor.restype = ctypes.c_int
 
+kanziWriteCallback = ctypes.CFUNCTYPE(
+    ctypes.c_size_t,
+    ctypes.c_void_p,
+    ctypes.POINTER(ctypes.c_ubyte),
+    ctypes.c_size_t,
+)
+
+_lib.initCompressorWithCallback.argtypes = [
+    ctypes.POINTER(cData),
+    kanziWriteCallback,
+    ctypes.c_void_p,
+    ctypes.POINTER(cContext_p),
+]
+_lib.initCompressorWithCallback.restype = ctypes.c_int
+
 _lib.compress.argtypes = [
     cContext_p,
     ctypes.POINTER(ctypes.c_ubyte),
@@ -103,12 +118,35 @@ _lib.compress.argtypes = [
 ]
 _lib.compress.restype = ctypes.c_int
 
+_lib.tryCompress.argtypes = [
+    cContext_p,
+    ctypes.POINTER(ctypes.c_ubyte),
+    ctypes.c_size_t,
+    ctypes.POINTER(ctypes.c_size_t),
+]
+_lib.tryCompress.restype = ctypes.c_int
+
 _lib.disposeCompressor.argtypes = [
     ctypes.POINTER(cContext_p),
     ctypes.POINTER(ctypes.c_size_t),
 ]
 _lib.disposeCompressor.restype = ctypes.c_int
 
+_lib.compressBound.argtypes = [
+    ctypes.c_size_t,
+    ctypes.c_size_t,
+]
+_lib.compressBound.restype = ctypes.c_size_t
+
+_lib.compressBuffer.argtypes = [
+    ctypes.POINTER(cData),
+    ctypes.POINTER(ctypes.c_ubyte),
+    ctypes.c_size_t,
+    ctypes.POINTER(ctypes.c_ubyte),
+    ctypes.POINTER(ctypes.c_size_t),
+]
+_lib.compressBuffer.restype = ctypes.c_int
+
 # -----------------------------------------------------------------------------
 # Function prototypes - Decompressor
 # -----------------------------------------------------------------------------
@@ -123,6 +161,35 @@ _lib.initDecompressor.argtypes = [
 ]
 _lib.initDecompressor.restype = ctypes.c_int
 
+kanziReadCallback = ctypes.CFUNCTYPE(
+    ctypes.c_size_t,
+    ctypes.c_void_p,
+    ctypes.POINTER(ctypes.c_ubyte),
+    ctypes.c_size_t,
+)
+
+_lib.initDecompressorWithCallback.argtypes = [
+    ctypes.POINTER(dData),
+    kanziReadCallback,
+    ctypes.c_void_p,
+    ctypes.POINTER(dContext_p),
+]
+_lib.initDecompressorWithCallback.restype = ctypes.c_int
+
+_lib.initDecompressorWithFeed.argtypes = [
+    ctypes.POINTER(dData),
+    ctypes.POINTER(dContext_p),
+]
+_lib.initDecompressorWithFeed.restype = ctypes.c_int
+
+_lib.feedDecompressor.argtypes = [
+    dContext_p,
+    ctypes.POINTER(ctypes.c_ubyte),
+    ctypes.c_size_t,
+    ctypes.c_int,
+]
+_lib.feedDecompressor.restype = ctypes.c_int
+
 _lib.decompress.argtypes = [
     dContext_p,
     ctypes.POINTER(ctypes.c_ubyte),
@@ -136,6 +203,15 @@ _lib.disposeDecompressor.argtypes = [
 ]
 _lib.disposeDecompressor.restype = ctypes.c_int
 
+_lib.decompressBuffer.argtypes = [
+    ctypes.POINTER(dData),
+    ctypes.POINTER(ctypes.c_ubyte),
+    ctypes.c_size_t,
+    ctypes.POINTER(ctypes.c_ubyte),
+    ctypes.POINTER(ctypes.c_size_t),
+]
+_lib.decompressBuffer.restype = ctypes.c_int
+
 # -----------------------------------------------------------------------------
 # Optional helpers (recommended for kanzi.py)
 # -----------------------------------------------------------------------------
@@ -21,8 +21,10 @@ limitations under the License.
 #include "InfoPrinter.hpp"
 #include "../SliceArray.hpp"
 #include "../transform/TransformFactory.hpp"
+#include "../io/BlockPlanner.hpp"
 #include "../io/IOException.hpp"
 #include "../io/IOUtil.hpp"
+#include "../io/MappedFile.hpp"
 #include "../io/NullOutputStream.hpp"
 #include "../util/Clock.hpp"
 #include "../util/Printer.hpp"
@@ -43,6 +45,7 @@ const int BlockCompressor::MAX_BLOCK_SIZE = 1024 * 1024 * 1024;
 BlockCompressor::BlockCompressor(const Context& ctx) :
             _ctx(ctx)
 {
+    _dict = nullptr;
     int level = -1;
 
     if (_ctx.has("level") == true) {
@@ -73,6 +76,28 @@ BlockCompressor::BlockCompressor(const Context& ctx) :
        }
     }
 
+    // Codecs chosen per block (see BlockSelector) among the levels up to the
+    // provided one or, if codecs are provided instead of a level, between
+    // these codecs and a copy of the block
+    if ((_ctx.getInt("auto", 0) != 0) && (level != 0)) {
+        stringstream ss;
+
+        if ((level < 0) && ((_ctx.has("transform") == true) || (_ctx.has("entropy") == true))) {
+            ss << _transform << "/" << _codec;
+        }
+        else {
+            const int maxLevel = (level < 0) ? 3 : level;
+
+            for (int i = 1; i <= maxLevel; i++) {
+                string tranformAndCodec[2];
+                getTransformAndCodec(i, tranformAndCodec);
+                ss << ((i > 1) ? "," : "") << tranformAndCodec[0] << "/" << tranformAndCodec[1];
+            }
+        }
+
+        _ctx.putString("autoCodecs", ss.str());
+    }
+
     _checksum = _ctx.getInt("checksum", 0);
 
     if ((_checksum != 0) && (_checksum != 32) && (_checksum != 64))
@@ -158,12 +183,21 @@ BlockCompressor::BlockCompressor(const Context& ctx) :
         bl = (bl + 15) & ~uint64(15);
         _blockSize = int(min(bl, uint64(MAX_BLOCK_SIZE)));
     }
+
+    if (_ctx.has("dictionary") == true) {
+        // The block tasks get the dictionary from copies of the context
+        _dict = Dictionary::load(_ctx.getString("dictionary"));
+        _ctx.setDictionary(_dict);
+    }
 }
 
 BlockCompressor::~BlockCompressor()
 {
     dispose();
     _listeners.clear();
+
+    if (_dict != nullptr)
+        delete _dict;
 }
 
 int BlockCompressor::compress(uint64& outputSize)
@@ -241,7 +275,16 @@ int BlockCompressor::compress(uint64& outputSize)
         string ecodec = _codec;
         transform(ecodec.begin(), ecodec.end(), ecodec.begin(), safeToUpper);
         ss << "Using " << (ecodec == "NONE" ? "no" : _codec) << " entropy codec (stage 2)" << endl;
+
+        if (_ctx.has("autoCodecs") == true)
+            ss << "Choosing the codecs of each block among " << _ctx.getString("autoCodecs") << endl;
+
         ss << "Using " << _jobs << " job" << (_jobs > 1 ? "s" : "") << endl;
+
+        if (_dict != nullptr) {
+            ss << "Using dictionary " << _ctx.getString("dictionary") << " (" << _dict->size() << " bytes, ID ";
+            ss << hex << _dict->getId() << dec << ")" << endl;
+        }
         log.print(ss.str(), true);
         ss.str(string());
     }
@@ -313,7 +356,9 @@ int BlockCompressor::compress(uint64& outputSize)
     }
 
 #ifdef CONCURRENCY_ENABLED
-    ThreadPool pool(_jobs + 1); // +1 to avoid deadlock due to thread exhaustion
+    // Runs the file workers and the block tasks of all the files. Tasks waiting
+    // for other tasks run pending tasks meanwhile (see ThreadPool::get).
+    ThreadPool pool(_jobs);
 #endif
 
     _ctx.putInt("verbosity", _verbosity);
@@ -331,13 +376,6 @@ int BlockCompressor::compress(uint64& outputSize)
             iName = files[0].fullPath();
             _ctx.putLong("fileSize", files[0]._size);
 
-            // Set the block size to optimize compression ratio when possible
-            if ((_autoBlockSize == true) && (_jobs > 0)) {
-                const int64 bl = files[0]._size / _jobs;
-                _blockSize = int(max(min((bl + 63) & ~63, int64(MAX_BLOCK_SIZE)), int64(MIN_BLOCK_SIZE)));
-                _ctx.putInt("blockSize", _blockSize);
-            }
-
             if (oName.length() == 0) {
                 oName = iName + ".knz";
             }
@@ -365,6 +403,14 @@ int BlockCompressor::compress(uint64& outputSize)
         vector<int> jobsPerTask(nbFiles);
         vector<FileCompressWorker<FCTask*, FileCompressResult>*> workers;
         Global::computeJobsPerTask(jobsPerTask.data(), _jobs, nbFiles);
+
+        // The files compressed concurrently share the memory budget
+        int64 budget = _ctx.getLong("maxMemory", 0);
+
+        if (budget <= 0)
+            budget = BlockPlanner::getDefaultBudget();
+
+        budget /= int64(min(_jobs, nbFiles));
 #endif
 
         try {
@@ -383,17 +429,10 @@ int BlockCompressor::compress(uint64& outputSize)
                     oName = formattedOutName + iName.substr(formattedInName.size()) + ".knz";
                 }
 
-                int blockSize = _blockSize;
-
-                // Set the block size to optimize compression ratio when possible
-                if ((_autoBlockSize == true) && (_jobs > 0)) {
-                    const int64 bl = files[i]._size / _jobs;
-                    blockSize = int(max(min((bl + 63) & ~63, int64(MAX_BLOCK_SIZE)), int64(MIN_BLOCK_SIZE)));
-                }
-
 #ifdef CONCURRENCY_ENABLED
                 Context taskCtx(_ctx, &pool);
                 taskCtx.putInt("jobs", jobsPerTask[i]);
+                taskCtx.putLong("maxMemory", budget);
 #else
                 Context taskCtx(_ctx);
                 taskCtx.putInt("jobs", 1);
@@ -401,7 +440,6 @@ int BlockCompressor::compress(uint64& outputSize)
                 taskCtx.putLong("fileSize", files[i]._size);
                 taskCtx.putString("inputName", iName);
                 taskCtx.putString("outputName", oName);
-                taskCtx.putInt("blockSize", blockSize);
                 tasks.push_back(new FileCompressTask<FileCompressResult>(taskCtx, _listeners));
             }
 
@@ -416,13 +454,13 @@ int BlockCompressor::compress(uint64& outputSize)
 
                 try {
                     // Create one worker per job and run it. A worker calls several tasks sequentially.
+                    // File workers are tasks of the pool: while waiting for its blocks, a file
+                    // worker runs pending block tasks (see ThreadPool::get), so there are no
+                    // more threads than jobs.
                     for (int i = 0; i < _jobs; i++) {
                         workers.push_back(new FileCompressWorker<FCTask*, FileCompressResult>(&queue));
 
-                        if (_ctx.getPool() == nullptr)
-                            results.push_back(std::async(launch::async, &FileCompressWorker<FCTask*, FileCompressResult>::run, workers[i]));
-                        else
-                            results.push_back(_ctx.getPool()->schedule(&FileCompressWorker<FCTask*, FileCompressResult>::run, workers[i]));
+                        results.push_back(pool.schedule(&FileCompressWorker<FCTask*, FileCompressResult>::run, workers[i]));
                     }
 
                     // Wait for results
@@ -754,6 +792,39 @@ T FileCompressTask<T>::run()
         }
 
         try {
+            // Choose the block size (if 'auto') and the number of blocks
+            // encoded concurrently
+            const string entropy = _ctx.getString("entropy");
+            const string transform = _ctx.getString("transform");
+            const string candidates = _ctx.getString("autoCodecs", "");
+            const BlockPlan plan = BlockPlanner::plan(_ctx);
+
+            if (_ctx.getString("autoCodecs", "") != candidates) {
+                ss << "Warning: using codecs " << _ctx.getString("autoCodecs") << " instead of ";
+                ss << candidates << " to fit in the memory budget";
+                log.println(ss.str(), verbosity > 0);
+                ss.str(string());
+            }
+
+            if ((_ctx.getString("entropy") != entropy) || (_ctx.getString("transform") != transform)) {
+                ss << "Warning: using " << _ctx.getString("transform") << "&" << _ctx.getString("entropy");
+                ss << " instead of " << transform << "&" << entropy << " to fit in the memory budget";
+                log.println(ss.str(), verbosity > 0);
+                ss.str(string());
+            }
+
+            if (verbosity > 1) {
+                ss << "Plan: " << plan.toString();
+                log.println(ss.str(), true);
+                ss.str(string());
+            }
+
+            if (plan.isOverBudget() == true) {
+                ss << "Warning: the estimated memory (" << plan._memory << " bytes) exceeds the budget";
+                log.println(ss.str(), verbosity > 0);
+                ss.str(string());
+            }
+
             _cos = new CompressedOutputStream(*os, _ctx);
 
             for (uint i = 0; i < _listeners.size(); i++)
@@ -778,6 +849,10 @@ T FileCompressTask<T>::run()
                             _is = nullptr; \
                          }
 
+    // Large regular files are mapped in memory and the block tasks read them
+    // directly (see CompressedOutputStream::writeNoCopy).
+    MappedFile mappedInput;
+
     try {
         string str = inputName;
         transform(str.begin(), str.end(), str.begin(), safeToUpper);
@@ -785,6 +860,9 @@ T FileCompressTask<T>::run()
         if (str == "STDIN") {
             _is = &cin;
         }
+        else if ((_ctx.getLong("fileSize", 0) >= MIN_MAPPED_FILE_SIZE) && (mappedInput.openRead(inputName) == true)) {
+            _is = nullptr;
+        }
         else {
             ifstream* ifs = new ifstream(inputName.c_str(), ifstream::in | ifstream::binary);
 
@@ -828,15 +906,33 @@ T FileCompressTask<T>::run()
     Clock stopClock;
 
     try {
-        while (true) {
-            int len;
-
-            try {
-                _is->read(reinterpret_cast<char*>(&sa._array[0]), sa._length);
-                len = int(_is->gcount());
+        if (mappedInput.data() != nullptr) {
+            _cos->writeNoCopy(reinterpret_cast<const char*>(mappedInput.data()), streamsize(mappedInput.size()));
+            read = mappedInput.size();
+        }
+        else {
+            while (true) {
+                int len;
 
-                if ((_is->bad() == true) || ((_is->fail() == true) && (_is->eof() == false))) {
-                    const string state = FileCompressTask<T>::describeStreamState(*_is);
+                try {
+                    _is->read(reinterpret_cast<char*>(&sa._array[0]), sa._length);
+                    len = int(_is->gcount());
+
+                    if ((_is->bad() == true) || ((_is->fail() == true) && (_is->eof() == false))) {
+                        const string state = FileCompressTask<T>::describeStreamState(*_is);
+                        CLEANUP_COMP_IS
+                        const uint64 w = _cos->getWritten();
+                        delete[] buf;
+                        delete _cos;
+                        _cos = nullptr;
+                        CLEANUP_COMP_OS
+                        stringstream sserr;
+                        sserr << "Failed to read block from file '" << inputName << "'";
+                        sserr << " (stream state: " << state << ")";
+                        return T(Error::ERR_READ_FILE, read, w, sserr.str().c_str());
+                    }
+                }
+                catch (const exception& e) {
                     CLEANUP_COMP_IS
                     const uint64 w = _cos->getWritten();
                     delete[] buf;
@@ -844,30 +940,18 @@ T FileCompressTask<T>::run()
                     _cos = nullptr;
                     CLEANUP_COMP_OS
                     stringstream sserr;
-                    sserr << "Failed to read block from file '" << inputName << "'";
-                    sserr << " (stream state: " << state << ")";
+                    sserr << "Failed to read block from file '" << inputName << "': ";
+                    sserr << e.what() << endl;
                     return T(Error::ERR_READ_FILE, read, w, sserr.str().c_str());
                 }
-            }
-            catch (const exception& e) {
-                CLEANUP_COMP_IS
-                const uint64 w = _cos->getWritten();
-                delete[] buf;
-                delete _cos;
-                _cos = nullptr;
-                CLEANUP_COMP_OS
-                stringstream sserr;
-                sserr << "Failed to read block from file '" << inputName << "': ";
-                sserr << e.what() << endl;
-                return T(Error::ERR_READ_FILE, read, w, sserr.str().c_str());
-            }
 
-            if (len <= 0)
-                break;
+                if (len <= 0)
+                    break;
 
-            // Just write block to the compressed output stream !
-            read += len;
-            _cos->write(reinterpret_cast<const char*>(&sa._array[0]), len);
+                // Just write block to the compressed output stream !
+                read += len;
+                _cos->write(reinterpret_cast<const char*>(&sa._array[0]), len);
+            }
         }
     }
     catch (const IOException& ioe) {
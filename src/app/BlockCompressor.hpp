@@ -20,6 +20,7 @@ limitations under the License.
 #include <map>
 #include <vector>
 #include "../InputStream.hpp"
+#include "../Dictionary.hpp"
 #include "../io/CompressedOutputStream.hpp"
 
 namespace kanzi {
@@ -98,6 +99,7 @@ namespace kanzi {
    class FileCompressTask FINAL : public Task<T> {
    public:
        static const int DEFAULT_BUFFER_SIZE = 65536;
+       static const int64 MIN_MAPPED_FILE_SIZE = 4 * 1024 * 1024;
 
        FileCompressTask(const Context& ctx, std::vector<Listener<Event>*>& listeners);
 
@@ -159,6 +161,7 @@ namespace kanzi {
        bool _noDotFiles;
        bool _noLinks;
        Context _ctx;
+       Dictionary* _dict; // owned, shared by the tasks
 
        static void notifyListeners(std::vector<Listener<Event>*>& listeners, const Event& evt);
 
@@ -23,6 +23,7 @@ limitations under the License.
 #include "../SliceArray.hpp"
 #include "../io/IOException.hpp"
 #include "../io/IOUtil.hpp"
+#include "../io/MappedFile.hpp"
 #include "../io/NullOutputStream.hpp"
 #include "../util/Clock.hpp"
 #include "../util/Printer.hpp"
@@ -37,6 +38,7 @@ using namespace std;
 BlockDecompressor::BlockDecompressor(const Context& ctx) :
      _ctx(ctx)
 {
+    _dict = nullptr;
     _blockSize = 0;
     _overwrite = _ctx.getInt("overwrite", 0) != 0;
     _ctx.putInt("overwrite", _overwrite ? 1 : 0);
@@ -67,12 +69,21 @@ BlockDecompressor::BlockDecompressor(const Context& ctx) :
 
     if (Global::isReservedName(_outputName))
         throw invalid_argument("'" + _outputName + "' is a reserved name");
+
+    if (_ctx.has("dictionary") == true) {
+        // The block tasks get the dictionary from copies of the context
+        _dict = Dictionary::load(_ctx.getString("dictionary"));
+        _ctx.setDictionary(_dict);
+    }
 }
 
 BlockDecompressor::~BlockDecompressor()
 {
     dispose();
     _listeners.clear();
+
+    if (_dict != nullptr)
+        delete _dict;
 }
 
 int BlockDecompressor::decompress(uint64& inputSize)
@@ -157,6 +168,11 @@ int BlockDecompressor::decompress(uint64& inputSize)
         ss << "Verbosity: " << _verbosity << endl;
         ss << "Overwrite: " << (_overwrite ? "true" : "false") << endl;
         ss << "Using " << _jobs << " job" << (_jobs > 1 ? "s" : "") << endl;
+
+        if (_dict != nullptr) {
+            ss << "Using dictionary " << _ctx.getString("dictionary") << " (" << _dict->size() << " bytes, ID ";
+            ss << hex << _dict->getId() << dec << ")" << endl;
+        }
         log.print(ss.str(), true);
         ss.str(string());
     }
@@ -231,7 +247,9 @@ int BlockDecompressor::decompress(uint64& inputSize)
     _ctx.putInt("verbosity", _verbosity);
 
 #ifdef CONCURRENCY_ENABLED
-    ThreadPool pool(_jobs + 1); // +1 to avoid deadlock due to thread exhaustion
+    // Runs the file workers and the block tasks of all the files. Tasks waiting
+    // for other tasks run pending tasks meanwhile (see ThreadPool::get).
+    ThreadPool pool(_jobs);
 #endif
 
     // Run the task(s)
@@ -318,6 +336,10 @@ int BlockDecompressor::decompress(uint64& inputSize)
 #ifdef CONCURRENCY_ENABLED
                 Context taskCtx(_ctx, &pool);
                 taskCtx.putInt("jobs", jobsPerTask[i]);
+
+                // The files decompressed concurrently share the memory budget
+                if (_ctx.getLong("maxMemory", 0) > 0)
+                    taskCtx.putLong("maxMemory", _ctx.getLong("maxMemory", 0) / int64(min(_jobs, nbFiles)));
 #else
                 Context taskCtx(_ctx);
                 taskCtx.putInt("jobs", 1);
@@ -339,13 +361,13 @@ int BlockDecompressor::decompress(uint64& inputSize)
 
                 try {
                     // Create one worker per job and run it. A worker calls several tasks sequentially.
+                    // File workers are tasks of the pool: while waiting for its blocks, a file
+                    // worker runs pending block tasks (see ThreadPool::get), so there are no
+                    // more threads than jobs.
                     for (int i = 0; i < _jobs; i++) {
                         workers.push_back(new FileDecompressWorker<FileDecompressTask<FileDecompressResult>*, FileDecompressResult>(&queue));
 
-                        if (_ctx.getPool() == nullptr)
-                            results.push_back(std::async(launch::async, &FileDecompressWorker<FDTask*, FileDecompressResult>::run, workers[i]));
-                        else
-                            results.push_back(_ctx.getPool()->schedule(&FileDecompressWorker<FDTask*, FileDecompressResult>::run, workers[i]));
+                        results.push_back(pool.schedule(&FileDecompressWorker<FDTask*, FileDecompressResult>::run, workers[i]));
                     }
 
                     // Wait for results
@@ -677,6 +699,10 @@ T FileDecompressTask<T>::run()
     Clock stopClock;
     kanzi::byte* buf = new kanzi::byte[DEFAULT_BUFFER_SIZE];
 
+    // Large outputs of known size are mapped in memory. The decoded blocks are
+    // copied straight to the mapping instead of going through the stream buffers.
+    MappedFile mappedOutput;
+
 #define CLEANUP_DECOMP_RESOURCES(readVar) \
     dispose(); \
     const uint64 readVar = _cis->getRead(); \
@@ -697,35 +723,72 @@ T FileDecompressTask<T>::run()
     delete[] buf
 
     try {
-        SliceArray<kanzi::byte> sa(buf, DEFAULT_BUFFER_SIZE, 0);
-        int decoded = 0;
-
-        // Decode next block
-        do {
-            _cis->read(reinterpret_cast<char*>(&sa._array[0]), sa._length);
-            decoded = int(_cis->gcount());
+        if ((fos != nullptr) && (_ctx.has("from") == false) && (_ctx.has("to") == false)) {
+            _cis->peek(); // read the header (and the original size if provided)
+            const int64 outputSize = _ctx.getLong("outputSize", 0);
 
-            if (decoded < 0) {
-                CLEANUP_DECOMP_RESOURCES(d);
-                stringstream sserr;
-                sserr << "Reached end of stream";
-                return T(Error::ERR_READ_FILE, d, sserr.str());
-            }
+            if (outputSize >= MIN_MAPPED_FILE_SIZE) {
+                // A single handle on the file: the (empty) output stream is
+                // closed, then reopened if the file cannot be mapped
+                fos->close();
 
-            try {
-                if (decoded > 0) {
-                    _os->write(reinterpret_cast<const char*>(&sa._array[0]), decoded);
+                if (mappedOutput.openWrite(outputName, outputSize) == false) {
+                    fos->open(outputName.c_str(), ofstream::out | ofstream::binary);
 
-                    if (_os->fail() || _os->bad()) {
+                    if (!*fos) {
                         CLEANUP_DECOMP_RESOURCES(d);
                         stringstream sserr;
-                        sserr << "Failed to write decompressed block to file '" << outputName << "'";
-                        return T(Error::ERR_WRITE_FILE, d, sserr.str());
+                        sserr << "Cannot open output file '" << outputName << "' for writing";
+                        return T(Error::ERR_CREATE_FILE, d, sserr.str());
                     }
-
-                    read += decoded;
                 }
             }
+        }
+
+        if (mappedOutput.data() != nullptr) {
+            char* dst = reinterpret_cast<char*>(mappedOutput.data());
+
+            while ((read < mappedOutput.size()) && (_cis->eof() == false)) {
+                _cis->read(&dst[read], streamsize(min(mappedOutput.size() - read, int64(DEFAULT_BUFFER_SIZE))));
+                read += int64(_cis->gcount());
+            }
+
+            // Any data past the original size is counted (and reported as an error)
+            while (_cis->eof() == false) {
+                _cis->read(reinterpret_cast<char*>(buf), DEFAULT_BUFFER_SIZE);
+                read += int64(_cis->gcount());
+            }
+        }
+        else {
+            SliceArray<kanzi::byte> sa(buf, DEFAULT_BUFFER_SIZE, 0);
+            int decoded = 0;
+
+            // Decode next block
+            do {
+                _cis->read(reinterpret_cast<char*>(&sa._array[0]), sa._length);
+                decoded = int(_cis->gcount());
+
+                if (decoded < 0) {
+                    CLEANUP_DECOMP_RESOURCES(d);
+                    stringstream sserr;
+                    sserr << "Reached end of stream";
+                    return T(Error::ERR_READ_FILE, d, sserr.str());
+                }
+
+                try {
+                    if (decoded > 0) {
+                        _os->write(reinterpret_cast<const char*>(&sa._array[0]), decoded);
+
+                        if (_os->fail() || _os->bad()) {
+                            CLEANUP_DECOMP_RESOURCES(d);
+                            stringstream sserr;
+                            sserr << "Failed to write decompressed block to file '" << outputName << "'";
+                            return T(Error::ERR_WRITE_FILE, d, sserr.str());
+                        }
+
+                        read += decoded;
+                    }
+                }
                 catch (const exception& e) {
                     CLEANUP_DECOMP_RESOURCES(d);
                     stringstream sserr;
@@ -733,8 +796,10 @@ T FileDecompressTask<T>::run()
                     return T(Error::ERR_WRITE_FILE, d, sserr.str());
                 }
             } while (_cis->eof() == 0);
+        }
     }
     catch (const IOException& e) {
+        mappedOutput.close(read); // keep the decoded data only
         CLEANUP_DECOMP_RESOURCES_EOF(d, isEOF);
 
         if (isEOF == true)
@@ -745,6 +810,7 @@ T FileDecompressTask<T>::run()
         return T(e.error(), d, sserr.str());
     }
     catch (const exception& e) {
+        mappedOutput.close(read); // keep the decoded data only
         CLEANUP_DECOMP_RESOURCES_EOF(d, isEOF);
 
         if (isEOF == true)
@@ -758,16 +824,32 @@ T FileDecompressTask<T>::run()
     uint64 written = 0;
 
     try {
-        _os->flush();
+        // The output stream is closed if the file is mapped
+        if (mappedOutput.data() == nullptr) {
+            _os->flush();
 
-        if (_os->fail() || _os->bad()) {
-            CLEANUP_DECOMP_RESOURCES(d);
-            stringstream sserr;
-            sserr << "Failed to flush decompressed output file '" << outputName << "'";
-            return T(Error::ERR_WRITE_FILE, d, sserr.str());
+            if (_os->fail() || _os->bad()) {
+                CLEANUP_DECOMP_RESOURCES(d);
+                stringstream sserr;
+                sserr << "Failed to flush decompressed output file '" << outputName << "'";
+                return T(Error::ERR_WRITE_FILE, d, sserr.str());
+            }
         }
 
-        if (checkOutputSize == true) {
+        if (mappedOutput.data() != nullptr) {
+            // Drop the end of the file if the stream is shorter than expected
+            const int64 size = mappedOutput.size();
+
+            if (mappedOutput.close(min(read, size)) == false) {
+                CLEANUP_DECOMP_RESOURCES(d);
+                stringstream sserr;
+                sserr << "Failed to write decompressed output file '" << outputName << "'";
+                return T(Error::ERR_WRITE_FILE, d, sserr.str());
+            }
+
+            written = uint64(read);
+        }
+        else if (checkOutputSize == true) {
             const streampos pos = _os->tellp();
 
             if ((pos == streampos(-1)) || _os->fail() || _os->bad()) {
@@ -780,7 +862,7 @@ T FileDecompressTask<T>::run()
             written = uint64(pos);
         }
 
-        if (fos != nullptr) {
+        if ((fos != nullptr) && (fos->is_open() == true)) {
             fos->close();
 
             if (!*fos) {
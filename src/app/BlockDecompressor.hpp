@@ -20,6 +20,7 @@ limitations under the License.
 #include <map>
 #include <vector>
 #include "../OutputStream.hpp"
+#include "../Dictionary.hpp"
 #include "../io/CompressedInputStream.hpp"
 
 namespace kanzi {
@@ -92,6 +93,7 @@ namespace kanzi {
    class FileDecompressTask FINAL : public Task<T> {
    public:
        static const int DEFAULT_BUFFER_SIZE = 65536;
+       static const int64 MIN_MAPPED_FILE_SIZE = 4 * 1024 * 1024;
 
        FileDecompressTask(const Context& ctx, std::vector<Listener<Event>*>& listeners);
 
@@ -140,6 +142,7 @@ namespace kanzi {
        bool _noDotFiles;
        bool _noLinks;
        Context _ctx;
+       Dictionary* _dict; // owned, shared by the tasks
 
        static void notifyListeners(std::vector<Listener<Event>*>& listeners, const Event& evt);
    };
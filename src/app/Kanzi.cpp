@@ -15,12 +15,16 @@ limitations under the License.
 
 #include <algorithm>
 #include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <map>
 
 #include "BlockCompressor.hpp"
 #include "BlockDecompressor.hpp"
+#include "../Dictionary.hpp"
 #include "../Error.hpp"
+#include "../io/IOUtil.hpp"
+#include "../util/CPUFeatures.hpp"
 #include "../util/Printer.hpp"
 
 #if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
@@ -54,13 +58,16 @@ static const int ARG_IDX_LEVEL = 9;
 static const string KANZI_VERSION = "2.5.3";
 static const string APP_HEADER = "Kanzi " + KANZI_VERSION + " (c) Frederic Langlet";
 static const string APP_SUB_HEADER = "Fast lossless data compressor.";
-static const string APP_USAGE = "Usage: kanzi [-c|-d|-y] [flags and files in any order]";
+static const string APP_USAGE = "Usage: kanzi [-c|-d|-y|--train] [flags and files in any order]";
 
 
 #ifdef CONCURRENCY_ENABLED
    static const int MAX_CONCURRENCY = 64;
 #endif
 
+static const int MAX_SOLID_LANES = 64;
+static const int MAX_LZ_SEARCH = 256;
+
 void printHelp(Printer& log, const string& mode, bool showHeader)
 {
    log.println("", true);
@@ -76,7 +83,7 @@ void printHelp(Printer& log, const string& mode, bool showHeader)
    log.println("Options\n", true);
    log.println("   -h, --help", true);
 
-   if ((mode != "c") && (mode != "d") && (mode != "y")) {
+   if ((mode != "c") && (mode != "d") && (mode != "y") && (mode != "t")) {
        log.println("        Display this message.", true);
        log.println("        Use in conjunction with -c to print information for compression,", true);
        log.println("        or -d to print information for decompression.\n", true);
@@ -86,6 +93,8 @@ void printHelp(Printer& log, const string& mode, bool showHeader)
        log.println("        Decompress mode\n", true);
        log.println("   -y, --info", true);
        log.println("        Info mode: display information about compressed files\n", true);
+       log.println("   --train", true);
+       log.println("        Train mode: build a dictionary from sample files\n", true);
    }
    else {
        log.println("        Display this message.\n", true);
@@ -116,6 +125,9 @@ void printHelp(Printer& log, const string& mode, bool showHeader)
            log.println("        <inputName> if input is <inputName.knz> or 'stdout' if input is 'stdin').", true);
            log.println("        or 'none' or 'stdout'.\n", true);
        }
+       else if (mode == "t") {
+           log.println("        Name of the dictionary file (mandatory).\n", true);
+       }
        else {
            log.println("        Optional name of the output file or 'none' or 'stdout'.\n", true);
        }
@@ -125,7 +137,8 @@ void printHelp(Printer& log, const string& mode, bool showHeader)
        log.println("   -b, --block=<size>", true);
        log.println("        Size of blocks (default 4|8|16|32 MiB based on level, max 1 GiB, min 1 KiB).", true);
        log.println("        'auto' means that the compressor derives the best value", true);
-       log.println("        based on input size (when available) and number of jobs.\n", true);
+       log.println("        based on input size (when available), codecs, number of jobs", true);
+       log.println("        and memory. The plan is displayed with -v 2 or more.\n", true);
        log.println("   -l, --level=<compression>", true);
        log.println("        Set the compression level [0..9]", true);
        log.println("        Providing this option forces entropy and transform.", true);
@@ -146,7 +159,7 @@ void printHelp(Printer& log, const string& mode, bool showHeader)
        log.println("        meaning higher compression levels could occasionally yield lower compression ratios.\n", true);
 
        log.println("   -e, --entropy=<codec>", true);
-       log.println("        Entropy codec [None|Huffman|ANS0|ANS1|Range|FPAQ|TPAQ|TPAQX|CM]\n", true);
+       log.println("        Entropy codec [None|Huffman|ANS0|ANS0X|ANS1|Range|FPAQ|TPAQ|TPAQX|CM]\n", true);
        log.println("   -t, --transform=<codec>", true);
        log.println("        Transform [None|BWT|BWTS|LZ|LZX|LZP|ROLZ|ROLZX|RLT|ZRLT]", true);
        log.println("                  [MTFT|RANK|SRT|TEXT|MM|EXE|UTF|PACK]", true);
@@ -156,6 +169,54 @@ void printHelp(Printer& log, const string& mode, bool showHeader)
        log.println("        -x is equivalent to -x32.\n", true);
        log.println("   -s, --skip", true);
        log.println("        Copy blocks with high entropy instead of compressing them.\n", true);
+       log.println("   --index", true);
+       log.println("        Append a block index to the compressed stream. It allows", true);
+       log.println("        decompression with --from to jump directly to the first block.\n", true);
+       log.println("   --solid[=<lanes>]", true);
+       log.println("        Carry the entropy model over from block to block (CM, TPAQ and", true);
+       log.println("        TPAQX only). Improves the compression of small blocks. The blocks", true);
+       log.println("        are dealt to <lanes> independent models (default is one per job):", true);
+       log.println("        more lanes allow more parallelism, fewer lanes compress better.\n", true);
+       log.println("   --auto", true);
+       log.println("        Choose the transforms and entropy codec of each block among the levels", true);
+       log.println("        from 1 to the compression level (default 3) by compressing a sample", true);
+       log.println("        of the block with each of them. Blocks that do not compress are copied.", true);
+       log.println("        With --transform or --entropy and no level, each block is either", true);
+       log.println("        compressed with these codecs or copied.\n", true);
+       log.println("   --lz-search=<depth>", true);
+       log.println("        Number of earlier positions tried by the LZ and LZX match finder", true);
+       log.println("        at each position (hash chains, max 256). Deeper searches find", true);
+       log.println("        longer matches but are slower. Default is 0 (one position, fastest).", true);
+       log.println("        Decompression is not affected.\n", true);
+       log.println("   --lz-optimal", true);
+       log.println("        Parse the LZ and LZX blocks by dynamic programming over the prices of", true);
+       log.println("        literals and matches instead of greedily. Better ratio after entropy", true);
+       log.println("        coding, slower compression, same decompression speed.\n", true);
+   }
+
+   if ((mode == "c") || (mode == "d") || (mode == "y")) {
+       log.println("   --dict=<dictionary>", true);
+       log.println("        Use a dictionary built with --train. Every block starts with the", true);
+       log.println("        dictionary as history, which improves the compression of small inputs", true);
+       log.println("        (EG. messages of a few KB). The same dictionary must be provided to", true);
+       log.println("        decompress.\n", true);
+   }
+
+   if ((mode == "c") || (mode == "d")) {
+       log.println("   --max-memory=<size>", true);
+       log.println("        Memory budget (EG. 2g). Fewer blocks are processed concurrently", true);
+       log.println("        (the jobs go to the blocks) and cheaper codecs are used at", true);
+       log.println("        compression if needed (TPAQX -> TPAQ, BWTS -> BWT). Files processed", true);
+       log.println("        concurrently share the budget. Default is 3/4 of the physical memory", true);
+       log.println("        (or of the cgroup memory limit if lower) at compression, no limit at", true);
+       log.println("        decompression. The budget is applied when the blocks are planned.\n", true);
+   }
+
+   if (mode == "t") {
+       log.println("   --dict-size=<size>", true);
+       log.println("        Maximum size of the dictionary (default 64 KiB, max 1 MiB).", true);
+       log.println("        Each input file is a sample. The samples should be typical of the", true);
+       log.println("        data to compress.\n", true);
    }
 
    log.println("   -j, --jobs=<jobs>", true);
@@ -208,6 +269,14 @@ void printHelp(Printer& log, const string& mode, bool showHeader)
        log.println("  kanzi --decompress --input=foo.knz --force --verbose=2 --jobs=2\n", true);
    }
 
+   if (mode == "t") {
+       log.println("", true);
+       log.println("Examples\n", true);
+       log.println("  kanzi --train -i samples/ -o msg.dict --dict-size=32k\n", true);
+       log.println("  kanzi -c -i msg.json -l 2 --dict=msg.dict\n", true);
+       log.println("  kanzi -d -i msg.json.knz --dict=msg.dict\n", true);
+   }
+
    if (mode == "c") {
        log.println("", true);
        log.println("Transforms\n", true);
@@ -252,6 +321,8 @@ void printHelp(Printer& log, const string& mode, bool showHeader)
        log.println("  ANS: based on Range Asymmetric Numeral Systems by Jarek Duda (specifically", true);
        log.println("       an implementation by Fabian Giesen). Works in a similar fashion to the Range", true);
        log.println("       codec but uses only 1 state instead of 2, and encodes in reverse byte order.\n", true);
+       log.println("  ANS0X: order 0 ANS with 32 interleaved states. Decoding uses vector instructions", true);
+       log.println("         when available (AVX2, AVX-512). Faster decoding, slightly larger output.\n", true);
        log.println("  FPAQ: a binary arithmetic codec based on FPAQ1 by Matt Mahoney. Uses a simple", true);
        log.println("        adaptive order 0 predictor based on frequencies.\n", true);
        log.println("  CM: a binary arithmetic codec derived from BCM by Ilya Muravyov. Uses context", true);
@@ -326,6 +397,10 @@ void printHeader(Printer& log, int verbose, bool& showHeader)
             extraHeader << " - SSE2";
     #elif defined(__SSE__)
             extraHeader << " - SSE";
+    #endif
+    #ifdef KANZI_SIMD_DISPATCH
+            // Vectorized kernels selected at runtime
+            extraHeader << " (runtime: " << CPUFeatures::getName(CPUFeatures::getSIMDLevel()) << ")";
     #endif
             log.println(extraHeader.str(), true);
         }
@@ -382,6 +457,11 @@ int processCommandLine(int argc, const char* argv[], Context& map, Printer& log)
     int overwrite = -1;
     int checksum = 0;
     int skip = -1;
+    int blockIndex = -1;
+    int solid = -1;
+    int lzSearch = -1;
+    int lzOptimal = -1;
+    int autoCodecs = -1;
     int reorder = -1;
     int noDotFiles = -1;
     int noLinks = -1;
@@ -396,6 +476,9 @@ int processCommandLine(int argc, const char* argv[], Context& map, Printer& log)
     int tasks = -1;
     int blockSize = -1;
     int autoBlockSize = -1;
+    int dictSize = -1;
+    int64 maxMemory = -1;
+    string dictName;
     string mode;
     bool showHeader = true;
     bool showHelp = false;
@@ -450,6 +533,16 @@ int processCommandLine(int argc, const char* argv[], Context& map, Printer& log)
             continue;
         }
 
+        if (arg == "--train") {
+            if (mode != "") {
+                cerr << "Only one mode can be provided (already got '" << mode << "')" << endl;
+                return Error::ERR_INVALID_PARAM;
+            }
+
+            mode = "t";
+            continue;
+        }
+
         if ((ctx == ARG_IDX_VERBOSE) || (arg.compare(0, 10, "--verbose=") == 0)) {
            if (verboseFlag == true) {
                 WARNING_OPT_DUPLICATE("verbosity level", arg);
@@ -532,7 +625,7 @@ int processCommandLine(int argc, const char* argv[], Context& map, Printer& log)
         }
 
         if ((arg == "-c") || (arg == "-d") || (arg == "-y") || (arg == "--compress") || (arg == "--decompress") ||
-            (arg == "--info")) {
+            (arg == "--info") || (arg == "--train")) {
             if (ctx != -1) {
                 WARNING_OPT_NOVALUE(CMD_LINE_ARGS[ctx]);
             }
@@ -579,6 +672,235 @@ int processCommandLine(int argc, const char* argv[], Context& map, Printer& log)
             continue;
         }
 
+        if (arg == "--index") {
+            if (ctx != -1) {
+                WARNING_OPT_NOVALUE(CMD_LINE_ARGS[ctx]);
+            }
+            else if (blockIndex >= 0) {
+                WARNING_OPT_DUPLICATE(arg, "true");
+            }
+
+            ctx = -1;
+
+            if (mode != "c") {
+                WARNING_OPT_COMP_ONLY(arg);
+                continue;
+            }
+
+            blockIndex = 1;
+            continue;
+        }
+
+        if ((arg == "--solid") || (arg.compare(0, 8, "--solid=") == 0)) {
+            if (ctx != -1) {
+                WARNING_OPT_NOVALUE(CMD_LINE_ARGS[ctx]);
+            }
+
+            ctx = -1;
+
+            if (mode != "c") {
+                WARNING_OPT_COMP_ONLY(arg);
+                continue;
+            }
+
+            if (solid >= 0) {
+                WARNING_OPT_DUPLICATE("--solid", arg);
+                continue;
+            }
+
+            // Without value, one lane per job
+            solid = 0;
+
+            if ((arg.length() > 8) && ((toInt(arg.substr(8), solid) == false) || (solid <= 0) || (solid > MAX_SOLID_LANES))) {
+                cerr << "Invalid number of solid lanes provided on command line: " << arg.substr(8) << endl;
+                cerr << "The number of lanes must be in [1.." << MAX_SOLID_LANES << "]" << endl;
+                return Error::ERR_INVALID_PARAM;
+            }
+
+            continue;
+        }
+
+        if (arg.compare(0, 12, "--lz-search=") == 0) {
+            if (ctx != -1) {
+                WARNING_OPT_NOVALUE(CMD_LINE_ARGS[ctx]);
+            }
+
+            ctx = -1;
+
+            if (mode != "c") {
+                WARNING_OPT_COMP_ONLY(arg);
+                continue;
+            }
+
+            if (lzSearch >= 0) {
+                WARNING_OPT_DUPLICATE("--lz-search", arg);
+                continue;
+            }
+
+            if ((toInt(arg.substr(12), lzSearch) == false) || (lzSearch < 0) || (lzSearch > MAX_LZ_SEARCH)) {
+                cerr << "Invalid LZ search depth provided on command line: " << arg.substr(12) << endl;
+                cerr << "The search depth must be in [0.." << MAX_LZ_SEARCH << "]" << endl;
+                return Error::ERR_INVALID_PARAM;
+            }
+
+            continue;
+        }
+
+        if (arg == "--lz-optimal") {
+            if (ctx != -1) {
+                WARNING_OPT_NOVALUE(CMD_LINE_ARGS[ctx]);
+            }
+
+            ctx = -1;
+
+            if (mode != "c") {
+                WARNING_OPT_COMP_ONLY(arg);
+                continue;
+            }
+
+            if (lzOptimal >= 0) {
+                WARNING_OPT_DUPLICATE(arg, "true");
+                continue;
+            }
+
+            lzOptimal = 1;
+            continue;
+        }
+
+        if (arg == "--auto") {
+            if (ctx != -1) {
+                WARNING_OPT_NOVALUE(CMD_LINE_ARGS[ctx]);
+            }
+
+            ctx = -1;
+
+            if (mode != "c") {
+                WARNING_OPT_COMP_ONLY(arg);
+                continue;
+            }
+
+            if (autoCodecs >= 0) {
+                WARNING_OPT_DUPLICATE(arg, "true");
+                continue;
+            }
+
+            autoCodecs = 1;
+            continue;
+        }
+
+        if (arg.compare(0, 7, "--dict=") == 0) {
+            if (ctx != -1) {
+                WARNING_OPT_NOVALUE(CMD_LINE_ARGS[ctx]);
+            }
+
+            ctx = -1;
+
+            if (mode == "t") {
+                WARNING_OPT_INVALID(arg);
+                continue;
+            }
+
+            if (dictName != "") {
+                WARNING_OPT_DUPLICATE("--dict", arg);
+                continue;
+            }
+
+            dictName = arg.substr(7);
+
+            if (dictName.length() == 0) {
+                cerr << "Invalid empty dictionary name provided on command line" << endl;
+                return Error::ERR_INVALID_PARAM;
+            }
+
+            continue;
+        }
+
+        if (arg.compare(0, 12, "--dict-size=") == 0) {
+            if (ctx != -1) {
+                WARNING_OPT_NOVALUE(CMD_LINE_ARGS[ctx]);
+            }
+
+            ctx = -1;
+
+            if (mode != "t") {
+                WARNING_OPT_INVALID(arg);
+                continue;
+            }
+
+            if (dictSize >= 0) {
+                WARNING_OPT_DUPLICATE("--dict-size", arg);
+                continue;
+            }
+
+            string str = arg.substr(12);
+            transform(str.begin(), str.end(), str.begin(), safeToUpper);
+            int scale = 1;
+
+            // Process K or M suffix
+            if ((str.length() > 0) && (str[str.length() - 1] == 'K')) {
+                scale = 1024;
+                str.resize(str.length() - 1);
+            }
+            else if ((str.length() > 0) && (str[str.length() - 1] == 'M')) {
+                scale = 1024 * 1024;
+                str.resize(str.length() - 1);
+            }
+
+            if ((toInt(str, dictSize) == false) || (dictSize <= 0) || (dictSize > Dictionary::MAX_SIZE / scale)) {
+                cerr << "Invalid dictionary size provided on command line: " << arg.substr(12) << endl;
+                cerr << "The dictionary size must be in [1.." << Dictionary::MAX_SIZE << "]" << endl;
+                return Error::ERR_INVALID_PARAM;
+            }
+
+            dictSize *= scale;
+            continue;
+        }
+
+        if (arg.compare(0, 13, "--max-memory=") == 0) {
+            if (ctx != -1) {
+                WARNING_OPT_NOVALUE(CMD_LINE_ARGS[ctx]);
+            }
+
+            ctx = -1;
+
+            if ((mode != "c") && (mode != "d")) {
+                WARNING_OPT_INVALID(arg);
+                continue;
+            }
+
+            if (maxMemory >= 0) {
+                WARNING_OPT_DUPLICATE("--max-memory", arg);
+                continue;
+            }
+
+            string str = arg.substr(13);
+            transform(str.begin(), str.end(), str.begin(), safeToUpper);
+            int64 scale = 1;
+            int value = 0;
+
+            // Process K or M or G suffix
+            if ((str.length() > 0) && (str[str.length() - 1] == 'K')) {
+                scale = 1024;
+                str.resize(str.length() - 1);
+            }
+            else if ((str.length() > 0) && (str[str.length() - 1] == 'M')) {
+                scale = 1024 * 1024;
+                str.resize(str.length() - 1);
+            }
+            else if ((str.length() > 0) && (str[str.length() - 1] == 'G')) {
+                scale = 1024 * 1024 * 1024;
+                str.resize(str.length() - 1);
+            }
+
+            if ((toInt(str, value) == false) || (value <= 0)) {
+                cerr << "Invalid memory budget provided on command line: " << arg.substr(13) << endl;
+                return Error::ERR_INVALID_PARAM;
+            }
+
+            maxMemory = int64(value) * scale;
+            continue;
+        }
+
         if ((arg == "-x") || (arg == "-x32") || (arg == "-x64")) {
             if (checksum > 0) {
                 WARNING_OPT_DUPLICATE(arg, "true");
@@ -1021,11 +1343,35 @@ int processCommandLine(int argc, const char* argv[], Context& map, Printer& log)
     if (skip == 1)
         map.putInt("skipBlocks", 1);
 
+    if (blockIndex == 1)
+        map.putInt("blockIndex", 1);
+
+    if (solid >= 0)
+        map.putInt("solid", (solid == 0) ? -1 : solid);
+
+    if (lzSearch > 0)
+        map.putInt("lzSearch", lzSearch);
+
+    if (lzOptimal == 1)
+        map.putInt("lzOptimal", 1);
+
+    if (autoCodecs == 1)
+        map.putInt("auto", 1);
+
     if (reorder == 0)
         map.putInt("fileReorder", 0);
     else
         map.putInt("fileReorder", 1);
 
+    if (dictName.length() > 0)
+        map.putString("dictionary", dictName);
+
+    if (dictSize > 0)
+        map.putInt("dictSize", dictSize);
+
+    if (maxMemory > 0)
+        map.putLong("maxMemory", maxMemory);
+
     if (noDotFiles == 1) // Skip dot files
         map.putInt("noDotFiles", 1);
 
@@ -1044,6 +1390,102 @@ int processCommandLine(int argc, const char* argv[], Context& map, Printer& log)
     return 0;
 }
 
+// Train mode: each input file is a sample, the dictionary is written to the output file
+int trainDictionary(const Context& ctx, Printer& log)
+{
+    const int verbosity = ctx.getInt("verbosity", 1);
+    string inputName = ctx.getString("inputName");
+    const string outputName = ctx.getString("outputName");
+    const int maxSize = ctx.getInt("dictSize", Dictionary::DEFAULT_SIZE);
+
+    if ((inputName.length() == 0) || (outputName.length() == 0)) {
+        cerr << "Train mode requires an input (sample files) and an output (dictionary file)" << endl;
+        return Error::ERR_MISSING_PARAM;
+    }
+
+    if ((ctx.getInt("overwrite", 0) == 0) && (ifstream(outputName.c_str()).good() == true)) {
+        cerr << "File '" << outputName << "' exists and the 'force' command line option has not been provided" << endl;
+        return Error::ERR_OVERWRITE_FILE;
+    }
+
+    vector<FileData> files;
+    vector<string> errors;
+    bool isRecursive = (inputName.length() < 2) ||
+        (inputName[inputName.length() - 2] != PATH_SEPARATOR) ||
+        (inputName[inputName.length() - 1] != '.');
+    FileListConfig cfg = { isRecursive, ctx.getInt("noLinks", 0) != 0, false, ctx.getInt("noDotFiles", 0) != 0 };
+    createFileList(inputName, files, cfg, errors);
+
+    if (errors.size() > 0) {
+        for (size_t i = 0; i < errors.size(); i++)
+            cerr << errors[i] << endl;
+
+        return Error::ERR_OPEN_FILE;
+    }
+
+    if (files.size() == 0) {
+        cerr << "Cannot find any file to train with" << endl;
+        return Error::ERR_OPEN_FILE;
+    }
+
+    int64 total = 0;
+
+    for (size_t i = 0; i < files.size(); i++)
+        total += files[i]._size;
+
+    if (total > int64(1) << 30) {
+        cerr << "Too much sample data: " << total << " bytes (max is 1 GiB)" << endl;
+        return Error::ERR_INVALID_PARAM;
+    }
+
+    vector<kanzi::byte> samples(size_t(total) + 8);
+    vector<int> sizes;
+    int64 offset = 0;
+
+    for (size_t i = 0; i < files.size(); i++) {
+        if (files[i]._size == 0)
+            continue;
+
+        ifstream is(files[i].fullPath().c_str(), ifstream::in | ifstream::binary);
+        is.read(reinterpret_cast<char*>(&samples[size_t(offset)]), streamsize(files[i]._size));
+
+        if (is.gcount() != streamsize(files[i]._size)) {
+            cerr << "Cannot read sample file '" << files[i].fullPath() << "'" << endl;
+            return Error::ERR_READ_FILE;
+        }
+
+        sizes.push_back(int(files[i]._size));
+        offset += files[i]._size;
+    }
+
+    Dictionary* dict = (sizes.size() == 0) ? nullptr : Dictionary::train(&samples[0], &sizes[0], int(sizes.size()), maxSize);
+
+    if (dict == nullptr) {
+        cerr << "Cannot build a dictionary: not enough sample data" << endl;
+        return Error::ERR_INVALID_PARAM;
+    }
+
+    ofstream os(outputName.c_str(), ofstream::out | ofstream::binary | ofstream::trunc);
+
+    if (os.is_open() == true)
+        dict->write(os);
+
+    os.close();
+
+    if (!os) {
+        delete dict;
+        cerr << "Cannot write dictionary file '" << outputName << "'" << endl;
+        return Error::ERR_WRITE_FILE;
+    }
+
+    stringstream ss;
+    ss << "Dictionary " << outputName << ": " << dict->size() << " bytes (ID " << hex << dict->getId() << dec;
+    ss << ") trained with " << sizes.size() << " sample" << (sizes.size() > 1 ? "s" : "") << " (" << offset << " bytes)";
+    log.println(ss.str(), verbosity > 0);
+    delete dict;
+    return 0;
+}
+
 int main(int argc, const char* argv[])
 {
 #if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
@@ -1144,6 +1586,9 @@ int main(int argc, const char* argv[])
             }
         }
 
+        if (mode == "t")
+            return trainDictionary(ctx, log);
+
         cout << "Missing arguments: try --help or -h" << endl;
         return Error::ERR_MISSING_PARAM;
     }
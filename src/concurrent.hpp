@@ -43,8 +43,10 @@ limitations under the License.
 
 
 #ifdef CONCURRENCY_ENABLED
+   #include <atomic>
+   #include <chrono>
+   #include <deque>
    #include <vector>
-   #include <queue>
    #include <memory>
    #include <thread>
    #include <mutex>
@@ -85,6 +87,24 @@ class Task {
 
 
 #ifdef CONCURRENCY_ENABLED
+   // A work stealing thread pool.
+   // Each worker owns a queue of tasks. Tasks scheduled by a worker go to its own
+   // queue, tasks scheduled by other threads are spread over the worker queues.
+   // An idle worker runs the oldest task of its own queue, else it steals the
+   // newest task of another queue. Each queue has its own lock and tasks are
+   // only taken from the ends of its deques. The pool lock is only used by the
+   // threads going to sleep and by the threads waking them up.
+   // Tasks must not block waiting on each other. A task waiting for the result
+   // of another task should call get() or wait() which keep the worker busy
+   // running pending tasks in the meantime. So, the pool size does not need to
+   // exceed the number of concurrent tasks, and tasks that mostly wait (EG. the
+   // compression of a file waiting for its blocks) can run in the pool.
+   // Each task has a level: 0 if scheduled from outside the pool, else the
+   // level of the scheduling task + 1. A waiting worker only runs tasks of a
+   // deeper level than the task it waits in (EG. the jobs of other blocks, not
+   // another whole stream), so a wait is never stalled by an unrelated long
+   // task. Tasks may only wait for tasks of a deeper level. The tasks of each
+   // level have their own deque and the deepest tasks run first.
    class ThreadPool FINAL {
    public:
        ThreadPool(int threads = 8);
@@ -96,45 +116,110 @@ class Task {
        std::future<typename std::result_of<F(Args...)>::type> schedule(F&& f, Args&&... args);
 #endif
 
+       // Wait for the result of a future returned by schedule(). When called
+       // from a worker of this pool, pending tasks of a deeper level are run
+       // while the result is not available.
+       template<class R>
+       R get(std::future<R>& f);
+
+       // Same as get() without retrieving the result.
+       template<class R>
+       void wait(std::future<R>& f);
+
+       // Run one pending task of a deeper level on the calling thread if it is
+       // a worker of this pool. Return false if no task was run.
+       bool runPendingTask();
+
+       int size() const { return int(_workers.size()); }
+
        ~ThreadPool() noexcept;
 
    private:
+       static const int MAX_LEVELS = 8; // deeper tasks share the last level
+
+       struct PendingTask {
+           std::function<void()> _fn;
+           int _level;
+       };
+
+       struct WorkQueue {
+           std::deque<PendingTask> _tasks[MAX_LEVELS]; // one deque per level
+           std::mutex _mutex;
+       };
+
+       // Pool, worker index and level of the running task of the calling thread
+       struct WorkerState {
+           const ThreadPool* _pool;
+           int _index;
+           int _level; // -1 if no task is running
+
+           WorkerState() : _pool(nullptr), _index(-1), _level(-1) {}
+       };
+
        std::vector<std::thread> _workers;
-       std::queue<std::function<void()>> _tasks;
-       std::mutex _mutex;
-       std::condition_variable _condition;
-       bool _stop;
+       std::vector<WorkQueue*> _queues; // one per worker
+       std::mutex _mutex; // sleeping threads only (see notify)
+       std::condition_variable _condition; // idle workers: new task or stop
+       std::condition_variable _progress; // waiting workers: new or completed task
+       std::atomic_int _pending; // number of queued tasks
+       std::atomic_uint _next; // queue for the next external task
+       std::atomic<kanzi::uint64> _events; // number of scheduled and completed tasks
+       std::atomic_int _sleepers; // idle workers waiting on _condition
+       std::atomic_int _waiters; // workers waiting on _progress (in get())
+       std::atomic_bool _stop;
+
+       static WorkerState& getWorkerState();
+
+       int getWorkerIndex() const;
+
+       bool runPendingTask(int idx, int minLevel);
+
+       void signalProgress();
+
+       void notify(std::condition_variable& cv, bool all);
    };
 
 
    inline ThreadPool::ThreadPool(int threads)
-       :   _stop(false)
+       :   _pending(0)
+       ,   _next(0)
+       ,   _events(0)
+       ,   _sleepers(0)
+       ,   _waiters(0)
+       ,   _stop(false)
    {
        if ((threads <= 0) || (threads > 1024))
            throw std::invalid_argument("The number of threads must be in [1..1024]");
 
+       _workers.reserve(threads);
+
+       for (int i = 0; i < threads; i++)
+           _queues.push_back(new WorkQueue());
+
        // Start and run threads
        for (int i = 0; i < threads; i++)
            _workers.emplace_back(
-               [this]
+               [this, i]
                {
-                   for(;;)
-                   {
-                       std::function<void()> task;
-
-                       {
-                           std::unique_lock<std::mutex> lock(_mutex);
-                           _condition.wait(lock,
-                               [this] { return _stop || !_tasks.empty(); });
-
-                           if (_stop && _tasks.empty())
-                               return;
-
-                           task = std::move(_tasks.front());
-                           _tasks.pop();
-                       }
+                   WorkerState& state = getWorkerState();
+                   state._pool = this;
+                   state._index = i;
 
-                       task();
+                   for (;;)
+                   {
+                       if (runPendingTask(i, 0) == true)
+                           continue;
+
+                       // The sleeper count is published before the pending
+                       // count is checked (see schedule)
+                       std::unique_lock<std::mutex> lock(_mutex);
+                       _sleepers.fetch_add(1);
+                       _condition.wait(lock,
+                           [this] { return _stop.load() || (_pending.load() > 0); });
+                       _sleepers.fetch_sub(1);
+
+                       if (_stop.load() && (_pending.load() <= 0))
+                           return;
                    }
                }
            );
@@ -164,19 +249,172 @@ class Task {
        );
        #endif
 
+       if (_stop.load() == true)
+           throw std::runtime_error("ThreadPool stopped");
+
        std::future<return_type> res = task->get_future();
+       const WorkerState& state = getWorkerState();
+       int idx = state._index;
+       int level = (state._level + 1 < MAX_LEVELS) ? state._level + 1 : MAX_LEVELS - 1;
+
+       if (state._pool != this) {
+           idx = int(_next.fetch_add(1, std::memory_order_relaxed) % uint(_queues.size()));
+           level = 0;
+       }
 
        {
+           std::lock_guard<std::mutex> lock(_queues[idx]->_mutex);
+           PendingTask pt;
+           pt._fn = [task](){ (*task)(); };
+           pt._level = level;
+           _queues[idx]->_tasks[level].push_back(std::move(pt));
+       }
+
+       // Sequentially consistent: either a sleeping thread sees the new task
+       // or this thread sees the sleeping thread (and wakes it up)
+       _pending.fetch_add(1);
+       _events.fetch_add(1);
+
+       if (_sleepers.load() > 0)
+           notify(_condition, false);
+
+       if (_waiters.load() > 0)
+           notify(_progress, true);
+
+       return res;
+   }
+
+
+   template<class R>
+   R ThreadPool::get(std::future<R>& f)
+   {
+       wait(f);
+       return f.get();
+   }
+
+
+   template<class R>
+   void ThreadPool::wait(std::future<R>& f)
+   {
+       const int idx = getWorkerIndex();
+
+       if (idx < 0) {
+           f.wait();
+           return;
+       }
+
+       const int minLevel = getWorkerState()._level + 1;
+
+       for (;;) {
+           // Check the result after reading the event count: a task
+           // completing later changes the count and wakes this worker up
+           const kanzi::uint64 events = _events.load();
+
+           if (f.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+               return;
+
+           if (runPendingTask(idx, minLevel) == true)
+               continue;
+
            std::unique_lock<std::mutex> lock(_mutex);
+           _waiters.fetch_add(1);
+           _progress.wait(lock, [this, events] { return _stop.load() || (_events.load() != events); });
+           _waiters.fetch_sub(1);
+       }
+   }
+
+
+   inline bool ThreadPool::runPendingTask()
+   {
+       const int idx = getWorkerIndex();
+       return (idx >= 0) ? runPendingTask(idx, getWorkerState()._level + 1) : false;
+   }
+
+
+   inline ThreadPool::WorkerState& ThreadPool::getWorkerState()
+   {
+       static thread_local WorkerState state;
+       return state;
+   }
+
+
+   inline int ThreadPool::getWorkerIndex() const
+   {
+       const WorkerState& state = getWorkerState();
+       return (state._pool == this) ? state._index : -1;
+   }
+
+
+   inline bool ThreadPool::runPendingTask(int idx, int minLevel)
+   {
+       if ((_pending.load(std::memory_order_acquire) <= 0) || (minLevel >= MAX_LEVELS))
+           return false;
 
-           if (_stop == true)
-               throw std::runtime_error("ThreadPool stopped");
+       PendingTask task;
+       task._level = -1;
+       const int n = int(_queues.size());
 
-           _tasks.emplace([task](){ (*task)(); });
+       // Own queue first (oldest task), then steal from the others (newest task).
+       // Deepest levels first, tasks below 'minLevel' are left for other workers.
+       for (int i = 0; (i < n) && (task._level < 0); i++) {
+           WorkQueue* q = _queues[(idx + i) % n];
+           std::lock_guard<std::mutex> lock(q->_mutex);
+
+           for (int level = MAX_LEVELS - 1; level >= minLevel; level--) {
+               std::deque<PendingTask>& tasks = q->_tasks[level];
+
+               if (tasks.empty() == true)
+                   continue;
+
+               if (i == 0) {
+                   task = std::move(tasks.front());
+                   tasks.pop_front();
+               }
+               else {
+                   task = std::move(tasks.back());
+                   tasks.pop_back();
+               }
+
+               break;
+           }
        }
 
-       _condition.notify_one();
-       return res;
+       if (task._level < 0)
+           return false;
+
+       _pending.fetch_sub(1, std::memory_order_acq_rel);
+       WorkerState& state = getWorkerState();
+       const int level = state._level;
+       state._level = task._level;
+       task._fn();
+       state._level = level;
+       signalProgress();
+       return true;
+   }
+
+
+   // Wake up the workers waiting in get(): the result may be available
+   inline void ThreadPool::signalProgress()
+   {
+       _events.fetch_add(1);
+
+       if (_waiters.load() > 0)
+           notify(_progress, true);
+   }
+
+
+   // Acquiring the lock first: a thread that checked its wake up condition
+   // is waiting on 'cv' before being notified
+   inline void ThreadPool::notify(std::condition_variable& cv, bool all)
+   {
+       {
+           std::lock_guard<std::mutex> lock(_mutex);
+       }
+
+       if (all == true)
+           cv.notify_all();
+       else
+           cv.notify_one();
    }
 
 
@@ -185,13 +423,17 @@ class Task {
    {
        {
            std::unique_lock<std::mutex> lock(_mutex);
-           _stop = true;
+           _stop.store(true);
        }
 
        _condition.notify_all();
+       _progress.notify_all();
 
        for (std::thread& w : _workers)
            w.join();
+
+       for (size_t i = 0; i < _queues.size(); i++)
+           delete _queues[i];
    }
 
 
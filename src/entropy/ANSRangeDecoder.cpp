@@ -25,6 +25,7 @@ using namespace kanzi;
 using namespace std;
 
 const uint ANSRangeDecoder::ANS_TOP = 1 << 15; // max possible for ANS_TOP=1<<23
+const int ANSRangeDecoder::MAX_STATES = 32;
 const int ANSRangeDecoder::DEFAULT_ANS0_CHUNK_SIZE = 16384;
 const int ANSRangeDecoder::DEFAULT_LOG_RANGE = 12;
 const int ANSRangeDecoder::MIN_CHUNK_SIZE = 1024;
@@ -33,11 +34,17 @@ const int ANSRangeDecoder::MAX_CHUNK_SIZE = 1 << 27; // 8*MAX_CHUNK_SIZE must no
 
 // The chunk size indicates how many bytes are encoded (per block) before
 // resetting the frequency stats.
-ANSRangeDecoder::ANSRangeDecoder(InputBitStream& bitstream, int order, int chunkSize) : _bitstream(bitstream)
+ANSRangeDecoder::ANSRangeDecoder(InputBitStream& bitstream, int order, int chunkSize, int states) : _bitstream(bitstream)
 {
     if ((order != 0) && (order != 1))
         throw invalid_argument("ANS Codec: The order must be 0 or 1");
 
+    if ((states != 4) && ((states != MAX_STATES) || (order != 0))) {
+        stringstream ss;
+        ss << "ANS Codec: Invalid number of states: " << states << " (must be 4 or " << MAX_STATES << " with order 0)";
+        throw invalid_argument(ss.str());
+    }
+
     if (chunkSize < MIN_CHUNK_SIZE) {
         stringstream ss;
         ss << "ANS Codec: The chunk size must be at least " << MIN_CHUNK_SIZE;
@@ -61,6 +68,9 @@ ANSRangeDecoder::ANSRangeDecoder(InputBitStream& bitstream, int order, int chunk
     _f2s = nullptr;
     _f2sSize = 0;
     _logRange = DEFAULT_LOG_RANGE;
+    _states = states;
+    _slots = (states == 4) ? nullptr : new uint32[1 << 12];
+    _simdLevel = CPUFeatures::getSIMDLevel();
 }
 
 ANSRangeDecoder::~ANSRangeDecoder()
@@ -73,6 +83,9 @@ ANSRangeDecoder::~ANSRangeDecoder()
     if (_f2s != nullptr)
        delete[] _f2s;
 
+    if (_slots != nullptr)
+       delete[] _slots;
+
     delete[] _freqs;
     delete[] _symbols;
 }
@@ -87,6 +100,12 @@ int ANSRangeDecoder::decodeHeader(uint frequencies[], uint alphabet[])
         throw BitStreamException(ss.str(), BitStreamException::INVALID_STREAM);
     }
 
+    if ((_states != 4) && (_logRange > 12)) {
+        stringstream ss;
+        ss << "Invalid bitstream: range = " << _logRange << " (must be in [8..12] with " << _states << " states)";
+        throw BitStreamException(ss.str(), BitStreamException::INVALID_STREAM);
+    }
+
     int res = 0;
     const int dim = 255 * _order + 1;
 
@@ -155,6 +174,25 @@ int ANSRangeDecoder::decodeHeader(uint frequencies[], uint alphabet[])
 
         f[alphabet[0]] = uint(scale - sum);
         sum = 0;
+
+        if (_slots != nullptr) {
+            // Packed entries: symbol (8 bits), frequency (12 bits), slot - cumFreq (12 bits)
+            for (int i = 0; i < 256; i++) {
+                if (f[i] == 0)
+                    continue;
+
+                const uint freq = (f[i] >= scale) ? scale - 1 : f[i]; // Mirror encoder
+
+                for (uint j = 0; j < f[i]; j++)
+                    _slots[sum + j] = uint32(i) | (freq << 8) | (j << 20);
+
+                sum += f[i];
+            }
+
+            res += alphabetSize;
+            continue;
+        }
+
         ANSDecSymbol* symb = &_symbols[k << 8];
         uint8* freq2sym = &_f2s[k << _logRange];
 
@@ -181,7 +219,8 @@ int ANSRangeDecoder::decode(kanzi::byte block[], uint blkptr, uint count)
         return count;
     }
 
-    const uint minBufSize = 2 * uint(_chunkSize);
+    // Padding for the vectorized decoders (read ahead of the stream)
+    const uint minBufSize = 2 * uint(_chunkSize) + ((_states == 4) ? 0 : 64);
 
     if (_bufferSize < minBufSize) {
         kanzi::byte* buffer = new kanzi::byte[minBufSize];
@@ -204,9 +243,12 @@ int ANSRangeDecoder::decode(kanzi::byte block[], uint blkptr, uint count)
         if ((_order == 0) && (alphabetSize == 1)) {
             // Shortcut for chunks with only one symbol
             memset(&block[startChunk], alphabet[0], size_t(sizeChunk));
-        } else {
+        } else if (_states == 4) {
             if (decodeChunk(&block[startChunk], sizeChunk) == false)
                 return -1;
+        } else {
+            if (decodeChunkN(&block[startChunk], sizeChunk) == false)
+                return -1;
         }
 
         startChunk += sizeChunk;
@@ -290,3 +332,246 @@ bool ANSRangeDecoder::decodeChunk(kanzi::byte block[], uint count)
 
     return p == endPayload;
 }
+
+
+#ifdef KANZI_SIMD_DISPATCH
+// Lane indexes of the renormalization words for an 8 lane mask: the k-th lane
+// set in the mask (byte k) reads the k-th word of the stream
+static const uint64 EXPAND_LANES[256] = {
+    0x0000000000000000, 0x0000000000000000, 0x0000000000000000, 0x0000000000000100,
+    0x0000000000000000, 0x0000000000010000, 0x0000000000010000, 0x0000000000020100,
+    0x0000000000000000, 0x0000000001000000, 0x0000000001000000, 0x0000000002000100,
+    0x0000000001000000, 0x0000000002010000, 0x0000000002010000, 0x0000000003020100,
+    0x0000000000000000, 0x0000000100000000, 0x0000000100000000, 0x0000000200000100,
+    0x0000000100000000, 0x0000000200010000, 0x0000000200010000, 0x0000000300020100,
+    0x0000000100000000, 0x0000000201000000, 0x0000000201000000, 0x0000000302000100,
+    0x0000000201000000, 0x0000000302010000, 0x0000000302010000, 0x0000000403020100,
+    0x0000000000000000, 0x0000010000000000, 0x0000010000000000, 0x0000020000000100,
+    0x0000010000000000, 0x0000020000010000, 0x0000020000010000, 0x0000030000020100,
+    0x0000010000000000, 0x0000020001000000, 0x0000020001000000, 0x0000030002000100,
+    0x0000020001000000, 0x0000030002010000, 0x0000030002010000, 0x0000040003020100,
+    0x0000010000000000, 0x0000020100000000, 0x0000020100000000, 0x0000030200000100,
+    0x0000020100000000, 0x0000030200010000, 0x0000030200010000, 0x0000040300020100,
+    0x0000020100000000, 0x0000030201000000, 0x0000030201000000, 0x0000040302000100,
+    0x0000030201000000, 0x0000040302010000, 0x0000040302010000, 0x0000050403020100,
+    0x0000000000000000, 0x0001000000000000, 0x0001000000000000, 0x0002000000000100,
+    0x0001000000000000, 0x0002000000010000, 0x0002000000010000, 0x0003000000020100,
+    0x0001000000000000, 0x0002000001000000, 0x0002000001000000, 0x0003000002000100,
+    0x0002000001000000, 0x0003000002010000, 0x0003000002010000, 0x0004000003020100,
+    0x0001000000000000, 0x0002000100000000, 0x0002000100000000, 0x0003000200000100,
+    0x0002000100000000, 0x0003000200010000, 0x0003000200010000, 0x0004000300020100,
+    0x0002000100000000, 0x0003000201000000, 0x0003000201000000, 0x0004000302000100,
+    0x0003000201000000, 0x0004000302010000, 0x0004000302010000, 0x0005000403020100,
+    0x0001000000000000, 0x0002010000000000, 0x0002010000000000, 0x0003020000000100,
+    0x0002010000000000, 0x0003020000010000, 0x0003020000010000, 0x0004030000020100,
+    0x0002010000000000, 0x0003020001000000, 0x0003020001000000, 0x0004030002000100,
+    0x0003020001000000, 0x0004030002010000, 0x0004030002010000, 0x0005040003020100,
+    0x0002010000000000, 0x0003020100000000, 0x0003020100000000, 0x0004030200000100,
+    0x0003020100000000, 0x0004030200010000, 0x0004030200010000, 0x0005040300020100,
+    0x0003020100000000, 0x0004030201000000, 0x0004030201000000, 0x0005040302000100,
+    0x0004030201000000, 0x0005040302010000, 0x0005040302010000, 0x0006050403020100,
+    0x0000000000000000, 0x0100000000000000, 0x0100000000000000, 0x0200000000000100,
+    0x0100000000000000, 0x0200000000010000, 0x0200000000010000, 0x0300000000020100,
+    0x0100000000000000, 0x0200000001000000, 0x0200000001000000, 0x0300000002000100,
+    0x0200000001000000, 0x0300000002010000, 0x0300000002010000, 0x0400000003020100,
+    0x0100000000000000, 0x0200000100000000, 0x0200000100000000, 0x0300000200000100,
+    0x0200000100000000, 0x0300000200010000, 0x0300000200010000, 0x0400000300020100,
+    0x0200000100000000, 0x0300000201000000, 0x0300000201000000, 0x0400000302000100,
+    0x0300000201000000, 0x0400000302010000, 0x0400000302010000, 0x0500000403020100,
+    0x0100000000000000, 0x0200010000000000, 0x0200010000000000, 0x0300020000000100,
+    0x0200010000000000, 0x0300020000010000, 0x0300020000010000, 0x0400030000020100,
+    0x0200010000000000, 0x0300020001000000, 0x0300020001000000, 0x0400030002000100,
+    0x0300020001000000, 0x0400030002010000, 0x0400030002010000, 0x0500040003020100,
+    0x0200010000000000, 0x0300020100000000, 0x0300020100000000, 0x0400030200000100,
+    0x0300020100000000, 0x0400030200010000, 0x0400030200010000, 0x0500040300020100,
+    0x0300020100000000, 0x0400030201000000, 0x0400030201000000, 0x0500040302000100,
+    0x0400030201000000, 0x0500040302010000, 0x0500040302010000, 0x0600050403020100,
+    0x0100000000000000, 0x0201000000000000, 0x0201000000000000, 0x0302000000000100,
+    0x0201000000000000, 0x0302000000010000, 0x0302000000010000, 0x0403000000020100,
+    0x0201000000000000, 0x0302000001000000, 0x0302000001000000, 0x0403000002000100,
+    0x0302000001000000, 0x0403000002010000, 0x0403000002010000, 0x0504000003020100,
+    0x0201000000000000, 0x0302000100000000, 0x0302000100000000, 0x0403000200000100,
+    0x0302000100000000, 0x0403000200010000, 0x0403000200010000, 0x0504000300020100,
+    0x0302000100000000, 0x0403000201000000, 0x0403000201000000, 0x0504000302000100,
+    0x0403000201000000, 0x0504000302010000, 0x0504000302010000, 0x0605000403020100,
+    0x0201000000000000, 0x0302010000000000, 0x0302010000000000, 0x0403020000000100,
+    0x0302010000000000, 0x0403020000010000, 0x0403020000010000, 0x0504030000020100,
+    0x0302010000000000, 0x0403020001000000, 0x0403020001000000, 0x0504030002000100,
+    0x0403020001000000, 0x0504030002010000, 0x0504030002010000, 0x0605040003020100,
+    0x0302010000000000, 0x0403020100000000, 0x0403020100000000, 0x0504030200000100,
+    0x0403020100000000, 0x0504030200010000, 0x0504030200010000, 0x0605040300020100,
+    0x0403020100000000, 0x0504030201000000, 0x0504030201000000, 0x0605040302000100,
+    0x0504030201000000, 0x0605040302010000, 0x0605040302010000, 0x0706050403020100
+};
+
+
+// Decode 'count' symbols (a multiple of 32) with 32 interleaved states in 4
+// vectors of 8 lanes. A gather in the slot table gives symbol, frequency and
+// offset for all lanes, then the lanes to renormalize read consecutive 16 bit
+// words from the stream in lane order.
+KANZI_TARGET_AVX2
+static const kanzi::byte* decodeStatesAVX2(const uint32 slots[], const kanzi::byte* p, uint32 states[],
+                                           kanzi::byte block[], int count, int logRange)
+{
+    const __m256i mask = _mm256_set1_epi32((1 << logRange) - 1);
+    const __m256i top = _mm256_set1_epi32(int(ANSRangeDecoder::ANS_TOP));
+    const __m256i mask8 = _mm256_set1_epi32(0xFF);
+    const __m256i mask12 = _mm256_set1_epi32(0xFFF);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const __m128i shift = _mm_cvtsi32_si128(logRange);
+    const __m128i bswap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    const int* tbl = reinterpret_cast<const int*>(slots);
+    __m256i st[4];
+
+    for (int k = 0; k < 4; k++)
+        st[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&states[8 * k]));
+
+    for (int i = 0; i < count; i += 32) {
+        __m256i sym[4];
+
+        for (int k = 0; k < 4; k++) {
+            const __m256i e = _mm256_i32gather_epi32(tbl, _mm256_and_si256(st[k], mask), 4);
+            const __m256i freq = _mm256_and_si256(_mm256_srli_epi32(e, 8), mask12);
+            sym[k] = _mm256_and_si256(e, mask8);
+            st[k] = _mm256_add_epi32(_mm256_mullo_epi32(freq, _mm256_srl_epi32(st[k], shift)), _mm256_srli_epi32(e, 20));
+        }
+
+        for (int k = 0; k < 4; k++) {
+            const __m256i renorm = _mm256_cmpgt_epi32(top, st[k]);
+            const int m = _mm256_movemask_ps(_mm256_castsi256_ps(renorm));
+            const __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&EXPAND_LANES[m])));
+            __m256i w = _mm256_cvtepu16_epi32(_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), bswap));
+            w = _mm256_permutevar8x32_epi32(w, idx);
+            st[k] = _mm256_blendv_epi8(st[k], _mm256_or_si256(_mm256_slli_epi32(st[k], 16), w), renorm);
+            p += 2 * _mm_popcnt_u32(uint32(m));
+        }
+
+        // Pack 32 symbols to bytes (in state order)
+        const __m256i s01 = _mm256_packus_epi32(sym[0], sym[1]);
+        const __m256i s23 = _mm256_packus_epi32(sym[2], sym[3]);
+        const __m256i s = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(s01, s23), order);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&block[i]), s);
+    }
+
+    for (int k = 0; k < 4; k++)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&states[8 * k]), st[k]);
+
+    return p;
+}
+
+
+#if defined(__GNUC__) && !defined(__clang__)
+   // False positives in the AVX512 intrinsics headers (undefined vectors)
+   #pragma GCC diagnostic push
+   #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+   #pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+// Same as decodeStatesAVX2 with 2 vectors of 16 lanes (the words are expanded
+// to the lanes to renormalize with a masked expand)
+KANZI_TARGET_AVX512
+static const kanzi::byte* decodeStatesAVX512(const uint32 slots[], const kanzi::byte* p, uint32 states[],
+                                             kanzi::byte block[], int count, int logRange)
+{
+    const __m512i mask = _mm512_set1_epi32((1 << logRange) - 1);
+    const __m512i top = _mm512_set1_epi32(int(ANSRangeDecoder::ANS_TOP));
+    const __m512i mask8 = _mm512_set1_epi32(0xFF);
+    const __m512i mask12 = _mm512_set1_epi32(0xFFF);
+    const __m128i shift = _mm_cvtsi32_si128(logRange);
+    const __m256i bswap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                           1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    const int* tbl = reinterpret_cast<const int*>(slots);
+    __m512i st[2];
+
+    for (int k = 0; k < 2; k++)
+        st[k] = _mm512_loadu_si512(&states[16 * k]);
+
+    for (int i = 0; i < count; i += 32) {
+        for (int k = 0; k < 2; k++) {
+            const __m512i e = _mm512_i32gather_epi32(_mm512_and_si512(st[k], mask), tbl, 4);
+            const __m512i freq = _mm512_and_si512(_mm512_srli_epi32(e, 8), mask12);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&block[i + 16 * k]), _mm512_cvtepi32_epi8(_mm512_and_si512(e, mask8)));
+            st[k] = _mm512_add_epi32(_mm512_mullo_epi32(freq, _mm512_srl_epi32(st[k], shift)), _mm512_srli_epi32(e, 20));
+        }
+
+        for (int k = 0; k < 2; k++) {
+            const __mmask16 renorm = _mm512_cmpgt_epi32_mask(top, st[k]);
+            const __m256i words = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), bswap);
+            const __m512i w = _mm512_maskz_expand_epi32(renorm, _mm512_cvtepu16_epi32(words));
+            st[k] = _mm512_mask_or_epi32(st[k], renorm, _mm512_slli_epi32(st[k], 16), w);
+            p += 2 * _mm_popcnt_u32(uint32(renorm));
+        }
+    }
+
+    for (int k = 0; k < 2; k++)
+        _mm512_storeu_si512(&states[16 * k], st[k]);
+
+    return p;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+   #pragma GCC diagnostic pop
+#endif
+#endif
+
+
+// Order 0 with _states interleaved states: state k decodes block[i+k] and
+// renormalizes with the next 16 bit word of the shared stream (in state order)
+bool ANSRangeDecoder::decodeChunkN(kanzi::byte block[], uint count)
+{
+    // Read chunk size
+    const uint sz = uint(EntropyUtils::readVarInt(_bitstream));
+
+    if ((sz >= MAX_CHUNK_SIZE) || (sz > _bufferSize - 66))
+       return false;
+
+    // Read initial ANS states
+    uint32 st[MAX_STATES];
+    const int n = _states;
+
+    for (int k = 0; k < n; k++)
+        st[k] = uint32(_bitstream.readBits(32));
+
+    if (count == 0)
+        return true;
+
+    // Read encoded data from bitstream
+    _bitstream.readBits(&_buffer[0], 8 * sz);
+    memset(&_buffer[sz], 0, _bufferSize - sz);
+    const kanzi::byte* p = &_buffer[0];
+    const kanzi::byte* const endPayload = &_buffer[sz];
+    const int lr = _logRange;
+    const uint32 mask = (1 << lr) - 1;
+    const int countN = count - (count % n);
+    int i = 0;
+
+#ifdef KANZI_SIMD_DISPATCH
+    // The kernels process 32 states
+    if ((n == 32) && (_simdLevel >= CPUFeatures::AVX2)) {
+        if (_simdLevel >= CPUFeatures::AVX512)
+            p = decodeStatesAVX512(_slots, p, st, block, countN, lr);
+        else
+            p = decodeStatesAVX2(_slots, p, st, block, countN, lr);
+
+        i = countN;
+    }
+#endif
+
+    for (; i < countN; i += n) {
+        for (int k = 0; k < n; k++) {
+            const uint32 e = _slots[st[k] & mask];
+            block[i + k] = kanzi::byte(e);
+            const uint32 s = ((e >> 8) & 0xFFF) * (st[k] >> lr) + (e >> 20);
+
+            // Normalize
+            const int x = (s < ANS_TOP) ? -1 : 0;
+            st[k] = (s << (x & 16)) | (uint32(x) & ((uint32(p[0]) << 8) | uint32(p[1])));
+            p -= (x + x);
+        }
+    }
+
+    for (uint j = countN; j < count; j++)
+        block[j] = *p++;
+
+    return p == endPayload;
+}
@@ -19,6 +19,7 @@ limitations under the License.
 
 #include "../EntropyDecoder.hpp"
 #include "../types.hpp"
+#include "../util/CPUFeatures.hpp"
 
 
 // Implementation of an Asymmetric Numeral System decoder.
@@ -41,10 +42,14 @@ namespace kanzi
    class ANSRangeDecoder : public EntropyDecoder {
    public:
       static const uint ANS_TOP;
+      static const int MAX_STATES;
+      static const int DEFAULT_ANS0_CHUNK_SIZE;
 
+      // 'states' must match the encoder (4 or MAX_STATES with order 0)
       ANSRangeDecoder(InputBitStream& bitstream,
                       int order = 0,
-                      int chunkSize = DEFAULT_ANS0_CHUNK_SIZE);
+                      int chunkSize = DEFAULT_ANS0_CHUNK_SIZE,
+                      int states = 4);
 
       ~ANSRangeDecoder();
 
@@ -56,7 +61,6 @@ namespace kanzi
 
 
    private:
-      static const int DEFAULT_ANS0_CHUNK_SIZE;
       static const int DEFAULT_LOG_RANGE;
       static const int MIN_CHUNK_SIZE;
       static const int MAX_CHUNK_SIZE;
@@ -71,9 +75,14 @@ namespace kanzi
       uint _chunkSize;
       uint _order;
       uint _logRange;
+      int _states;
+      uint32* _slots; // slot -> symbol, frequency, slot - cumFreq (MAX_STATES only)
+      CPUFeatures::SIMDLevel _simdLevel;
 
       bool decodeChunk(byte block[], uint count);
 
+      bool decodeChunkN(byte block[], uint count);
+
       uint decodeSymbol(byte*& p, uint& st, const ANSDecSymbol& sym, const int mask) const;
 
       int decodeHeader(uint frequencies[], uint alphabet[]);
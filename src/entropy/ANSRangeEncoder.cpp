@@ -25,6 +25,7 @@ using namespace kanzi;
 using namespace std;
 
 const int ANSRangeEncoder::ANS_TOP = 1 << 15; // max possible for ANS_TOP=1<<23
+const int ANSRangeEncoder::MAX_STATES = 32;
 const int ANSRangeEncoder::DEFAULT_ANS0_CHUNK_SIZE = 16384;
 const int ANSRangeEncoder::DEFAULT_LOG_RANGE = 12;
 const int ANSRangeEncoder::MIN_CHUNK_SIZE = 1024;
@@ -33,11 +34,17 @@ const int ANSRangeEncoder::MAX_CHUNK_SIZE = 1 << 27; // 8*MAX_CHUNK_SIZE must no
 
 // The chunk size indicates how many bytes are encoded (per block) before
 // resetting the frequency stats.
-ANSRangeEncoder::ANSRangeEncoder(OutputBitStream& bitstream, int order, int chunkSize, int logRange) : _bitstream(bitstream)
+ANSRangeEncoder::ANSRangeEncoder(OutputBitStream& bitstream, int order, int chunkSize, int logRange, int states) : _bitstream(bitstream)
 {
     if ((order != 0) && (order != 1))
         throw invalid_argument("ANS Codec: The order must be 0 or 1");
 
+    if ((states != 4) && ((states != MAX_STATES) || (order != 0))) {
+        stringstream ss;
+        ss << "ANS Codec: Invalid number of states: " << states << " (must be 4 or " << MAX_STATES << " with order 0)";
+        throw invalid_argument(ss.str());
+    }
+
     if (chunkSize < MIN_CHUNK_SIZE) {
         stringstream ss;
         ss << "ANS Codec: The chunk size must be at least " << MIN_CHUNK_SIZE;
@@ -56,6 +63,13 @@ ANSRangeEncoder::ANSRangeEncoder(OutputBitStream& bitstream, int order, int chun
         throw invalid_argument(ss.str());
     }
 
+    // The decoder packs symbol, frequency and slot offset in 32 bits
+    if ((states != 4) && (logRange > 12)) {
+        stringstream ss;
+        ss << "ANS Codec: Invalid range: " << logRange << " (must be in [8..12] with " << states << " states)";
+        throw invalid_argument(ss.str());
+    }
+
     const uint64 scaledChunkSize = uint64(chunkSize) << (8 * order);
     _chunkSize = uint(min(scaledChunkSize, uint64(MAX_CHUNK_SIZE)));
     _order = order;
@@ -65,6 +79,7 @@ ANSRangeEncoder::ANSRangeEncoder(OutputBitStream& bitstream, int order, int chun
     _buffer = nullptr;
     _bufferSize = 0;
     _logRange = (order == 0) ? logRange : max(logRange - 1, 8);
+    _states = states;
 }
 
 ANSRangeEncoder::~ANSRangeEncoder()
@@ -184,7 +199,11 @@ int ANSRangeEncoder::encode(const kanzi::byte block[], uint blkptr, uint count)
             continue;
         }
 
-        encodeChunk(&block[startChunk], sizeChunk);
+        if (_states == 4)
+            encodeChunk(&block[startChunk], sizeChunk);
+        else
+            encodeChunkN(&block[startChunk], sizeChunk);
+
         startChunk += sizeChunk;
     }
 
@@ -260,6 +279,42 @@ void ANSRangeEncoder::encodeChunk(const kanzi::byte block[], int end)
     }
 }
 
+// Order 0 with _states interleaved states. The decoder processes the states
+// in order (state k decodes block[i+k]) and each state pulls its 16 bit
+// renormalization word from the shared stream. Encode in the reverse order
+// since the stream is written backwards.
+void ANSRangeEncoder::encodeChunkN(const kanzi::byte block[], int end)
+{
+    int st[MAX_STATES];
+    kanzi::byte* p = &_buffer[_bufferSize - 1];
+    const kanzi::byte* p0 = p;
+    const int n = _states;
+    const int endN = end - (end % n);
+
+    for (int k = 0; k < n; k++)
+        st[k] = ANS_TOP;
+
+    for (int i = end - 1; i >= endN; i--)
+        *p-- = block[i];
+
+    for (int i = endN - n; i >= 0; i -= n) {
+        for (int k = n - 1; k >= 0; k--)
+            st[k] = encodeSymbol(p, st[k], _symbols[int(block[i + k])]);
+    }
+
+    // Write chunk size
+    EntropyUtils::writeVarInt(_bitstream, uint32(p0 - p));
+
+    // Write final ANS states
+    for (int k = 0; k < n; k++)
+        _bitstream.writeBits(st[k], 32);
+
+    if (p != p0) {
+        // Write encoded data to bitstream
+        _bitstream.writeBits(&p[1], 8 * uint(p0 - p));
+    }
+}
+
 // Compute chunk frequencies, cumulated frequencies and encode chunk header
 int ANSRangeEncoder::rebuildStatistics(const kanzi::byte block[], int end, uint lr)
 {
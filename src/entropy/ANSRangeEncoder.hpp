@@ -44,11 +44,17 @@ namespace kanzi
    {
    public:
        static const int ANS_TOP;
+       static const int MAX_STATES;
+       static const int DEFAULT_ANS0_CHUNK_SIZE;
+       static const int DEFAULT_LOG_RANGE;
 
+       // 'states' is the number of interleaved ANS states: 4 or MAX_STATES (order 0
+       // only, the decoder can process the states with vector instructions).
        ANSRangeEncoder(OutputBitStream& bitstream,
                       int order = 0,
                       int chunkSize = DEFAULT_ANS0_CHUNK_SIZE,
-                      int logRange = DEFAULT_LOG_RANGE);
+                      int logRange = DEFAULT_LOG_RANGE,
+                      int states = 4);
 
        ~ANSRangeEncoder();
 
@@ -62,8 +68,6 @@ namespace kanzi
 
 
    private:
-       static const int DEFAULT_ANS0_CHUNK_SIZE;
-       static const int DEFAULT_LOG_RANGE;
        static const int MIN_CHUNK_SIZE;
        static const int MAX_CHUNK_SIZE;
 
@@ -75,12 +79,15 @@ namespace kanzi
        uint _chunkSize;
        uint _logRange;
        uint _order;
+       int _states;
 
 
        int rebuildStatistics(const byte block[], int end, uint lr);
 
        void encodeChunk(const byte block[], int end);
 
+       void encodeChunkN(const byte block[], int end);
+
        int encodeSymbol(byte*& p, int& st, const ANSEncSymbol& sym) const;
 
        bool encodeHeader(int alphabetSize, const uint alphabet[], const uint frequencies[], uint lr) const;
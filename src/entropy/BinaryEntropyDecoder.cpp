@@ -29,20 +29,6 @@ const int BinaryEntropyDecoder::MAX_BLOCK_SIZE = 1 << 30;
 const int BinaryEntropyDecoder::MAX_CHUNK_SIZE = 1 << 26;
 
 
-BinaryEntropyDecoder::BinaryEntropyDecoder(InputBitStream& bitstream, Predictor* predictor, bool deallocate)
-    : _predictor(predictor)
-    , _bitstream(bitstream)
-    , _deallocate(deallocate)
-    , _sba(nullptr, 0)
-{
-    if (predictor == nullptr)
-        throw invalid_argument("Invalid null predictor parameter");
-
-    _low = 0;
-    _high = TOP;
-    _current = 0;
-}
-
 BinaryEntropyDecoder::~BinaryEntropyDecoder()
 {
     _dispose();
@@ -110,16 +96,7 @@ int BinaryEntropyDecoder::decode(kanzi::byte block[], uint blkptr, uint count)
         _sba._index = 0;
         const uint endChunk = startChunk + chunkSize;
 
-        for (uint i = startChunk; i < endChunk; i++) {
-            block[i] = kanzi::byte((decodeBit(_predictor->get()) << 7)
-                          | (decodeBit(_predictor->get()) << 6)
-                          | (decodeBit(_predictor->get()) << 5)
-                          | (decodeBit(_predictor->get()) << 4)
-                          | (decodeBit(_predictor->get()) << 3)
-                          | (decodeBit(_predictor->get()) << 2)
-                          | (decodeBit(_predictor->get()) << 1)
-                          |  decodeBit(_predictor->get()));
-        }
+        (this->*_decodeChunk)(block, startChunk, endChunk);
 
         startChunk = endChunk;
     }
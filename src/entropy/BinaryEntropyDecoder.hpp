@@ -17,6 +17,7 @@ limitations under the License.
 #ifndef knz_BinaryEntropyDecoder
 #define knz_BinaryEntropyDecoder
 
+#include <stdexcept>
 #include "../EntropyDecoder.hpp"
 #include "../Predictor.hpp"
 #include "../SliceArray.hpp"
@@ -35,6 +36,7 @@ namespace kanzi
        static const int MAX_CHUNK_SIZE;
 
        Predictor* _predictor;
+       void (BinaryEntropyDecoder::*_decodeChunk)(byte block[], uint start, uint end);
        uint64 _low;
        uint64 _high;
        uint64 _current;
@@ -48,8 +50,14 @@ namespace kanzi
 
        void _dispose() const {}
 
+       template <class P>
+       void decodeChunk(byte block[], uint start, uint end);
+
    public:
-       BinaryEntropyDecoder(InputBitStream& bitstream, Predictor* predictor, bool deallocate=true);
+       // The decoding loop is specialized for the static type of the predictor
+       // (see BinaryEntropyEncoder).
+       template <class P>
+       BinaryEntropyDecoder(InputBitStream& bitstream, P* predictor, bool deallocate=true);
 
        ~BinaryEntropyDecoder();
 
@@ -65,6 +73,63 @@ namespace kanzi
    };
 
 
+   template <class P>
+   BinaryEntropyDecoder::BinaryEntropyDecoder(InputBitStream& bitstream, P* predictor, bool deallocate)
+       : _predictor(predictor)
+       , _bitstream(bitstream)
+       , _deallocate(deallocate)
+       , _sba(nullptr, 0)
+   {
+       if (predictor == nullptr)
+           throw std::invalid_argument("Invalid null predictor parameter");
+
+       _decodeChunk = &BinaryEntropyDecoder::decodeChunk<P>;
+       _low = 0;
+       _high = TOP;
+       _current = 0;
+   }
+
+
+   template <class P>
+   void BinaryEntropyDecoder::decodeChunk(byte block[], uint start, uint end)
+   {
+       P* predictor = static_cast<P*>(_predictor);
+       uint64 low = _low;
+       uint64 high = _high;
+       uint64 current = _current;
+
+       for (uint i = start; i < end; i++) {
+           int val = 0;
+
+           for (int n = 0; n < 8; n++) {
+               // Calculate interval split
+               const uint64 split = ((((high - low) >> 4) * uint64(predictor->get())) >> 8) + low;
+               const int bit = (split >= current) ? 1 : 0;
+               (bit != 0) ? high = split : low = split + 1;
+               predictor->update(bit);
+               val = (val << 1) | bit;
+
+               // Read 32 bits from bitstream
+               if (((low ^ high) >> 24) == 0) {
+                   _low = low;
+                   _high = high;
+                   _current = current;
+                   read();
+                   low = _low;
+                   high = _high;
+                   current = _current;
+               }
+           }
+
+           block[i] = byte(val);
+       }
+
+       _low = low;
+       _high = high;
+       _current = current;
+   }
+
+
    inline int BinaryEntropyDecoder::decodeBit(int pred)
    {
        // Calculate interval split
@@ -30,20 +30,6 @@ const int BinaryEntropyEncoder::MAX_CHUNK_SIZE = 1 << 26;
 static const uint64 BINARY_ENTROPY_BUFFER_FLOOR = uint64(8) << 20;
 
 
-BinaryEntropyEncoder::BinaryEntropyEncoder(OutputBitStream& bitstream, Predictor* predictor, bool deallocate)
-    : _predictor(predictor)
-    , _bitstream(bitstream)
-    , _deallocate(deallocate)
-    , _sba(nullptr, 0)
-{
-    if (predictor == nullptr)
-        throw invalid_argument("Invalid null predictor parameter");
-
-    _low = 0;
-    _high = TOP;
-    _disposed = false;
-}
-
 BinaryEntropyEncoder::~BinaryEntropyEncoder()
 {
     _dispose();
@@ -96,16 +82,7 @@ int BinaryEntropyEncoder::encode(const kanzi::byte block[], uint blkptr, uint co
         const uint endChunk = startChunk + chunkSize;
         _sba._index = 0;
 
-        for (uint i = startChunk; i < endChunk; i++) {
-            encodeBit(int(block[i]) & 0x80, _predictor->get());
-            encodeBit(int(block[i]) & 0x40, _predictor->get());
-            encodeBit(int(block[i]) & 0x20, _predictor->get());
-            encodeBit(int(block[i]) & 0x10, _predictor->get());
-            encodeBit(int(block[i]) & 0x08, _predictor->get());
-            encodeBit(int(block[i]) & 0x04, _predictor->get());
-            encodeBit(int(block[i]) & 0x02, _predictor->get());
-            encodeBit(int(block[i]) & 0x01, _predictor->get());
-        }
+        (this->*_encodeChunk)(block, startChunk, endChunk);
 
         EntropyUtils::writeVarInt(_bitstream, uint32(_sba._index));
         _bitstream.writeBits(&_sba._array[0], 8 * _sba._index);
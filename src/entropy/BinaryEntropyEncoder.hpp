@@ -17,6 +17,7 @@ limitations under the License.
 #ifndef knz_BinaryEntropyEncoder
 #define knz_BinaryEntropyEncoder
 
+#include <stdexcept>
 #include "../EntropyEncoder.hpp"
 #include "../Predictor.hpp"
 #include "../SliceArray.hpp"
@@ -35,6 +36,7 @@ namespace kanzi
        static const int MAX_CHUNK_SIZE;
 
        Predictor* _predictor;
+       void (BinaryEntropyEncoder::*_encodeChunk)(const byte block[], uint start, uint end);
        uint64 _low;
        uint64 _high;
        OutputBitStream& _bitstream;
@@ -48,8 +50,15 @@ namespace kanzi
 
        void flush();
 
+       template <class P>
+       void encodeChunk(const byte block[], uint start, uint end);
+
    public:
-       BinaryEntropyEncoder(OutputBitStream& bitstream, Predictor* predictor, bool deallocate=true);
+       // The coding loop is specialized for the static type of the predictor:
+       // with a final predictor class (eg. CMPredictor, TPAQPredictor), get()
+       // and update() are called directly instead of through the vtable.
+       template <class P>
+       BinaryEntropyEncoder(OutputBitStream& bitstream, P* predictor, bool deallocate=true);
 
        ~BinaryEntropyEncoder();
 
@@ -65,6 +74,57 @@ namespace kanzi
    };
 
 
+   template <class P>
+   BinaryEntropyEncoder::BinaryEntropyEncoder(OutputBitStream& bitstream, P* predictor, bool deallocate)
+       : _predictor(predictor)
+       , _bitstream(bitstream)
+       , _deallocate(deallocate)
+       , _sba(nullptr, 0)
+   {
+       if (predictor == nullptr)
+           throw std::invalid_argument("Invalid null predictor parameter");
+
+       _encodeChunk = &BinaryEntropyEncoder::encodeChunk<P>;
+       _low = 0;
+       _high = TOP;
+       _disposed = false;
+   }
+
+
+   template <class P>
+   void BinaryEntropyEncoder::encodeChunk(const byte block[], uint start, uint end)
+   {
+       P* predictor = static_cast<P*>(_predictor);
+       uint64 low = _low;
+       uint64 high = _high;
+
+       for (uint i = start; i < end; i++) {
+           const int val = int(block[i]);
+
+           for (int shift = 7; shift >= 0; shift--) {
+               const int bit = (val >> shift) & 1;
+
+               // Update fields with new interval bounds and predictor
+               const uint64 mid = low + ((((high - low) >> 4) * uint64(predictor->get())) >> 8);
+               (bit != 0) ? high = mid : low = mid + 1;
+               predictor->update(bit);
+
+               // Write unchanged first 32 bits to bitstream
+               if (((low ^ high) >> 24) == 0) {
+                   _low = low;
+                   _high = high;
+                   flush();
+                   low = _low;
+                   high = _high;
+               }
+           }
+       }
+
+       _low = low;
+       _high = high;
+   }
+
+
    inline void BinaryEntropyEncoder::encodeBit(int bit, int pred)
    {
        // Update fields with new interval bounds and predictor
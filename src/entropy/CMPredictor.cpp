@@ -30,7 +30,7 @@ CMPredictor::CMPredictor(Context* pCtx)
     _runMask = 0;
     _c1 = 0;
     _c2 = 0;
-    const int bsVersion = (pCtx == nullptr) ? 7 : pCtx->getInt("bsVersion", 7);
+    const int bsVersion = (pCtx == nullptr) ? 7 : pCtx->getInt(Context::BS_VERSION, 7);
 
     for (int i = 0; i < 256; i++) {
         for (int j = 0; j <= 256; j++)
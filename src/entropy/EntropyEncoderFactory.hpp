@@ -20,6 +20,7 @@ limitations under the License.
 #include <algorithm>
 #include "../util/strings.hpp"
 #include "../Context.hpp"
+#include "../Dictionary.hpp"
 #include "ANSRangeEncoder.hpp"
 #include "BinaryEntropyEncoder.hpp"
 #include "HuffmanEncoder.hpp"
@@ -44,14 +45,15 @@ namespace kanzi {
        static const short TPAQ_TYPE = 7; // Tangelo PAQ
        static const short ANS1_TYPE = 8; // Asymmetric Numerical System order 1
        static const short TPAQX_TYPE = 9; // Tangelo PAQ Extra
-       static const short RESERVED1 = 10; //Reserved
+       static const short ANS0X_TYPE = 10; // Asymmetric Numerical System order 0, 32 interleaved states
        static const short RESERVED2 = 11; //Reserved
        static const short RESERVED3 = 12; //Reserved
        static const short RESERVED4 = 13; //Reserved
        static const short RESERVED5 = 14; //Reserved
        static const short RESERVED6 = 15; //Reserved
 
-       static EntropyEncoder* newEncoder(OutputBitStream& obs, Context& ctx, short entropyType);
+       // 'arena' (optional) provides the memory of the TPAQ models
+       static EntropyEncoder* newEncoder(OutputBitStream& obs, Context& ctx, short entropyType, ModelArena* arena = nullptr);
 
        static const char* getName(short entropyType);
 
@@ -59,7 +61,7 @@ namespace kanzi {
    };
 
 
-   inline EntropyEncoder* EntropyEncoderFactory::newEncoder(OutputBitStream& obs, Context& ctx, short entropyType)
+   inline EntropyEncoder* EntropyEncoderFactory::newEncoder(OutputBitStream& obs, Context& ctx, short entropyType, ModelArena* arena)
    {
        switch (entropyType) {
        case HUFFMAN_TYPE:
@@ -71,6 +73,10 @@ namespace kanzi {
        case ANS1_TYPE:
            return new ANSRangeEncoder(obs, 1);
 
+       case ANS0X_TYPE:
+           return new ANSRangeEncoder(obs, 0, ANSRangeEncoder::DEFAULT_ANS0_CHUNK_SIZE,
+                                      ANSRangeEncoder::DEFAULT_LOG_RANGE, ANSRangeEncoder::MAX_STATES);
+
        case RANGE_TYPE:
            return new RangeEncoder(obs);
 
@@ -78,13 +84,13 @@ namespace kanzi {
            return new FPAQEncoder(obs);
 
        case CM_TYPE:
-           return new BinaryEntropyEncoder(obs, new CMPredictor(&ctx));
+           return new BinaryEntropyEncoder(obs, Dictionary::primePredictor(ctx, new CMPredictor(&ctx)));
 
        case TPAQ_TYPE:
-           return new BinaryEntropyEncoder(obs, new TPAQPredictor<false>(&ctx));
+           return new BinaryEntropyEncoder(obs, Dictionary::primePredictor(ctx, new TPAQPredictor<false>(&ctx, arena)));
 
        case TPAQX_TYPE:
-           return new BinaryEntropyEncoder(obs, new TPAQPredictor<true>(&ctx));
+           return new BinaryEntropyEncoder(obs, Dictionary::primePredictor(ctx, new TPAQPredictor<true>(&ctx, arena)));
 
        case NONE_TYPE:
            return new NullEntropyEncoder(obs);
@@ -110,6 +116,9 @@ namespace kanzi {
        case ANS1_TYPE:
            return "ANS1";
 
+       case ANS0X_TYPE:
+           return "ANS0X";
+
        case RANGE_TYPE:
            return "RANGE";
 
@@ -151,6 +160,9 @@ namespace kanzi {
        if (name == "ANS1")
            return ANS1_TYPE;
 
+       if (name == "ANS0X")
+           return ANS0X_TYPE;
+
        if (name == "FPAQ")
            return FPAQ_TYPE;
 
@@ -21,6 +21,7 @@ using namespace kanzi;
 const int HuffmanCommon::LOG_MAX_CHUNK_SIZE = 14;
 const int HuffmanCommon::MAX_CHUNK_SIZE = 1 << LOG_MAX_CHUNK_SIZE;
 const int HuffmanCommon::MAX_SYMBOL_SIZE = 12;
+const int HuffmanCommon::MAX_STREAMS = 32;
 const int HuffmanCommon::BUFFER_SIZE = (MAX_SYMBOL_SIZE << 8) + 256;
 
 
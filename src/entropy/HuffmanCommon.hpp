@@ -29,6 +29,7 @@ namespace kanzi
        static const int LOG_MAX_CHUNK_SIZE;
        static const int MAX_CHUNK_SIZE;
        static const int MAX_SYMBOL_SIZE;
+       static const int MAX_STREAMS; // interleaved streams per chunk
 
        static int generateCanonicalCodes(const uint16 sizes[], uint16 codes[], uint ranks[], int count);
 
@@ -46,6 +46,8 @@ HuffmanDecoder::HuffmanDecoder(InputBitStream& bitstream, Context* pCtx, int chu
     _buffer = nullptr;
     _bufferSize = 0;
     _pCtx = pCtx;
+    _bsVersion = (pCtx == nullptr) ? 7 : pCtx->getInt(Context::BS_VERSION, 7);
+    _simdLevel = CPUFeatures::getSIMDLevel();
     reset();
 }
 
@@ -144,9 +146,7 @@ int HuffmanDecoder::decode(kanzi::byte block[], uint blkptr, uint count)
     if (count == 0)
         return 0;
 
-    int bsVersion = _pCtx == nullptr ? 6 : _pCtx->getInt("bsVersion", 6);
-
-    if (bsVersion < 6)
+    if (_bsVersion < 6)
         return decodeV5(block, blkptr, count);
 
     return decodeV6(block, blkptr, count);
@@ -155,7 +155,7 @@ int HuffmanDecoder::decode(kanzi::byte block[], uint blkptr, uint count)
 
 int HuffmanDecoder::decodeV6(kanzi::byte block[], uint blkptr, uint count)
 {
-    const uint minBufSize = 2 * uint(_chunkSize) + (4 * HUFFMAN_FRAGMENT_GUARD_BYTES);
+    const uint minBufSize = 2 * uint(_chunkSize) + (HuffmanCommon::MAX_STREAMS * HUFFMAN_FRAGMENT_GUARD_BYTES);
 
     if (_bufferSize < minBufSize) {
         kanzi::byte* buffer = new kanzi::byte[minBufSize];
@@ -200,43 +200,264 @@ int HuffmanDecoder::decodeV6(kanzi::byte block[], uint blkptr, uint count)
     return count;
 }
 
+#ifdef KANZI_SIMD_DISPATCH
+// Decode 8*N interleaved streams of szFrag symbols, one per 32 bit lane.
+// Each lane reads the next 32 bits of its stream at its bit position (gather)
+// which is enough to decode 2 symbols (at most 2*12 bits). The N vectors are
+// independent dependency chains (hide the latency of the gathers).
+template <int N>
+KANZI_TARGET_AVX2
+static void decodeStreamsAVX2(const uint16 table[], const kanzi::byte buffer[], kanzi::byte block[],
+                              int szFrag, const int base[], int used[])
+{
+    const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                           3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    const __m256i mask8 = _mm256_set1_epi32(0xFF);
+    const __m256i mask3 = _mm256_set1_epi32(7);
+    const int* src = reinterpret_cast<const int*>(buffer);
+    const int* tbl = reinterpret_cast<const int*>(table);
+    __m256i pos[N];
+    uint32 out[8 * N];
+    int n = 0;
+
+    for (int k = 0; k < N; k++)
+        pos[k] = _mm256_slli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&base[8 * k])), 3);
+
+#define DECODE_SYMBOL(w, pos, sym) do { \
+       const __m256i val = _mm256_i32gather_epi32(tbl, _mm256_srli_epi32(w, 20), 2); \
+       const __m256i len = _mm256_and_si256(val, mask8); \
+       sym = _mm256_and_si256(_mm256_srli_epi32(val, 8), mask8); \
+       w = _mm256_sllv_epi32(w, len); \
+       pos = _mm256_add_epi32(pos, len); \
+    } while (0)
+
+#define READ_WORD(w, pos) do { \
+       w = _mm256_i32gather_epi32(src, _mm256_srli_epi32(pos, 3), 1); \
+       w = _mm256_sllv_epi32(_mm256_shuffle_epi8(w, bswap), _mm256_and_si256(pos, mask3)); \
+    } while (0)
+
+    for (; n + 4 <= szFrag; n += 4) {
+        __m256i w[N], s0[N], s1[N], s2[N], s3[N];
+
+        for (int k = 0; k < N; k++) READ_WORD(w[k], pos[k]);
+        for (int k = 0; k < N; k++) DECODE_SYMBOL(w[k], pos[k], s0[k]);
+        for (int k = 0; k < N; k++) DECODE_SYMBOL(w[k], pos[k], s1[k]);
+        for (int k = 0; k < N; k++) READ_WORD(w[k], pos[k]);
+        for (int k = 0; k < N; k++) DECODE_SYMBOL(w[k], pos[k], s2[k]);
+        for (int k = 0; k < N; k++) DECODE_SYMBOL(w[k], pos[k], s3[k]);
+
+        // Pack 4 symbols per lane and write them to each fragment
+        for (int k = 0; k < N; k++) {
+            const __m256i s01 = _mm256_or_si256(s0[k], _mm256_slli_epi32(s1[k], 8));
+            const __m256i s23 = _mm256_or_si256(_mm256_slli_epi32(s2[k], 16), _mm256_slli_epi32(s3[k], 24));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[8 * k]), _mm256_or_si256(s01, s23));
+        }
+
+        for (int i = 0; i < 8 * N; i++)
+            memcpy(&block[i * szFrag + n], &out[i], 4);
+    }
+
+#undef READ_WORD
+#undef DECODE_SYMBOL
+
+    for (int k = 0; k < N; k++)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[8 * k]), pos[k]);
+
+    for (int i = 0; i < 8 * N; i++) {
+        uint p = out[i];
+
+        for (int j = n; j < szFrag; j++) {
+            const uint32 w = uint32(BigEndian::readInt32(&buffer[p >> 3])) << (p & 7);
+            const uint16 val = table[w >> 20];
+            block[i * szFrag + j] = kanzi::byte(val >> 8);
+            p += (val & 0xFF);
+        }
+
+        used[i] = int(p) - (base[i] << 3);
+    }
+}
+
+
+#if defined(__GNUC__) && !defined(__clang__)
+   // False positives in the AVX512 intrinsics headers (undefined vectors)
+   #pragma GCC diagnostic push
+   #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+   #pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+// Same as decodeStreamsAVX2 with 16*N streams (the symbols are scattered to the fragments)
+template <int N>
+KANZI_TARGET_AVX512
+static void decodeStreamsAVX512(const uint16 table[], const kanzi::byte buffer[], kanzi::byte block[],
+                                int szFrag, const int base[], int used[])
+{
+    const __m512i bswap = _mm512_set4_epi32(0x0C0D0E0F, 0x08090A0B, 0x04050607, 0x00010203);
+    const __m512i mask8 = _mm512_set1_epi32(0xFF);
+    const __m512i mask3 = _mm512_set1_epi32(7);
+    const int* src = reinterpret_cast<const int*>(buffer);
+    const int* tbl = reinterpret_cast<const int*>(table);
+    __m512i pos[N];
+    uint32 out[16 * N];
+    int n = 0;
+
+    __m512i dst[N]; // fragment offsets in block
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+    for (int k = 0; k < N; k++) {
+        pos[k] = _mm512_slli_epi32(_mm512_loadu_si512(&base[16 * k]), 3);
+        dst[k] = _mm512_mullo_epi32(_mm512_add_epi32(lanes, _mm512_set1_epi32(16 * k)), _mm512_set1_epi32(szFrag));
+    }
+
+#define DECODE_SYMBOL(w, pos, sym) do { \
+       const __m512i val = _mm512_i32gather_epi32(_mm512_srli_epi32(w, 20), tbl, 2); \
+       const __m512i len = _mm512_and_si512(val, mask8); \
+       sym = _mm512_and_si512(_mm512_srli_epi32(val, 8), mask8); \
+       w = _mm512_sllv_epi32(w, len); \
+       pos = _mm512_add_epi32(pos, len); \
+    } while (0)
+
+#define READ_WORD(w, pos) do { \
+       w = _mm512_i32gather_epi32(_mm512_srli_epi32(pos, 3), src, 1); \
+       w = _mm512_sllv_epi32(_mm512_shuffle_epi8(w, bswap), _mm512_and_si512(pos, mask3)); \
+    } while (0)
+
+    for (; n + 4 <= szFrag; n += 4) {
+        __m512i w[N], s0[N], s1[N], s2[N], s3[N];
+
+        for (int k = 0; k < N; k++) READ_WORD(w[k], pos[k]);
+        for (int k = 0; k < N; k++) DECODE_SYMBOL(w[k], pos[k], s0[k]);
+        for (int k = 0; k < N; k++) DECODE_SYMBOL(w[k], pos[k], s1[k]);
+        for (int k = 0; k < N; k++) READ_WORD(w[k], pos[k]);
+        for (int k = 0; k < N; k++) DECODE_SYMBOL(w[k], pos[k], s2[k]);
+        for (int k = 0; k < N; k++) DECODE_SYMBOL(w[k], pos[k], s3[k]);
+
+        // Pack 4 symbols per lane and write them to each fragment
+        for (int k = 0; k < N; k++) {
+            const __m512i s01 = _mm512_or_si512(s0[k], _mm512_slli_epi32(s1[k], 8));
+            const __m512i s23 = _mm512_or_si512(_mm512_slli_epi32(s2[k], 16), _mm512_slli_epi32(s3[k], 24));
+            _mm512_i32scatter_epi32(&block[n], dst[k], _mm512_or_si512(s01, s23), 1);
+        }
+    }
+
+#undef READ_WORD
+#undef DECODE_SYMBOL
+
+    for (int k = 0; k < N; k++)
+        _mm512_storeu_si512(&out[16 * k], pos[k]);
+
+    for (int i = 0; i < 16 * N; i++) {
+        uint p = out[i];
+
+        for (int j = n; j < szFrag; j++) {
+            const uint32 w = uint32(BigEndian::readInt32(&buffer[p >> 3])) << (p & 7);
+            const uint16 val = table[w >> 20];
+            block[i * szFrag + j] = kanzi::byte(val >> 8);
+            p += (val & 0xFF);
+        }
+
+        used[i] = int(p) - (base[i] << 3);
+    }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+   #pragma GCC diagnostic pop
+#endif
+#endif
+
+
 // count is at least 32
 bool HuffmanDecoder::decodeChunk(kanzi::byte block[], uint count)
 {
-    // Read fragment sizes
-    const int szBits0 = EntropyUtils::readVarInt(_bitstream);
-    const int szBits1 = EntropyUtils::readVarInt(_bitstream);
-    const int szBits2 = EntropyUtils::readVarInt(_bitstream);
-    const int szBits3 = EntropyUtils::readVarInt(_bitstream);
+    int szBits[32];
+    int nbStreams = 4;
+
+    if (_bsVersion >= 7) {
+        // Number of interleaved streams (4, 8, 16 or 32) and fragment sizes
+        // (first size then zigzag encoded differences)
+        nbStreams <<= int(_bitstream.readBits(2));
+        szBits[0] = EntropyUtils::readVarInt(_bitstream);
+
+        for (int i = 1; i < nbStreams; i++) {
+            const uint32 delta = EntropyUtils::readVarInt(_bitstream);
+            szBits[i] = int(uint32(szBits[i - 1]) + ((delta >> 1) ^ (0 - (delta & 1))));
+        }
+    }
+    else {
+        // Read fragment sizes
+        for (int i = 0; i < nbStreams; i++)
+            szBits[i] = EntropyUtils::readVarInt(_bitstream);
+    }
 
-    if ((szBits0 < 0) || (szBits1 < 0) || (szBits2 < 0) || (szBits3 < 0))
-        return false;
+    for (int i = 0; i < nbStreams; i++) {
+        if (szBits[i] < 0)
+            return false;
+    }
 
-    const uint fragCapacity = (_bufferSize - (4 * HUFFMAN_FRAGMENT_GUARD_BYTES)) >> 2;
+    const uint fragCapacity = (_bufferSize - (HuffmanCommon::MAX_STREAMS * HUFFMAN_FRAGMENT_GUARD_BYTES)) / nbStreams;
     const uint fragStride = fragCapacity + HUFFMAN_FRAGMENT_GUARD_BYTES;
     const int maxFragBits = int(fragCapacity << 3);
+    int base[32];
+    int used[32];
+
+    // Read all compressed data from bitstream
+    for (int i = 0; i < nbStreams; i++) {
+        if (szBits[i] > maxFragBits)
+            return false;
 
-    if ((szBits0 > maxFragBits) || (szBits1 > maxFragBits) || (szBits2 > maxFragBits) || (szBits3 > maxFragBits))
-        return false;
+        base[i] = i * fragStride;
+        _bitstream.readBits(&_buffer[base[i]], szBits[i]);
+        memset(&_buffer[base[i] + ((szBits[i] + 7) >> 3)], 0, HUFFMAN_FRAGMENT_GUARD_BYTES);
+    }
 
-    const int base0 = 0 * fragStride;
-    const int base1 = 1 * fragStride;
-    const int base2 = 2 * fragStride;
-    const int base3 = 3 * fragStride;
-    int idx0 = base0;
-    int idx1 = base1;
-    int idx2 = base2;
-    int idx3 = base3;
+    const int szFrag = count / nbStreams;
+    bool decoded = false;
 
-    // Read all compressed data from bitstream
-    _bitstream.readBits(&_buffer[idx0], szBits0);
-    _bitstream.readBits(&_buffer[idx1], szBits1);
-    _bitstream.readBits(&_buffer[idx2], szBits2);
-    _bitstream.readBits(&_buffer[idx3], szBits3);
-    memset(&_buffer[idx0 + ((szBits0 + 7) >> 3)], 0, HUFFMAN_FRAGMENT_GUARD_BYTES);
-    memset(&_buffer[idx1 + ((szBits1 + 7) >> 3)], 0, HUFFMAN_FRAGMENT_GUARD_BYTES);
-    memset(&_buffer[idx2 + ((szBits2 + 7) >> 3)], 0, HUFFMAN_FRAGMENT_GUARD_BYTES);
-    memset(&_buffer[idx3 + ((szBits3 + 7) >> 3)], 0, HUFFMAN_FRAGMENT_GUARD_BYTES);
+#ifdef KANZI_SIMD_DISPATCH
+    if ((nbStreams >= 16) && (_simdLevel >= CPUFeatures::AVX512)) {
+        if (nbStreams == 32)
+            decodeStreamsAVX512<2>(_table, _buffer, block, szFrag, base, used);
+        else
+            decodeStreamsAVX512<1>(_table, _buffer, block, szFrag, base, used);
+
+        decoded = true;
+    }
+    else if ((nbStreams >= 8) && (_simdLevel >= CPUFeatures::AVX2)) {
+        if (nbStreams == 32)
+            decodeStreamsAVX2<4>(_table, _buffer, block, szFrag, base, used);
+        else if (nbStreams == 16)
+            decodeStreamsAVX2<2>(_table, _buffer, block, szFrag, base, used);
+        else
+            decodeStreamsAVX2<1>(_table, _buffer, block, szFrag, base, used);
+
+        decoded = true;
+    }
+#endif
+
+    if (decoded == false) {
+        for (int i = 0; i < nbStreams; i += 4)
+            decodeStreams(&block[i * szFrag], szFrag, &base[i], &used[i]);
+    }
+
+    // Process any remaining bytes at the end of the whole chunk
+    for (uint n = uint(nbStreams * szFrag); n < count; n++)
+        block[n] = kanzi::byte(_bitstream.readBits(8));
+
+    for (int i = 0; i < nbStreams; i++) {
+        if (used[i] != szBits[i])
+            return false;
+    }
+
+    return true;
+}
+
+// Decode 4 interleaved streams of szFrag symbols
+// Return the number of bits consumed per stream in 'used'
+void HuffmanDecoder::decodeStreams(kanzi::byte block[], int szFrag, const int base[], int used[]) const
+{
+    int idx0 = base[0];
+    int idx1 = base[1];
+    int idx2 = base[2];
+    int idx3 = base[3];
 
     // State variables for each of the four parallel streams
     uint64 state0 = 0, state1 = 0, state2 = 0, state3 = 0; // bits read from bitstream
@@ -249,7 +470,6 @@ bool HuffmanDecoder::decodeChunk(kanzi::byte block[], uint count)
        idx += (shift >> 3); \
     } while (0);
 
-    const int szFrag = count / 4;
     kanzi::byte* block0 = &block[0 * szFrag];
     kanzi::byte* block1 = &block[1 * szFrag];
     kanzi::byte* block2 = &block[2 * szFrag];
@@ -331,19 +551,12 @@ bool HuffmanDecoder::decodeChunk(kanzi::byte block[], uint count)
         n++;
     }
 
-    // Process any remaining bytes at the end of the whole chunk
-    const uint count4 = 4 * szFrag;
-
-    for (uint i = count4; i < count; i++)
-        block[i] = kanzi::byte(_bitstream.readBits(8));
-
-    const int used0 = ((idx0 - base0) << 3) - (int(int8(bits0)) + DECODING_BATCH_SIZE);
-    const int used1 = ((idx1 - base1) << 3) - (int(int8(bits1)) + DECODING_BATCH_SIZE);
-    const int used2 = ((idx2 - base2) << 3) - (int(int8(bits2)) + DECODING_BATCH_SIZE);
-    const int used3 = ((idx3 - base3) << 3) - (int(int8(bits3)) + DECODING_BATCH_SIZE);
+#undef READ_STATE
 
-    return (used0 == szBits0) && (used1 == szBits1) &&
-           (used2 == szBits2) && (used3 == szBits3);
+    used[0] = ((idx0 - base[0]) << 3) - (int(int8(bits0)) + DECODING_BATCH_SIZE);
+    used[1] = ((idx1 - base[1]) << 3) - (int(int8(bits1)) + DECODING_BATCH_SIZE);
+    used[2] = ((idx2 - base[2]) << 3) - (int(int8(bits2)) + DECODING_BATCH_SIZE);
+    used[3] = ((idx3 - base[3]) << 3) - (int(int8(bits3)) + DECODING_BATCH_SIZE);
 }
 
 int HuffmanDecoder::decodeV5(kanzi::byte block[], uint blkptr, uint count)
@@ -20,6 +20,7 @@ limitations under the License.
 #include "HuffmanCommon.hpp"
 #include "../Context.hpp"
 #include "../EntropyDecoder.hpp"
+#include "../util/CPUFeatures.hpp"
 
 
 namespace kanzi
@@ -49,14 +50,18 @@ namespace kanzi
        uint16 _codes[256];
        uint _alphabet[256];
        uint16 _sizes[256];
-       uint16 _table[1 << 12]; // decoding table: code -> size, symbol
+       uint16 _table[(1 << 12) + 2]; // decoding table: code -> size, symbol (padded for 32 bit gathers)
        int _chunkSize;
+       int _bsVersion;
+       CPUFeatures::SIMDLevel _simdLevel; // kernels used to decode 8 to 32 streams
        Context* _pCtx;
 
        int readLengths();
 
        bool decodeChunk(byte block[], uint count);
 
+       void decodeStreams(byte block[], int szFrag, const int base[], int used[]) const;
+
        bool buildDecodingTable(int count);
 
        bool reset();
@@ -347,13 +347,17 @@ int HuffmanEncoder::encode(const kanzi::byte block[], uint blkptr, uint count)
 // count is at least 32
 void HuffmanEncoder::encodeChunk(const kanzi::byte block[], uint count)
 {
-    uint nbBits[4] = { 0 };
-    const uint szFrag = count / 4;
+    // Split the chunk into 4 to 32 interleaved streams of at least 512 symbols
+    // (more streams allow vectorized decoding)
+    const int logStreams = min(max(Global::_log2(uint32(count)) - 11, 0), 3);
+    const int nbStreams = 4 << logStreams;
+    uint nbBits[32] = { 0 };
+    const uint szFrag = count / nbStreams;
     const uint szFrag4 = szFrag & ~3;
-    const uint szBuf = _bufferSize / 4;
+    const uint szBuf = _bufferSize / nbStreams;
 
     // Encode chunk
-    for (int j = 0; j < 4; j++) {
+    for (int j = 0; j < nbStreams; j++) {
         const kanzi::byte* src = &block[j * szFrag];
         kanzi::byte* buf = &_buffer[j * szBuf];
         int idx = 0;
@@ -401,21 +405,21 @@ void HuffmanEncoder::encodeChunk(const kanzi::byte block[], uint count)
             buf[idx++] = kanzi::byte(state << (8 - bits));
     }
 
-    // Write chunk size in bits
+    // Write number of streams and stream sizes in bits (first size, then
+    // zigzag encoded differences with the previous size)
+    _bitstream.writeBits(logStreams, 2);
     EntropyUtils::writeVarInt(_bitstream, nbBits[0]);
-    EntropyUtils::writeVarInt(_bitstream, nbBits[1]);
-    EntropyUtils::writeVarInt(_bitstream, nbBits[2]);
-    EntropyUtils::writeVarInt(_bitstream, nbBits[3]);
+
+    for (int j = 1; j < nbStreams; j++) {
+        const int delta = int(nbBits[j]) - int(nbBits[j - 1]);
+        EntropyUtils::writeVarInt(_bitstream, uint32((delta << 1) ^ (delta >> 31)));
+    }
 
     // Write compressed data to bitstream
-    _bitstream.writeBits(&_buffer[0 * szBuf], nbBits[0]);
-    _bitstream.writeBits(&_buffer[1 * szBuf], nbBits[1]);
-    _bitstream.writeBits(&_buffer[2 * szBuf], nbBits[2]);
-    _bitstream.writeBits(&_buffer[3 * szBuf], nbBits[3]);
+    for (int j = 0; j < nbStreams; j++)
+        _bitstream.writeBits(&_buffer[j * szBuf], nbBits[j]);
 
     // Chunk last bytes
-    const uint count4 = 4 * szFrag;
-
-    for (uint i = count4; i < count; i++)
+    for (uint i = nbStreams * szFrag; i < count; i++)
         _bitstream.writeBits(uint64(block[i]), 8);
 }
@@ -0,0 +1,191 @@
+/*
+Copyright 2011-2026 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef knz_ModelArena
+#define knz_ModelArena
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "../concurrent.hpp"
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(_WIN64)
+   #include <sys/mman.h>
+   #define KNZ_ARENA_MMAP
+#endif
+
+
+namespace kanzi {
+
+   // Memory of the entropy models (eg. the TPAQ hash tables) kept between blocks.
+   // Allocating and zeroing tens of MB per block (page faults included) costs
+   // more than clearing memory already mapped, so the streams keep a few arenas
+   // and the predictors take their tables from them.
+   // Large buffers are aligned on 2 MB and advised for transparent huge pages
+   // (where supported) to reduce TLB misses on random accesses.
+   // An arena is used by one task at a time (see acquire()).
+   class ModelArena FINAL {
+   public:
+       static const int MAX_BUFFERS = 8;
+
+       ModelArena();
+
+       ~ModelArena() { clear(); }
+
+       // Return a buffer of 'size' zeroed bytes. 'id' identifies the buffer
+       // in the arena (in [0..MAX_BUFFERS-1]).
+       void* get(int id, size_t size);
+
+       // Release the buffers.
+       void clear();
+
+       // Reserve the arena for the calling task. Return false if it is in use.
+       bool acquire();
+
+       void release() { STORE_ATOMIC(_busy, 0); }
+
+       // Reserve the first free arena in 'arenas'. Return null if all are in use.
+       static ModelArena* acquire(ModelArena arenas[], int count);
+
+   private:
+       static const size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+       void* _buffers[MAX_BUFFERS];
+       size_t _capacities[MAX_BUFFERS];
+       atomic_int_t _busy;
+
+       // 'size' is updated with the actual size of the buffer
+       static void* allocate(size_t& size);
+
+       static void deallocate(void* buf, size_t size);
+
+       ModelArena(const ModelArena&); // not copyable
+       ModelArena& operator=(const ModelArena&);
+   };
+
+
+   inline ModelArena::ModelArena()
+       : _busy(0)
+   {
+       for (int i = 0; i < MAX_BUFFERS; i++) {
+           _buffers[i] = nullptr;
+           _capacities[i] = 0;
+       }
+   }
+
+   inline bool ModelArena::acquire()
+   {
+       // Acquire ordering (unlike COMPARE_EXCHANGE_ATOMIC) so that the buffers
+       // left by the previous owner are visible
+       return EXCHANGE_ATOMIC(_busy, 1) == 0;
+   }
+
+   inline ModelArena* ModelArena::acquire(ModelArena arenas[], int count)
+   {
+       for (int i = 0; i < count; i++) {
+           if (arenas[i].acquire() == true)
+               return &arenas[i];
+       }
+
+       return nullptr;
+   }
+
+   inline void* ModelArena::get(int id, size_t size)
+   {
+       if ((id < 0) || (id >= MAX_BUFFERS))
+           return nullptr;
+
+       if (_capacities[id] >= size) {
+           // Only clear the part in use
+           memset(_buffers[id], 0, size);
+           return _buffers[id];
+       }
+
+       // Newly allocated memory is already zeroed
+       deallocate(_buffers[id], _capacities[id]);
+       _buffers[id] = nullptr;
+       _capacities[id] = 0;
+       void* buf = allocate(size);
+       _buffers[id] = buf;
+       _capacities[id] = size;
+       return buf;
+   }
+
+   inline void ModelArena::clear()
+   {
+       for (int i = 0; i < MAX_BUFFERS; i++) {
+           deallocate(_buffers[i], _capacities[i]);
+           _buffers[i] = nullptr;
+           _capacities[i] = 0;
+       }
+   }
+
+   inline void* ModelArena::allocate(size_t& size)
+   {
+#ifdef KNZ_ARENA_MMAP
+       if (size >= HUGE_PAGE_SIZE) {
+           // Map an extra huge page to align the buffer, then unmap the slack.
+           // Anonymous mappings are zeroed by the kernel.
+           size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+           const size_t length = size + HUGE_PAGE_SIZE;
+           void* addr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+           if (addr == MAP_FAILED)
+               throw std::bad_alloc();
+
+           byte* start = static_cast<byte*>(addr);
+           byte* buf = reinterpret_cast<byte*>((uintptr_t(start) + HUGE_PAGE_SIZE - 1) & ~uintptr_t(HUGE_PAGE_SIZE - 1));
+           const size_t head = size_t(buf - start);
+
+           if (head != 0)
+               munmap(start, head);
+
+           if (length - head - size != 0)
+               munmap(buf + size, length - head - size);
+
+#ifdef MADV_HUGEPAGE
+           madvise(buf, size, MADV_HUGEPAGE);
+#endif
+           return buf;
+       }
+#endif
+
+       void* buf = calloc(size, 1);
+
+       if (buf == nullptr)
+           throw std::bad_alloc();
+
+       return buf;
+   }
+
+   inline void ModelArena::deallocate(void* buf, size_t size)
+   {
+       if (buf == nullptr)
+           return;
+
+#ifdef KNZ_ARENA_MMAP
+       if (size >= HUGE_PAGE_SIZE) {
+           munmap(buf, size);
+           return;
+       }
+#else
+       (void) size;
+#endif
+
+       free(buf);
+   }
+}
+#endif
@@ -0,0 +1,151 @@
+/*
+Copyright 2011-2026 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef knz_SolidModel
+#define knz_SolidModel
+
+#include "../Context.hpp"
+#include "../Dictionary.hpp"
+#include "BinaryEntropyDecoder.hpp"
+#include "BinaryEntropyEncoder.hpp"
+#include "CMPredictor.hpp"
+#include "EntropyEncoderFactory.hpp"
+#include "TPAQPredictor.hpp"
+
+
+namespace kanzi {
+
+   // Model of a lane of blocks in solid mode (CM, TPAQ and TPAQX only).
+   // In solid mode, the blocks are dealt to lanes (block n goes to lane
+   // (n-1) % lanes) and the blocks of a lane are coded in order with the same
+   // predictor: each block starts with the statistics learnt from the previous
+   // blocks of the lane instead of a cold model.
+   // The encoder and the decoder must create and reset the model for the same
+   // blocks: a copy block (not entropy coded) resets the model of its lane.
+   class SolidModel FINAL {
+   public:
+       SolidModel() : _predictor(nullptr), _type(-1), _coded(0) {}
+
+       ~SolidModel() { reset(); }
+
+       // Entropy types supported in solid mode. The type values are the same
+       // in EntropyEncoderFactory and EntropyDecoderFactory.
+       static bool isSupported(short entropyType);
+
+       // Return an encoder of 'count' bytes using the model of the lane. The
+       // model is created for the first block (with the context of this block).
+       EntropyEncoder* newEncoder(OutputBitStream& obs, Context& ctx, short entropyType, int count);
+
+       EntropyDecoder* newDecoder(InputBitStream& ibs, Context& ctx, short entropyType, int count);
+
+       // Discard the model, the next block of the lane starts with a new one.
+       void reset();
+
+   private:
+       // Positions in the TPAQ models are 32 bit integers: start a new model
+       // before they overflow.
+       static const int64 MAX_CODED_SIZE = int64(1) << 30;
+
+       Predictor* _predictor;
+       short _type;
+       int64 _coded;
+
+       void prepare(Context& ctx, short entropyType, int count);
+
+       SolidModel(const SolidModel&); // not copyable
+       SolidModel& operator=(const SolidModel&);
+   };
+
+
+   inline bool SolidModel::isSupported(short entropyType)
+   {
+       return (entropyType == EntropyEncoderFactory::CM_TYPE) || (entropyType == EntropyEncoderFactory::TPAQ_TYPE)
+           || (entropyType == EntropyEncoderFactory::TPAQX_TYPE);
+   }
+
+   inline void SolidModel::prepare(Context& ctx, short entropyType, int count)
+   {
+       if ((_predictor != nullptr) && ((_type != entropyType) || (_coded + int64(count) > MAX_CODED_SIZE)))
+           reset();
+
+       if (_predictor == nullptr) {
+           switch (entropyType) {
+           case EntropyEncoderFactory::CM_TYPE:
+               _predictor = Dictionary::primePredictor(ctx, new CMPredictor(&ctx));
+               break;
+
+           case EntropyEncoderFactory::TPAQ_TYPE:
+               _predictor = Dictionary::primePredictor(ctx, new TPAQPredictor<false>(&ctx));
+               break;
+
+           case EntropyEncoderFactory::TPAQX_TYPE:
+               _predictor = Dictionary::primePredictor(ctx, new TPAQPredictor<true>(&ctx));
+               break;
+
+           default:
+               throw std::invalid_argument("Solid mode not supported by this entropy codec");
+           }
+
+           _type = entropyType;
+       }
+
+       _coded += int64(count);
+   }
+
+   inline EntropyEncoder* SolidModel::newEncoder(OutputBitStream& obs, Context& ctx, short entropyType, int count)
+   {
+       prepare(ctx, entropyType, count);
+
+       // The predictor is not deallocated with the encoder
+       switch (_type) {
+       case EntropyEncoderFactory::CM_TYPE:
+           return new BinaryEntropyEncoder(obs, static_cast<CMPredictor*>(_predictor), false);
+
+       case EntropyEncoderFactory::TPAQ_TYPE:
+           return new BinaryEntropyEncoder(obs, static_cast<TPAQPredictor<false>*>(_predictor), false);
+
+       default:
+           return new BinaryEntropyEncoder(obs, static_cast<TPAQPredictor<true>*>(_predictor), false);
+       }
+   }
+
+   inline EntropyDecoder* SolidModel::newDecoder(InputBitStream& ibs, Context& ctx, short entropyType, int count)
+   {
+       prepare(ctx, entropyType, count);
+
+       switch (_type) {
+       case EntropyEncoderFactory::CM_TYPE:
+           return new BinaryEntropyDecoder(ibs, static_cast<CMPredictor*>(_predictor), false);
+
+       case EntropyEncoderFactory::TPAQ_TYPE:
+           return new BinaryEntropyDecoder(ibs, static_cast<TPAQPredictor<false>*>(_predictor), false);
+
+       default:
+           return new BinaryEntropyDecoder(ibs, static_cast<TPAQPredictor<true>*>(_predictor), false);
+       }
+   }
+
+   inline void SolidModel::reset()
+   {
+       if (_predictor != nullptr)
+           delete _predictor;
+
+       _predictor = nullptr;
+       _type = -1;
+       _coded = 0;
+   }
+}
+#endif
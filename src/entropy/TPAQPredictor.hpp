@@ -23,6 +23,7 @@ limitations under the License.
 #include "../Predictor.hpp"
 #include "../Memory.hpp"
 #include "AdaptiveProbMap.hpp"
+#include "ModelArena.hpp"
 
 
 namespace kanzi
@@ -61,7 +62,9 @@ namespace kanzi
    class TPAQPredictor FINAL : public Predictor
    {
    public:
-       TPAQPredictor(Context* ctx = nullptr);
+       // If not null, the tables are taken from 'arena' (not owned), which
+       // must not be used by another predictor while this one is alive.
+       TPAQPredictor(Context* ctx = nullptr, ModelArena* arena = nullptr);
 
        ~TPAQPredictor();
 
@@ -119,6 +122,7 @@ namespace kanzi
        int _ctx4;
        int _ctx5;
        int _ctx6;
+       ModelArena* _arena;
 
        int hash(uint x, uint y) const;
 
@@ -295,9 +299,10 @@ namespace kanzi
 
 
    template <bool T>
-   TPAQPredictor<T>::TPAQPredictor(Context* ctx)
+   TPAQPredictor<T>::TPAQPredictor(Context* ctx, ModelArena* arena)
        : _sse0(256)
        , _sse1((T == true) ? 65536 : 256)
+       , _arena(arena)
    {
        uint statesSize = 1 << 28;
        uint mixersSize = 1 << 12;
@@ -309,7 +314,7 @@ namespace kanzi
        if (ctx != nullptr) {
            // Block size requested by the user
            // The user can request a big block size to force more states
-           const int rbsz = ctx->getInt("blockSize", 32768);
+           const int rbsz = ctx->getInt(Context::BLOCK_SIZE, 32768);
 
            if (rbsz >= 64 * 1024 * 1024)
                statesSize = 1 << 28;
@@ -323,7 +328,7 @@ namespace kanzi
            // Actual size of the current block
            // Too many mixers hurts compression for small blocks.
            // Too few mixers hurts compression for big blocks.
-           const int absz = ctx->getInt("size", rbsz);
+           const int absz = ctx->getInt(Context::SIZE, rbsz);
 
            if (absz >= 32 * 1024 * 1024)
                mixersSize = 1 << 16;
@@ -339,7 +344,7 @@ namespace kanzi
            bufferSize = rbsz < BUFFER_SIZE ? rbsz : BUFFER_SIZE;
            const uint mxsz = absz < (1 << 26) ? absz * 16 : 1 << 30;
            hashSize = hashSize < mxsz ? hashSize : mxsz;
-           bsVersion = ctx->getInt("bsVersion", bsVersion);
+           bsVersion = ctx->getInt(Context::BS_VERSION, bsVersion);
        }
 
        if (bsVersion > 6) {
@@ -361,12 +366,27 @@ namespace kanzi
        _mixersMask = (mixersSize - 1) & ~1;
        _hashMask = hashSize - 1;
        _bufferMask = bufferSize - 1;
-       _mixers = new TPAQMixer[mixersSize];
-       _bigStatesMap = new uint8[statesSize];
-       _smallStatesMap0 = new uint8[1 << 16];
-       _smallStatesMap1 = new uint8[1 << 24];
-       _hashes = new int[hashSize];
-       _buffer = new byte[bufferSize];
+
+       if (_arena != nullptr) {
+           _mixers = static_cast<TPAQMixer*>(_arena->get(0, sizeof(TPAQMixer) * size_t(mixersSize)));
+
+           for (uint i = 0; i < mixersSize; i++)
+               new (&_mixers[i]) TPAQMixer();
+
+           _bigStatesMap = static_cast<uint8*>(_arena->get(1, size_t(statesSize)));
+           _smallStatesMap0 = static_cast<uint8*>(_arena->get(2, 1 << 16));
+           _smallStatesMap1 = static_cast<uint8*>(_arena->get(3, 1 << 24));
+           _hashes = static_cast<int*>(_arena->get(4, sizeof(int) * size_t(hashSize)));
+           _buffer = static_cast<byte*>(_arena->get(5, size_t(bufferSize)));
+       }
+       else {
+           _mixers = new TPAQMixer[mixersSize];
+           _bigStatesMap = new uint8[statesSize]();
+           _smallStatesMap0 = new uint8[1 << 16]();
+           _smallStatesMap1 = new uint8[1 << 24]();
+           _hashes = new int[hashSize]();
+           _buffer = new byte[bufferSize]();
+       }
 
        reset();
    }
@@ -385,11 +405,6 @@ namespace kanzi
        _matchVal = 0;
        _hash = 0;
        _mixer = &_mixers[0];
-       memset(_bigStatesMap, 0, size_t(_statesMask + 1));
-       memset(_smallStatesMap0, 0, 1 << 16);
-       memset(_smallStatesMap1, 0, 1 << 24);
-       memset(_hashes, 0, sizeof(int) * size_t(_hashMask + 1));
-       memset(_buffer, 0, size_t(_bufferMask + 1));
        _cp0 = &_smallStatesMap0[0];
        _cp1 = &_smallStatesMap1[0];
        _cp2 = &_bigStatesMap[0];
@@ -405,6 +420,10 @@ namespace kanzi
    template <bool T>
    TPAQPredictor<T>::~TPAQPredictor()
    {
+       // Tables from the arena are kept for the next predictor
+       if (_arena != nullptr)
+           return;
+
        delete[] _bigStatesMap;
        delete[] _smallStatesMap0;
        delete[] _smallStatesMap1;
@@ -0,0 +1,522 @@
+/*
+Copyright 2011-2026 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "BlockPlanner.hpp"
+#include "BlockSelector.hpp"
+#include "../entropy/EntropyEncoderFactory.hpp"
+#include "../entropy/SolidModel.hpp"
+#include "../transform/SegmentedCodec.hpp"
+#include "../transform/TransformFactory.hpp"
+#include "../util/strings.hpp"
+
+#if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
+   #ifndef NOMINMAX
+      #define NOMINMAX
+   #endif
+   #include <windows.h>
+#else
+   #include <unistd.h>
+#endif
+
+using namespace kanzi;
+using namespace std;
+
+const int BlockPlanner::MIN_BLOCK_SIZE;
+const int BlockPlanner::MAX_BLOCK_SIZE;
+const int BlockPlanner::MAX_SLOTS;
+
+
+string BlockPlan::toString() const
+{
+    stringstream ss;
+
+    if (_nbBlocks > 0)
+        ss << _nbBlocks << ((_nbBlocks > 1) ? " blocks" : " block") << " of ";
+    else
+        ss << "blocks of ";
+
+    ss << formatSize(double(_blockSize)) << ", " << _tasks << ((_tasks > 1) ? " blocks" : " block");
+    ss << " in parallel with ";
+    const int q = _jobs / _tasks;
+
+    if (q * _tasks == _jobs)
+        ss << q << ((q > 1) ? " jobs" : " job");
+    else
+        ss << q << " to " << (q + 1) << " jobs";
+
+    ss << ((_tasks > 1) ? " each" : "") << ", estimated memory " << formatSize(double(_memory));
+
+    if (_budget > 0)
+        ss << " (budget " << formatSize(double(_budget)) << ")";
+
+    return ss.str();
+}
+
+
+BlockPlanner::BlockPlanner(uint64 transformType, short entropyType, int jobs, int64 budget, int lzSearch,
+    bool lzOptimal, int lanes)
+    : _transformType(transformType)
+    , _entropyType(entropyType)
+    , _jobs(max(jobs, 1))
+    , _budget(max(budget, int64(0)))
+    , _lzSearch(max(lzSearch, 0))
+    , _lzOptimal(lzOptimal)
+    , _lanes(max(lanes, 0))
+{
+}
+
+
+void BlockPlanner::setCandidates(const vector<uint64>& transformTypes, const vector<short>& entropyTypes)
+{
+    _candidateTransforms = transformTypes;
+    _candidateEntropies = entropyTypes;
+    _candidateEntropies.resize(_candidateTransforms.size(), short(EntropyEncoderFactory::NONE_TYPE));
+}
+
+
+BlockPlan BlockPlanner::plan(int64 inputSize, int blockSize, bool autoBlockSize) const
+{
+    int64 bs = int64(blockSize);
+
+    if ((autoBlockSize == true) && (inputSize > 0)) {
+        // One block per job, but not below the minimum efficient size
+        bs = (inputSize + int64(_jobs - 1)) / int64(_jobs);
+        bs = max(bs, min(int64(getMinBlockSize()), inputSize));
+    }
+
+    bs = min(max((bs + 15) & ~int64(15), int64(MIN_BLOCK_SIZE)), int64(MAX_BLOCK_SIZE));
+    BlockPlan p;
+    p._jobs = _jobs;
+    p._budget = _budget;
+    p._blockSize = int(bs);
+    p._nbBlocks = (inputSize > 0) ? int((inputSize + bs - 1) / bs) : 0;
+    p._tasks = (p._nbBlocks > 0) ? min(p._nbBlocks, _jobs) : _jobs;
+
+    if (_budget > 0) {
+        const int minShrink = max(getMinBlockSize() / 4, 64 * 1024);
+
+        while (getMemory(p._blockSize, p._tasks) > _budget) {
+            const bool canShrink = (autoBlockSize == true) && (p._blockSize / 2 >= minShrink);
+
+            if ((p._tasks > 1) && ((canShrink == false) || (isParallelBlock(p._blockSize) == true))) {
+                // The jobs go to fewer blocks
+                p._tasks--;
+            }
+            else if (canShrink == true) {
+                p._blockSize = ((p._blockSize / 2) + 15) & -16;
+                p._nbBlocks = (inputSize > 0) ? int((inputSize + p._blockSize - 1) / p._blockSize) : 0;
+            }
+            else {
+                break; // over budget
+            }
+        }
+    }
+
+    p._memory = getMemory(p._blockSize, p._tasks);
+    return p;
+}
+
+
+bool BlockPlanner::isParallelBlock(int blockSize) const
+{
+    for (int i = 0; i < 8; i++) {
+        const uint64 t = (_transformType >> (6 * i)) & 0x3F;
+
+        switch (t) {
+        case TransformFactory<kanzi::byte>::BWT_TYPE:
+        case TransformFactory<kanzi::byte>::BWTS_TYPE:
+            return true;
+
+        case TransformFactory<kanzi::byte>::LZ_TYPE:
+        case TransformFactory<kanzi::byte>::LZX_TYPE:
+        case TransformFactory<kanzi::byte>::ROLZ_TYPE:
+        case TransformFactory<kanzi::byte>::ROLZX_TYPE:
+            if (SegmentedCodec::getSegments(blockSize) > 1)
+                return true;
+
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return false;
+}
+
+
+// Small blocks hurt the compression ratio of the BWT and of the context
+// models more than the ratio of the LZ codecs.
+int BlockPlanner::getMinBlockSize() const
+{
+    if ((_entropyType == EntropyEncoderFactory::CM_TYPE) || (_entropyType == EntropyEncoderFactory::TPAQ_TYPE) ||
+        (_entropyType == EntropyEncoderFactory::TPAQX_TYPE))
+        return 4 * 1024 * 1024;
+
+    int res = 256 * 1024;
+
+    for (int i = 0; i < 8; i++) {
+        const uint64 t = (_transformType >> (6 * i)) & 0x3F;
+
+        if ((t == TransformFactory<kanzi::byte>::BWT_TYPE) || (t == TransformFactory<kanzi::byte>::BWTS_TYPE))
+            return 4 * 1024 * 1024;
+
+        if ((t == TransformFactory<kanzi::byte>::LZ_TYPE) || (t == TransformFactory<kanzi::byte>::LZX_TYPE) ||
+            (t == TransformFactory<kanzi::byte>::ROLZ_TYPE) || (t == TransformFactory<kanzi::byte>::ROLZX_TYPE))
+            res = 1024 * 1024;
+    }
+
+    return res;
+}
+
+
+int64 BlockPlanner::getMemory(int blockSize, int tasks) const
+{
+    const int64 bs = int64(blockSize);
+    const int64 buffers = bs + (bs >> 6) + bs + (bs >> 3);
+
+    if (_lanes > 0) {
+        // Solid mode: no more block slots than lanes, and the model of each
+        // lane stays allocated from one block to the next.
+        const int slots = min((_jobs > 1) ? getBlockSlots(tasks) : 1, _lanes);
+        return int64(slots) * (buffers + getTransformMemory(blockSize)) +
+            int64(_lanes) * getEntropyMemory(blockSize);
+    }
+
+    const int slots = (_jobs > 1) ? getBlockSlots(tasks) : 1;
+
+    // Each block slot owns an input buffer, an output buffer and the transforms
+    // (kept between blocks), plus the transforms of the trials if the codecs
+    // are chosen per block. There is at most one entropy model per job.
+    return int64(slots) * (buffers + getTransformMemory(blockSize) + getTrialMemory(blockSize)) +
+        int64(min(slots, _jobs)) * getEntropyMemory(blockSize);
+}
+
+
+int64 BlockPlanner::getBlockMemory(int blockSize) const
+{
+    const int64 bs = int64(blockSize);
+    return bs + (bs >> 6) + bs + (bs >> 3) + getTransformMemory(blockSize) +
+        getTrialMemory(blockSize) + getEntropyMemory(blockSize);
+}
+
+
+int64 BlockPlanner::getTrialMemory(int blockSize) const
+{
+    if (_candidateTransforms.size() == 0)
+        return 0;
+
+    // Sample, copy of the sample, transform output and encoded output, plus
+    // the transforms of every candidate (kept between blocks). The entropy
+    // models of the trials use the arenas (see getEntropyMemory).
+    const int sampleSize = BlockSelector::getSampleSize(blockSize);
+    int64 res = 4 * int64(sampleSize);
+
+    for (size_t i = 0; i < _candidateTransforms.size(); i++) {
+        const BlockPlanner planner(_candidateTransforms[i], _candidateEntropies[i], _jobs, 0, _lzSearch, _lzOptimal);
+        res += planner.getTransformMemory(sampleSize);
+    }
+
+    return res;
+}
+
+
+int BlockPlanner::getBlockSlots(int tasks)
+{
+    return (tasks > 1) ? min(2 * tasks, MAX_SLOTS) : 1;
+}
+
+
+int64 BlockPlanner::getTransformMemory(int blockSize) const
+{
+    if (_candidateTransforms.size() > 0) {
+        // The transforms of the block slot are those of the selected candidate
+        int64 res = 0;
+
+        for (size_t i = 0; i < _candidateTransforms.size(); i++) {
+            const BlockPlanner planner(_candidateTransforms[i], _candidateEntropies[i], _jobs, 0, _lzSearch, _lzOptimal);
+            res = max(res, planner.getTransformMemory(blockSize));
+        }
+
+        return res;
+    }
+
+    const int64 bs = int64(blockSize);
+    const int64 segments = (SegmentedCodec::getSegments(blockSize) > 1) ? bs : 0;
+    int64 res = 0;
+    int nbTransforms = 0;
+
+    for (int i = 0; i < 8; i++) {
+        const uint64 t = (_transformType >> (6 * i)) & 0x3F;
+
+        switch (t) {
+        case TransformFactory<kanzi::byte>::NONE_TYPE:
+            continue;
+
+        case TransformFactory<kanzi::byte>::BWT_TYPE:
+            res += 4 * bs + (1 << 20); // suffix array
+            break;
+
+        case TransformFactory<kanzi::byte>::BWTS_TYPE:
+            res += 8 * bs;
+            break;
+
+        case TransformFactory<kanzi::byte>::LZ_TYPE:
+        case TransformFactory<kanzi::byte>::LZX_TYPE:
+            res += (3 * bs) / 5 + (2 << 20) + segments;
+
+            // Hash chains (ring of up to 4M positions)
+            if ((_lzSearch > 0) || (_lzOptimal == true))
+                res += 4 * min(2 * bs, int64(4 << 20));
+
+            // Optimal parser: window nodes and greedy encoding of the block
+            if (_lzOptimal == true)
+                res += bs + (4 << 20);
+
+            break;
+
+        case TransformFactory<kanzi::byte>::ROLZ_TYPE:
+        case TransformFactory<kanzi::byte>::ROLZX_TYPE:
+            res += 2 * min(bs, int64(16 << 20)) + (32 << 20) + segments;
+            break;
+
+        case TransformFactory<kanzi::byte>::DICT_TYPE:
+            // Word hash map (up to 8 bytes per block byte / 8) and word list
+            res += ((_entropyType == EntropyEncoderFactory::TPAQX_TYPE) ? 2 * bs : bs) + (8 << 20);
+            break;
+
+        default:
+            res += 1 << 20;
+            break;
+        }
+
+        nbTransforms++;
+    }
+
+    // Intermediate buffer of the transform sequence
+    return (nbTransforms > 1) ? res + bs : res;
+}
+
+
+// Sizes of the TPAQ tables (see TPAQPredictor) or a rough size of the
+// tables of the other codecs.
+int64 BlockPlanner::getEntropyMemory(int blockSize) const
+{
+    if (_candidateTransforms.size() > 0) {
+        int64 res = 0;
+
+        for (size_t i = 0; i < _candidateEntropies.size(); i++) {
+            const BlockPlanner planner(_candidateTransforms[i], _candidateEntropies[i], _jobs, 0);
+            res = max(res, planner.getEntropyMemory(blockSize));
+        }
+
+        return res;
+    }
+
+    if ((_entropyType != EntropyEncoderFactory::TPAQ_TYPE) && (_entropyType != EntropyEncoderFactory::TPAQX_TYPE))
+        return (_entropyType == EntropyEncoderFactory::ANS1_TYPE) ? 4 << 20 : 1 << 20;
+
+    int64 states, mixers;
+
+    if (blockSize >= 64 * 1024 * 1024)
+        states = int64(1) << 28;
+    else if (blockSize >= 16 * 1024 * 1024)
+        states = int64(1) << 27;
+    else if (blockSize >= 4 * 1024 * 1024)
+        states = int64(1) << 26;
+    else
+        states = (blockSize >= 1024 * 1024) ? int64(1) << 24 : int64(1) << 22;
+
+    if (blockSize >= 32 * 1024 * 1024)
+        mixers = int64(1) << 16;
+    else if (blockSize >= 8 * 1024 * 1024)
+        mixers = int64(1) << 14;
+    else
+        mixers = (blockSize >= 1024 * 1024) ? int64(1) << 11 : int64(1) << 8;
+
+    const int64 hashes = min(int64(16 << 20), 16 * int64(blockSize));
+    const int64 extra = (_entropyType == EntropyEncoderFactory::TPAQX_TYPE) ? 4 : 1;
+    return extra * (states + 4 * hashes + 80 * mixers) + (1 << 24) + (1 << 16) + min(int64(blockSize), int64(64 << 20));
+}
+
+
+int64 BlockPlanner::getPhysicalMemory()
+{
+#if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    return (GlobalMemoryStatusEx(&status) != 0) ? int64(status.ullTotalPhys) : 0;
+#elif defined(_SC_PHYS_PAGES) && defined(_SC_PAGESIZE)
+    const long pages = sysconf(_SC_PHYS_PAGES);
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    return ((pages > 0) && (pageSize > 0)) ? int64(pages) * int64(pageSize) : 0;
+#else
+    return 0;
+#endif
+}
+
+
+int64 BlockPlanner::getMemoryLimit()
+{
+#if defined(__linux__)
+    // cgroup v2 first, then cgroup v1
+    const char* files[2] = { "/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory/memory.limit_in_bytes" };
+
+    for (int i = 0; i < 2; i++) {
+        ifstream is(files[i]);
+
+        if (is.is_open() == false)
+            continue;
+
+        string str;
+        is >> str;
+
+        if (str.empty() == true)
+            continue;
+
+        // "max" (v2) or a page aligned LLONG_MAX (v1) when there is no limit
+        char* end = nullptr;
+        const int64 limit = int64(strtoll(str.c_str(), &end, 10));
+
+        if ((*end != 0) || (limit <= 0) || (limit >= (int64(1) << 60)))
+            return 0;
+
+        return limit;
+    }
+#endif
+
+    return 0;
+}
+
+
+int64 BlockPlanner::getDefaultBudget()
+{
+    int64 mem = getPhysicalMemory();
+    const int64 limit = getMemoryLimit();
+
+    // Containers: the cgroup limit is usually lower than the host memory
+    if ((limit > 0) && ((mem == 0) || (limit < mem)))
+        mem = limit;
+
+    return mem - (mem >> 2);
+}
+
+
+BlockPlan BlockPlanner::plan(Context& ctx)
+{
+    const string entropy = ctx.getString("entropy", "NONE");
+    const string transform = ctx.getString("transform", "NONE");
+    const int64 maxMemory = ctx.getLong("maxMemory", 0);
+    const int64 budget = (maxMemory > 0) ? maxMemory : getDefaultBudget();
+    const int64 inputSize = ctx.getLong("fileSize", 0);
+    const int blockSize = ctx.getInt(Context::BLOCK_SIZE, 4 * 1024 * 1024);
+    const bool autoBlockSize = ctx.getInt("autoBlock", 0) != 0;
+    const int lzSearch = ctx.getInt("lzSearch", 0);
+    const bool lzOptimal = ctx.getInt("lzOptimal", 0) != 0;
+    const int jobs = ctx.getInt(Context::JOBS, 1);
+    uint64 tType = TransformFactory<kanzi::byte>::getType(transform.c_str());
+    short eType = EntropyEncoderFactory::getType(entropy.c_str());
+
+    // Solid lanes (negative for one lane per job), see CompressedOutputStream
+    int lanes = ctx.getInt("solid", 0);
+    lanes = (SolidModel::isSupported(eType) == false) ? 0 : ((lanes < 0) ? jobs : lanes);
+
+    // Codecs chosen per block among candidates (see BlockSelector)
+    vector<uint64> tTypes;
+    vector<short> eTypes;
+    const string candidates = ctx.getString("autoCodecs", "");
+
+    if (candidates.length() > 0) {
+        const BlockSelector selector(candidates); // throws on error
+
+        for (int i = 0; i < selector.size(); i++) {
+            tTypes.push_back(selector.getTransformType(i));
+            eTypes.push_back(selector.getEntropyType(i));
+        }
+    }
+
+    BlockPlanner planner(tType, eType, jobs, budget, lzSearch, lzOptimal, lanes);
+    planner.setCandidates(tTypes, eTypes);
+    BlockPlan p = planner.plan(inputSize, blockSize, autoBlockSize);
+
+    // Cheaper codecs if the memory of the plan cannot be reduced enough
+    while (p.isOverBudget() == true) {
+        uint64 tType2 = tType;
+        short eType2 = eType;
+        vector<uint64> tTypes2 = tTypes;
+        vector<short> eTypes2 = eTypes;
+        bool cheaper = getCheaperCodecs(tType2, eType2);
+
+        for (size_t i = 0; i < tTypes2.size(); i++)
+            cheaper |= getCheaperCodecs(tTypes2[i], eTypes2[i]);
+
+        if (cheaper == false)
+            break; // no cheaper variant
+
+        BlockPlanner planner2(tType2, eType2, jobs, budget, lzSearch, lzOptimal, lanes);
+        planner2.setCandidates(tTypes2, eTypes2);
+        const BlockPlan p2 = planner2.plan(inputSize, blockSize, autoBlockSize);
+
+        if (p2._memory >= p._memory)
+            break;
+
+        tType = tType2;
+        eType = eType2;
+        tTypes = tTypes2;
+        eTypes = eTypes2;
+        p = p2;
+        ctx.putString("entropy", EntropyEncoderFactory::getName(eType));
+        ctx.putString("transform", TransformFactory<kanzi::byte>::getName(tType));
+
+        if (tTypes.size() > 0) {
+            stringstream ss;
+
+            for (size_t i = 0; i < tTypes.size(); i++) {
+                ss << ((i == 0) ? "" : ",") << TransformFactory<kanzi::byte>::getName(tTypes[i]);
+                ss << "/" << EntropyEncoderFactory::getName(eTypes[i]);
+            }
+
+            ctx.putString("autoCodecs", ss.str());
+        }
+    }
+
+    ctx.putInt(Context::BLOCK_SIZE, p._blockSize);
+    ctx.putInt("blockTasks", p._tasks);
+    return p;
+}
+
+
+bool BlockPlanner::getCheaperCodecs(uint64& transformType, short& entropyType)
+{
+    if (entropyType == EntropyEncoderFactory::TPAQX_TYPE) {
+        entropyType = EntropyEncoderFactory::TPAQ_TYPE;
+        return true;
+    }
+
+    bool res = false;
+
+    for (int i = 0; i < 8; i++) {
+        if (((transformType >> (6 * i)) & 0x3F) == TransformFactory<kanzi::byte>::BWTS_TYPE) {
+            transformType ^= (uint64(TransformFactory<kanzi::byte>::BWTS_TYPE ^ TransformFactory<kanzi::byte>::BWT_TYPE) << (6 * i));
+            res = true;
+        }
+    }
+
+    return res;
+}
@@ -0,0 +1,147 @@
+/*
+Copyright 2011-2026 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef knz_BlockPlanner
+#define knz_BlockPlanner
+
+#include <string>
+#include <vector>
+#include "../Context.hpp"
+#include "../types.hpp"
+
+
+namespace kanzi {
+
+   // How an input is compressed: size of the blocks, number of blocks encoded
+   // concurrently (tasks) and jobs given to each block.
+   class BlockPlan {
+   public:
+       int _blockSize;
+       int _nbBlocks; // 0 if the input size is unknown
+       int _tasks; // blocks encoded concurrently
+       int _jobs; // total number of jobs
+       int64 _memory; // estimated peak memory (bytes)
+       int64 _budget; // memory budget (bytes), 0 if unlimited
+
+       BlockPlan() : _blockSize(0), _nbBlocks(0), _tasks(1), _jobs(1), _memory(0), _budget(0) {}
+
+       bool isOverBudget() const { return (_budget > 0) && (_memory > _budget); }
+
+       // EG. "8 blocks of 16 MiB, 4 blocks in parallel with 2 jobs each,
+       // estimated memory 600 MiB (budget 12 GiB)"
+       std::string toString() const;
+   };
+
+
+   // Choose the block size and the concurrency of a compressed stream from the
+   // input size, the cost of the transforms and entropy codec, the number of
+   // jobs and a memory budget.
+   // With an automatic block size, the input is split into one block per job
+   // (better ratio than more, smaller blocks) but blocks do not go below a
+   // size that depends on the codecs (small BWT or CM blocks compress poorly):
+   // the extra jobs then go to the blocks (BWT, LZX/ROLZ segments).
+   // Above the budget, the planner first encodes fewer blocks concurrently if
+   // the transforms can use several jobs per block, else it reduces the block
+   // size (automatic block size only) before reducing the number of tasks.
+   class BlockPlanner {
+   public:
+       static const int MIN_BLOCK_SIZE = 1024;
+       static const int MAX_BLOCK_SIZE = 1024 * 1024 * 1024;
+       static const int MAX_SLOTS = 64;
+
+       // 'budget' is the memory budget in bytes (0 for no budget).
+       // 'lzSearch' is the search depth of the LZ match finder and 'lzOptimal'
+       // enables the optimal LZ parser (see LZXCodec). 'lanes' is the number of
+       // solid lanes (see SolidModel), 0 if the blocks are coded independently.
+       BlockPlanner(uint64 transformType, short entropyType, int jobs, int64 budget, int lzSearch = 0,
+           bool lzOptimal = false, int lanes = 0);
+
+       ~BlockPlanner() {}
+
+       // Codecs chosen per block among candidates (see BlockSelector): the
+       // memory of the largest candidate and of the trials on the samples is
+       // counted instead of the memory of the transform and entropy types.
+       void setCandidates(const std::vector<uint64>& transformTypes, const std::vector<short>& entropyTypes);
+
+       // 'inputSize' is 0 if unknown. 'blockSize' is the requested block size
+       // or the default block size if 'autoBlockSize' is true.
+       BlockPlan plan(int64 inputSize, int blockSize, bool autoBlockSize) const;
+
+       // Estimated memory (bytes) used to encode 'tasks' blocks of 'blockSize'
+       // bytes concurrently (buffers, transforms and entropy models, including
+       // the models of the solid lanes, resident for the whole stream).
+       int64 getMemory(int blockSize, int tasks) const;
+
+       // Estimated memory (bytes) used by one block of 'blockSize' bytes
+       // while it is encoded or decoded.
+       int64 getBlockMemory(int blockSize) const;
+
+       // Return true if the transforms can use several jobs for one block
+       // of 'blockSize' bytes.
+       bool isParallelBlock(int blockSize) const;
+
+       // Physical memory of the machine (0 if unknown)
+       static int64 getPhysicalMemory();
+
+       // Memory limit of the control group of the process (Linux cgroup v2
+       // or v1), 0 if there is no limit or if it is unknown
+       static int64 getMemoryLimit();
+
+       // Default memory budget: 3/4 of the physical memory or of the cgroup
+       // memory limit if lower (0 if unknown). The budget is checked when the
+       // blocks are planned (see plan()), not when they are submitted: memory
+       // used by other processes afterwards is not taken into account.
+       static int64 getDefaultBudget();
+
+       // Number of block slots of the compressed streams (blocks in flight)
+       // for 'tasks' concurrent blocks: blocks are emitted in order, so each
+       // task has a second slot to move on while a slow block is pending.
+       static int getBlockSlots(int tasks);
+
+       // Read the plan parameters from the context ("transform", "entropy",
+       // "jobs", "fileSize", "blockSize", "autoBlock", "maxMemory", "lzSearch",
+       // "lzOptimal", "solid" and "autoCodecs"), then
+       // store the block size and the number of tasks ("blockTasks") chosen.
+       // If the plan does not fit in the budget, the codecs (and the candidates)
+       // are replaced by cheaper variants (TPAQX by TPAQ, BWTS by BWT) in the context.
+       static BlockPlan plan(Context& ctx);
+
+   private:
+       uint64 _transformType;
+       short _entropyType;
+       int _jobs;
+       int64 _budget;
+       int _lzSearch;
+       bool _lzOptimal;
+       int _lanes;
+       std::vector<uint64> _candidateTransforms; // empty if the codecs are fixed
+       std::vector<short> _candidateEntropies;
+
+       int getMinBlockSize() const;
+
+       int64 getTransformMemory(int blockSize) const;
+
+       int64 getEntropyMemory(int blockSize) const;
+
+       // Memory of the codec trials on the sample of a block (see BlockSelector)
+       int64 getTrialMemory(int blockSize) const;
+
+       // Replace the codecs by a cheaper variant (TPAQX by TPAQ, else BWTS by BWT).
+       // Return false if there is none.
+       static bool getCheaperCodecs(uint64& transformType, short& entropyType);
+   };
+}
+#endif
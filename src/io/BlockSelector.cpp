@@ -0,0 +1,239 @@
+/*
+Copyright 2011-2026 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include "BlockSelector.hpp"
+#include "../Global.hpp"
+#include "../Magic.hpp"
+#include "../bitstream/DefaultOutputBitStream.hpp"
+#include "../entropy/EntropyEncoderFactory.hpp"
+#include "../entropy/EntropyUtils.hpp"
+#include "../entropy/ModelArena.hpp"
+#include "../util/fixedbuf.hpp"
+#include "../util/strings.hpp"
+
+using namespace kanzi;
+using namespace std;
+
+const int BlockSelector::MIN_SAMPLE_SIZE;
+const int BlockSelector::MAX_SAMPLE_SIZE;
+const int BlockSelector::MAX_CANDIDATES;
+const int BlockSelector::NB_SLICES;
+
+
+BlockSelector::BlockSelector(const string& candidates)
+{
+    vector<string> tokens;
+    tokenize(candidates, tokens, ',');
+
+    for (size_t i = 0; i < tokens.size(); i++) {
+        string token = tokens[i];
+        trim(token);
+
+        if (token.length() == 0)
+            continue;
+
+        const size_t pos = token.find('/');
+
+        if ((pos == string::npos) || (pos == 0) || (pos == token.length() - 1)) {
+            stringstream ss;
+            ss << "Invalid codec candidate, expected 'transform/entropy': " << token;
+            throw invalid_argument(ss.str());
+        }
+
+        string transform = token.substr(0, pos);
+        string entropy = token.substr(pos + 1);
+        std::transform(transform.begin(), transform.end(), transform.begin(), safeToUpper);
+        std::transform(entropy.begin(), entropy.end(), entropy.begin(), safeToUpper);
+        _transformTypes.push_back(TransformFactory<byte>::getType(transform.c_str())); // throws on error
+        _entropyTypes.push_back(EntropyEncoderFactory::getType(entropy.c_str())); // throws on error
+    }
+
+    if (_transformTypes.size() == 0)
+        throw invalid_argument("No codec candidate provided");
+
+    if (_transformTypes.size() > size_t(MAX_CANDIDATES)) {
+        stringstream ss;
+        ss << "Too many codec candidates (max " << MAX_CANDIDATES << "): " << _transformTypes.size();
+        throw invalid_argument(ss.str());
+    }
+}
+
+
+int BlockSelector::getSampleSize(int count)
+{
+    const int sampleSize = max(min(count / 8, MAX_SAMPLE_SIZE), MIN_SAMPLE_SIZE);
+    return min(sampleSize, count);
+}
+
+
+int BlockSelector::select(const Context& ctx, const byte block[], int count,
+    TransformCache<byte> trials[], ModelArena arenas[], int nbArenas) const
+{
+    const uint magic = (count >= 4) ? Magic::getType(block) : Magic::NO_MAGIC;
+
+    if (Magic::isCompressed(magic) == true)
+        return -1;
+
+    // The sample is made of slices spread from the start to the end of the
+    // block (blocks often mix several kinds of data)
+    const int sampleSize = getSampleSize(count);
+    const int sliceSize = sampleSize / NB_SLICES;
+    SliceArray<byte> sample(new byte[sampleSize], sampleSize, 0);
+    SliceArray<byte> in(new byte[sampleSize], sampleSize, 0);
+    SliceArray<byte> out(nullptr, 0, 0);
+    int best = -1;
+
+    try {
+        bool incompressible = true;
+
+        for (int i = 0; i < NB_SLICES; i++) {
+            const int dstIdx = i * sliceSize;
+            const int length = (i == NB_SLICES - 1) ? sampleSize - dstIdx : sliceSize;
+            const int srcIdx = (sampleSize == count) ? dstIdx :
+                int((int64(i) * int64(count - length)) / (NB_SLICES - 1));
+            memcpy(&sample._array[dstIdx], &block[srcIdx], size_t(length));
+
+            if (incompressible == true) {
+                uint histo[256] = { 0 };
+                Global::computeHistogram(&sample._array[dstIdx], length, histo);
+                incompressible = Global::computeFirstOrderEntropy1024(length, histo) >= EntropyUtils::INCOMPRESSIBLE_THRESHOLD;
+            }
+        }
+
+        if (size() == 1) {
+            best = (incompressible == true) ? -1 : 0;
+        }
+        else {
+            Context sCtx(ctx);
+            sCtx.putInt(Context::SIZE, sampleSize);
+
+            // Same data type hint as the encoder (see EncodingTask)
+            if (Magic::isMultimedia(magic) == true)
+                sCtx.putInt(Context::DATA_TYPE, Global::MULTIMEDIA);
+            else if (Magic::isExecutable(magic) == true)
+                sCtx.putInt(Context::DATA_TYPE, Global::EXE);
+
+            int64 bestSize = int64(sampleSize) << 3;
+
+            for (int i = 0; i < size(); i++) {
+                memcpy(&in._array[0], &sample._array[0], size_t(sampleSize));
+                const int64 bits = encode(sCtx, i, sampleSize, in, out, trials[i], arenas, nbArenas);
+
+                if ((bits >= 0) && (bits < bestSize)) {
+                    best = i;
+                    bestSize = bits;
+                }
+
+                // High entropy sample: the other candidates are tried only
+                // if the fastest one compresses the sample
+                if ((incompressible == true) && (best < 0))
+                    break;
+            }
+        }
+    }
+    catch (...) {
+        delete[] sample._array;
+        delete[] in._array;
+        delete[] out._array;
+        throw;
+    }
+
+    delete[] sample._array;
+    delete[] in._array;
+    delete[] out._array;
+    return best;
+}
+
+
+int64 BlockSelector::encode(const Context& ctx, int idx, int count, SliceArray<byte>& in,
+    SliceArray<byte>& out, TransformCache<byte>& trial, ModelArena arenas[], int nbArenas) const
+{
+    // The transforms of the candidate (and their work buffers) are reused
+    // from one block to the next
+    Context& tCtx = trial.reset(ctx);
+    tCtx.putLong(Context::TRANSFORM_TYPE, _transformTypes[idx]);
+    tCtx.putInt(Context::ENTROPY_TYPE, _entropyTypes[idx]);
+    tCtx.putString("entropy", EntropyEncoderFactory::getName(_entropyTypes[idx]));
+    int64 res = -1;
+
+    try {
+        TransformSequence<byte>* transform = trial.get(_transformTypes[idx]);
+        const int required = max(transform->getMaxEncodedLength(count), count);
+
+        if (out._length < required) {
+            delete[] out._array;
+            out._array = new byte[required];
+            out._length = required;
+        }
+
+        // The sequence may use its input as work space: 'in' is a copy of the sample
+        in._index = 0;
+        out._index = 0;
+        transform->forward(in, out, count);
+        const int length = out._index;
+
+        if ((length > 0) && (length <= out._length)) {
+            const int sinkSize = length + (length >> 3) + 1024;
+            SliceArray<byte> sink(new byte[sinkSize], sinkSize, 0);
+
+            {
+                growable_ofixedbuf buf(&sink); // may reallocate sink._array
+                ostream os(&buf);
+                DefaultOutputBitStream obs(os);
+                Context eCtx(tCtx);
+                eCtx.putInt(Context::SIZE, length);
+                EntropyEncoder* ee = nullptr;
+                ModelArena* arena = nullptr;
+
+                try {
+                    // The TPAQ models take their memory from a free arena (if any)
+                    if ((_entropyTypes[idx] == EntropyEncoderFactory::TPAQ_TYPE) || (_entropyTypes[idx] == EntropyEncoderFactory::TPAQX_TYPE))
+                        arena = ModelArena::acquire(arenas, nbArenas);
+
+                    ee = EntropyEncoderFactory::newEncoder(obs, eCtx, _entropyTypes[idx], arena);
+
+                    if (ee->encode(&out._array[0], 0, length) == length) {
+                        ee->dispose();
+                        obs.close();
+                        res = int64(obs.written());
+                    }
+                }
+                catch (const exception&) {
+                    res = -1;
+                }
+
+                if (ee != nullptr)
+                    delete ee;
+
+                if (arena != nullptr)
+                    arena->release();
+            }
+
+            delete[] sink._array;
+        }
+    }
+    catch (const exception&) {
+        // A failing candidate is not selected. Do not reuse transforms that
+        // may be in an inconsistent state.
+        trial.clear();
+        res = -1;
+    }
+
+    return res;
+}
@@ -0,0 +1,83 @@
+/*
+Copyright 2011-2026 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef knz_BlockSelector
+#define knz_BlockSelector
+
+#include <string>
+#include <vector>
+#include "../Context.hpp"
+#include "../SliceArray.hpp"
+#include "../transform/TransformCache.hpp"
+#include "../types.hpp"
+
+
+namespace kanzi {
+
+   class ModelArena;
+
+   // Choose the transforms and the entropy codec of each block of a compressed
+   // stream among a few candidates (see the "autoCodecs" option of
+   // CompressedOutputStream).
+   // A sample of the block (slices spread over the block) is encoded with
+   // every candidate and the smallest output wins (the fastest one on a tie:
+   // the candidates are listed from the fastest to the slowest). Blocks that
+   // no candidate compresses are copied. Blocks with a compressed format are
+   // copied without trials and, if the order 0 entropy of the sample is high,
+   // the other candidates are tried only if the fastest one compresses it.
+   class BlockSelector {
+   public:
+       static const int MIN_SAMPLE_SIZE = 256 * 1024;
+       static const int MAX_SAMPLE_SIZE = 1024 * 1024;
+       static const int MAX_CANDIDATES = 16;
+       static const int NB_SLICES = 4;
+
+       // 'candidates' is a comma separated list of "transform/entropy" pairs,
+       // EG. "LZX/NONE,TEXT+UTF+BWT+RANK+ZRLT/ANS0". Throws invalid_argument
+       // if the list is empty or contains an unknown codec.
+       BlockSelector(const std::string& candidates);
+
+       ~BlockSelector() {}
+
+       int size() const { return int(_transformTypes.size()); }
+
+       uint64 getTransformType(int idx) const { return _transformTypes[idx]; }
+
+       short getEntropyType(int idx) const { return _entropyTypes[idx]; }
+
+       // Return the size of the sample encoded by the trials for a block of 'count' bytes.
+       static int getSampleSize(int count);
+
+       // Return the index of the candidate for the block or -1 if the block
+       // should be copied. 'ctx' provides the parameters of the block (size,
+       // jobs, ...) as for the transforms and entropy codecs. 'trials' holds
+       // the transforms of each candidate (one cache per candidate, owned by
+       // the block slot) and the TPAQ models of the trials take their memory
+       // from a free arena in 'arenas' (if any).
+       int select(const Context& ctx, const byte block[], int count,
+           TransformCache<byte> trials[], ModelArena arenas[], int nbArenas) const;
+
+   private:
+       std::vector<uint64> _transformTypes;
+       std::vector<short> _entropyTypes;
+
+       // Return the size in bits of the 'count' bytes of 'in' encoded with a
+       // candidate (-1 if the candidate fails). 'out' is a work buffer.
+       int64 encode(const Context& ctx, int idx, int count, SliceArray<byte>& in,
+           SliceArray<byte>& out, TransformCache<byte>& trial, ModelArena arenas[], int nbArenas) const;
+   };
+}
+#endif
@@ -15,10 +15,14 @@ limitations under the License.
 
 #include <sstream>
 #include "CompressedInputStream.hpp"
+#include "BlockPlanner.hpp"
 #include "IOException.hpp"
+#include "../Dictionary.hpp"
 #include "../Error.hpp"
 #include "../entropy/EntropyDecoderFactory.hpp"
-#include "../transform/TransformFactory.hpp"
+#include "../entropy/ModelArena.hpp"
+#include "../entropy/SolidModel.hpp"
+#include "../transform/TransformCache.hpp"
 #include "../util/fixedbuf.hpp"
 
 using namespace kanzi;
@@ -26,7 +30,7 @@ using namespace std;
 
 
 const int CompressedInputStream::BITSTREAM_TYPE = 0x4B414E5A; // "KANZ"
-const int CompressedInputStream::BITSTREAM_FORMAT_VERSION = 6;
+const int CompressedInputStream::BITSTREAM_FORMAT_VERSION = 7;
 const int CompressedInputStream::DEFAULT_BUFFER_SIZE = 256 * 1024;
 const int CompressedInputStream::EXTRA_BUFFER_SIZE = 512;
 const kanzi::byte CompressedInputStream::COPY_BLOCK_MASK = kanzi::byte(0x80);
@@ -36,6 +40,9 @@ const int CompressedInputStream::MAX_BITSTREAM_BLOCK_SIZE = 1024 * 1024 * 1024;
 const int CompressedInputStream::CANCEL_TASKS_ID = -1;
 const int CompressedInputStream::MAX_CONCURRENCY = 64;
 const int CompressedInputStream::MAX_BLOCK_ID = int((uint(1) << 31) - 1);
+const int CompressedInputStream::BLOCK_INDEX_MAGIC = 0x4B494458; // "KIDX"
+const int CompressedInputStream::AUTO_CODECS_MAGIC = 0x4155544F; // "AUTO"
+const int CompressedInputStream::BLOCK_INDEX_ENTRY_SIZE = 224; // bits
 
 
 CompressedInputStream::CompressedInputStream(InputStream& is,
@@ -82,10 +89,17 @@ CompressedInputStream::CompressedInputStream(InputStream& is,
     _gcount = 0;
     _ibs = new DefaultInputBitStream(is, DEFAULT_BUFFER_SIZE);
     _jobs = tasks;
+
+    // Reorder buffer: more block slots than jobs. Workers move on to the next
+    // blocks while a slow block is still pending, blocks are emitted in order.
+    _slots = BlockPlanner::getBlockSlots(_jobs);
+    _blockTasks = _jobs;
     _outputSize = originalSize;
     _nbInputBlocks = 0;
-    _buffers = new SliceArray<kanzi::byte>*[2 * _jobs];
+    _buffers = new SliceArray<kanzi::byte>*[2 * _slots];
     _headless = headerless;
+    _hasBlockIndex = false;
+    _autoCodecs = false;
     _consumeBlockId = 0;
 
     if (_headless == true) {
@@ -95,10 +109,10 @@ CompressedInputStream::CompressedInputStream(InputStream& is,
            throw invalid_argument(ss.str());
        }
 
-       _ctx.putInt("bsVersion", bsVersion);
+       _ctx.putInt(Context::BS_VERSION, bsVersion);
        _ctx.putString("entropy", entropy);
        _ctx.putString("transform", transform);
-       _ctx.putInt("blockSize", blockSize);
+       _ctx.putInt(Context::BLOCK_SIZE, blockSize);
 
        if (checksum == 32) {
           _hasher32 = new XXHash32(BITSTREAM_TYPE);
@@ -113,17 +127,22 @@ CompressedInputStream::CompressedInputStream(InputStream& is,
        }
     }
 
-    _jobsPerTask.resize(_jobs);
+    _jobsPerTask.resize(_slots);
     std::fill(_jobsPerTask.begin(), _jobsPerTask.end(), 1);
 
 #ifdef CONCURRENCY_ENABLED
-    _futures.resize(_jobs);
+    _futures.resize(_slots);
 #else
-    _results.resize(_jobs);
+    _results.resize(_slots);
 #endif
 
-    for (int i = 0; i < 2 * _jobs; i++)
+    for (int i = 0; i < 2 * _slots; i++)
         _buffers[i] = new SliceArray<kanzi::byte>(nullptr, 0, 0);
+
+    _transforms = new TransformCache<kanzi::byte>[_slots];
+    _arenas = new ModelArena[_jobs];
+    _lanes = 0;
+    _models = nullptr;
 }
 
 CompressedInputStream::CompressedInputStream(InputStream& is, Context& ctx, bool headerless)
@@ -131,7 +150,7 @@ CompressedInputStream::CompressedInputStream(InputStream& is, Context& ctx, bool
     , _ctx(ctx)
     , _parentCtx(&ctx)
 {
-    int tasks = _ctx.getInt("jobs", 1);
+    int tasks = _ctx.getInt(Context::JOBS, 1);
 
 #ifdef CONCURRENCY_ENABLED
     if ((tasks <= 0) || (tasks > MAX_CONCURRENCY)) {
@@ -157,19 +176,30 @@ CompressedInputStream::CompressedInputStream(InputStream& is, Context& ctx, bool
     _initialized = 0;
     _closed = 0;
     _gcount = 0;
-    _ibs = new DefaultInputBitStream(is, DEFAULT_BUFFER_SIZE);
+    // A short input does not need the default bitstream buffer
+    const int64 inputSize = _ctx.getLong("fileSize", 0);
+    const int ibsSize = ((inputSize > 0) && (inputSize < int64(DEFAULT_BUFFER_SIZE))) ?
+        int(inputSize + 1023) & -1024 : DEFAULT_BUFFER_SIZE;
+    _ibs = new DefaultInputBitStream(is, uint(ibsSize));
     _jobs = tasks;
+
+    // Reorder buffer: more block slots than jobs. Workers move on to the next
+    // blocks while a slow block is still pending, blocks are emitted in order.
+    _slots = BlockPlanner::getBlockSlots(_jobs);
+    _blockTasks = _jobs;
     _hasher32 = nullptr;
     _hasher64 = nullptr;
     _outputSize = 0;
     _nbInputBlocks = 0;
     _headless = headerless;
+    _hasBlockIndex = false;
+    _autoCodecs = false;
     _consumeBlockId = 0;
 
     if (_headless == true) {
         // Validation of required values
         // Optional bsVersion
-        const int bsVersion = _ctx.getInt("bsVersion", BITSTREAM_FORMAT_VERSION);
+        const int bsVersion = _ctx.getInt(Context::BS_VERSION, BITSTREAM_FORMAT_VERSION);
 
         if (bsVersion > BITSTREAM_FORMAT_VERSION) {
             stringstream ss;
@@ -177,14 +207,14 @@ CompressedInputStream::CompressedInputStream(InputStream& is, Context& ctx, bool
             throw invalid_argument(ss.str());
         }
 
-        _ctx.putInt("bsVersion", bsVersion);
+        _ctx.putInt(Context::BS_VERSION, bsVersion);
         string entropy = _ctx.getString("entropy");
         _entropyType = EntropyDecoderFactory::getType(entropy.c_str()); // throws on error
 
         string transform = _ctx.getString("transform");
         _transformType = TransformFactory<kanzi::byte>::getType(transform.c_str()); // throws on error
 
-        _blockSize = _ctx.getInt("blockSize", 0);
+        _blockSize = _ctx.getInt(Context::BLOCK_SIZE, 0);
 
         if ((_blockSize < MIN_BITSTREAM_BLOCK_SIZE) || (_blockSize > MAX_BITSTREAM_BLOCK_SIZE)) {
             stringstream ss;
@@ -206,7 +236,7 @@ CompressedInputStream::CompressedInputStream(InputStream& is, Context& ctx, bool
         _nbInputBlocks = min(nbBlocks, MAX_CONCURRENCY - 1);
 
         // Optional checksum
-        int checksum = ctx.getInt("checksum", 0);
+        int checksum = ctx.getInt(Context::CHECKSUM, 0);
 
         if (checksum == 0) {
             _hasher32 = nullptr;
@@ -225,19 +255,114 @@ CompressedInputStream::CompressedInputStream(InputStream& is, Context& ctx, bool
         }
     }
 
-    _jobsPerTask.resize(_jobs);
+    _jobsPerTask.resize(_slots);
     std::fill(_jobsPerTask.begin(), _jobsPerTask.end(), 1);
 
 #ifdef CONCURRENCY_ENABLED
-    _futures.resize(_jobs);
+    _futures.resize(_slots);
 #else
-    _results.resize(_jobs);
+    _results.resize(_slots);
 #endif
 
-    _buffers = new SliceArray<kanzi::byte>*[2 * _jobs];
+    _buffers = new SliceArray<kanzi::byte>*[2 * _slots];
 
-    for (int i = 0; i < 2 * _jobs; i++)
+    for (int i = 0; i < 2 * _slots; i++)
         _buffers[i] = new SliceArray<kanzi::byte>(nullptr, 0, 0);
+
+    _transforms = new TransformCache<kanzi::byte>[_slots];
+    _arenas = new ModelArena[_jobs];
+    _lanes = 0;
+    _models = nullptr;
+
+    if (_headless == true) {
+        // Solid mode: the number of lanes used by the encoder
+        const int lanes = _ctx.getInt("solid", 0);
+
+        if ((lanes < 0) || (lanes > MAX_CONCURRENCY)) {
+            stringstream ss;
+            ss << "The number of solid lanes must be in [1.." << MAX_CONCURRENCY << "], got " << lanes;
+            throw invalid_argument(ss.str());
+        }
+
+        // Codecs chosen per block: the candidates used by the encoder (any
+        // non empty value)
+        _autoCodecs = _ctx.getString("autoCodecs", "").length() > 0;
+
+        if ((_autoCodecs == true) && (lanes != 0))
+            throw invalid_argument("Solid mode is not compatible with the per-block choice of codecs");
+
+        if (SolidModel::isSupported(_entropyType) == true)
+            setLanes(lanes);
+
+        setMemoryBudget();
+
+        // A short output does not need more block slots than blocks
+        if (_nbInputBlocks > 0)
+            setSlots(_nbInputBlocks);
+
+        if (_jobs > 1) {
+            const int nbTasks = min(_blockTasks, _slots);
+            Global::computeJobsPerTask(&_jobsPerTask[0], _jobs, nbTasks);
+
+            for (int i = nbTasks; i < _slots; i++)
+                _jobsPerTask[i] = _jobsPerTask[i % nbTasks];
+        }
+    }
+}
+
+
+// Solid mode: the blocks of a lane are decoded in order with the model of the
+// lane. A block slot is reused once its block has been consumed, so using no
+// more slots than lanes orders the blocks of each lane. Must be called before
+// the first block is submitted.
+void CompressedInputStream::setLanes(int lanes)
+{
+    if (lanes <= 0)
+        return;
+
+    _lanes = lanes;
+    _models = new SolidModel[_lanes];
+    setSlots(_lanes);
+}
+
+
+// Release the block slots above 'slots'. Must be called before the first
+// block is submitted.
+void CompressedInputStream::setSlots(int slots)
+{
+    if (slots >= _slots)
+        return;
+
+    for (int i = slots; i < _slots; i++) {
+        delete[] _buffers[i]->_array;
+        delete _buffers[i];
+        delete[] _buffers[_slots + i]->_array;
+        delete _buffers[_slots + i];
+    }
+
+    // Output buffers follow the input buffers
+    for (int i = 0; i < slots; i++)
+        _buffers[slots + i] = _buffers[_slots + i];
+
+    _slots = slots;
+}
+
+
+// Decode fewer blocks concurrently if the blocks in flight do not fit in the
+// memory budget ("maxMemory"), estimated as for the encoder (see BlockPlanner).
+// The jobs go to the blocks being decoded. Must be called before the first
+// block is submitted.
+void CompressedInputStream::setMemoryBudget()
+{
+    const int64 budget = _ctx.getLong("maxMemory", 0);
+
+    if ((budget <= 0) || (_jobs == 1))
+        return;
+
+    const BlockPlanner planner(_transformType, _entropyType, _jobs, budget, 0, false, _lanes);
+    const BlockPlan plan = planner.plan(_outputSize, _blockSize, false);
+    _blockTasks = min(plan._tasks, _blockTasks);
+    setSlots(BlockPlanner::getBlockSlots(_blockTasks));
 }
 
 CompressedInputStream::~CompressedInputStream()
@@ -249,7 +374,7 @@ CompressedInputStream::~CompressedInputStream()
         // Ignore and continue
     }
 
-    for (int i = 0; i < 2 * _jobs; i++) {
+    for (int i = 0; i < 2 * _slots; i++) {
         if (_buffers[i]->_array != nullptr)
             delete[] _buffers[i]->_array;
 
@@ -257,6 +382,12 @@ CompressedInputStream::~CompressedInputStream()
     }
 
     delete[] _buffers;
+    delete[] _transforms;
+    delete[] _arenas;
+
+    if (_models != nullptr)
+        delete[] _models;
+
     delete _ibs;
 
     if (_hasher32 != nullptr) {
@@ -282,26 +413,81 @@ void CompressedInputStream::submitBlock(int bufferId)
         _buffers[bufferId]->_length = blkSize;
     }
 
+    const int blockId = _submitBlockId + 1;
+    int64 blockBits = -1;
+    int64 blockOffset = -1;
+
+    if (_jobs > 1) {
+        // Read the block from the shared bitstream now, in order, so that the
+        // decoding tasks do not need to wait for each other.
+        if (LOAD_ATOMIC(_blockId) == CANCEL_TASKS_ID) {
+            // End of stream or error already reached: nothing to decode
+#ifdef CONCURRENCY_ENABLED
+            _futures[bufferId] = std::future<DecodingTaskResult>();
+#endif
+            _submitBlockId++;
+            return;
+        }
+
+        int error = 0;
+        string msg;
+
+        try {
+            blockBits = int64(readBlock(bufferId, blkSize, blockOffset));
+            STORE_ATOMIC(_blockId, (blockBits == 0) ? CANCEL_TASKS_ID : blockId);
+        }
+        catch (const IOException& e) {
+            error = e.error();
+            msg = e.what();
+        }
+        catch (const exception& e) {
+            error = Error::ERR_PROCESS_BLOCK;
+            msg = e.what();
+        }
+
+        if (error != 0) {
+            // Report the error when the block is consumed
+            STORE_ATOMIC(_blockId, CANCEL_TASKS_ID);
+            DecodingTaskResult res(*_buffers[bufferId], blockId, 0, 0, error, msg);
+
+#ifdef CONCURRENCY_ENABLED
+            std::promise<DecodingTaskResult> p;
+            p.set_value(res);
+            _futures[bufferId] = p.get_future();
+#else
+            _results[bufferId] = res;
+#endif
+            _submitBlockId++;
+            return;
+        }
+    }
+
+    if (_listeners.size() > 0) {
+        WallTimer timer;
+        const BlockPlanner planner(_transformType, _entropyType, _jobsPerTask[bufferId], 0);
+        Event evt(Event::MEMORY_INFO, blockId, planner.getBlockMemory(_blockSize), timer.getCurrentTime());
+        CompressedInputStream::notifyListeners(_listeners, evt);
+    }
+
     Context copyCtx(_ctx);
-    copyCtx.putLong("tType", _transformType);
-    copyCtx.putInt("eType", _entropyType);
-    copyCtx.putInt("blockId", _submitBlockId + 1);
-    copyCtx.putInt("jobs", _jobsPerTask[bufferId]);
-    copyCtx.putInt("tasks", _jobs);
+    copyCtx.putLong(Context::TRANSFORM_TYPE, _transformType);
+    copyCtx.putInt(Context::ENTROPY_TYPE, _entropyType);
+    copyCtx.putInt(Context::BLOCK_ID, blockId);
+    copyCtx.putInt(Context::JOBS, _jobsPerTask[bufferId]);
+    copyCtx.putInt(Context::TASKS, _jobs);
 
     _buffers[bufferId]->_index = 0;
-    _buffers[_jobs + bufferId]->_index = 0;
+    _buffers[_slots + bufferId]->_index = 0;
 
     DecodingTask<DecodingTaskResult>* task = new DecodingTask<DecodingTaskResult>(
         _buffers[bufferId],
-        _buffers[_jobs + bufferId],
+        _buffers[_slots + bufferId],
         blkSize,
-        _ibs, _hasher32, _hasher64,
-#ifdef CONCURRENCY_ENABLED
-        &_blockMutex, &_blockCondition,
-#endif
-        &_blockId,
-        _listeners, copyCtx);
+        _ibs, blockBits, blockOffset,
+        _hasher32, _hasher64,
+        &_blockId, &_transforms[bufferId], _arenas, _jobs,
+        (_lanes > 0) ? &_models[(blockId - 1) % _lanes] : nullptr,
+        _autoCodecs, _listeners, copyCtx);
 
 #ifdef CONCURRENCY_ENABLED
     std::shared_ptr<DecodingTask<DecodingTaskResult>> safeTask(task);
@@ -311,8 +497,12 @@ void CompressedInputStream::submitBlock(int bufferId)
     };
 
     if (_pool == nullptr) {
-        // std::async returns std::future<DecodingTaskResult>
-        _futures[bufferId] = std::async(std::launch::async, taskRunner);
+        // With one block slot, the block is consumed before the next one is
+        // submitted: run the task on the calling thread when the block is read.
+        if (_slots > 1)
+            reserveJobs(bufferId, _jobsPerTask[bufferId]);
+
+        _futures[bufferId] = std::async((_slots == 1) ? std::launch::deferred : std::launch::async, taskRunner);
     }
     else {
         // pool->schedule returns std::future<DecodingTaskResult>
@@ -333,13 +523,95 @@ void CompressedInputStream::submitBlock(int bufferId)
 }
 
 
+#ifdef CONCURRENCY_ENABLED
+// Without a pool, each task runs on its own thread: wait for the oldest
+// tasks (from the slot after 'bufferId') until 'jobs' more jobs fit in _jobs.
+// The other slots only hold decoded blocks waiting to be read.
+void CompressedInputStream::reserveJobs(int bufferId, int jobs)
+{
+    for (int i = 1; i < _slots; i++) {
+        int running = 0;
+
+        for (int j = 0; j < _slots; j++) {
+            if ((_futures[j].valid() == true) &&
+                (_futures[j].wait_for(std::chrono::seconds(0)) == std::future_status::timeout))
+                running += _jobsPerTask[j];
+        }
+
+        if (running + jobs <= _jobs)
+            return;
+
+        const int id = (bufferId + i) % _slots;
+
+        if (_futures[id].valid() == true)
+            _futures[id].wait();
+    }
+}
+#endif
+
+
+// Read the next block (size + payload) from the shared bitstream into the
+// input buffer of the slot. Return the size of the block in bits (0 at the
+// end of the stream).
+uint64 CompressedInputStream::readBlock(int bufferId, int blockSize, int64& blockOffset)
+{
+    uint64 read;
+
+    if (_ctx.getInt(Context::BS_VERSION) >= 7) {
+        // Byte aligned block, size in bytes on 32 bits
+        const uint pad = uint(8 - (_ibs->read() & 7)) & 7;
+
+        if (pad != 0)
+            _ibs->readBits(pad);
+
+#if !defined(_MSC_VER) || _MSC_VER > 1500
+        blockOffset = _ibs->tell();
+#endif
+        read = _ibs->readBits(32) << 3;
+    }
+    else {
+#if !defined(_MSC_VER) || _MSC_VER > 1500
+        blockOffset = _ibs->tell();
+#endif
+        const uint lr = 3 + uint(_ibs->readBits(5));
+        read = _ibs->readBits(lr);
+    }
+
+    if (read == 0)
+        return 0;
+
+    if (read > (uint64(1) << 34))
+        throw IOException("Invalid block size", Error::ERR_BLOCK_SIZE);
+
+    const int r = int((read + 7) >> 3);
+    SliceArray<kanzi::byte>* data = _buffers[bufferId];
+
+    if (data->_length < max(blockSize, r)) {
+        data->_length = max(blockSize, r);
+        delete[] data->_array;
+        data->_array = new kanzi::byte[data->_length];
+    }
+
+    uint64 remaining = read;
+
+    for (int n = 0; remaining > 0; ) {
+        const uint chkSize = uint(min(remaining, uint64(1) << 30));
+        _ibs->readBits(&data->_array[n], chkSize);
+        n += ((chkSize + 7) >> 3);
+        remaining -= uint64(chkSize);
+    }
+
+    return read;
+}
+
+
 int CompressedInputStream::_get(int inc)
 {
     try {
         if (LOAD_ATOMIC(_initialized) == 0) {
              readHeader();
 
-             for (int i = 0; i < _jobs; i++)
+             for (int i = 0; i < _slots; i++)
                 submitBlock(i);
         }
 
@@ -351,7 +623,7 @@ int CompressedInputStream::_get(int inc)
 
 #ifdef CONCURRENCY_ENABLED
             if (_futures[_bufferId].valid()) {
-                 res = _futures[_bufferId].get();
+                 res = (_pool != nullptr) ? _pool->get(_futures[_bufferId]) : _futures[_bufferId].get();
             } else {
                  setstate(ios::eofbit);
                  return EOF;
@@ -391,7 +663,7 @@ int CompressedInputStream::_get(int inc)
                 }
 
                 submitBlock(_bufferId);
-                _bufferId = (_bufferId + 1) % _jobs;
+                _bufferId = (_bufferId + 1) % _slots;
                 _consumeBlockId++;
             }
 
@@ -408,7 +680,7 @@ int CompressedInputStream::_get(int inc)
 
         if (_available == 0) {
             submitBlock(_bufferId);
-            _bufferId = (_bufferId + 1) % _jobs;
+            _bufferId = (_bufferId + 1) % _slots;
             _consumeBlockId++;
         }
 
@@ -425,6 +697,53 @@ int CompressedInputStream::_get(int inc)
 }
 
 
+streamsize CompressedInputStream::readsome(char* data, streamsize length)
+{
+    _gcount = 0;
+
+    if (length <= 0)
+        return 0;
+
+    // Load the next block if needed
+    if ((_available == 0) && (peek() == EOF))
+        return 0;
+
+    read(data, min(length, streamsize(_available)));
+    return _gcount;
+}
+
+
+// One shot decompression of a memory buffer. The bitstream is read from 'src'
+// in place, the blocks are decoded to buffers sized to the blocks and copied
+// to 'dst'.
+int64 CompressedInputStream::decompressBuffer(const kanzi::byte* src, int64 srcLength,
+    kanzi::byte* dst, int64 dstCapacity, Context& ctx, bool headerless)
+{
+    if ((src == nullptr) || (srcLength <= 0))
+        throw invalid_argument("Invalid source buffer");
+
+    if ((dstCapacity < 0) || ((dst == nullptr) && (dstCapacity != 0)))
+        throw invalid_argument("Invalid destination buffer");
+
+    // The size of the bitstream limits the buffers of the stream. The header
+    // values still go to the caller context.
+    Context dctx(ctx);
+    dctx.putLong("fileSize", srcLength);
+    ifixedbuf buf(const_cast<char*>(reinterpret_cast<const char*>(src)), size_t(srcLength));
+    istream is(&buf);
+    CompressedInputStream cis(is, dctx, headerless);
+    cis._parentCtx = &ctx;
+    cis.read(reinterpret_cast<char*>(dst), streamsize(dstCapacity));
+    const int64 decoded = int64(cis.gcount());
+
+    if ((decoded == dstCapacity) && (cis.peek() != EOF))
+        throw IOException("The destination buffer is too small", Error::ERR_WRITE_FILE);
+
+    cis.close();
+    return decoded;
+}
+
+
 istream& CompressedInputStream::read(char* data, streamsize length)
 {
     if (length < 0)
@@ -439,7 +758,7 @@ istream& CompressedInputStream::read(char* data, streamsize length)
         if (LOAD_ATOMIC(_initialized) == 0) {
              readHeader();
 
-             for (int i = 0; i < _jobs; i++)
+             for (int i = 0; i < _slots; i++)
                  submitBlock(i);
         }
 
@@ -447,7 +766,7 @@ istream& CompressedInputStream::read(char* data, streamsize length)
             DecodingTaskResult res;
 #ifdef CONCURRENCY_ENABLED
             if (_futures[_bufferId].valid()) {
-                 res = _futures[_bufferId].get();
+                 res = (_pool != nullptr) ? _pool->get(_futures[_bufferId]) : _futures[_bufferId].get();
             } else {
                  setstate(ios::eofbit);
                  break;
@@ -499,7 +818,7 @@ istream& CompressedInputStream::read(char* data, streamsize length)
 
         if (_available == 0) {
             submitBlock(_bufferId);
-            _bufferId = (_bufferId + 1) % _jobs;
+            _bufferId = (_bufferId + 1) % _slots;
             _consumeBlockId++;
         }
     }
@@ -534,7 +853,7 @@ void CompressedInputStream::readHeader()
         throw IOException(ss.str(), Error::ERR_STREAM_VERSION);
     }
 
-    _ctx.putInt("bsVersion", bsVersion);
+    _ctx.putInt(Context::BS_VERSION, bsVersion);
     uint64 ckSize = 0;
 
     // Read block checksum
@@ -581,7 +900,7 @@ void CompressedInputStream::readHeader()
 
     // Read block size
     _blockSize = int(_ibs->readBits(28) << 4);
-    _ctx.putInt("blockSize", _blockSize);
+    _ctx.putInt(Context::BLOCK_SIZE, _blockSize);
     _bufferThreshold = _blockSize;
 
     if ((_blockSize < MIN_BITSTREAM_BLOCK_SIZE) || (_blockSize > MAX_BITSTREAM_BLOCK_SIZE)) {
@@ -604,16 +923,47 @@ void CompressedInputStream::readHeader()
         _nbInputBlocks = min(nbBlocks, MAX_CONCURRENCY - 1);
     }
 
+    int lanes = 0;
+    bool hasDict = false;
+    uint32 dictId = 0;
+
     if (bsVersion >= 6) {
-       // Padding
-       _ibs->readBits(15);
+       // Flags: block index (1 bit), solid lanes (7 bits), dictionary (1 bit),
+       // codecs chosen per block (1 bit) + padding
+       const uint flags = uint(_ibs->readBits(15));
+       _hasBlockIndex = (flags >> 14) != 0;
+       lanes = int(flags >> 7) & 0x7F;
+       hasDict = ((flags >> 6) & 1) != 0;
+       _autoCodecs = ((flags >> 5) & 1) != 0;
+
+       if (hasDict == true)
+           dictId = uint32(_ibs->readBits(32));
+
+       if ((lanes > MAX_CONCURRENCY) || ((lanes != 0) && ((SolidModel::isSupported(_entropyType) == false) || (_autoCodecs == true)))) {
+           stringstream ss;
+           ss << "Invalid bitstream, incorrect number of solid lanes: " << lanes;
+           throw IOException(ss.str(), Error::ERR_INVALID_FILE);
+       }
+
+       setLanes(lanes);
     }
 
+    setMemoryBudget();
+
+    // A short output does not need more block slots than blocks
+    if (_nbInputBlocks > 0)
+        setSlots(_nbInputBlocks);
+
     // Assign optimal number of tasks and jobs per task (if the number of blocks is available)
     if (_jobs > 1) {
         // Limit the number of tasks if there are fewer blocks that _jobs
-        int nbTasks = (_nbInputBlocks != 0) ? min(_nbInputBlocks, _jobs) : _jobs;
+        int nbTasks = (_nbInputBlocks != 0) ? min(_nbInputBlocks, _blockTasks) : _blockTasks;
+        nbTasks = min(nbTasks, _slots);
         Global::computeJobsPerTask(&_jobsPerTask[0], _jobs, nbTasks);
+
+        // Extra slots (reorder buffer) share the jobs in the same way
+        for (int i = nbTasks; i < _slots; i++)
+            _jobsPerTask[i] = _jobsPerTask[i % nbTasks];
     }
     else {
         _jobsPerTask[0] = 1;
@@ -639,11 +989,41 @@ void CompressedInputStream::readHeader()
         cksum2 ^= (HASH * uint32(~_outputSize));
     }
 
+    if (lanes != 0)
+        cksum2 ^= (HASH * uint32(~lanes));
+
+    if (hasDict == true)
+        cksum2 ^= (HASH * uint32(~dictId));
+
+    if (_autoCodecs == true)
+        cksum2 ^= (HASH * uint32(~AUTO_CODECS_MAGIC));
+
     cksum2 = (cksum2 >> 23) ^ (cksum2 >> 3);
 
     if (cksum1 != (cksum2 & ((1 << crcSize) - 1)))
         throw IOException("Invalid bitstream, header checksum mismatch", Error::ERR_CRC_CHECK);
 
+    if (hasDict == true) {
+        const Dictionary* dict = _ctx.getDictionary();
+
+        // No dictionary needed if no block is decoded (EG. info mode)
+        if ((dict == nullptr) && (_ctx.getInt(Context::TO, MAX_BLOCK_ID) > 1)) {
+            stringstream ss;
+            ss << "The bitstream was compressed with a dictionary (ID " << std::hex << dictId << "), provide it to decompress";
+            throw IOException(ss.str(), Error::ERR_MISSING_PARAM);
+        }
+
+        if ((dict != nullptr) && (dict->getId() != dictId)) {
+            stringstream ss;
+            ss << "Incorrect dictionary: the bitstream requires ID " << std::hex << dictId << ", got " << dict->getId();
+            throw IOException(ss.str(), Error::ERR_INVALID_PARAM);
+        }
+    }
+    else {
+        // A dictionary provided for a stream compressed without it is not used
+        _ctx.setDictionary(nullptr);
+    }
+
     if (_listeners.size() > 0) {
         Event::HeaderInfo info;
         info.inputName = _ctx.getString("inputName", "");
@@ -660,9 +1040,93 @@ void CompressedInputStream::readHeader()
         Event evt(Event::AFTER_HEADER_DECODING, 0, info, timer.getCurrentTime());
         notifyListeners(_listeners, evt);
     }
+
+#if !defined(_MSC_VER) || _MSC_VER > 1500
+    // Jump straight to the first requested block if the stream has an index.
+    // Otherwise, the preceding blocks are read and skipped by the decoding tasks.
+    const int from = _ctx.getInt(Context::FROM, 1);
+
+    // In solid mode, the preceding blocks are needed to rebuild the models.
+    if ((_hasBlockIndex == true) && (from > 1) && (_lanes == 0))
+        seekToBlock(from);
+#endif
 }
 
 
+#if !defined(_MSC_VER) || _MSC_VER > 1500
+// Use the block index trailer (see CompressedOutputStream::writeBlockIndex)
+// to position the bitstream at the start of the provided block.
+// On failure (non seekable input, missing or invalid index), the stream
+// position is restored and false is returned.
+bool CompressedInputStream::seekToBlock(int blockId)
+{
+    const int64 pos = _ibs->tell();
+
+    if (pos < 0)
+        return false;
+
+    // Bit position of the start of the bitstream in the underlying stream
+    const int64 start = pos - int64(_ibs->read());
+    const streampos end = rdbuf()->pubseekoff(0, ios::end, ios::in);
+
+    if ((end == streampos(-1)) || (8 * int64(end) - start < 128)) {
+        _ibs->seek(pos);
+        return false;
+    }
+
+    try {
+        const int64 endBits = 8 * int64(end);
+
+        // Read footer
+        if (_ibs->seek(endBits - 128) == false)
+            throw IOException("Cannot read block index footer");
+
+        const int nbBlocks = int(_ibs->readBits(32));
+        const int64 indexOffset = int64(_ibs->readBits(64));
+
+        if (int(_ibs->readBits(32)) != BLOCK_INDEX_MAGIC)
+            throw IOException("Invalid block index magic");
+
+        if ((nbBlocks < 0) ||
+            (start + indexOffset + int64(nbBlocks) * BLOCK_INDEX_ENTRY_SIZE + 128 != endBits))
+            throw IOException("Invalid block index size");
+
+        // Past the last block, point to the end of stream marker
+        const int id = min(blockId, nbBlocks + 1);
+        int64 offset = pos - start; // block 1 starts right after the header
+
+        if (id > 1) {
+            const int entry = (id <= nbBlocks) ? id - 1 : nbBlocks - 1;
+
+            if (_ibs->seek(start + indexOffset + int64(entry) * BLOCK_INDEX_ENTRY_SIZE) == false)
+                throw IOException("Cannot read block index entry");
+
+            offset = int64(_ibs->readBits(64));
+
+            if (id > nbBlocks)
+                offset += int64(_ibs->readBits(64));
+
+            if ((offset <= 0) || (offset >= indexOffset))
+                throw IOException("Invalid block index entry");
+        }
+
+        if (_ibs->seek(start + offset) == false)
+            throw IOException("Cannot seek to block");
+
+        _submitBlockId = id - 1;
+        STORE_ATOMIC(_blockId, id - 1);
+        return true;
+    }
+    catch (const exception&) {
+        // Fall back to sequential decoding
+        this->clear();
+        _ibs->seek(pos);
+        return false;
+    }
+}
+#endif
+
+
 bool CompressedInputStream::addListener(Listener<Event>& bl)
 {
     _listeners.push_back(&bl);
@@ -687,28 +1151,23 @@ void CompressedInputStream::close()
     if (EXCHANGE_ATOMIC(_closed, 1) == 1)
         return;
 
-    // Signal to break the waits in DecodingTask::run immediately and
-    // ensure no thread is writing to _buffers before we delete them.
-#ifdef CONCURRENCY_ENABLED
-    {
-        std::lock_guard<std::mutex> lock(_blockMutex);
-        STORE_ATOMIC(_blockId, CANCEL_TASKS_ID);
-    }
-
-    _blockCondition.notify_all();
+    // Ensure no task is writing to _buffers before we delete them.
+    STORE_ATOMIC(_blockId, CANCEL_TASKS_ID);
 
+#ifdef CONCURRENCY_ENABLED
     for (size_t i = 0; i < _futures.size(); i++) {
         if (_futures[i].valid()) {
             try {
-                _futures[i].get();
+                if (_pool != nullptr)
+                    _pool->get(_futures[i]);
+                else
+                    _futures[i].get();
             }
             catch (...) {
                 // Ignore exceptions, we are closing anyway.
             }
         }
     }
-#else
-    STORE_ATOMIC(_blockId, CANCEL_TASKS_ID);
 #endif
 
     try {
@@ -724,7 +1183,7 @@ void CompressedInputStream::close()
     _bufferThreshold = 0;
 
     // Buffer cleanup: force error on any subsequent read attempt
-    for (int i = 0; i < 2 * _jobs; i++) {
+    for (int i = 0; i < 2 * _slots; i++) {
         if (_buffers[i]->_array != nullptr)
            delete[] _buffers[i]->_array;
 
@@ -732,6 +1191,15 @@ void CompressedInputStream::close()
         _buffers[i]->_length = 0;
         _buffers[i]->_index = 0;
     }
+
+    for (int i = 0; i < _slots; i++)
+        _transforms[i].clear();
+
+    for (int i = 0; i < _jobs; i++)
+        _arenas[i].clear();
+
+    for (int i = 0; i < _lanes; i++)
+        _models[i].reset();
 }
 
 
@@ -743,12 +1211,11 @@ void CompressedInputStream::notifyListeners(vector<Listener<Event>*>& listeners,
 
 template <class T>
 DecodingTask<T>::DecodingTask(SliceArray<kanzi::byte>* iBuffer, SliceArray<kanzi::byte>* oBuffer,
-    int blockSize, DefaultInputBitStream* ibs, XXHash32* hasher32, XXHash64* hasher64,
-#ifdef CONCURRENCY_ENABLED
-    std::mutex* blockMutex, std::condition_variable* blockCondition,
-#endif
-    atomic_int_t* processedBlockId, vector<Listener<Event>*>& listeners,
-    const Context& ctx)
+    int blockSize, DefaultInputBitStream* ibs, int64 blockBits, int64 blockOffset,
+    XXHash32* hasher32, XXHash64* hasher64,
+    atomic_int_t* processedBlockId, TransformCache<kanzi::byte>* transforms,
+    ModelArena* arenas, int nbArenas, SolidModel* model, bool autoCodecs,
+    vector<Listener<Event>*>& listeners, const Context& ctx)
     : _listeners(listeners)
     , _ctx(ctx)
 {
@@ -756,28 +1223,16 @@ DecodingTask<T>::DecodingTask(SliceArray<kanzi::byte>* iBuffer, SliceArray<kanzi
     _data = iBuffer;
     _buffer = oBuffer;
     _ibs = ibs;
+    _blockBits = blockBits;
+    _blockOffset = blockOffset;
     _hasher32 = hasher32;
     _hasher64 = hasher64;
-#ifdef CONCURRENCY_ENABLED
-    _blockMutex = blockMutex;
-    _blockCondition = blockCondition;
-#endif
     _processedBlockId = processedBlockId;
-}
-
-template <class T>
-void DecodingTask<T>::storeProcessedBlockId(int value)
-{
-#ifdef CONCURRENCY_ENABLED
-    {
-        std::lock_guard<std::mutex> lock(*_blockMutex);
-        STORE_ATOMIC(*_processedBlockId, value);
-    }
-
-    _blockCondition->notify_all();
-#else
-    STORE_ATOMIC(*_processedBlockId, value);
-#endif
+    _transforms = transforms;
+    _arenas = arenas;
+    _nbArenas = nbArenas;
+    _model = model;
+    _autoCodecs = autoCodecs;
 }
 
 // Decode mode + transformed entropy coded data
@@ -787,60 +1242,71 @@ void DecodingTask<T>::storeProcessedBlockId(int value)
 //      | 0b0001xxxx => transform sequence skip flags (1 means skip)
 //  case more than 4 transforms
 //      | 0b0yy00000 0bxxxxxxxx => transform sequence skip flags in next kanzi::byte (1 means skip)
+// Codecs chosen per block (see BlockSelector): the mode (and skip flags) of
+// the blocks that are not copied are followed by the transform types (48 bits)
+// and the entropy type (5 bits + 3 bits of padding)
 template <class T>
 T DecodingTask<T>::run()
 {
-    int blockId = _ctx.getInt("blockId");
-    bool streamPerTask = _ctx.getInt("tasks") > 1;
-    uint64 tType = _ctx.getLong("tType");
-    short eType = short(_ctx.getInt("eType"));
-
-#ifdef CONCURRENCY_ENABLED
-    {
-        std::unique_lock<std::mutex> lock(*_blockMutex);
-        _blockCondition->wait(lock, [this, blockId]() {
-            const int taskId = LOAD_ATOMIC(*_processedBlockId);
-            return (taskId == CompressedInputStream::CANCEL_TASKS_ID) || (taskId == blockId - 1);
-        });
-    }
-
-    if (LOAD_ATOMIC(*_processedBlockId) == CompressedInputStream::CANCEL_TASKS_ID) {
-        // Skip, an error occurred
-        return T(*_data, blockId, 0, 0, 0, "Canceled");
-    }
-#endif
+    int blockId = _ctx.getInt(Context::BLOCK_ID);
+    bool streamPerTask = _ctx.getInt(Context::TASKS) > 1;
+    uint64 tType = _ctx.getLong(Context::TRANSFORM_TYPE);
+    short eType = short(_ctx.getInt(Context::ENTROPY_TYPE));
+    const int bsVersion = _ctx.getInt(Context::BS_VERSION);
 
     uint64 checksum1 = 0;
     EntropyDecoder* ed = nullptr;
+    ModelArena* arena = nullptr;
     InputBitStream* ibs = nullptr;
-    TransformSequence<kanzi::byte>* transform = nullptr;
 
     try {
-        // Read shared bitstream sequentially (each task is gated by _processedBlockId)
+        uint64 read;
 #if !defined(_MSC_VER) || _MSC_VER > 1500
-        const uint64 blockOffset = _ibs->tell();
+        int64 blockOffset = _blockOffset;
 #endif
-        const uint lr = 3 + uint(_ibs->readBits(5));
-        uint64 read = _ibs->readBits(lr);
 
-        if (read == 0) {
-            storeProcessedBlockId(CompressedInputStream::CANCEL_TASKS_ID);
-            return T(*_data, blockId, 0, 0, 0, "Success");
+        if (_blockBits >= 0) {
+            // Block already read from the shared bitstream by the stream
+            read = uint64(_blockBits);
         }
+        else {
+            // Single task: read the shared bitstream directly
+            if (bsVersion >= 7) {
+                // Byte aligned block, size in bytes on 32 bits
+                const uint pad = uint(8 - (_ibs->read() & 7)) & 7;
 
-        if (read > (uint64(1) << 34)) {
-            storeProcessedBlockId(CompressedInputStream::CANCEL_TASKS_ID);
-            return T(*_data, blockId, 0, 0, Error::ERR_BLOCK_SIZE, "Invalid block size");
+                if (pad != 0)
+                    _ibs->readBits(pad);
+            }
+
+#if !defined(_MSC_VER) || _MSC_VER > 1500
+            blockOffset = _ibs->tell();
+#endif
+
+            if (bsVersion >= 7) {
+                read = _ibs->readBits(32) << 3;
+            }
+            else {
+                const uint lr = 3 + uint(_ibs->readBits(5));
+                read = _ibs->readBits(lr);
+            }
+
+            STORE_ATOMIC(*_processedBlockId, (read == 0) ? CompressedInputStream::CANCEL_TASKS_ID : blockId);
         }
 
-        const int from = _ctx.getInt("from", 1);
-        const int to = _ctx.getInt("to", CompressedInputStream::MAX_BLOCK_ID);
+        if (read == 0)
+            return T(*_data, blockId, 0, 0, 0, "Success");
+
+        if (read > (uint64(1) << 34))
+            return T(*_data, blockId, 0, 0, Error::ERR_BLOCK_SIZE, "Invalid block size");
+
+        const int from = _ctx.getInt(Context::FROM, 1);
+        const int to = _ctx.getInt(Context::TO, CompressedInputStream::MAX_BLOCK_ID);
         const uint r = uint((read + 7) >> 3);
 
-        // Read from the shared bitstream if
-        // - there is one that one task (each with their own local bitstream)
-        // - the block is going to be skipped (bits must be consumed)
-        if ((streamPerTask == true) || (blockId < from)) {
+        // Single task: read from the shared bitstream if the block is going
+        // to be skipped (bits must be consumed)
+        if ((_blockBits < 0) && (blockId < from) && (_model == nullptr)) {
             if (_data->_length < int(max(_blockLength, r))) {
                 _data->_length = int(max(_blockLength, r));
                 delete[] _data->_array;
@@ -855,12 +1321,9 @@ T DecodingTask<T>::run()
             }
         }
 
-        // After completion of the bitstream reading, increment the block id.
-        // It unblocks the task processing the next block (if any)
-        storeProcessedBlockId(blockId);
-
-        // Check if the block must be skipped
-        if (blockId < from) {
+        // Check if the block must be skipped. In solid mode, the blocks before
+        // 'from' are entropy decoded to rebuild the model of their lane.
+        if ((blockId < from) && (_model == nullptr)) {
             return T(*_data, blockId, 0, 0, 0, "Skipped", true);
         }
         else if (blockId >= to) {
@@ -869,7 +1332,8 @@ T DecodingTask<T>::run()
 
         ifixedbuf buf(reinterpret_cast<char*>(&_data->_array[0]), streamsize(r));
         istream ios(&buf);
-        ibs = (streamPerTask == true) ? new DefaultInputBitStream(ios) : _ibs;
+        // Small blocks do not need the default bitstream buffer
+        ibs = (streamPerTask == true) ? new DefaultInputBitStream(ios, min(r + 1023, 65536u) & ~1023u) : _ibs;
 
         // Extract block header from bitstream
         kanzi::byte mode = kanzi::byte(ibs->readBits(8));
@@ -884,6 +1348,29 @@ T DecodingTask<T>::run()
                 skipFlags = kanzi::byte(ibs->readBits(8));
             else
                 skipFlags = (mode << 4) | kanzi::byte(0x0F);
+
+            if (_autoCodecs == true) {
+                tType = ibs->readBits(48);
+                eType = short(ibs->readBits(8) >> 3);
+                string entropy;
+
+                try {
+                    TransformFactory<kanzi::byte>::getName(tType);
+                    entropy = EntropyDecoderFactory::getName(eType);
+                }
+                catch (const invalid_argument&) {
+                    if (streamPerTask == true)
+                        delete ibs;
+
+                    return T(*_data, blockId, 0, checksum1, Error::ERR_INVALID_CODEC,
+                        "Invalid bitstream, unknown codec in block header");
+                }
+
+                // Some transforms depend on the entropy codec (see TransformCache)
+                _ctx.putLong(Context::TRANSFORM_TYPE, tType);
+                _ctx.putInt(Context::ENTROPY_TYPE, eType);
+                _ctx.putString("entropy", entropy);
+            }
         }
 
         const int dataSize = 1 + (int(mode >> 5) & 0x03);
@@ -894,8 +1381,6 @@ T DecodingTask<T>::run()
                                          uint(CompressedInputStream::MAX_BITSTREAM_BLOCK_SIZE)));
 
         if ((preTransformLength <= 0) || (preTransformLength > maxTransformSize)) {
-            // Error => cancel concurrent decoding tasks
-            storeProcessedBlockId(CompressedInputStream::CANCEL_TASKS_ID);
             stringstream ss;
             ss << "Invalid compressed block length: " << preTransformLength;
 
@@ -920,7 +1405,7 @@ T DecodingTask<T>::run()
 
         if (_listeners.size() > 0) {
 #if !defined(_MSC_VER) || _MSC_VER > 1500
-            if (_ctx.getInt("verbosity", 0) > 4) {
+            if (_ctx.getInt(Context::VERBOSITY, 0) > 4) {
                 Event evt1(Event::BLOCK_INFO, blockId, int64(r), timer.getCurrentTime(), checksum1,
                            hashType, blockOffset, uint8(skipFlags));
                 CompressedInputStream::notifyListeners(_listeners, evt1);
@@ -943,18 +1428,27 @@ T DecodingTask<T>::run()
         }
 
         const int savedIdx = _data->_index;
-        _ctx.putInt("size", preTransformLength);
+        _ctx.putInt(Context::SIZE, preTransformLength);
+
+        // The TPAQ models take their memory from a free arena (if any)
+        if ((_model == nullptr) && ((eType == EntropyDecoderFactory::TPAQ_TYPE) || (eType == EntropyDecoderFactory::TPAQX_TYPE)))
+            arena = ModelArena::acquire(_arenas, _nbArenas);
 
         // Each block is decoded separately
-        // Rebuild the entropy decoder to reset block statistics
-        ed = EntropyDecoderFactory::newDecoder(*ibs, _ctx, eType);
+        // Rebuild the entropy decoder to reset block statistics, except in
+        // solid mode where the model of the lane carries over.
+        if ((_model != nullptr) && (SolidModel::isSupported(eType) == true))
+            ed = _model->newDecoder(*ibs, _ctx, eType, preTransformLength);
+        else
+            ed = EntropyDecoderFactory::newDecoder(*ibs, _ctx, eType, arena);
 
         // Block entropy decode
         if (ed->decode(_buffer->_array, 0, preTransformLength) != preTransformLength) {
-            // Error => cancel concurrent decoding tasks
-            storeProcessedBlockId(CompressedInputStream::CANCEL_TASKS_ID);
             delete ed;
 
+            if (arena != nullptr)
+                arena->release();
+
             if (streamPerTask == true)
                 delete ibs;
 
@@ -970,6 +1464,20 @@ T DecodingTask<T>::run()
         delete ed;
         ed = nullptr;
 
+        if (arena != nullptr) {
+            arena->release();
+            arena = nullptr;
+        }
+
+        if (_model != nullptr) {
+            // A copy block resets the model of its lane (see SolidModel)
+            if ((mode & CompressedInputStream::COPY_BLOCK_MASK) != kanzi::byte(0))
+                _model->reset();
+
+            if (blockId < from)
+                return T(*_data, blockId, 0, 0, 0, "Skipped", true);
+        }
+
         if (_listeners.size() > 0) {
             // Notify after entropy
             Event evt1(Event::AFTER_ENTROPY, blockId,
@@ -982,17 +1490,16 @@ T DecodingTask<T>::run()
             CompressedInputStream::notifyListeners(_listeners, evt2);
         }
 
-        transform = TransformFactory<kanzi::byte>::newTransform(_ctx, tType);
+        // Reuse the transforms of this buffer slot (see TransformCache)
+        _transforms->reset(_ctx);
+        TransformSequence<kanzi::byte>* transform = _transforms->get(tType);
         transform->setSkipFlags(skipFlags);
         _buffer->_index = 0;
 
         // Inverse transform
         bool res = transform->inverse(*_buffer, *_data, preTransformLength);
-        delete transform;
-        transform = nullptr;
 
         if (res == false) {
-            storeProcessedBlockId(CompressedInputStream::CANCEL_TASKS_ID);
             return T(*_data, blockId, 0, checksum1, Error::ERR_PROCESS_BLOCK,
                 "Transform inverse failed");
         }
@@ -1004,7 +1511,6 @@ T DecodingTask<T>::run()
             const uint32 checksum2 = _hasher32->hash(&_data->_array[savedIdx], decoded);
 
             if (checksum2 != uint32(checksum1)) {
-                storeProcessedBlockId(CompressedInputStream::CANCEL_TASKS_ID);
                 stringstream ss;
                 ss << "Corrupted bitstream: expected checksum " << std::hex << checksum1 << ", found " << std::hex << checksum2;
                 return T(*_data, blockId, decoded, checksum1, Error::ERR_CRC_CHECK, ss.str());
@@ -1014,7 +1520,6 @@ T DecodingTask<T>::run()
             const uint64 checksum2 = _hasher64->hash(&_data->_array[savedIdx], decoded);
 
             if (checksum2 != checksum1) {
-                storeProcessedBlockId(CompressedInputStream::CANCEL_TASKS_ID);
                 stringstream ss;
                 ss << "Corrupted bitstream: expected checksum " << std::hex << checksum1 << ", found " << std::hex << checksum2;
                 return T(*_data, blockId, decoded, checksum1, Error::ERR_CRC_CHECK, ss.str());
@@ -1024,15 +1529,15 @@ T DecodingTask<T>::run()
         return T(*_data, blockId, decoded, checksum1, 0, "Success");
     }
     catch (const exception& e) {
-        // Cancel any in-flight task waiting on this block.
-        storeProcessedBlockId(CompressedInputStream::CANCEL_TASKS_ID);
-
-        if (transform != nullptr)
-            delete transform;
+        // Do not reuse transforms that may be in an inconsistent state
+        _transforms->clear();
 
         if (ed != nullptr)
             delete ed;
 
+        if (arena != nullptr)
+            arena->release();
+
         if ((streamPerTask == true) && (ibs != nullptr))
             delete ibs;
 
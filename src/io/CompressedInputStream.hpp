@@ -40,6 +40,10 @@ limitations under the License.
 namespace kanzi
 {
 
+   template <class T> class TransformCache;
+   class ModelArena;
+   class SolidModel;
+
    class DecodingTaskResult FINAL {
    public:
        int _blockId;
@@ -140,7 +144,10 @@ namespace kanzi
    };
 
    // A task used to decode a block
-   // Several tasks (transform+entropy) may run in parallel
+   // Several tasks (transform+entropy) may run in parallel. When there are
+   // several tasks, the stream reads each block from the shared bitstream
+   // before submitting the task, so a task never waits for the previous ones.
+   // With a single task, the task reads the block from the shared bitstream.
    template <class T>
    class DecodingTask FINAL : public Task<T> {
    private:
@@ -148,26 +155,26 @@ namespace kanzi
        SliceArray<byte>* _buffer;
        uint _blockLength;
        DefaultInputBitStream* _ibs;
+       int64 _blockBits; // size of the block already read in _data, -1 if not read
+       int64 _blockOffset;
        XXHash32* _hasher32;
        XXHash64* _hasher64;
-#ifdef CONCURRENCY_ENABLED
-       std::mutex* _blockMutex;
-       std::condition_variable* _blockCondition;
-#endif
        atomic_int_t* _processedBlockId;
+       TransformCache<byte>* _transforms; // owned by the stream, one per buffer slot
+       ModelArena* _arenas; // owned by the stream, shared by the tasks (see ModelArena::acquire)
+       int _nbArenas;
+       SolidModel* _model; // model of the lane of the block in solid mode, else null
+       bool _autoCodecs; // the block header provides the codecs of the block
        std::vector<Listener<Event>*> _listeners;
        Context _ctx;
 
-       void storeProcessedBlockId(int value);
-
    public:
        DecodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuffer,
-           int blockSize, DefaultInputBitStream* ibs, XXHash32* hasher32, XXHash64* hasher64,
-#ifdef CONCURRENCY_ENABLED
-           std::mutex* blockMutex, std::condition_variable* blockCondition,
-#endif
-           atomic_int_t* processedBlockId, std::vector<Listener<Event>*>& listeners,
-           const Context& ctx);
+           int blockSize, DefaultInputBitStream* ibs, int64 blockBits, int64 blockOffset,
+           XXHash32* hasher32, XXHash64* hasher64,
+           atomic_int_t* processedBlockId, TransformCache<byte>* transforms,
+           ModelArena* arenas, int nbArenas, SolidModel* model, bool autoCodecs,
+           std::vector<Listener<Event>*>& listeners, const Context& ctx);
 
        ~DecodingTask(){}
 
@@ -213,6 +220,10 @@ namespace kanzi
 
        std::istream& read(char* s, std::streamsize n);
 
+       // Read at most n bytes from the current decoded block (the next block is
+       // decoded first if the current one is consumed). Return 0 at end of stream.
+       std::streamsize readsome(char* s, std::streamsize n);
+
        std::streamsize gcount() const { return _gcount; }
 
        int get();
@@ -223,6 +234,13 @@ namespace kanzi
 
        uint64 getRead() const { return (_ibs->read() + 7) >> 3; }
 
+       // Decompress the bitstream in 'src' in one call and return the number of
+       // bytes written to 'dst'. The context provides the same parameters as for
+       // the stream constructor (and receives the header values).
+       // Throws an IOException if the data does not fit in 'dstCapacity' bytes.
+       static int64 decompressBuffer(const byte* src, int64 srcLength, byte* dst, int64 dstCapacity,
+                                     Context& ctx, bool headerless = false);
+
 #if !defined(_MSC_VER) || _MSC_VER > 1500
        bool seek(int64 bitPos);
 
@@ -234,6 +252,8 @@ namespace kanzi
 
        void readHeader();
 
+       bool seekToBlock(int blockId);
+
 
    private:
        static const int BITSTREAM_TYPE;
@@ -247,18 +267,27 @@ namespace kanzi
        static const int CANCEL_TASKS_ID;
        static const int MAX_CONCURRENCY;
        static const int MAX_BLOCK_ID;
+       static const int BLOCK_INDEX_MAGIC;
+       static const int AUTO_CODECS_MAGIC;
+       static const int BLOCK_INDEX_ENTRY_SIZE;
 
        int _blockSize;
        int _bufferId; // index of current read buffer
        int _maxBufferId; // max index of read buffer
        int _nbInputBlocks;
        int _jobs;
+       int _slots; // block slots (reorder buffer), at least _jobs unless there are fewer blocks
+       int _blockTasks; // blocks decoded concurrently (see setMemoryBudget)
        int _bufferThreshold;
        int64 _available; // decoded not consumed bytes
        int64 _outputSize;
        XXHash32* _hasher32;
        XXHash64* _hasher64;
        SliceArray<byte>** _buffers; // input & output per block
+       TransformCache<byte>* _transforms; // transforms reused between blocks, one per buffer slot
+       ModelArena* _arenas; // entropy model memory reused between blocks, one per job
+       SolidModel* _models; // solid mode: entropy model of each lane, else null
+       int _lanes; // solid mode: number of lanes, 0 if the blocks are coded independently
        short _entropyType;
        uint64 _transformType;
        DefaultInputBitStream* _ibs;
@@ -272,19 +301,31 @@ namespace kanzi
        Context _ctx;
        Context* _parentCtx; // not owner
        bool _headless;
+       bool _hasBlockIndex;
+       bool _autoCodecs; // codecs chosen per block (see BlockSelector)
        std::vector<int> _jobsPerTask;
 
 #ifdef CONCURRENCY_ENABLED
        ThreadPool* _pool;
        std::vector<std::future<DecodingTaskResult>> _futures;
-       std::mutex _blockMutex;
-       std::condition_variable _blockCondition;
 #else
        std::vector<DecodingTaskResult> _results;
 #endif
 
        void submitBlock(int bufferId);
 
+#ifdef CONCURRENCY_ENABLED
+       void reserveJobs(int bufferId, int jobs);
+#endif
+
+       void setLanes(int lanes);
+
+       void setSlots(int slots);
+
+       void setMemoryBudget();
+
+       uint64 readBlock(int bufferId, int blockSize, int64& blockOffset);
+
        int _get(int inc);
 
        static void notifyListeners(std::vector<Listener<Event>*>& listeners, const Event& evt);
@@ -335,15 +376,23 @@ namespace kanzi
        if (bitPos < 0)
           return false;
 
+       // Solid mode: a block can only be decoded with the model built by the
+       // previous blocks of its lane
+       if (_lanes > 0)
+          return false;
+
 #ifdef CONCURRENCY_ENABLED
       // Cancel any in-flight decode pipeline tied to the previous position.
       STORE_ATOMIC(_blockId, CANCEL_TASKS_ID);
 
       // Drain futures so no task can still consume the old underlying bitstream.
-      for (int i = 0; i < _jobs; i++) {
+      for (int i = 0; i < _slots; i++) {
          if (_futures[i].valid()) {
             try {
-               (void) _futures[i].get();
+               if (_pool != nullptr)
+                  (void) _pool->get(_futures[i]);
+               else
+                  (void) _futures[i].get();
             }
             catch (...) {
                // Ignore: we are resetting the stream state anyway.
@@ -370,7 +419,7 @@ namespace kanzi
       // If stream was already initialized, bootstrap decoding tasks from new pos now.
       // If not initialized, read()/get() will initialize and submit as usual.
       if (LOAD_ATOMIC(_initialized) == 1) {
-         for (int i = 0; i < _jobs; i++)
+         for (int i = 0; i < _slots; i++)
             submitBlock(i);
       }
 
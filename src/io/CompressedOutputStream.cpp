@@ -17,27 +17,35 @@ limitations under the License.
 #include <sstream>
 #include <stdio.h>
 #include "CompressedOutputStream.hpp"
+#include "BlockPlanner.hpp"
+#include "BlockSelector.hpp"
 #include "IOException.hpp"
+#include "../Dictionary.hpp"
 #include "../Error.hpp"
 #include "../Magic.hpp"
 #include "../entropy/EntropyEncoderFactory.hpp"
 #include "../entropy/EntropyUtils.hpp"
-#include "../transform/TransformFactory.hpp"
+#include "../entropy/ModelArena.hpp"
+#include "../entropy/SolidModel.hpp"
+#include "../transform/TransformCache.hpp"
 #include "../util/fixedbuf.hpp"
 
 using namespace kanzi;
 using namespace std;
 
 const int CompressedOutputStream::BITSTREAM_TYPE = 0x4B414E5A; // "KANZ"
-const int CompressedOutputStream::BITSTREAM_FORMAT_VERSION = 6;
+const int CompressedOutputStream::BITSTREAM_FORMAT_VERSION = 7;
 const int CompressedOutputStream::DEFAULT_BUFFER_SIZE = 256 * 1024;
 const kanzi::byte CompressedOutputStream::COPY_BLOCK_MASK = kanzi::byte(0x80);
 const kanzi::byte CompressedOutputStream::TRANSFORMS_MASK = kanzi::byte(0x10);
 const int CompressedOutputStream::MIN_BITSTREAM_BLOCK_SIZE = 1024;
 const int CompressedOutputStream::MAX_BITSTREAM_BLOCK_SIZE = 1024 * 1024 * 1024;
 const int CompressedOutputStream::SMALL_BLOCK_SIZE = 15;
-const int CompressedOutputStream::CANCEL_TASKS_ID = -1;
 const int CompressedOutputStream::MAX_CONCURRENCY = 64;
+const int CompressedOutputStream::BLOCK_INDEX_MAGIC = 0x4B494458; // "KIDX"
+const int CompressedOutputStream::AUTO_CODECS_MAGIC = 0x4155544F; // "AUTO"
+const int CompressedOutputStream::MAX_HEADER_SIZE = 30;
+const int CompressedOutputStream::MAX_BLOCK_OVERHEAD = 25; // alignment, size, mode, codecs (autoCodecs), length, checksum
 
 
 CompressedOutputStream::CompressedOutputStream(OutputStream& os,
@@ -90,6 +98,7 @@ CompressedOutputStream::CompressedOutputStream(OutputStream& os,
     const int nbBlocks = (_inputSize == 0) ? 0 : int((_inputSize + int64(blockSize - 1)) / int64(blockSize));
     _nbInputBlocks = min(nbBlocks, MAX_CONCURRENCY - 1);
     _headless = headerless;
+    _blockIndex = false;
     _initialized = 0;
     _closed = 0;
     _obs = new DefaultOutputBitStream(os, DEFAULT_BUFFER_SIZE);
@@ -113,17 +122,25 @@ CompressedOutputStream::CompressedOutputStream(OutputStream& os,
     }
 
     _jobs = tasks;
-    _ctx.putInt("blockSize", _blockSize);
-    _ctx.putInt("checksum", checksum);
+
+    // Reorder buffer: more block slots than jobs. Workers move on to the next
+    // blocks while a slow block is still pending, blocks are emitted in order.
+    _slots = BlockPlanner::getBlockSlots(_jobs);
+    _lanes = 0;
+    _models = nullptr;
+    _selector = nullptr;
+    _trials = nullptr;
+    _ctx.putInt(Context::BLOCK_SIZE, _blockSize);
+    _ctx.putInt(Context::CHECKSUM, checksum);
     _ctx.putString("entropy", entropy);
     _ctx.putString("transform", transform);
-    _ctx.putInt("bsVersion", BITSTREAM_FORMAT_VERSION);
+    _ctx.putInt(Context::BS_VERSION, BITSTREAM_FORMAT_VERSION);
 
 #ifdef CONCURRENCY_ENABLED
-    _futures.resize(_jobs);
+    _futures.resize(_slots);
 #endif
 
-    _jobsPerTask.resize(_jobs);
+    _jobsPerTask.resize(_slots, 1);
 
     // Assign optimal number of tasks and jobs per task (if the number of blocks is available)
     if (_jobs > 1) {
@@ -136,20 +153,22 @@ CompressedOutputStream::CompressedOutputStream(OutputStream& os,
         _jobsPerTask[0] = 1;
     }
 
-    // Allocate first buffer and add padding for incompressible blocks
-    _buffers = new SliceArray<kanzi::byte>*[2 * _jobs];
-    const int bufSize = max(_blockSize + (_blockSize >> 3), DEFAULT_BUFFER_SIZE);
-    _buffers[0] = new SliceArray<kanzi::byte>(new kanzi::byte[bufSize], bufSize, 0);
+    // The input buffers are allocated on first use (see allocateBuffer)
+    _buffers = new SliceArray<kanzi::byte>*[2 * _slots];
 
-    for (int i = 1; i < 2 * _jobs; i++)
+    for (int i = 0; i < 2 * _slots; i++)
        _buffers[i] = new SliceArray<kanzi::byte>(nullptr, 0, 0);
+
+    _transforms = new TransformCache<kanzi::byte>[_slots];
+    _nbArenas = min(_jobs, _slots);
+    _arenas = new ModelArena[_nbArenas];
 }
 
 CompressedOutputStream::CompressedOutputStream(OutputStream& os, Context& ctx, bool headerless)
     : OutputStream(os.rdbuf())
     , _ctx(ctx)
 {
-    int tasks = ctx.getInt("jobs", 1);
+    int tasks = ctx.getInt(Context::JOBS, 1);
 
 #ifdef CONCURRENCY_ENABLED
     if ((tasks <= 0) || (tasks > MAX_CONCURRENCY)) {
@@ -164,7 +183,7 @@ CompressedOutputStream::CompressedOutputStream(OutputStream& os, Context& ctx, b
         throw invalid_argument("The number of jobs is limited to 1 in this version");
 #endif
 
-    int blockSize = ctx.getInt("blockSize");
+    int blockSize = ctx.getInt(Context::BLOCK_SIZE);
 
     if (blockSize > MAX_BITSTREAM_BLOCK_SIZE) {
         std::stringstream ss;
@@ -181,10 +200,27 @@ CompressedOutputStream::CompressedOutputStream(OutputStream& os, Context& ctx, b
     if ((blockSize & -16) != blockSize)
         throw invalid_argument("The block size must be a multiple of 16");
 
+    // Memory budget without a plan (see BlockPlanner): limit the number of
+    // blocks in flight and use cheaper codecs if needed. The plan is stored
+    // in the caller context.
+    if ((ctx.getLong("maxMemory", 0) > 0) && (ctx.has("blockTasks") == false)) {
+        BlockPlanner::plan(ctx);
+        _ctx = ctx;
+        blockSize = _ctx.getInt(Context::BLOCK_SIZE);
+    }
+
     _inputSize = ctx.getLong("fileSize", 0);
     const int nbBlocks = (_inputSize == 0) ? 0 : int((_inputSize + int64(blockSize - 1)) / int64(blockSize));
     _nbInputBlocks = min(nbBlocks, MAX_CONCURRENCY - 1);
     _jobs = tasks;
+
+    // Reorder buffer: more block slots than jobs. Workers move on to the next
+    // blocks while a slow block is still pending, blocks are emitted in order.
+
+    // The number of blocks encoded concurrently may be limited (EG. by the
+    // memory budget, see BlockPlanner). The other jobs go to the blocks.
+    const int blockTasks = _ctx.getInt("blockTasks", 0);
+    _slots = BlockPlanner::getBlockSlots((blockTasks > 0) ? min(blockTasks, _jobs) : _jobs);
     _blockId = 0;
     _inputBlockId = 0;
     _bufferId = 0;
@@ -193,13 +229,61 @@ CompressedOutputStream::CompressedOutputStream(OutputStream& os, Context& ctx, b
     _initialized = 0;
     _closed = 0;
     _headless = headerless;
-    _obs = new DefaultOutputBitStream(os, DEFAULT_BUFFER_SIZE);
-    _ctx.putInt("bsVersion", BITSTREAM_FORMAT_VERSION);
-    string entropyCodec = ctx.getString("entropy");
-    string transform = ctx.getString("transform");
+
+    // The block index is advertised in the header, so it requires one
+    _blockIndex = (_headless == false) && (ctx.getInt("blockIndex", 0) != 0);
+
+    // A short input does not need the default bitstream buffer
+    const int obsSize = ((_inputSize > 0) && (_inputSize < int64(DEFAULT_BUFFER_SIZE))) ?
+        int(_inputSize + 1023) & -1024 : DEFAULT_BUFFER_SIZE;
+    _obs = new DefaultOutputBitStream(os, uint(obsSize));
+    _ctx.putInt(Context::BS_VERSION, BITSTREAM_FORMAT_VERSION);
+    string entropyCodec = _ctx.getString("entropy");
+    string transform = _ctx.getString("transform");
     _entropyType = EntropyEncoderFactory::getType(entropyCodec.c_str());
     _transformType = TransformFactory<kanzi::byte>::getType(transform.c_str());
-    int checksum = ctx.getInt("checksum", 0);
+    int checksum = ctx.getInt(Context::CHECKSUM, 0);
+
+    // Solid mode: number of lanes, negative for one lane per job. Ignored
+    // by the entropy codecs without a context model.
+    _lanes = ctx.getInt("solid", 0);
+    _models = nullptr;
+
+    if (_lanes < 0)
+        _lanes = _jobs;
+
+    if (_lanes > MAX_CONCURRENCY) {
+        stringstream ss;
+        ss << "The number of solid lanes must be in [1.." << MAX_CONCURRENCY << "], got " << _lanes;
+        throw invalid_argument(ss.str());
+    }
+
+    if (SolidModel::isSupported(_entropyType) == false)
+        _lanes = 0;
+
+    // Per-block choice of the transforms and entropy codec among candidates
+    // (see BlockSelector). The models of solid lanes need a fixed codec.
+    const string candidates = _ctx.getString("autoCodecs", "");
+    _selector = nullptr;
+
+    if (candidates.length() > 0) {
+        if (_lanes > 0)
+            throw invalid_argument("Solid mode is not compatible with the per-block choice of codecs");
+
+        _selector = new BlockSelector(candidates); // throws on error
+    }
+
+    if (_lanes > 0) {
+        // A block starts once the previous block of its lane has been emitted
+        // (see processBuffer): there are no more block slots than lanes.
+        _slots = min(_slots, _lanes);
+        _models = new SolidModel[_lanes];
+    }
+
+    // A short input does not need more block slots (buffers and transforms)
+    // than blocks
+    if (_nbInputBlocks > 0)
+        _slots = min(_slots, _nbInputBlocks);
 
     if (checksum == 0) {
        _hasher32 = nullptr;
@@ -218,30 +302,42 @@ CompressedOutputStream::CompressedOutputStream(OutputStream& os, Context& ctx, b
     }
 
 #ifdef CONCURRENCY_ENABLED
-    _futures.resize(_jobs);
+    _futures.resize(_slots);
 #endif
 
-    _jobsPerTask.resize(_jobs);
+    _jobsPerTask.resize(_slots, 1);
 
     // Assign optimal number of tasks and jobs per task (if the number of blocks is available)
     if (_jobs > 1) {
         // Limit the number of tasks if there are fewer blocks that _jobs
         // It allows more jobs per task and reduces memory usage.
         int nbTasks = (_nbInputBlocks != 0) ? min(_nbInputBlocks, _jobs) : _jobs;
+        nbTasks = min(nbTasks, _slots);
+
+        if (blockTasks > 0)
+            nbTasks = min(nbTasks, blockTasks);
+
         Global::computeJobsPerTask(&_jobsPerTask[0], _jobs, nbTasks);
+
+        // Extra slots (reorder buffer) share the jobs in the same way
+        for (int i = nbTasks; i < _slots; i++)
+            _jobsPerTask[i] = _jobsPerTask[i % nbTasks];
     }
     else {
         _jobsPerTask[0] = 1;
     }
 
-    _buffers = new SliceArray<kanzi::byte>*[2 * _jobs];
-
-    // Allocate first buffer and add padding for incompressible blocks
-    const int bufSize = max(_blockSize + (_blockSize >> 3), DEFAULT_BUFFER_SIZE);
-    _buffers[0] = new SliceArray<kanzi::byte>(new kanzi::byte[bufSize], bufSize, 0);
+    // The input buffers are allocated on first use (see allocateBuffer):
+    // writeNoCopy() does not need them
+    _buffers = new SliceArray<kanzi::byte>*[2 * _slots];
 
-    for (int i = 1; i < 2 * _jobs; i++)
+    for (int i = 0; i < 2 * _slots; i++)
        _buffers[i] = new SliceArray<kanzi::byte>(nullptr, 0, 0);
+
+    _transforms = new TransformCache<kanzi::byte>[_slots];
+    _trials = (_selector != nullptr) ? new TransformCache<kanzi::byte>[_slots * _selector->size()] : nullptr;
+    _nbArenas = min(_jobs, _slots);
+    _arenas = new ModelArena[_nbArenas];
 }
 
 CompressedOutputStream::~CompressedOutputStream()
@@ -253,7 +349,7 @@ CompressedOutputStream::~CompressedOutputStream()
         // Ignore and continue
     }
 
-    for (int i = 0; i < 2 * _jobs; i++) {
+    for (int i = 0; i < 2 * _slots; i++) {
         if (_buffers[i]->_array != nullptr)
            delete[] _buffers[i]->_array;
 
@@ -261,6 +357,18 @@ CompressedOutputStream::~CompressedOutputStream()
     }
 
     delete[] _buffers;
+    delete[] _transforms;
+    delete[] _arenas;
+
+    if (_trials != nullptr)
+        delete[] _trials;
+
+    if (_models != nullptr)
+        delete[] _models;
+
+    if (_selector != nullptr)
+        delete _selector;
+
     delete _obs;
 
     if (_hasher32 != nullptr) {
@@ -316,11 +424,33 @@ void CompressedOutputStream::writeHeader()
             throw IOException("Cannot write size of input to header", Error::ERR_WRITE_FILE);
     }
 
+    // Flags: block index present (1 bit), solid lanes (7 bits, 0 if not solid)
+    if (_obs->writeBits(_blockIndex ? 1 : 0, 1) != 1)
+        throw IOException("Cannot write flags to header", Error::ERR_WRITE_FILE);
+
+    if (_obs->writeBits(uint64(_lanes), 7) != 7)
+        throw IOException("Cannot write flags to header", Error::ERR_WRITE_FILE);
+
+    // Dictionary present (1 bit) followed by the dictionary ID (32 bits)
+    const Dictionary* dict = _ctx.getDictionary();
+
+    if (_obs->writeBits(dict != nullptr ? 1 : 0, 1) != 1)
+        throw IOException("Cannot write flags to header", Error::ERR_WRITE_FILE);
+
+    // Codecs chosen per block (1 bit): the block headers carry them
+    if (_obs->writeBits(_selector != nullptr ? 1 : 0, 1) != 1)
+        throw IOException("Cannot write flags to header", Error::ERR_WRITE_FILE);
+
     const uint64 padding = 0;
 
-    if (_obs->writeBits(padding, 15) != 15)
+    if (_obs->writeBits(padding, 5) != 5)
         throw IOException("Cannot write padding to header", Error::ERR_WRITE_FILE);
 
+    if (dict != nullptr) {
+        if (_obs->writeBits(dict->getId(), 32) != 32)
+            throw IOException("Cannot write dictionary ID to header", Error::ERR_WRITE_FILE);
+    }
+
     uint32 seed = 0x01030507 * BITSTREAM_FORMAT_VERSION; // no const to avoid VS2008 warning
     const uint32 HASH = 0x1E35A7BD;
     uint32 cksum = HASH * seed;
@@ -335,6 +465,18 @@ void CompressedOutputStream::writeHeader()
         cksum ^= (HASH * uint32(~_inputSize));
     }
 
+    // Decoders without solid mode support reject solid streams
+    if (_lanes != 0)
+        cksum ^= (HASH * uint32(~_lanes));
+
+    // Decoders without dictionary support reject streams with a dictionary
+    if (dict != nullptr)
+        cksum ^= (HASH * uint32(~dict->getId()));
+
+    // Decoders without per-block codecs reject streams that use them
+    if (_selector != nullptr)
+        cksum ^= (HASH * uint32(~AUTO_CODECS_MAGIC));
+
     cksum = (cksum >> 23) ^ (cksum >> 3);
 
     if (_obs->writeBits(uint64(cksum & 0xFFFFFFu), 24) != 24)
@@ -370,6 +512,7 @@ ostream& CompressedOutputStream::write(const char* data, streamsize length)
         const streamsize lenChunk = min(remaining, streamsize(_bufferThreshold - _buffers[_bufferId]->_index));
 
         if (lenChunk > 0) {
+            allocateBuffer();
             memcpy(&_buffers[_bufferId]->_array[_buffers[_bufferId]->_index], &data[off], size_t(lenChunk));
             _buffers[_bufferId]->_index += int(lenChunk);
             off += lenChunk;
@@ -389,6 +532,132 @@ ostream& CompressedOutputStream::write(const char* data, streamsize length)
 }
 
 
+bool CompressedOutputStream::wouldBlock(streamsize length) const
+{
+#ifdef CONCURRENCY_ENABLED
+    // With one slot, the task is deferred and runs on the calling thread
+    if ((length <= 0) || (_slots == 1) || (_bufferThreshold <= 0) || (LOAD_ATOMIC(_closed) == 1))
+        return false;
+
+    // Each block completed by the data moves the stream to the next slot,
+    // where write() waits for the block still encoding (if any)
+    const streamsize nbBlocks = (streamsize(_buffers[_bufferId]->_index) + length) / streamsize(_bufferThreshold);
+
+    if (nbBlocks >= streamsize(_slots))
+        return true;
+
+    for (int i = 1; i <= int(nbBlocks); i++) {
+        const int id = (_bufferId + i) % _slots;
+
+        if ((_futures[id].valid() == true) &&
+            (_futures[id].wait_for(std::chrono::seconds(0)) == std::future_status::timeout))
+            return true;
+    }
+#else
+    (void) length;
+#endif
+
+    return false;
+}
+
+
+// Full blocks are encoded straight from the caller data instead of being
+// copied into the block buffers (single transform chains only, see
+// EncodingTask::run). The data must remain valid until close() returns.
+// Blocks start at the same positions as with write().
+ostream& CompressedOutputStream::writeNoCopy(const char* data, streamsize length)
+{
+    return writeBlocks(data, length, false);
+}
+
+
+// Write full blocks from the caller data. If 'last' is true, no data follows:
+// the last partial block is also encoded from the caller data, else it is
+// copied to the current buffer.
+ostream& CompressedOutputStream::writeBlocks(const char* data, streamsize length, bool last)
+{
+    if (length < 0)
+       throw IOException("Invalid buffer size");
+
+    streamsize off = 0;
+
+    // Complete the pending block (if any)
+    if (_buffers[_bufferId]->_index > 0) {
+        off = min(length, streamsize(_bufferThreshold - _buffers[_bufferId]->_index));
+        write(data, off);
+    }
+
+    while ((_bufferThreshold > 0) && (length - off >= streamsize(_bufferThreshold))) {
+        processBuffer(reinterpret_cast<const kanzi::byte*>(&data[off]), _bufferThreshold);
+        off += streamsize(_bufferThreshold);
+    }
+
+    if (off < length) {
+        if ((last == true) && (_bufferThreshold > 0))
+            processBuffer(reinterpret_cast<const kanzi::byte*>(&data[off]), int(length - off));
+        else
+            write(&data[off], length - off); // copy the last partial block
+    }
+
+    return *this;
+}
+
+
+// One shot compression of a memory buffer: no intermediate output stream and
+// no copy of the input to the block buffers, including the last partial block
+// (except for sequences of several transforms, see EncodingTask::run). Small
+// inputs use a block size matching their size to limit the memory allocated
+// by both sides.
+int64 CompressedOutputStream::compressBuffer(const kanzi::byte* src, int64 srcLength,
+    kanzi::byte* dst, int64 dstCapacity, Context& ctx, bool headerless)
+{
+    if ((srcLength < 0) || ((src == nullptr) && (srcLength != 0)))
+        throw invalid_argument("Invalid source buffer");
+
+    if ((dst == nullptr) || (dstCapacity <= 0))
+        throw invalid_argument("Invalid destination buffer");
+
+    Context cctx(ctx);
+    cctx.putLong("fileSize", srcLength);
+    cctx.putInt("blockIndex", 0); // not accounted for by getMaxCompressedLength()
+
+    if (headerless == false) {
+        const int blockSize = ctx.getInt(Context::BLOCK_SIZE);
+
+        if (srcLength < int64(blockSize))
+            cctx.putInt(Context::BLOCK_SIZE, max(int(srcLength + 15) & -16, MIN_BITSTREAM_BLOCK_SIZE));
+    }
+
+    ofixedbuf buf(reinterpret_cast<char*>(dst), size_t(dstCapacity));
+    ostream os(&buf);
+    CompressedOutputStream cos(os, cctx, headerless);
+
+    try {
+        cos.writeBlocks(reinterpret_cast<const char*>(src), streamsize(srcLength), true);
+        cos.close();
+    }
+    catch (const exception&) {
+        if (os.fail() == true)
+            throw IOException("The destination buffer is too small", Error::ERR_WRITE_FILE);
+
+        throw;
+    }
+
+    return int64(buf.written());
+}
+
+
+int64 CompressedOutputStream::getMaxCompressedLength(int64 srcLength, int blockSize)
+{
+    if ((srcLength < 0) || (blockSize <= 0))
+        return -1;
+
+    // Blocks that do not compress are emitted as copy blocks
+    const int64 nbBlocks = max((srcLength + int64(blockSize - 1)) / int64(blockSize), int64(1));
+    return int64(MAX_HEADER_SIZE) + nbBlocks * int64(MAX_BLOCK_OVERHEAD) + srcLength + 5;
+}
+
+
 void CompressedOutputStream::close()
 {
     if (LOAD_ATOMIC(_closed) == 1)
@@ -401,20 +670,22 @@ void CompressedOutputStream::close()
         submitBlock();
 
 #ifdef CONCURRENCY_ENABLED
-        // Wait for ALL pending tasks to complete
-        for (int i = 0; i < _jobs; i++) {
-            if (_futures[i].valid()) {
-                EncodingTaskResult res = _futures[i].get();
-
-                if (res._error != 0)
-                    throw IOException(res._msg, res._error);
-            }
-        }
+        // Wait for ALL pending tasks to complete and emit the blocks in order
+        for (int i = 1; i <= _slots; i++)
+            emitBlock((_bufferId + i) % _slots);
 #endif
 
-        // Write last block: length-3 (0) and 0 bits
-        _obs->writeBits(uint64(0), 5);
-        _obs->writeBits(uint64(0), 3);
+        // Write last block: byte aligned length (0)
+        const uint pad = uint(8 - (_obs->written() & 7)) & 7;
+
+        if (pad != 0)
+            _obs->writeBits(uint64(0), pad);
+
+        _obs->writeBits(uint64(0), 32);
+
+        if (_blockIndex == true)
+            writeBlockIndex();
+
         _obs->close();
     }
     catch (const exception& e) {
@@ -422,13 +693,31 @@ void CompressedOutputStream::close()
         errMsg = e.what();
     }
 
+#ifdef CONCURRENCY_ENABLED
+    // On error, make sure that no task still uses the buffers (or the caller data)
+    for (int i = 0; i < _slots; i++) {
+        if (_futures[i].valid() == false)
+            continue;
+
+        try {
+            if (_pool != nullptr)
+                _pool->get(_futures[i]);
+            else
+                _futures[i].get();
+        }
+        catch (...) {
+            // Ignore, an error is already reported
+        }
+    }
+#endif
+
     STORE_ATOMIC(_closed, 1);
 
     // Force subsequent writes to trigger submitBlock immediately
     _bufferThreshold = 0;
 
     // Release resources
-    for (int i = 0; i < 2 * _jobs; i++) {
+    for (int i = 0; i < 2 * _slots; i++) {
         if (_buffers[i]->_array != nullptr)
            delete[] _buffers[i]->_array;
 
@@ -437,6 +726,20 @@ void CompressedOutputStream::close()
         _buffers[i]->_index = 0;
     }
 
+    for (int i = 0; i < _slots; i++)
+        _transforms[i].clear();
+
+    if (_trials != nullptr) {
+        for (int i = 0; i < _slots * _selector->size(); i++)
+            _trials[i].clear();
+    }
+
+    for (int i = 0; i < _nbArenas; i++)
+        _arenas[i].clear();
+
+    for (int i = 0; i < _lanes; i++)
+        _models[i].reset();
+
     if (errMsg != "")
        throw IOException(errMsg, Error::ERR_WRITE_FILE);
 
@@ -444,43 +747,77 @@ void CompressedOutputStream::close()
 }
 
 
-void CompressedOutputStream::processBuffer()
+// Block index trailer (byte aligned, located after the last block):
+// per block: offset (64 bits), compressed size in bits (64 bits),
+//            original size (32 bits), checksum or 0 (64 bits)
+// footer:    number of blocks (32 bits), index offset (64 bits), magic (32 bits)
+// Offsets are bit positions relative to the start of the bitstream.
+void CompressedOutputStream::writeBlockIndex()
 {
-    submitBlock();
-    _bufferId = (_bufferId + 1) % _jobs;
+    const uint pad = uint(8 - (_obs->written() & 7)) & 7;
 
-#ifdef CONCURRENCY_ENABLED
-    if (_futures[_bufferId].valid()) {
-        EncodingTaskResult res = _futures[_bufferId].get();
+    if (pad != 0)
+        _obs->writeBits(uint64(0), pad);
+
+    const uint64 indexOffset = _obs->written();
 
-        if (res._error != 0)
-            throw IOException(res._msg, res._error);
+    for (size_t i = 0; i < _index.size(); i++) {
+        _obs->writeBits(_index[i]._offset, 64);
+        _obs->writeBits(_index[i]._compressedBits, 64);
+        _obs->writeBits(uint64(_index[i]._originalSize), 32);
+        _obs->writeBits(_index[i]._checksum, 64);
     }
-#endif
 
-    const int bSize = _blockSize + (_blockSize >> 6);
-    const int bufSize = max(bSize, 65536);
+    _obs->writeBits(uint64(_index.size()), 32);
+    _obs->writeBits(indexOffset, 64);
+
+    if (_obs->writeBits(uint64(BLOCK_INDEX_MAGIC), 32) != 32)
+        throw IOException("Cannot write block index", Error::ERR_WRITE_FILE);
+}
 
-    if (_buffers[_bufferId]->_length == 0) {
-        if (_buffers[_bufferId]->_array != nullptr)
-            delete[] _buffers[_bufferId]->_array;
 
-        _buffers[_bufferId]->_array = new kanzi::byte[bufSize];
-        _buffers[_bufferId]->_length = bufSize;
-    }
+// Allocate the buffer of the current slot if needed (blocks written from
+// the caller data do not use it)
+void CompressedOutputStream::allocateBuffer()
+{
+    if (_buffers[_bufferId]->_length >= _bufferThreshold)
+        return;
+
+    if (_buffers[_bufferId]->_array != nullptr)
+        delete[] _buffers[_bufferId]->_array;
+
+    const int bufSize = _blockSize + (_blockSize >> 6);
+    _buffers[_bufferId]->_array = new kanzi::byte[bufSize];
+    _buffers[_bufferId]->_length = bufSize;
+}
+
+
+void CompressedOutputStream::processBuffer(const kanzi::byte* input, int length)
+{
+    submitBlock(input, length);
+    _bufferId = (_bufferId + 1) % _slots;
+
+#ifdef CONCURRENCY_ENABLED
+    // Emit the oldest block (encoded in the buffer to reuse), then the
+    // following blocks already encoded
+    emitBlock(_bufferId);
+    emitReadyBlocks();
+#endif
 
     _buffers[_bufferId]->_index = 0;
 }
 
 
-void CompressedOutputStream::submitBlock()
+// Submit the block in the current buffer, or the 'length' bytes at 'input'
+// (caller data) if not null.
+void CompressedOutputStream::submitBlock(const kanzi::byte* input, int length)
 {
     if (LOAD_ATOMIC(_closed) == 1)
         throw IOException("Stream closed", Error::ERR_WRITE_FILE);
 
     writeHeader(); // Ensure header is written before first block processing
 
-    const int dataLength = _buffers[_bufferId]->_index;
+    const int dataLength = (input != nullptr) ? length : _buffers[_bufferId]->_index;
 
     if (dataLength == 0)
         return;
@@ -488,26 +825,47 @@ void CompressedOutputStream::submitBlock()
     // Increment input block counter (1-based for the Task logic)
     _inputBlockId++;
 
+    if (_listeners.size() > 0) {
+        WallTimer timer;
+        BlockPlanner planner(_transformType, _entropyType, _jobsPerTask[_bufferId], 0);
+
+        if (_selector != nullptr) {
+            vector<uint64> tTypes;
+            vector<short> eTypes;
+
+            for (int i = 0; i < _selector->size(); i++) {
+                tTypes.push_back(_selector->getTransformType(i));
+                eTypes.push_back(_selector->getEntropyType(i));
+            }
+
+            planner.setCandidates(tTypes, eTypes);
+        }
+
+        Event evt(Event::MEMORY_INFO, _inputBlockId, planner.getBlockMemory(dataLength), timer.getCurrentTime());
+        CompressedOutputStream::notifyListeners(_listeners, evt);
+    }
+
     Context copyCtx(_ctx);
-    copyCtx.putLong("tType", _transformType);
-    copyCtx.putInt("eType", _entropyType);
-    copyCtx.putInt("blockId", _inputBlockId);
-    copyCtx.putInt("size", dataLength);
-    copyCtx.putInt("jobs", _jobsPerTask[_bufferId]);
+    copyCtx.putLong(Context::TRANSFORM_TYPE, _transformType);
+    copyCtx.putInt(Context::ENTROPY_TYPE, _entropyType);
+    copyCtx.putInt(Context::BLOCK_ID, _inputBlockId);
+    copyCtx.putInt(Context::SIZE, dataLength);
+    copyCtx.putInt(Context::JOBS, _jobsPerTask[_bufferId]);
 
     // Prepare the buffer for processing
     _buffers[_bufferId]->_index = 0;
 
     // Create the task
-    // Note: Input is _buffers[_bufferId], Output is _buffers[_jobs + _bufferId]
+    // Note: Input is _buffers[_bufferId] (or caller data), Output is _buffers[_slots + _bufferId]
     EncodingTask<EncodingTaskResult>* task = new EncodingTask<EncodingTaskResult>(
         _buffers[_bufferId],
-        _buffers[_jobs + _bufferId],
-        _obs, _hasher32, _hasher64,
-#ifdef CONCURRENCY_ENABLED
-        &_blockMutex, &_blockCondition,
-#endif
-        &_blockId, _listeners, copyCtx);
+        _buffers[_slots + _bufferId],
+        input,
+        _hasher32, _hasher64,
+        &_transforms[_bufferId], _arenas, _nbArenas,
+        (_lanes > 0) ? &_models[(_inputBlockId - 1) % _lanes] : nullptr,
+        _selector, (_trials != nullptr) ? &_trials[_bufferId * _selector->size()] : nullptr,
+        _listeners, copyCtx);
 
 #ifdef CONCURRENCY_ENABLED
     std::shared_ptr<EncodingTask<EncodingTaskResult>> safeTask(task);
@@ -517,28 +875,150 @@ void CompressedOutputStream::submitBlock()
     };
 
     if (_pool == nullptr) {
-        _futures[_bufferId] = std::async(std::launch::async, taskWrapper);
+        // With one block slot, the block is emitted right after submission: run
+        // the task on the calling thread instead of starting a new thread.
+        if (_slots > 1)
+            reserveJobs(_jobsPerTask[_bufferId]);
+
+        _futures[_bufferId] = std::async((_slots == 1) ? std::launch::deferred : std::launch::async, taskWrapper);
     }
     else {
-        // REQUIRES: Pool size > Number of concurrent tasks to avoid deadlock
         _futures[_bufferId] = _pool->schedule(taskWrapper);
     }
 #else
     // Synchronous fallback
-    try {
-        EncodingTaskResult res = task->run();
+    EncodingTaskResult res;
 
-        if (res._error != 0)
-           throw IOException(res._msg, res._error);
+    try {
+        res = task->run();
     } catch (...) {
         delete task;
         throw;
     }
 
     delete task;
+    emitBlock(_bufferId, res);
 #endif
 }
 
+
+#ifdef CONCURRENCY_ENABLED
+// Wait for the task encoding in the buffer (if any) and emit its block
+void CompressedOutputStream::emitBlock(int bufferId)
+{
+    if (_futures[bufferId].valid() == false)
+        return;
+
+    // Run pending tasks while waiting when called from a pool worker
+    EncodingTaskResult res = (_pool != nullptr) ? _pool->get(_futures[bufferId]) :
+        _futures[bufferId].get();
+    emitBlock(bufferId, res);
+}
+
+
+// Without a pool, each task runs on its own thread: wait for the oldest
+// tasks until 'jobs' more jobs fit in _jobs. The other slots only hold
+// encoded blocks waiting to be emitted in order.
+void CompressedOutputStream::reserveJobs(int jobs)
+{
+    for (int i = 1; i < _slots; i++) {
+        int running = 0;
+
+        for (int j = 0; j < _slots; j++) {
+            if ((_futures[j].valid() == true) &&
+                (_futures[j].wait_for(std::chrono::seconds(0)) == std::future_status::timeout))
+                running += _jobsPerTask[j];
+        }
+
+        if (running + jobs <= _jobs)
+            return;
+
+        const int id = (_bufferId + i) % _slots;
+
+        if (_futures[id].valid() == true)
+            _futures[id].wait();
+    }
+}
+
+
+// Emit the encoded blocks in order, starting from the oldest one, and stop
+// at the first block still being encoded.
+void CompressedOutputStream::emitReadyBlocks()
+{
+    for (int i = 0; i < _slots; i++) {
+        const int id = (_bufferId + i) % _slots;
+
+        // Already emitted or not used yet
+        if (_futures[id].valid() == false)
+            continue;
+
+        if (_futures[id].wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+
+        emitBlock(id);
+    }
+}
+#endif
+
+
+// Write the block encoded in the buffer to the shared bitstream.
+// Blocks are emitted by the stream, in order, once their task is complete.
+void CompressedOutputStream::emitBlock(int bufferId, const EncodingTaskResult& res)
+{
+    if (res._error != 0)
+        throw IOException(res._msg, res._error);
+
+    if (res._written == 0)
+        return;
+
+    WallTimer timer;
+    SliceArray<kanzi::byte>* data = _buffers[bufferId];
+    const uint64 ww = (res._written + 7) >> 3;
+
+    // Since bsVersion 7, each block starts on a byte boundary and its size
+    // in bytes is emitted on 32 bits. A reader can locate the next block
+    // without decoding the current one.
+    const uint pad = uint(8 - (_obs->written() & 7)) & 7;
+
+    if (pad != 0)
+        _obs->writeBits(uint64(0), pad);
+
+#if !defined(_MSC_VER) || _MSC_VER > 1500
+    const int64 blockOffset = _obs->tell();
+#endif
+    const uint64 blockStart = _obs->written();
+    _obs->writeBits(ww, 32);
+
+    // Emit data to shared bitstream
+    uint64 remaining = res._written;
+
+    for (uint n = 0; remaining > 0; ) {
+        uint chkSize = uint(min(remaining, uint64(1) << 30));
+        _obs->writeBits(&data->_array[n], chkSize);
+        n += ((chkSize + 7) >> 3);
+        remaining -= uint64(chkSize);
+    }
+
+    if (_blockIndex == true)
+        _index.push_back(BlockIndexEntry(blockStart, _obs->written() - blockStart, uint(res._blockLength), res._checksum));
+
+    STORE_ATOMIC(_blockId, res._blockId);
+
+    if (_listeners.size() > 0) {
+        // Notify after entropy
+        Event evt1(Event::AFTER_ENTROPY, res._blockId, int64(ww), timer.getCurrentTime(), res._checksum, res._hashType);
+        CompressedOutputStream::notifyListeners(_listeners, evt1);
+
+#if !defined(_MSC_VER) || _MSC_VER > 1500
+        if (_ctx.getInt(Context::VERBOSITY, 0) > 4) {
+            Event evt2(Event::BLOCK_INFO, res._blockId,
+               int64(ww), timer.getCurrentTime(), res._checksum, res._hashType, blockOffset, uint8(res._skipFlags));
+            CompressedOutputStream::notifyListeners(_listeners, evt2);
+        }
+#endif
+    }
+}
+
 ostream& CompressedOutputStream::put(char c)
 {
     try {
@@ -547,32 +1027,18 @@ ostream& CompressedOutputStream::put(char c)
             submitBlock();
 
             // Rotate to next buffer
-            _bufferId = (_bufferId + 1) % _jobs;
+            _bufferId = (_bufferId + 1) % _slots;
 
             // If concurrent, wait if the target buffer is still busy
 #ifdef CONCURRENCY_ENABLED
-            if (_futures[_bufferId].valid()) {
-                EncodingTaskResult res = _futures[_bufferId].get();
-
-                if (res._error != 0)
-                    throw IOException(res._msg, res._error);
-            }
+            emitBlock(_bufferId);
+            emitReadyBlocks();
 #endif
 
-            // Allocation / Reset logic
-            const int bufSize = max(_blockSize + (_blockSize >> 6), 65536);
-
-            if (_buffers[_bufferId]->_length == 0) {
-                 if (_buffers[_bufferId]->_array != nullptr)
-                     delete[] _buffers[_bufferId]->_array;
-
-                _buffers[_bufferId]->_array = new kanzi::byte[bufSize];
-                _buffers[_bufferId]->_length = bufSize;
-            }
-
             _buffers[_bufferId]->_index = 0;
         }
 
+        allocateBuffer();
         _buffers[_bufferId]->_array[_buffers[_bufferId]->_index++] = kanzi::byte(c);
         return *this;
     }
@@ -590,55 +1056,54 @@ void CompressedOutputStream::notifyListeners(vector<Listener<Event>*>& listeners
 
 template <class T>
 EncodingTask<T>::EncodingTask(SliceArray<kanzi::byte>* iBuffer, SliceArray<kanzi::byte>* oBuffer,
-    DefaultOutputBitStream* obs, XXHash32* hasher32, XXHash64* hasher64,
-#ifdef CONCURRENCY_ENABLED
-    std::mutex* blockMutex, std::condition_variable* blockCondition,
-#endif
-    atomic_int_t* processedBlockId, vector<Listener<Event>*>& listeners,
-    const Context& ctx)
-    : _obs(obs)
-    , _listeners(listeners)
+    const kanzi::byte* input, XXHash32* hasher32, XXHash64* hasher64, TransformCache<kanzi::byte>* transforms,
+    ModelArena* arenas, int nbArenas, SolidModel* model, const BlockSelector* selector,
+    TransformCache<kanzi::byte>* trials, vector<Listener<Event>*>& listeners, const Context& ctx)
+    : _listeners(listeners)
     , _ctx(ctx)
 {
     _data = iBuffer;
     _buffer = oBuffer;
+    _input = input;
     _hasher32 = hasher32;
     _hasher64 = hasher64;
-#ifdef CONCURRENCY_ENABLED
-    _blockMutex = blockMutex;
-    _blockCondition = blockCondition;
-#endif
-    _processedBlockId = processedBlockId;
+    _transforms = transforms;
+    _arenas = arenas;
+    _nbArenas = nbArenas;
+    _model = model;
+    _selector = selector;
+    _trials = trials;
 }
 
+// Return the original block after entropy coding: caller data, transform output
+// if no transform applied, else the inverse of the transform output (rebuilt in
+// the transform buffer). Return null if the block cannot be rebuilt.
 template <class T>
-void EncodingTask<T>::storeProcessedBlockId(int value)
+const kanzi::byte* EncodingTask<T>::getOriginalBlock(TransformSequence<kanzi::byte>* transform,
+    int blockLength, int postTransformLength)
 {
-#ifdef CONCURRENCY_ENABLED
-    {
-        std::lock_guard<std::mutex> lock(*_blockMutex);
-        STORE_ATOMIC(*_processedBlockId, value);
-    }
+    if (_input != nullptr)
+        return _input;
 
-    _blockCondition->notify_all();
-#else
-    STORE_ATOMIC(*_processedBlockId, value);
-#endif
-}
+    if (transform->getSkipFlags() == SKIP_MASK)
+        return _buffer->_array;
 
-template <class T>
-void EncodingTask<T>::fetchAddProcessedBlockId()
-{
-#ifdef CONCURRENCY_ENABLED
-    {
-        std::lock_guard<std::mutex> lock(*_blockMutex);
-        FETCH_ADD_ATOMIC(*_processedBlockId, 1);
+    kanzi::byte* buf = new kanzi::byte[max(_buffer->_length, blockLength)];
+    SliceArray<kanzi::byte> in(_buffer->_array, _buffer->_length, 0);
+    SliceArray<kanzi::byte> out(buf, max(_buffer->_length, blockLength), 0);
+    bool res = false;
+
+    try {
+        res = transform->inverse(in, out, postTransformLength) && (out._index == blockLength);
+    }
+    catch (const exception&) {
     }
 
-    _blockCondition->notify_all();
-#else
-    FETCH_ADD_ATOMIC(*_processedBlockId, 1);
-#endif
+    if (res == true)
+        memcpy(&_buffer->_array[0], &buf[0], size_t(blockLength));
+
+    delete[] buf;
+    return (res == true) ? _buffer->_array : nullptr;
 }
 
 // Encode mode + transformed entropy coded data
@@ -648,36 +1113,44 @@ void EncodingTask<T>::fetchAddProcessedBlockId()
 //      | 0b0001xxxx => transform sequence skip flags (1 means skip)
 //  case more than 4 transforms
 //      | 0b0yy00000 0bxxxxxxxx => transform sequence skip flags in next kanzi::byte (1 means skip)
+// Codecs chosen per block (see BlockSelector): the mode (and skip flags) of
+// the blocks that are not copied are followed by the transform types (48 bits)
+// and the entropy type (5 bits + 3 bits of padding)
 template <class T>
 T EncodingTask<T>::run()
 {
-    const int blockId = _ctx.getInt("blockId");
-    const int blockLength = _ctx.getInt("size");
-    TransformSequence<kanzi::byte>* transform = nullptr;
+    const int blockId = _ctx.getInt(Context::BLOCK_ID);
+    const int blockLength = _ctx.getInt(Context::SIZE);
     EntropyEncoder* ee = nullptr;
+    ModelArena* arena = nullptr;
 
     try {
         if (blockLength == 0) {
             // Last block (only block with 0 length)
-            fetchAddProcessedBlockId();
             return T(blockId, 0, "Success");
         }
 
         kanzi::byte mode = kanzi::byte(0);
         int postTransformLength = blockLength;
         uint64 checksum = 0;
-        uint64 tType = _ctx.getLong("tType");
-        short eType = short(_ctx.getInt("eType"));
+        uint64 tType = _ctx.getLong(Context::TRANSFORM_TYPE);
+        short eType = short(_ctx.getInt(Context::ENTROPY_TYPE));
         Event::HashType hashType = Event::NO_HASH;
         WallTimer timer;
 
+        // The block is read from the caller data (see writeNoCopy) or from the buffer slot.
+        // The encoded block is written to the buffer slot. The caller data is read only.
+        SliceArray<kanzi::byte> input((_input != nullptr) ? const_cast<kanzi::byte*>(_input) : _data->_array,
+            (_input != nullptr) ? blockLength : _data->_length,
+            (_input != nullptr) ? 0 : _data->_index);
+
         // Compute block checksum
         if (_hasher32 != nullptr) {
-            checksum = _hasher32->hash(&_data->_array[_data->_index], blockLength);
+            checksum = _hasher32->hash(&input._array[input._index], blockLength);
             hashType = Event::SIZE_32;
         }
         else if (_hasher64 != nullptr) {
-            checksum = _hasher64->hash(&_data->_array[_data->_index], blockLength);
+            checksum = _hasher64->hash(&input._array[input._index], blockLength);
             hashType = Event::SIZE_64;
         }
 
@@ -694,14 +1167,14 @@ T EncodingTask<T>::run()
             mode |= CompressedOutputStream::COPY_BLOCK_MASK;
         }
         else {
-            int checkSkip = _ctx.getInt("skipBlocks", 0);
+            int checkSkip = _ctx.getInt(Context::SKIP_BLOCKS, 0);
 
             if (checkSkip != 0) {
-                bool skip = Magic::isCompressed(Magic::getType(&_data->_array[_data->_index]));
+                bool skip = Magic::isCompressed(Magic::getType(&input._array[input._index]));
 
                 if (skip == false) {
                     uint histo[256] = { 0 };
-                    Global::computeHistogram(&_data->_array[_data->_index], blockLength, histo);
+                    Global::computeHistogram(&input._array[input._index], blockLength, histo);
                     const int entropy = Global::computeFirstOrderEntropy1024(blockLength, histo);
                     skip = entropy >= EntropyUtils::INCOMPRESSIBLE_THRESHOLD;
                     //_ctx.putString("histo0", toString(histo, 256));
@@ -713,21 +1186,44 @@ T EncodingTask<T>::run()
                     mode |= CompressedOutputStream::COPY_BLOCK_MASK;
                 }
             }
+
+            // Codecs of the block chosen among the candidates (see BlockSelector)
+            if ((_selector != nullptr) && ((mode & CompressedOutputStream::COPY_BLOCK_MASK) == kanzi::byte(0))) {
+                const int idx = _selector->select(_ctx, &input._array[input._index], blockLength,
+                    _trials, _arenas, _nbArenas);
+
+                if (idx < 0) {
+                    tType = TransformFactory<kanzi::byte>::NONE_TYPE;
+                    eType = EntropyEncoderFactory::NONE_TYPE;
+                    mode |= CompressedOutputStream::COPY_BLOCK_MASK;
+                }
+                else {
+                    tType = _selector->getTransformType(idx);
+                    eType = _selector->getEntropyType(idx);
+                    _ctx.putLong(Context::TRANSFORM_TYPE, tType);
+                    _ctx.putInt(Context::ENTROPY_TYPE, eType);
+                    _ctx.putString("entropy", EntropyEncoderFactory::getName(eType));
+                }
+            }
         }
 
-        _ctx.putInt("size", blockLength);
-        transform = TransformFactory<kanzi::byte>::newTransform(_ctx, tType);
+        _ctx.putInt(Context::SIZE, blockLength);
+
+        // The transforms of this buffer slot (and their work buffers) are reused
+        // from one block to the next. The context they point to is refreshed here.
+        Context& tCtx = _transforms->reset(_ctx);
+        TransformSequence<kanzi::byte>* transform = _transforms->get(tType);
         const int requiredSize = transform->getMaxEncodedLength(blockLength);
 
         if (blockLength >= 4) {
-           uint magic = Magic::getType(&_data->_array[_data->_index]);
+           uint magic = Magic::getType(&input._array[input._index]);
 
            if (Magic::isCompressed(magic) == true)
-               _ctx.putInt("dataType", Global::BIN);
+               tCtx.putInt(Context::DATA_TYPE, Global::BIN);
            else if (Magic::isMultimedia(magic) == true)
-               _ctx.putInt("dataType", Global::MULTIMEDIA);
+               tCtx.putInt(Context::DATA_TYPE, Global::MULTIMEDIA);
            else if (Magic::isExecutable(magic) == true)
-               _ctx.putInt("dataType", Global::EXE);
+               tCtx.putInt(Context::DATA_TYPE, Global::EXE);
         }
 
         if (_buffer->_length < requiredSize) {
@@ -738,26 +1234,35 @@ T EncodingTask<T>::run()
             _buffer->_length = requiredSize;
         }
 
+        // A sequence of transforms may use its input as work space: move caller
+        // data to the buffer slot first
+        if ((_input != nullptr) && (transform->getNbTransforms() > 1)) {
+            if (_data->_length < blockLength) {
+                delete[] _data->_array;
+                _data->_length = blockLength + (blockLength >> 3);
+                _data->_array = new kanzi::byte[_data->_length];
+            }
+
+            memcpy(&_data->_array[0], _input, size_t(blockLength));
+            input = SliceArray<kanzi::byte>(_data->_array, _data->_length, 0);
+        }
+
         // Forward transform (ignore error, encode skipFlags)
-        // _data->_length is at least blockLength
+        // input._length is at least blockLength
         _buffer->_index = 0;
-        transform->forward(*_data, *_buffer, blockLength);
+        transform->forward(input, *_buffer, blockLength);
         const int nbTransforms = transform->getNbTransforms();
         const kanzi::byte skipFlags = transform->getSkipFlags();
-        delete transform;
-        transform = nullptr;
         postTransformLength = _buffer->_index;
 
         if (postTransformLength < 0) {
-            storeProcessedBlockId(CompressedOutputStream::CANCEL_TASKS_ID);
             return T(blockId, Error::ERR_WRITE_FILE, "Invalid transform size");
         }
 
-        _ctx.putInt("size", postTransformLength);
+        _ctx.putInt(Context::SIZE, postTransformLength);
         const int dataSize = (postTransformLength < 256) ? 1 : (Global::_log2(uint32(postTransformLength)) >> 3) + 1;
 
         if (dataSize > 4) {
-            storeProcessedBlockId(CompressedOutputStream::CANCEL_TASKS_ID);
             return T(blockId, Error::ERR_WRITE_FILE, "Invalid block data length");
         }
 
@@ -771,8 +1276,7 @@ T EncodingTask<T>::run()
             CompressedOutputStream::notifyListeners(_listeners, evt);
         }
 
-        const int bufSize = max(CompressedOutputStream::DEFAULT_BUFFER_SIZE,
-                                max(postTransformLength, blockLength + (blockLength >> 3)));
+        const int bufSize = max(postTransformLength, blockLength + (blockLength >> 3)) + 1024;
 
         if (_data->_length < bufSize) {
             // Rare case where the transform expanded the input or
@@ -785,7 +1289,7 @@ T EncodingTask<T>::run()
         _data->_index = 0;
         growable_ofixedbuf buf(_data);
         ostream os(&buf);
-        DefaultOutputBitStream obs(os);
+        DefaultOutputBitStream obs(os, uint(min(bufSize, 65536)) & ~1023u);
 
         // Write block 'header' (mode + compressed length)
         if (((mode & CompressedOutputStream::COPY_BLOCK_MASK) != kanzi::byte(0)) || (nbTransforms <= 4)) {
@@ -798,6 +1302,12 @@ T EncodingTask<T>::run()
             obs.writeBits(uint64(skipFlags), 8);
         }
 
+        // Codecs chosen for the block: transforms (48 bits), entropy (5 bits) + padding
+        if ((_selector != nullptr) && ((mode & CompressedOutputStream::COPY_BLOCK_MASK) == kanzi::byte(0))) {
+            obs.writeBits(tType, 48);
+            obs.writeBits(uint64(eType) << 3, 8);
+        }
+
         obs.writeBits(postTransformLength, 8 * dataSize);
 
         // Write checksum
@@ -813,14 +1323,25 @@ T EncodingTask<T>::run()
             CompressedOutputStream::notifyListeners(_listeners, evt);
         }
 
+        // The TPAQ models take their memory from a free arena (if any)
+        if ((_model == nullptr) && ((eType == EntropyEncoderFactory::TPAQ_TYPE) || (eType == EntropyEncoderFactory::TPAQX_TYPE)))
+            arena = ModelArena::acquire(_arenas, _nbArenas);
+
         // Each block is encoded separately
-        // Rebuild the entropy encoder to reset block statistics
-        ee = EntropyEncoderFactory::newEncoder(obs, _ctx, eType);
+        // Rebuild the entropy encoder to reset block statistics, except in
+        // solid mode where the model of the lane carries over.
+        if ((_model != nullptr) && (SolidModel::isSupported(eType) == true))
+            ee = _model->newEncoder(obs, _ctx, eType, postTransformLength);
+        else
+            ee = EntropyEncoderFactory::newEncoder(obs, _ctx, eType, arena);
 
         // Entropy encode block
         if (ee->encode(_buffer->_array, 0, postTransformLength) != postTransformLength) {
             delete ee;
-            storeProcessedBlockId(CompressedOutputStream::CANCEL_TASKS_ID);
+
+            if (arena != nullptr)
+                arena->release();
+
             return T(blockId, Error::ERR_PROCESS_BLOCK, "Entropy coding failed");
         }
 
@@ -828,71 +1349,79 @@ T EncodingTask<T>::run()
         ee->dispose();
         delete ee;
         ee = nullptr;
-        obs.close();
-        const uint64 written = obs.written();
-        const uint lw = (written < 8) ? 3 : uint(Global::log2(uint32(written >> 3)) + 4);
 
-#ifdef CONCURRENCY_ENABLED
-        {
-            std::unique_lock<std::mutex> lock(*_blockMutex);
-            _blockCondition->wait(lock, [this, blockId]() {
-                const int taskId = LOAD_ATOMIC(*_processedBlockId);
-                return (taskId == CompressedOutputStream::CANCEL_TASKS_ID) || (taskId == blockId - 1);
-            });
+        if (arena != nullptr) {
+            arena->release();
+            arena = nullptr;
         }
+        obs.close();
+        uint64 written = obs.written();
+        byte blockSkipFlags = skipFlags;
+
+        // Emit a copy block if the encoded block is larger than the original one.
+        // It bounds the size of the bitstream (see getMaxCompressedLength): a
+        // block that cannot be rebuilt is an error, never an expanded block.
+        const int copyDataSize = (blockLength < 256) ? 1 : (Global::_log2(uint32(blockLength)) >> 3) + 1;
+        const uint64 ckBits = (_hasher32 != nullptr) ? 32 : ((_hasher64 != nullptr) ? 64 : 0);
+        const uint64 copyBits = uint64(8 + 8 * copyDataSize) + ckBits + 8 * uint64(blockLength);
+
+        if ((written > copyBits) && ((mode & CompressedOutputStream::COPY_BLOCK_MASK) == kanzi::byte(0))) {
+            const kanzi::byte* raw = getOriginalBlock(transform, blockLength, postTransformLength);
+
+            if (raw == nullptr)
+                return T(blockId, Error::ERR_PROCESS_BLOCK, "Cannot rebuild the original block");
+
+            mode = CompressedOutputStream::COPY_BLOCK_MASK | kanzi::byte(((copyDataSize - 1) & 0x03) << 5) | kanzi::byte(0x0F);
+            _data->_index = 0;
+            growable_ofixedbuf cbuf(_data);
+            ostream cos(&cbuf);
+            DefaultOutputBitStream cobs(cos);
+            cobs.writeBits(uint64(mode), 8);
+            cobs.writeBits(blockLength, 8 * copyDataSize);
+
+            if (_hasher32 != nullptr)
+                cobs.writeBits(checksum, 32);
+            else if (_hasher64 != nullptr)
+                cobs.writeBits(checksum, 64);
+
+            ee = EntropyEncoderFactory::newEncoder(cobs, _ctx, EntropyEncoderFactory::NONE_TYPE);
+
+            if (ee->encode(raw, 0, blockLength) != blockLength) {
+                delete ee;
+                return T(blockId, Error::ERR_PROCESS_BLOCK, "Entropy coding failed");
+            }
 
-        if (LOAD_ATOMIC(*_processedBlockId) == CompressedOutputStream::CANCEL_TASKS_ID)
-            return T(blockId, 0, "Canceled");
-#endif
-
-        // Emit block size in bits (max size pre-entropy is 1 GB = 1 << 30 bytes)
-#if !defined(_MSC_VER) || _MSC_VER > 1500
-        const int64 blockOffset = _obs->tell();
-#endif
-        _obs->writeBits(lw - 3, 5); // write length-3 (5 bits max)
-        _obs->writeBits(written, lw);
-        int64 ww = int64((written + 7) >> 3);
-
-        // Emit data to shared bitstream
-        uint64 remaining = written;
-
-        for (uint n = 0; remaining > 0; ) {
-            uint chkSize = uint(min(remaining, uint64(1) << 30));
-            _obs->writeBits(&_data->_array[n], chkSize);
-            n += ((chkSize + 7) >> 3);
-            remaining -= uint64(chkSize);
+            ee->dispose();
+            delete ee;
+            ee = nullptr;
+            cobs.close();
+            written = cobs.written();
+            blockSkipFlags = SKIP_MASK;
         }
 
-        // After completion of the entropy coding, increment the block id.
-        // It unblocks the task processing the next block (if any).
-        storeProcessedBlockId(blockId);
+        const uint64 ww = (written + 7) >> 3;
 
-        if (_listeners.size() > 0) {
-            // Notify after entropy
-            Event evt1(Event::AFTER_ENTROPY, blockId, ww, timer.getCurrentTime(), checksum, hashType);
-            CompressedOutputStream::notifyListeners(_listeners, evt1);
-
-#if !defined(_MSC_VER) || _MSC_VER > 1500
-            if (_ctx.getInt("verbosity", 0) > 4) {
-                Event evt2(Event::BLOCK_INFO, blockId,
-                   int64((written + 7) >> 3), timer.getCurrentTime(), checksum, hashType, blockOffset, uint8(skipFlags));
-                CompressedOutputStream::notifyListeners(_listeners, evt2);
-            }
-#endif
+        if (ww > uint64(0xFFFFFFFF)) {
+            return T(blockId, Error::ERR_BLOCK_SIZE, "Invalid compressed block size");
         }
 
-        return T(blockId, 0, "Success");
+        // The decoder does not see the data of a copy block: the next block of
+        // the lane starts with a new model on both sides.
+        if ((_model != nullptr) && ((mode & CompressedOutputStream::COPY_BLOCK_MASK) != kanzi::byte(0)))
+            _model->reset();
+
+        return T(blockId, written, blockLength, checksum, hashType, blockSkipFlags);
     }
     catch (const exception& e) {
-        // Cancel any in-flight task waiting on this block.
-        storeProcessedBlockId(CompressedOutputStream::CANCEL_TASKS_ID);
-
-        if (transform != nullptr)
-            delete transform;
+        // Do not reuse transforms that may be in an inconsistent state
+        _transforms->clear();
 
         if (ee != nullptr)
             delete ee;
 
+        if (arena != nullptr)
+            arena->release();
+
         return T(blockId, Error::ERR_PROCESS_BLOCK, e.what());
     }
 }
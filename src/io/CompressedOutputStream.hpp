@@ -39,22 +39,56 @@ limitations under the License.
 
 namespace kanzi {
 
+   template <class T> class TransformCache;
+   template <class T> class TransformSequence;
+   class BlockSelector;
+   class ModelArena;
+   class SolidModel;
+
    class EncodingTaskResult FINAL {
    public:
        int _blockId;
        int _error; // 0 = OK
        std::string _msg;
+       uint64 _written; // encoded size in bits, 0 if nothing to emit
+       int _blockLength; // size before encoding
+       uint64 _checksum;
+       Event::HashType _hashType;
+       byte _skipFlags;
 
        EncodingTaskResult()
        {
            _blockId = -1;
            _error = 0;
+           _written = 0;
+           _blockLength = 0;
+           _checksum = 0;
+           _hashType = Event::NO_HASH;
+           _skipFlags = byte(0);
        }
 
        EncodingTaskResult(int blockId, int error, const std::string& msg)
            : _blockId(blockId)
            , _error(error)
            , _msg(msg)
+           , _written(0)
+           , _blockLength(0)
+           , _checksum(0)
+           , _hashType(Event::NO_HASH)
+           , _skipFlags(byte(0))
+       {
+       }
+
+       EncodingTaskResult(int blockId, uint64 written, int blockLength,
+                          uint64 checksum, Event::HashType hashType, byte skipFlags)
+           : _blockId(blockId)
+           , _error(0)
+           , _msg("Success")
+           , _written(written)
+           , _blockLength(blockLength)
+           , _checksum(checksum)
+           , _hashType(hashType)
+           , _skipFlags(skipFlags)
        {
        }
 
@@ -62,6 +96,11 @@ namespace kanzi {
            : _blockId(result._blockId)
            , _error(result._error)
            , _msg(result._msg)
+           , _written(result._written)
+           , _blockLength(result._blockLength)
+           , _checksum(result._checksum)
+           , _hashType(result._hashType)
+           , _skipFlags(result._skipFlags)
        {
        }
 
@@ -70,6 +109,11 @@ namespace kanzi {
            _msg = result._msg;
            _blockId = result._blockId;
            _error = result._error;
+           _written = result._written;
+           _blockLength = result._blockLength;
+           _checksum = result._checksum;
+           _hashType = result._hashType;
+           _skipFlags = result._skipFlags;
            return *this;
        }
 
@@ -78,6 +122,11 @@ namespace kanzi {
            : _blockId(other._blockId)
            , _error(other._error)
            , _msg(std::move(other._msg)) // Transfer ownership of string buffer
+           , _written(other._written)
+           , _blockLength(other._blockLength)
+           , _checksum(other._checksum)
+           , _hashType(other._hashType)
+           , _skipFlags(other._skipFlags)
        {
        }
 
@@ -88,6 +137,11 @@ namespace kanzi {
                _blockId = other._blockId;
                _error = other._error;
                _msg = std::move(other._msg); // Transfer ownership of string buffer
+               _written = other._written;
+               _blockLength = other._blockLength;
+               _checksum = other._checksum;
+               _hashType = other._hashType;
+               _skipFlags = other._skipFlags;
            }
 
            return *this;
@@ -97,40 +151,58 @@ namespace kanzi {
        ~EncodingTaskResult() {}
    };
 
+   // One entry of the optional block index written after the last block.
+   // Offsets and sizes are in bits, relative to the start of the bitstream.
+   class BlockIndexEntry FINAL {
+   public:
+       uint64 _offset;
+       uint64 _compressedBits;
+       uint _originalSize;
+       uint64 _checksum;
+
+       BlockIndexEntry(uint64 offset = 0, uint64 compressedBits = 0,
+                       uint originalSize = 0, uint64 checksum = 0)
+           : _offset(offset)
+           , _compressedBits(compressedBits)
+           , _originalSize(originalSize)
+           , _checksum(checksum)
+       {
+       }
+   };
+
    // A task used to encode a block
-   // Several tasks (transform+entropy) may run in parallel
+   // Several tasks (transform+entropy) may run in parallel. A task encodes its
+   // block into the input buffer and returns without waiting for the previous
+   // blocks. The stream emits the encoded blocks to the bitstream in order.
    template <class T>
    class EncodingTask FINAL : public Task<T> {
    private:
        SliceArray<byte>* _data;
        SliceArray<byte>* _buffer;
-       DefaultOutputBitStream* _obs;
+       const byte* _input; // caller data (see writeNoCopy), null if the block is in _data
        XXHash32* _hasher32;
        XXHash64* _hasher64;
-#ifdef CONCURRENCY_ENABLED
-       std::mutex* _blockMutex;
-       std::condition_variable* _blockCondition;
-#endif
-       atomic_int_t* _processedBlockId;
+       TransformCache<byte>* _transforms; // owned by the stream, one per buffer slot
+       ModelArena* _arenas; // owned by the stream, shared by the tasks (see ModelArena::acquire)
+       int _nbArenas;
+       SolidModel* _model; // model of the lane of the block in solid mode, else null
+       const BlockSelector* _selector; // per-block choice of the codecs, else null
+       TransformCache<byte>* _trials; // transforms of the codec trials of the buffer slot, else null
        std::vector<Listener<Event>*> _listeners;
        Context _ctx;
 
-       void storeProcessedBlockId(int value);
-
-       void fetchAddProcessedBlockId();
-
    public:
        EncodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuffer,
-           DefaultOutputBitStream* obs, XXHash32* hasher32, XXHash64* hasher64,
-#ifdef CONCURRENCY_ENABLED
-           std::mutex* blockMutex, std::condition_variable* blockCondition,
-#endif
-           atomic_int_t* processedBlockId, std::vector<Listener<Event>*>& listeners,
-           const Context& ctx);
+           const byte* input, XXHash32* hasher32, XXHash64* hasher64, TransformCache<byte>* transforms,
+           ModelArena* arenas, int nbArenas, SolidModel* model, const BlockSelector* selector,
+           TransformCache<byte>* trials, std::vector<Listener<Event>*>& listeners, const Context& ctx);
 
        ~EncodingTask(){}
 
        T run();
+
+   private:
+       const byte* getOriginalBlock(TransformSequence<byte>* transform, int blockLength, int postTransformLength);
    };
 
    class CompressedOutputStream : public OutputStream {
@@ -159,8 +231,17 @@ namespace kanzi {
 
        std::ostream& write(const char* s, std::streamsize n);
 
+       // Return true if write() of 'length' bytes would wait for a block task:
+       // the blocks it completes would reuse slots of blocks still encoding.
+       bool wouldBlock(std::streamsize length) const;
+
        std::ostream& put(char c);
 
+       // Same as write() but full blocks are not copied: the block tasks read
+       // them from 'data' (eg. a memory mapped file). The data is not modified
+       // and must remain valid until close() returns.
+       std::ostream& writeNoCopy(const char* data, std::streamsize length);
+
        std::ostream& flush();
 
        std::streampos tellp();
@@ -171,11 +252,23 @@ namespace kanzi {
 
        uint64 getWritten() const { return (_obs->written() + 7) >> 3; }
 
+       // Compress 'srcLength' bytes in one call and return the size of the bitstream
+       // written to 'dst'. The context provides the same parameters as for the
+       // stream constructor. Blocks are encoded straight from 'src' (not modified).
+       // Throws an IOException if the bitstream does not fit in 'dstCapacity' bytes.
+       static int64 compressBuffer(const byte* src, int64 srcLength, byte* dst, int64 dstCapacity,
+                                   Context& ctx, bool headerless = false);
+
+       // Size of 'dst' required by compressBuffer() for 'srcLength' bytes
+       static int64 getMaxCompressedLength(int64 srcLength, int blockSize);
+
 
   protected:
 
        void writeHeader();
 
+       void writeBlockIndex();
+
 
    private:
        static const int BITSTREAM_TYPE;
@@ -186,40 +279,65 @@ namespace kanzi {
        static const int MIN_BITSTREAM_BLOCK_SIZE;
        static const int MAX_BITSTREAM_BLOCK_SIZE;
        static const int SMALL_BLOCK_SIZE;
-       static const int CANCEL_TASKS_ID;
        static const int MAX_CONCURRENCY;
+       static const int BLOCK_INDEX_MAGIC;
+       static const int AUTO_CODECS_MAGIC;
+       static const int MAX_HEADER_SIZE;
+       static const int MAX_BLOCK_OVERHEAD;
 
        int _blockSize;
        int _bufferId; // index of current write buffer
        int _jobs;
+       int _slots; // block slots (reorder buffer), at least _jobs unless there are fewer blocks
        int _bufferThreshold;
        int _nbInputBlocks;
        int64 _inputSize;
        XXHash32* _hasher32;
        XXHash64* _hasher64;
        SliceArray<byte>** _buffers; // input & output per block
+       TransformCache<byte>* _transforms; // transforms reused between blocks, one per buffer slot
+       ModelArena* _arenas; // entropy model memory reused between blocks, one per concurrent task
+       int _nbArenas;
+       SolidModel* _models; // solid mode: entropy model of each lane, else null
+       int _lanes; // solid mode: number of lanes, 0 if the blocks are coded independently
+       BlockSelector* _selector; // codecs chosen per block ("autoCodecs"), else null
+       TransformCache<byte>* _trials; // transforms of the codec trials, one per candidate and buffer slot, else null
        short _entropyType;
        uint64 _transformType;
        DefaultOutputBitStream* _obs;
        atomic_int_t _initialized;
        atomic_int_t _closed;
-       atomic_int_t _blockId;
+       atomic_int_t _blockId; // last block emitted
        atomic_int_t _inputBlockId; // Counter for input blocks
        std::vector<Listener<Event>*> _listeners;
        std::vector<int> _jobsPerTask;
+       std::vector<BlockIndexEntry> _index;
        Context _ctx;
        bool _headless;
+       bool _blockIndex;
 
 #ifdef CONCURRENCY_ENABLED
        ThreadPool* _pool;
        std::vector<std::future<EncodingTaskResult> > _futures; // Futures for async tasks
-       std::mutex _blockMutex;
-       std::condition_variable _blockCondition;
 #endif
 
-       void processBuffer();
+       void allocateBuffer();
+
+       std::ostream& writeBlocks(const char* data, std::streamsize length, bool last);
+
+       void processBuffer(const byte* input = nullptr, int length = 0);
+
+       void submitBlock(const byte* input = nullptr, int length = 0);
+
+#ifdef CONCURRENCY_ENABLED
+       void emitBlock(int bufferId);
+
+       void emitReadyBlocks();
+
+       void reserveJobs(int jobs);
+#endif
 
-       void submitBlock();
+       void emitBlock(int bufferId, const EncodingTaskResult& res);
 
        static void notifyListeners(std::vector<Listener<Event>*>& listeners, const Event& evt);
    };
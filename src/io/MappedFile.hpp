@@ -0,0 +1,185 @@
+/*
+Copyright 2011-2026 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef knz_MappedFile
+#define knz_MappedFile
+
+#include <string>
+#include "../types.hpp"
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(_WIN64)
+   #include <fcntl.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <unistd.h>
+   #define KNZ_MMAP_SUPPORTED
+
+   // The space of a file mapped for writing must be reserved first (a write
+   // to a sparse mapping on a full disk raises SIGBUS)
+   #if defined(__linux__) || defined(__FreeBSD__)
+      #define KNZ_FALLOCATE_SUPPORTED
+   #endif
+#endif
+
+
+namespace kanzi {
+
+   // A regular file mapped in memory.
+   // Used by the file tasks to hand the input to the block tasks and to receive
+   // the decoded blocks without going through stream buffers.
+   // Mapping is only available on POSIX platforms (for writing, on platforms
+   // with posix_fallocate). Otherwise, or if the file cannot be mapped,
+   // openRead() and openWrite() return false and the caller uses streams.
+   class MappedFile FINAL {
+   public:
+       MappedFile() : _data(nullptr), _size(0), _fd(-1), _writable(false) {}
+
+       ~MappedFile() { close(); }
+
+       // Map an existing file for reading. The mapping is private: the file is
+       // never modified.
+       bool openRead(const std::string& name);
+
+       // Reserve 'size' bytes on disk for the file and map it for writing.
+       // The caller must not keep the file open. On failure, the file is left
+       // as it was and the caller uses streams.
+       bool openWrite(const std::string& name, int64 size);
+
+       // Unmap the file. A file mapped for writing is truncated to 'size'
+       // bytes if 'size' is positive or null.
+       bool close(int64 size = -1);
+
+       byte* data() const { return _data; }
+
+       int64 size() const { return _size; }
+
+   private:
+       byte* _data;
+       int64 _size;
+       int _fd;
+       bool _writable;
+
+       MappedFile(const MappedFile&); // not copyable
+       MappedFile& operator=(const MappedFile&);
+   };
+
+
+   inline bool MappedFile::openRead(const std::string& name)
+   {
+#ifdef KNZ_MMAP_SUPPORTED
+       close();
+       const int fd = ::open(name.c_str(), O_RDONLY);
+
+       if (fd < 0)
+           return false;
+
+       struct stat st;
+
+       if ((fstat(fd, &st) != 0) || (S_ISREG(st.st_mode) == 0) || (st.st_size <= 0)) {
+           ::close(fd);
+           return false;
+       }
+
+       void* addr = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+       if (addr == MAP_FAILED) {
+           ::close(fd);
+           return false;
+       }
+
+#ifdef MADV_SEQUENTIAL
+       madvise(addr, size_t(st.st_size), MADV_SEQUENTIAL);
+#endif
+
+       _data = static_cast<byte*>(addr);
+       _size = int64(st.st_size);
+       _fd = fd;
+       _writable = false;
+       return true;
+#else
+       (void) name;
+       return false;
+#endif
+   }
+
+   inline bool MappedFile::openWrite(const std::string& name, int64 size)
+   {
+#ifdef KNZ_FALLOCATE_SUPPORTED
+       close();
+
+       // The size may come from an untrusted header
+       if ((size <= 0) || (uint64(size) > uint64(SIZE_MAX)) || (off_t(size) != size))
+           return false;
+
+       const int fd = ::open(name.c_str(), O_RDWR | O_CREAT, 0644);
+
+       if (fd < 0)
+           return false;
+
+       struct stat st;
+
+       if ((fstat(fd, &st) != 0) || (S_ISREG(st.st_mode) == 0)) {
+           ::close(fd);
+           return false;
+       }
+
+       // Map only once the space is allocated (fails on a full disk or on
+       // a size beyond the file system limits)
+       bool res = posix_fallocate(fd, 0, off_t(size)) == 0;
+       void* addr = (res == true) ? mmap(nullptr, size_t(size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+
+       if (addr == MAP_FAILED) {
+           // Restore the file size, the caller writes the file with streams
+           res = ftruncate(fd, st.st_size) == 0;
+           ::close(fd);
+           return false;
+       }
+
+       _data = static_cast<byte*>(addr);
+       _size = size;
+       _fd = fd;
+       _writable = true;
+       return true;
+#else
+       (void) name;
+       (void) size;
+       return false;
+#endif
+   }
+
+   inline bool MappedFile::close(int64 size)
+   {
+#ifdef KNZ_MMAP_SUPPORTED
+       if (_fd < 0)
+           return true;
+
+       bool res = munmap(_data, size_t(_size)) == 0;
+
+       if ((_writable == true) && (size >= 0) && (size != _size))
+           res &= ftruncate(_fd, off_t(size)) == 0;
+
+       res &= ::close(_fd) == 0;
+       _data = nullptr;
+       _size = 0;
+       _fd = -1;
+       return res;
+#else
+       (void) size;
+       return true;
+#endif
+   }
+}
+#endif
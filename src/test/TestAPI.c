@@ -19,6 +19,7 @@
     } while (0)
 
 #define KANZI_ERR_INVALID_PARAM 18
+#define KANZI_ERR_WOULD_BLOCK 21
 
 
 #ifndef PORTABLE_FMEMOPEN_H
@@ -656,7 +657,7 @@ static void test_headerless(void)
     dparams.blockSize     = 1 << 15;
     dparams.originalSize  = strlen(input);
     dparams.checksum      = 0;
-    dparams.bsVersion     = 1;
+    dparams.bsVersion     = 7;
 
     struct dContext* dctx = NULL;
     ASSERT(initDecompressor(&dparams, fdec, &dctx) == 0, "failed to init decompressor");
@@ -676,6 +677,355 @@ static void test_headerless(void)
     remove(fcomp_name);
 }
 
+// One shot buffer compression and decompression
+static void test_buffer_roundtrip(void)
+{
+    printf("TEST: buffer roundtrip\n");
+
+    const char* transforms[] = { "NONE", "LZX", "BWT+SRT+ZRLT", "TEXT+UTF+PACK+MM+LZX" };
+    const char* entropies[] = { "NONE", "HUFFMAN", "ANS1", "TPAQ" };
+    size_t size = 300000;
+    unsigned char* data = (unsigned char*)malloc(size);
+    ASSERT(data != NULL, "failed to allocate buffer memory");
+
+    // Compressible first half, random second half (blocks emitted as copy blocks)
+    srand(12345);
+
+    for (size_t i = 0; i < size; i++)
+        data[i] = (i < size / 2) ? (unsigned char)("kanzi buffer api "[i % 17]) : (unsigned char)rand();
+
+    size_t bound = compressBound(size, 64 * 1024);
+    ASSERT(bound > size, "invalid compression bound");
+    unsigned char* comp = (unsigned char*)malloc(bound);
+    unsigned char* out = (unsigned char*)malloc(size);
+    ASSERT((comp != NULL) && (out != NULL), "failed to allocate buffer memory");
+
+    for (int t = 0; t < 4; t++) {
+        for (int e = 0; e < 4; e++) {
+            for (unsigned int jobs = 1; jobs <= 4; jobs += 3) {
+                struct cData cparams;
+                memset(&cparams, 0, sizeof(cparams));
+                strcpy(cparams.transform, transforms[t]);
+                strcpy(cparams.entropy, entropies[e]);
+                cparams.blockSize = 64 * 1024;
+                cparams.jobs = jobs;
+                cparams.checksum = 32;
+
+                size_t compSize = bound;
+                ASSERT(compressBuffer(&cparams, data, size, comp, &compSize) == 0, "failed to compress buffer");
+                ASSERT(compSize <= bound, "compressed size exceeds bound");
+
+                struct dData dparams;
+                memset(&dparams, 0, sizeof(dparams));
+                dparams.jobs = jobs;
+
+                size_t outSize = size;
+                ASSERT(decompressBuffer(&dparams, comp, compSize, out, &outSize) == 0, "failed to decompress buffer");
+                ASSERT(outSize == size, "failed to decompress buffer: invalid data size");
+                ASSERT(memcmp(out, data, size) == 0, "failed to decompress buffer: data differ from original");
+            }
+        }
+    }
+
+    // Small payload
+    struct cData cparams = make_params();
+    size_t compSize = bound;
+    ASSERT(compressBuffer(&cparams, data, 100, comp, &compSize) == 0, "failed to compress small buffer");
+    ASSERT(compSize <= compressBound(100, cparams.blockSize), "compressed size exceeds bound");
+
+    struct dData dparams;
+    memset(&dparams, 0, sizeof(dparams));
+    dparams.jobs = 1;
+    size_t outSize = size;
+    ASSERT(decompressBuffer(&dparams, comp, compSize, out, &outSize) == 0, "failed to decompress small buffer");
+    ASSERT((outSize == 100) && (memcmp(out, data, 100) == 0), "failed to decompress small buffer");
+
+    free(out);
+    free(comp);
+    free(data);
+}
+
+// One shot buffer API: invalid parameters and destination too small
+static void test_buffer_invalid(void)
+{
+    printf("TEST: buffer invalid params...\n");
+
+    uint8_t data[4096];
+    uint8_t comp[8192];
+    uint8_t out[4096];
+    fill_buffer(data, 4096);
+
+    struct cData cparams = make_params();
+    size_t compSize = sizeof(comp);
+    ASSERT(compressBuffer(NULL, data, 4096, comp, &compSize) == KANZI_ERR_INVALID_PARAM, "compressBuffer should fail on NULL params");
+    ASSERT(compressBuffer(&cparams, NULL, 4096, comp, &compSize) == KANZI_ERR_INVALID_PARAM, "compressBuffer should fail on NULL src");
+    ASSERT(compressBuffer(&cparams, data, 4096, NULL, &compSize) == KANZI_ERR_INVALID_PARAM, "compressBuffer should fail on NULL dst");
+    ASSERT(compressBound(4096, 0) == 0, "compressBound should fail on null block size");
+
+    compSize = 16;
+    ASSERT(compressBuffer(&cparams, data, 4096, comp, &compSize) != 0, "compressBuffer should fail on small dst");
+
+    compSize = sizeof(comp);
+    ASSERT(compressBuffer(&cparams, data, 4096, comp, &compSize) == 0, "failed to compress buffer");
+
+    struct dData dparams;
+    memset(&dparams, 0, sizeof(dparams));
+    dparams.jobs = 1;
+    size_t outSize = 100;
+    ASSERT(decompressBuffer(&dparams, comp, compSize, out, &outSize) != 0, "decompressBuffer should fail on small dst");
+
+    outSize = sizeof(out);
+    ASSERT(decompressBuffer(&dparams, comp, compSize / 2, out, &outSize) != 0, "decompressBuffer should fail on truncated data");
+    ASSERT(decompressBuffer(NULL, comp, compSize, out, &outSize) == KANZI_ERR_INVALID_PARAM, "decompressBuffer should fail on NULL params");
+}
+
+// Memory buffer used by the callback tests
+struct memBuffer {
+    unsigned char* data;
+    size_t size;
+    size_t capacity;
+    size_t pos;
+    size_t maxRead; // largest chunk returned by one read
+};
+
+static size_t mem_write(void* userData, const unsigned char* data, size_t size)
+{
+    struct memBuffer* mb = (struct memBuffer*)userData;
+
+    if (mb->size + size > mb->capacity)
+        return 0;
+
+    memcpy(mb->data + mb->size, data, size);
+    mb->size += size;
+    return size;
+}
+
+static size_t mem_read(void* userData, unsigned char* buffer, size_t size)
+{
+    struct memBuffer* mb = (struct memBuffer*)userData;
+    size_t n = mb->size - mb->pos;
+
+    if (n > size)
+        n = size;
+
+    if (n > mb->maxRead)
+        n = mb->maxRead;
+
+    memcpy(buffer, mb->data + mb->pos, n);
+    mb->pos += n;
+    return n;
+}
+
+// Streaming through callbacks (no FILE*)
+static void test_callback_roundtrip(void)
+{
+    printf("TEST: callback roundtrip\n");
+
+    size_t size = 1000000;
+    unsigned char* data = (unsigned char*)malloc(size);
+    ASSERT(data != NULL, "failed to allocate buffer memory");
+
+    for (size_t i = 0; i < size; i++)
+        data[i] = (unsigned char)((i % 251) ^ (i >> 12));
+
+    struct memBuffer mb;
+    mb.capacity = compressBound(size, 64 * 1024);
+    mb.data = (unsigned char*)malloc(mb.capacity);
+    unsigned char* out = (unsigned char*)malloc(size);
+    ASSERT((mb.data != NULL) && (out != NULL), "failed to allocate buffer memory");
+
+    struct cContext* cctx = NULL;
+    struct cData cparams = make_params();
+    ASSERT(initCompressorWithCallback(&cparams, NULL, &mb, &cctx) == KANZI_ERR_INVALID_PARAM,
+           "initCompressorWithCallback should fail on NULL callback");
+
+    for (unsigned int jobs = 1; jobs <= 4; jobs += 3) {
+        mb.size = 0;
+        mb.pos = 0;
+        mb.maxRead = 1000;
+        cparams = make_params();
+        strcpy(cparams.transform, "LZX");
+        strcpy(cparams.entropy, "HUFFMAN");
+        cparams.blockSize = 64 * 1024;
+        cparams.jobs = jobs;
+        cparams.checksum = 32;
+        ASSERT(initCompressorWithCallback(&cparams, mem_write, &mb, &cctx) == 0, "failed to init compressor");
+
+        size_t written = 0;
+
+        for (size_t i = 0; i < size; i += cparams.blockSize) {
+            size_t inSize = (size - i < cparams.blockSize) ? size - i : cparams.blockSize;
+            size_t outSize = 0;
+            int res;
+
+            // With several jobs, tryCompress() does not wait for a block slot: call again
+            do {
+                outSize = 0;
+                res = (jobs > 1) ? tryCompress(cctx, data + i, inSize, &outSize) :
+                    compress(cctx, data + i, inSize, &outSize);
+                ASSERT((res == 0) || ((res == KANZI_ERR_WOULD_BLOCK) && (outSize == 0)), "failed to compress data");
+            } while (res == KANZI_ERR_WOULD_BLOCK);
+
+            written += outSize;
+        }
+
+        size_t flushed = 0;
+        ASSERT(disposeCompressor(&cctx, &flushed) == 0, "failed to dispose compressor");
+        ASSERT(written + flushed == mb.size, "invalid compressed size");
+
+        struct dData dparams;
+        memset(&dparams, 0, sizeof(dparams));
+        dparams.bufferSize = 100000;
+        dparams.jobs = jobs;
+
+        struct dContext* dctx = NULL;
+        ASSERT(initDecompressorWithCallback(&dparams, NULL, &mb, &dctx) == KANZI_ERR_INVALID_PARAM,
+               "initDecompressorWithCallback should fail on NULL callback");
+        ASSERT(initDecompressorWithCallback(&dparams, mem_read, &mb, &dctx) == 0, "failed to init decompressor");
+
+        size_t totalOut = 0;
+
+        while (1) {
+            size_t outBytes = dparams.bufferSize;
+            ASSERT(decompress(dctx, out + totalOut, NULL, &outBytes) == 0, "failed to decompress data");
+
+            if (outBytes == 0)
+                break;
+
+            // Short reads only at the end of stream
+            ASSERT((outBytes == dparams.bufferSize) || (totalOut + outBytes == size), "invalid decompressed chunk size");
+            totalOut += outBytes;
+            ASSERT(totalOut <= size, "failed to decompress: too much data");
+        }
+
+        ASSERT(disposeDecompressor(&dctx) == 0, "failed to dispose decompressor");
+        ASSERT(totalOut == size, "failed to decompress: invalid data size");
+        ASSERT(memcmp(out, data, size) == 0, "failed to decompress: data differ from original");
+    }
+
+    // Write errors are reported
+    mb.size = 0;
+    mb.capacity = 16;
+    cparams = make_params();
+    ASSERT(initCompressorWithCallback(&cparams, mem_write, &mb, &cctx) == 0, "failed to init compressor");
+    size_t outSize = 0;
+    int res = compress(cctx, data, cparams.blockSize, &outSize);
+    size_t flushed = 0;
+    res |= disposeCompressor(&cctx, &flushed);
+    ASSERT(res != 0, "compression should fail on write error");
+
+    free(out);
+    free(mb.data);
+    free(data);
+}
+
+// Compressed data pushed by the caller, decompress() does not wait
+static void test_feed_roundtrip(void)
+{
+    printf("TEST: feed roundtrip\n");
+
+    size_t size = 1000000;
+    unsigned char* data = (unsigned char*)malloc(size);
+    ASSERT(data != NULL, "failed to allocate buffer memory");
+
+    for (size_t i = 0; i < size; i++)
+        data[i] = (unsigned char)((i % 251) ^ (i >> 12));
+
+    struct cData cparams = make_params();
+    strcpy(cparams.transform, "LZX");
+    strcpy(cparams.entropy, "HUFFMAN");
+    cparams.blockSize = 64 * 1024;
+    size_t compSize = compressBound(size, cparams.blockSize);
+    unsigned char* comp = (unsigned char*)malloc(compSize);
+    unsigned char* out = (unsigned char*)malloc(size);
+    ASSERT((comp != NULL) && (out != NULL), "failed to allocate buffer memory");
+    ASSERT(compressBuffer(&cparams, data, size, comp, &compSize) == 0, "failed to compress data");
+
+    struct dData dparams;
+    memset(&dparams, 0, sizeof(dparams));
+    dparams.bufferSize = 100000;
+    dparams.jobs = 2;
+
+    struct dContext* dctx = NULL;
+    ASSERT(initDecompressorWithFeed(NULL, &dctx) == KANZI_ERR_INVALID_PARAM,
+           "initDecompressorWithFeed should fail on NULL params");
+    ASSERT(initDecompressorWithFeed(&dparams, &dctx) == 0, "failed to init decompressor");
+    ASSERT(feedDecompressor(NULL, comp, 16, 0) == KANZI_ERR_INVALID_PARAM,
+           "feedDecompressor should fail on NULL context");
+
+    // Not enough data to decode anything: no wait, no end of stream
+    ASSERT(feedDecompressor(dctx, comp, 16, 0) == 0, "failed to feed decompressor");
+    size_t outBytes = dparams.bufferSize;
+    ASSERT(decompress(dctx, out, NULL, &outBytes) == KANZI_ERR_WOULD_BLOCK, "decompress should not wait for data");
+    ASSERT(outBytes == 0, "invalid decompressed size");
+
+    size_t fed = 16;
+    size_t totalIn = 0;
+    size_t totalOut = 0;
+    int res;
+
+    while (1) {
+        if (fed < compSize) {
+            size_t n = (compSize - fed < 1000) ? compSize - fed : 1000;
+            res = feedDecompressor(dctx, comp + fed, n, fed + n == compSize);
+            ASSERT((res == 0) || (res == KANZI_ERR_WOULD_BLOCK), "failed to feed decompressor");
+
+            if (res == 0)
+                fed += n;
+        }
+
+        size_t inBytes = 0;
+        outBytes = dparams.bufferSize;
+        res = decompress(dctx, out + totalOut, &inBytes, &outBytes);
+        ASSERT((res == 0) || (res == KANZI_ERR_WOULD_BLOCK), "failed to decompress data");
+        totalIn += inBytes;
+
+        if ((res == 0) && (outBytes == 0))
+            break;
+
+        totalOut += outBytes;
+        ASSERT(totalOut <= size, "failed to decompress: too much data");
+    }
+
+    ASSERT(feedDecompressor(dctx, comp, 16, 1) == KANZI_ERR_INVALID_PARAM,
+           "feedDecompressor should fail after the last data");
+    ASSERT(disposeDecompressor(&dctx) == 0, "failed to dispose decompressor");
+    ASSERT(totalIn == compSize, "invalid compressed size");
+    ASSERT(totalOut == size, "failed to decompress: invalid data size");
+    ASSERT(memcmp(out, data, size) == 0, "failed to decompress: data differ from original");
+
+    // Truncated stream: an error, not a silent end of stream
+    ASSERT(initDecompressorWithFeed(&dparams, &dctx) == 0, "failed to init decompressor");
+    ASSERT(feedDecompressor(dctx, comp, compSize / 2, 1) == 0, "failed to feed decompressor");
+
+    do {
+        outBytes = dparams.bufferSize;
+        res = decompress(dctx, out, NULL, &outBytes);
+    } while ((res == KANZI_ERR_WOULD_BLOCK) || ((res == 0) && (outBytes != 0)));
+
+    ASSERT(res != 0, "decompression should fail on truncated data");
+    disposeDecompressor(&dctx);
+
+    // Dispose while the decoder waits for data
+    ASSERT(initDecompressorWithFeed(&dparams, &dctx) == 0, "failed to init decompressor");
+    ASSERT(feedDecompressor(dctx, comp, compSize / 2, 0) == 0, "failed to feed decompressor");
+    ASSERT(disposeDecompressor(&dctx) == 0, "failed to dispose decompressor");
+
+    // Full queue: the decoder pauses after bufferSize decompressed bytes (and
+    // a few blocks read ahead), the rest of the compressed data stays queued
+    // and nothing more is accepted
+    dparams.bufferSize = 1024;
+    ASSERT(initDecompressorWithFeed(&dparams, &dctx) == 0, "failed to init decompressor");
+    ASSERT(feedDecompressor(dctx, comp, compSize, 0) == 0, "failed to feed decompressor");
+    ASSERT(feedDecompressor(dctx, comp, dparams.bufferSize, 0) == KANZI_ERR_WOULD_BLOCK,
+           "feedDecompressor should not queue more than bufferSize bytes");
+    ASSERT(disposeDecompressor(&dctx) == 0, "failed to dispose decompressor");
+
+    free(out);
+    free(comp);
+    free(data);
+}
+
 int main(void)
 {
     // Compressor
@@ -695,6 +1045,14 @@ int main(void)
     test_large_multi_block();
     test_headerless();
 
+    // One shot buffer API
+    test_buffer_roundtrip();
+    test_buffer_invalid();
+
+    // Callback streaming API
+    test_callback_roundtrip();
+    test_feed_roundtrip();
+
     printf("All C API tests passed.\n");
     return 0;
 }
@@ -346,6 +346,65 @@ int testBWTInvalidSecondaryIndex()
     return res;
 }
 
+int testBWTConcurrentForward()
+{
+    cout << endl
+         << endl
+         << "BWT concurrent forward test" << endl;
+    int res = 0;
+
+#ifdef CONCURRENCY_ENABLED
+    const int size = 4 * 1024 * 1024;
+    kanzi::byte* input = new kanzi::byte[size];
+    kanzi::byte* output1 = new kanzi::byte[size];
+    kanzi::byte* output2 = new kanzi::byte[size];
+    kanzi::byte* reverse = new kanzi::byte[size];
+
+    // Text like data with many repeats to exercise long B* buckets
+    for (int i = 0; i < size; i++)
+        input[i] = kanzi::byte(((i % 5000) < 2500) ? 65 + (rand() % 8) : 97 + ((i >> 4) % 13));
+
+    BWT bwt1(1);
+    BWT bwt2(4);
+    SliceArray<kanzi::byte> ia1(input, size, 0);
+    SliceArray<kanzi::byte> ia2(output1, size, 0);
+    SliceArray<kanzi::byte> ia3(input, size, 0);
+    SliceArray<kanzi::byte> ia4(output2, size, 0);
+    SliceArray<kanzi::byte> ia5(reverse, size, 0);
+
+    if ((bwt1.forward(ia1, ia2, size) == false) || (bwt2.forward(ia3, ia4, size) == false)) {
+        res = 1;
+    }
+    else if (memcmp(output1, output2, size) != 0) {
+        cout << "Different outputs with 1 and 4 jobs" << endl;
+        res = 1;
+    }
+    else {
+        BWT bwt3(4);
+
+        for (int i = 0; i < BWT::getBWTChunks(size); i++) {
+            if (bwt1.getPrimaryIndex(i) != bwt2.getPrimaryIndex(i))
+                res = 1;
+
+            bwt3.setPrimaryIndex(i, bwt2.getPrimaryIndex(i));
+        }
+
+        ia4._index = 0;
+
+        if ((res != 0) || (bwt3.inverse(ia4, ia5, size) == false) || (memcmp(input, reverse, size) != 0))
+            res = 1;
+    }
+
+    delete[] input;
+    delete[] output1;
+    delete[] output2;
+    delete[] reverse;
+#endif
+
+    cout << (res == 0 ? "OK" : "Failed") << endl;
+    return res;
+}
+
 #ifdef __GNUG__
 int main(int argc, const char* argv[])
 #else
@@ -364,6 +423,7 @@ int TestBWT_main(int argc, const char* argv[])
     res |= testBWTCorrectness(true);
     res |= testBWTCorrectness(false);
     res |= testBWTInvalidSecondaryIndex();
+    res |= testBWTConcurrentForward();
 
     if (doPerf) {
        res |= testBWTSpeed(true, 200, true); // test MergeTPSI inverse
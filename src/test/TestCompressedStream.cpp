@@ -17,9 +17,14 @@ limitations under the License.
 #include <fstream>
 #include <iostream>
 #include <limits>
+#include "../Dictionary.hpp"
+#include "../io/BlockPlanner.hpp"
+#include "../io/BlockSelector.hpp"
 #include "../io/CompressedInputStream.hpp"
 #include "../io/CompressedOutputStream.hpp"
 #include "../io/IOException.hpp"
+#include "../entropy/EntropyEncoderFactory.hpp"
+#include "../transform/TransformFactory.hpp"
 
 using namespace std;
 using namespace kanzi;
@@ -242,6 +247,647 @@ uint64 compress6(kanzi::byte block[])
     return res;
 }
 
+uint64 compress7(kanzi::byte block[], uint length)
+{
+    cout << "Test - block index with block range (LZ&HUFFMAN)" << endl;
+    const int blockSize = 4096;
+    const int nbBlocks = int((length + blockSize - 1) / blockSize);
+    const int from = 1 + rand() % nbBlocks;
+    const int to = from + 1 + rand() % 3;
+    int jobs = 1;
+
+#ifdef CONCURRENCY_ENABLED
+    jobs = 1 + (rand() & 3);
+#endif
+
+    stringbuf buffer;
+    iostream ios(&buffer);
+    Context ctx1;
+    ctx1.putInt("jobs", jobs);
+    ctx1.putString("entropy", "HUFFMAN");
+    ctx1.putString("transform", "LZ");
+    ctx1.putInt("blockSize", blockSize);
+    ctx1.putInt("checksum", 32);
+    ctx1.putInt("blockIndex", 1);
+    CompressedOutputStream* cos = new CompressedOutputStream(ios, ctx1);
+    cos->write((const char*)block, length);
+    cos->close();
+    delete cos;
+
+    uint64 res = 0;
+
+    for (int i = 0; i < 2; i++) {
+        // First pass: jump to the block range via the index, second pass: full decoding
+        const int first = (i == 0) ? from : 1;
+        const int end = (i == 0) ? to : nbBlocks + 1;
+        string s = buffer.str();
+        stringbuf buffer2(s);
+        istream is(&buffer2);
+        Context ctx2;
+        ctx2.putInt("jobs", jobs);
+
+        if (i == 0) {
+            ctx2.putInt("from", first);
+            ctx2.putInt("to", end);
+        }
+
+        CompressedInputStream* cis = new CompressedInputStream(is, ctx2);
+        kanzi::byte* out = new kanzi::byte[length];
+        streamsize decoded = 0;
+
+        while (decoded < streamsize(length)) {
+            cis->read((char*)&out[decoded], streamsize(length) - decoded);
+
+            if (cis->gcount() <= 0)
+                break;
+
+            decoded += cis->gcount();
+        }
+
+        cis->close();
+        delete cis;
+        const streamsize expected = min(streamsize(length), streamsize(end - 1) * blockSize) - streamsize(first - 1) * blockSize;
+
+        if (decoded != expected) {
+            cout << "Failure: decoded " << decoded << " bytes, expected " << expected << endl;
+            res = 1;
+        }
+        else if (memcmp(&block[(first - 1) * blockSize], out, size_t(decoded)) != 0) {
+            cout << "Failure: invalid data in block range [" << first << ".." << end << "[" << endl;
+            res = 1;
+        }
+
+        delete[] out;
+    }
+
+    return res;
+}
+
+uint64 compress8(kanzi::byte block[], uint length, const char* entropy)
+{
+    const int blockSize = 4096;
+    const int nbBlocks = int((length + blockSize - 1) / blockSize);
+    const int from = 1 + rand() % nbBlocks;
+    const int to = from + 1 + rand() % 3;
+    int jobs = 1;
+    int lanes = 1;
+    int decJobs = 1;
+
+#ifdef CONCURRENCY_ENABLED
+    jobs = 1 + (rand() & 3);
+    lanes = 1 + (rand() & 3);
+    decJobs = 1 + (rand() & 3);
+#endif
+
+    cout << "Test - solid mode, " << jobs << " job(s), " << lanes << " lane(s) (" << entropy << ")" << endl;
+    stringbuf buffer;
+    iostream ios(&buffer);
+    Context ctx1;
+    ctx1.putInt("jobs", jobs);
+    ctx1.putString("entropy", entropy);
+    ctx1.putString("transform", "NONE");
+    ctx1.putInt("blockSize", blockSize);
+    ctx1.putInt("checksum", 32);
+    ctx1.putInt("skipBlocks", 1);
+    ctx1.putInt("solid", lanes);
+    CompressedOutputStream* cos = new CompressedOutputStream(ios, ctx1);
+    cos->write((const char*)block, length);
+    cos->close();
+    delete cos;
+
+    uint64 res = 0;
+
+    for (int i = 0; i < 2; i++) {
+        // First pass: block range (previous blocks decoded to rebuild the models),
+        // second pass: full decoding
+        const int first = (i == 0) ? from : 1;
+        const int end = (i == 0) ? to : nbBlocks + 1;
+        string s = buffer.str();
+        stringbuf buffer2(s);
+        istream is(&buffer2);
+        Context ctx2;
+        ctx2.putInt("jobs", decJobs);
+
+        if (i == 0) {
+            ctx2.putInt("from", first);
+            ctx2.putInt("to", end);
+        }
+
+        CompressedInputStream* cis = new CompressedInputStream(is, ctx2);
+        kanzi::byte* out = new kanzi::byte[length];
+        streamsize decoded = 0;
+
+        while (decoded < streamsize(length)) {
+            cis->read((char*)&out[decoded], streamsize(length) - decoded);
+
+            if (cis->gcount() <= 0)
+                break;
+
+            decoded += cis->gcount();
+        }
+
+        cis->close();
+        delete cis;
+        const streamsize expected = min(streamsize(length), streamsize(end - 1) * blockSize) - streamsize(first - 1) * blockSize;
+
+        if (decoded != expected) {
+            cout << "Failure: decoded " << decoded << " bytes, expected " << expected << endl;
+            res = 1;
+        }
+        else if (memcmp(&block[(first - 1) * blockSize], out, size_t(decoded)) != 0) {
+            cout << "Failure: invalid data in block range [" << first << ".." << end << "[" << endl;
+            res = 1;
+        }
+
+        delete[] out;
+    }
+
+    // The models of the lanes are part of the memory estimate
+    const short eType = EntropyEncoderFactory::getType(entropy);
+    const BlockPlanner planner1(TransformFactory<kanzi::byte>::NONE_TYPE, eType, 1, 0);
+    const BlockPlanner planner2(TransformFactory<kanzi::byte>::NONE_TYPE, eType, 1, 0, 0, false, 4);
+
+    if (planner2.getMemory(blockSize, 1) <= planner1.getMemory(blockSize, 1)) {
+        cout << "Failure: the models of the lanes are not accounted for" << endl;
+        res = 1;
+    }
+
+#if !defined(_MSC_VER) || _MSC_VER > 1500
+    // No seek: the blocks need the models built by the previous blocks of their lane
+    string s = buffer.str();
+    stringbuf buffer3(s);
+    istream is(&buffer3);
+    CompressedInputStream cis(is, 1);
+    char c;
+    cis.read(&c, 1);
+
+    if (cis.seek(cis.tell()) == true) {
+        cout << "Failure: seek accepted in solid mode" << endl;
+        res = 1;
+    }
+
+    cis.close();
+#endif
+
+    return res;
+}
+
+uint64 compress9(kanzi::byte block[], uint length)
+{
+    cout << "Test - dictionary (LZX+TEXT&CM)" << endl;
+    const int blockSize = 4096;
+    length = min(length, uint(16 * blockSize));
+    Dictionary dict(&block[0], blockSize);
+    stringbuf buffer;
+    iostream ios(&buffer);
+    Context ctx1;
+    ctx1.putInt("jobs", 1);
+    ctx1.putString("entropy", "CM");
+    ctx1.putString("transform", "LZX+TEXT");
+    ctx1.putInt("blockSize", blockSize);
+    ctx1.putInt("checksum", 32);
+    ctx1.setDictionary(&dict);
+    CompressedOutputStream* cos = new CompressedOutputStream(ios, ctx1);
+    cos->write((const char*)&block[blockSize], length - blockSize);
+    cos->close();
+    delete cos;
+    uint64 res = 0;
+
+    // Decode with the dictionary, without dictionary and with another dictionary
+    for (int i = 0; i < 3; i++) {
+        string s = buffer.str();
+        stringbuf buffer2(s);
+        istream is(&buffer2);
+        Context ctx2;
+        Dictionary other(&block[1], blockSize);
+
+        if (i != 1)
+            ctx2.setDictionary((i == 0) ? &dict : &other);
+
+        CompressedInputStream* cis = new CompressedInputStream(is, ctx2);
+        kanzi::byte* out = new kanzi::byte[length];
+        streamsize decoded = 0;
+        int error = 0;
+
+        try {
+            while (decoded < streamsize(length)) {
+                cis->read((char*)&out[decoded], streamsize(length) - decoded);
+
+                if (cis->gcount() <= 0)
+                    break;
+
+                decoded += cis->gcount();
+            }
+
+            cis->close();
+        }
+        catch (const IOException& e) {
+            error = e.error();
+        }
+
+        delete cis;
+
+        if (i == 0) {
+            if ((decoded != streamsize(length - blockSize)) || (memcmp(&block[blockSize], out, size_t(decoded)) != 0)) {
+                cout << "Failure: invalid data decoded with the dictionary" << endl;
+                res = 1;
+            }
+        }
+        else if (error != ((i == 1) ? Error::ERR_MISSING_PARAM : Error::ERR_INVALID_PARAM)) {
+            cout << "Failure: " << ((i == 1) ? "missing" : "incorrect") << " dictionary not detected" << endl;
+            res = 1;
+        }
+
+        delete[] out;
+    }
+
+    return res;
+}
+
+uint64 compress10(kanzi::byte block[], uint length)
+{
+    cout << "Test - planner (BWT&ANS0, 4 jobs, memory budget)" << endl;
+    stringbuf buffer;
+    iostream ios(&buffer);
+    Context ctx1;
+    ctx1.putInt("jobs", 4);
+    ctx1.putString("entropy", "ANS0");
+    ctx1.putString("transform", "BWT");
+    ctx1.putInt("blockSize", 4 * 1024 * 1024);
+    ctx1.putInt("autoBlock", 1);
+    ctx1.putLong("fileSize", length);
+
+    // Without budget: one block per job, but no block below 4 MB for the BWT
+    BlockPlan plan = BlockPlanner::plan(ctx1);
+    const int expectedSize = int(min(uint(4 * 1024 * 1024), (length + 15) & ~15u));
+
+    if ((plan._blockSize != expectedSize) || (plan._tasks != 1)) {
+        cout << "Failure: unexpected plan " << plan.toString() << endl;
+        return 1;
+    }
+
+    // Smaller blocks and a budget allowing only 2 blocks in flight
+    ctx1.putInt("autoBlock", 0);
+    ctx1.putInt("blockSize", length / 8);
+    BlockPlanner planner(TransformFactory<kanzi::byte>::BWT_TYPE, EntropyEncoderFactory::ANS0_TYPE, 4, 0);
+    ctx1.putLong("maxMemory", planner.getMemory(length / 8, 1) + 1);
+    plan = BlockPlanner::plan(ctx1);
+    cout << plan.toString() << endl;
+
+    if ((plan._blockSize != int(length / 8)) || (plan._tasks != 1) || (plan.isOverBudget() == true) ||
+        (ctx1.getInt("blockTasks") != 1)) {
+        cout << "Failure: the plan does not respect the budget" << endl;
+        return 1;
+    }
+
+    CompressedOutputStream* cos = new CompressedOutputStream(ios, ctx1);
+    cos->write((const char*)block, length);
+    cos->close();
+    delete cos;
+    string s = buffer.str();
+    stringbuf buffer2(s);
+    istream is(&buffer2);
+    Context ctx2;
+    ctx2.putInt("jobs", 4);
+    CompressedInputStream* cis = new CompressedInputStream(is, ctx2);
+    kanzi::byte* out = new kanzi::byte[length];
+    streamsize decoded = 0;
+
+    while (decoded < streamsize(length)) {
+        cis->read((char*)&out[decoded], streamsize(length) - decoded);
+
+        if (cis->gcount() <= 0)
+            break;
+
+        decoded += cis->gcount();
+    }
+
+    cis->close();
+    delete cis;
+    uint64 res = ((decoded != streamsize(length)) || (memcmp(&block[0], out, size_t(length)) != 0)) ? 1 : 0;
+    delete[] out;
+    return res;
+}
+
+class MemoryListener : public Listener<Event> {
+public:
+    int _blocks;
+    int64 _memory;
+
+    MemoryListener() : _blocks(0), _memory(0) {}
+
+    void processEvent(const Event& evt)
+    {
+        if (evt.getType() != Event::MEMORY_INFO)
+            return;
+
+        _blocks++;
+        _memory = max(_memory, evt.getSize());
+    }
+};
+
+uint64 compress11(kanzi::byte block[], uint length)
+{
+    cout << "Test - memory budget (BWTS&TPAQX, 4 jobs)" << endl;
+    const int blockSize = int(length / 8) & -16;
+    stringbuf buffer;
+    iostream ios(&buffer);
+    Context ctx1;
+    ctx1.putInt("jobs", 4);
+    ctx1.putString("entropy", "TPAQX");
+    ctx1.putString("transform", "BWTS");
+    ctx1.putInt("blockSize", blockSize);
+
+    // Enough memory for one block with TPAQ, not with TPAQX
+    BlockPlanner planner(TransformFactory<kanzi::byte>::BWTS_TYPE, EntropyEncoderFactory::TPAQ_TYPE, 4, 0);
+    ctx1.putLong("maxMemory", planner.getMemory(blockSize, 1) + 1);
+    MemoryListener listener1;
+    CompressedOutputStream* cos = new CompressedOutputStream(ios, ctx1);
+    cos->addListener(listener1);
+    cos->write((const char*)block, length);
+    cos->close();
+    delete cos;
+
+    if ((ctx1.getString("entropy") != "TPAQ") || (ctx1.getString("transform") != "BWTS")) {
+        cout << "Failure: expected BWTS&TPAQ, got " << ctx1.getString("transform") << "&" << ctx1.getString("entropy") << endl;
+        return 1;
+    }
+
+    if ((listener1._blocks != int((length + blockSize - 1) / blockSize)) || (listener1._memory <= blockSize)) {
+        cout << "Failure: unexpected memory events (" << listener1._blocks << " blocks)" << endl;
+        return 1;
+    }
+
+    // Decode one block at a time
+    string s = buffer.str();
+    stringbuf buffer2(s);
+    istream is(&buffer2);
+    Context ctx2;
+    ctx2.putInt("jobs", 4);
+    ctx2.putLong("maxMemory", 1);
+    MemoryListener listener2;
+    CompressedInputStream* cis = new CompressedInputStream(is, ctx2);
+    cis->addListener(listener2);
+    kanzi::byte* out = new kanzi::byte[length];
+    streamsize decoded = 0;
+
+    while (decoded < streamsize(length)) {
+        cis->read((char*)&out[decoded], streamsize(length) - decoded);
+
+        if (cis->gcount() <= 0)
+            break;
+
+        decoded += cis->gcount();
+    }
+
+    cis->close();
+    delete cis;
+    uint64 res = ((decoded != streamsize(length)) || (memcmp(&block[0], out, size_t(length)) != 0)) ? 1 : 0;
+    delete[] out;
+
+    if (listener2._blocks < listener1._blocks) {
+        cout << "Failure: unexpected memory events (" << listener2._blocks << " blocks)" << endl;
+        res = 1;
+    }
+
+    return res;
+}
+
+// Compress 'length' bytes with the parameters of the context, return the bitstream
+static string compressWith(Context& ctx, const kanzi::byte block[], uint length, bool headerless = false)
+{
+    stringbuf buffer;
+    iostream ios(&buffer);
+    CompressedOutputStream* cos = new CompressedOutputStream(ios, ctx, headerless);
+    cos->write((const char*)block, length);
+    cos->close();
+    delete cos;
+    return buffer.str();
+}
+
+// Collect the bit offsets of the blocks in the bitstream (verbosity > 4)
+class BlockInfoListener : public Listener<Event> {
+public:
+    vector<int64> _offsets;
+
+    void processEvent(const Event& evt)
+    {
+        if (evt.getType() == Event::BLOCK_INFO)
+            _offsets.push_back(evt.getOffset());
+    }
+};
+
+uint64 compress12(kanzi::byte incompressible[], kanzi::byte values[], uint length)
+{
+    const int blockSize = 16384;
+    const int nbBlocks = 12;
+    int jobs = 1;
+    int decJobs = 1;
+
+#ifdef CONCURRENCY_ENABLED
+    jobs = 1 + (rand() & 3);
+    decJobs = 1 + (rand() & 3);
+#endif
+
+    cout << "Test - codecs chosen per block, " << jobs << " job(s)" << endl;
+    length = min(length, uint(nbBlocks * blockSize));
+    kanzi::byte* input = new kanzi::byte[length];
+    const char* words[] = { "error ", "warning ", "info ", "connection ", "closed ", "request ", "GET /index.html ", "\n" };
+
+    // Mix of text, random and low entropy blocks
+    for (uint i = 0; i < length; ) {
+        const int type = (i / blockSize) % 3;
+
+        if (type == 0) {
+            const char* w = words[rand() & 7];
+
+            for (; (*w != 0) && (i < length); w++)
+                input[i++] = kanzi::byte(*w);
+        }
+        else {
+            input[i] = (type == 1) ? incompressible[i] : values[i];
+            i++;
+        }
+    }
+
+    const string candidates = "LZX/NONE,TEXT+LZX/HUFFMAN,TEXT+LZX/CM,TEXT+BWT+RANK+ZRLT/ANS0";
+    Context ctx1;
+    ctx1.putInt("jobs", jobs);
+    ctx1.putString("entropy", "ANS0");
+    ctx1.putString("transform", "TEXT+BWT+RANK+ZRLT");
+    ctx1.putInt("blockSize", blockSize);
+    ctx1.putInt("checksum", 32);
+    ctx1.putString("autoCodecs", candidates);
+    const string s1 = compressWith(ctx1, input, length);
+
+    // Same stream with the fastest candidate only
+    Context ctx2(ctx1);
+    ctx2.putString("entropy", "NONE");
+    ctx2.putString("transform", "LZX");
+    ctx2.putString("autoCodecs", "");
+    const string s2 = compressWith(ctx2, input, length);
+    cout << "Size with per-block codecs: " << s1.length() << ", with LZX: " << s2.length() << endl;
+    uint64 res = 0;
+
+    // The whole block is the sample: no block is larger than with the first
+    // candidate, except for the codec types in the block headers
+    if (s1.length() > s2.length() + 8 * nbBlocks) {
+        cout << "Failure: the chosen codecs compress worse than the first candidate" << endl;
+        res = 1;
+    }
+
+    // Decode the headered stream, then the headerless stream with the encoder context
+    for (int i = 0; i < 2; i++) {
+        Context ctx3(ctx1);
+        const string s = (i == 0) ? s1 : compressWith(ctx3, input, length, true);
+        stringbuf buffer2(s);
+        istream is(&buffer2);
+        Context ctx4;
+
+        if (i == 1)
+            ctx4 = ctx1;
+
+        ctx4.putInt("jobs", decJobs);
+        CompressedInputStream* cis = new CompressedInputStream(is, ctx4, i == 1);
+        kanzi::byte* out = new kanzi::byte[length];
+        streamsize decoded = 0;
+
+        while (decoded < streamsize(length)) {
+            cis->read((char*)&out[decoded], streamsize(length) - decoded);
+
+            if (cis->gcount() <= 0)
+                break;
+
+            decoded += cis->gcount();
+        }
+
+        cis->close();
+        delete cis;
+
+        if ((decoded != streamsize(length)) || (memcmp(&input[0], out, size_t(length)) != 0)) {
+            cout << "Failure: invalid data decoded (" << ((i == 0) ? "headered" : "headerless") << " stream)" << endl;
+            res = 1;
+        }
+
+        delete[] out;
+    }
+
+    // Solid lanes need a fixed codec
+    try {
+        Context ctx5(ctx1);
+        ctx5.putInt("solid", 2);
+        ctx5.putString("entropy", "CM");
+        compressWith(ctx5, input, length);
+        cout << "Failure: solid mode accepted with codecs chosen per block" << endl;
+        res = 1;
+    }
+    catch (const invalid_argument&) {
+    }
+
+    delete[] input;
+
+    // Large blocks (the sample is 1/8 of the block): text, random and low
+    // entropy blocks. The codecs of each block are read from its header.
+    const int bigBlockSize = 1024 * 1024;
+    const uint bigLength = 3 * bigBlockSize;
+    input = new kanzi::byte[bigLength];
+
+    for (uint i = 0; i < bigLength; ) {
+        const int type = (i / bigBlockSize) % 3;
+
+        if (type == 0) {
+            const char* w = words[rand() & 7];
+
+            for (; (*w != 0) && (i < bigLength); w++)
+                input[i++] = kanzi::byte(*w);
+        }
+        else {
+            input[i++] = kanzi::byte((type == 1) ? rand() : 65 + (rand() & 3));
+        }
+    }
+
+    Context ctx6(ctx1);
+    ctx6.putInt("blockSize", bigBlockSize);
+    ctx6.putInt("verbosity", 5);
+    BlockInfoListener listener;
+    stringbuf buffer6;
+    iostream ios6(&buffer6);
+    CompressedOutputStream* cos = new CompressedOutputStream(ios6, ctx6);
+    cos->addListener(listener);
+    cos->write((const char*)input, bigLength);
+    cos->close();
+    delete cos;
+    const string s6 = buffer6.str();
+    const BlockSelector selector(candidates);
+    int chosen[3] = { -2, -2, -2 }; // -1 for a copy block
+
+    for (size_t n = 0; (n < listener._offsets.size()) && (n < 3); n++) {
+        // Block: size (32 bits), mode, skip flags (if TRANSFORMS_MASK), transforms (48 bits), entropy
+        const size_t pos = size_t(listener._offsets[n] >> 3) + 4;
+
+        if (pos + 8 > s6.length())
+            break;
+
+        const uint8 mode = uint8(s6[pos]);
+
+        if ((mode & 0x80) != 0) {
+            chosen[n] = -1;
+            continue;
+        }
+
+        const size_t idx = pos + (((mode & 0x10) != 0) ? 2 : 1);
+        uint64 tType = 0;
+
+        for (int j = 0; j < 6; j++)
+            tType = (tType << 8) | uint64(uint8(s6[idx + j]));
+
+        const short eType = short(uint8(s6[idx + 6]) >> 3);
+
+        for (int j = 0; j < selector.size(); j++) {
+            if ((selector.getTransformType(j) == tType) && (selector.getEntropyType(j) == eType))
+                chosen[n] = j;
+        }
+    }
+
+    cout << "Codecs of the 1 MB blocks: " << chosen[0] << ", " << chosen[1] << ", " << chosen[2] << endl;
+
+    // Text: an entropy codec beats LZX alone. Random: copy block.
+    // Low entropy: an entropy codec is needed.
+    if ((listener._offsets.size() != 3) || (chosen[0] < 1) || (chosen[1] != -1) || (chosen[2] < 1)) {
+        cout << "Failure: unexpected codecs in the block headers" << endl;
+        res = 1;
+    }
+
+    stringbuf buffer7(s6);
+    istream is7(&buffer7);
+    Context ctx7;
+    ctx7.putInt("jobs", decJobs);
+    CompressedInputStream* cis = new CompressedInputStream(is7, ctx7);
+    kanzi::byte* out = new kanzi::byte[bigLength];
+    streamsize decoded = 0;
+
+    while (decoded < streamsize(bigLength)) {
+        cis->read((char*)&out[decoded], streamsize(bigLength) - decoded);
+
+        if (cis->gcount() <= 0)
+            break;
+
+        decoded += cis->gcount();
+    }
+
+    cis->close();
+    delete cis;
+
+    if ((decoded != streamsize(bigLength)) || (memcmp(&input[0], out, size_t(bigLength)) != 0)) {
+        cout << "Failure: invalid data decoded (1 MB blocks)" << endl;
+        res = 1;
+    }
+
+    delete[] out;
+    delete[] input;
+    return res;
+}
+
 int testCorrectness(int, const char*[])
 {
     // Test correctness
@@ -272,6 +918,12 @@ int testCorrectness(int, const char*[])
         cres = compress3(incompressible, length);
         cout << ((cres == 0) ? "Success" : "Failure") << endl;
         res &= (cres == 0);
+        cres = compress7(values, length);
+        cout << ((cres == 0) ? "Success" : "Failure") << endl;
+        res &= (cres == 0);
+        cres = compress8(values, length, "CM");
+        cout << ((cres == 0) ? "Success" : "Failure") << endl;
+        res &= (cres == 0);
 
         if (test == 1) {
             cres = compress4(values, length);
@@ -283,6 +935,21 @@ int testCorrectness(int, const char*[])
             cres = compress6(values);
             cout << ((cres == 0) ? "Success" : "Failure") << endl;
             res &= (cres == 0);
+            cres = compress8(values, length, "TPAQ");
+            cout << ((cres == 0) ? "Success" : "Failure") << endl;
+            res &= (cres == 0);
+            cres = compress9(values, length);
+            cout << ((cres == 0) ? "Success" : "Failure") << endl;
+            res &= (cres == 0);
+            cres = compress10(values, length);
+            cout << ((cres == 0) ? "Success" : "Failure") << endl;
+            res &= (cres == 0);
+            cres = compress11(values, length);
+            cout << ((cres == 0) ? "Success" : "Failure") << endl;
+            res &= (cres == 0);
+            cres = compress12(incompressible, values, length);
+            cout << ((cres == 0) ? "Success" : "Failure") << endl;
+            res &= (cres == 0);
         }
     }
 
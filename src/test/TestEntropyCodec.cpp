@@ -356,6 +356,181 @@ int testHuffmanFragmentedRoundTrip()
     return 0;
 }
 
+int testHuffmanStreamsRoundTrip()
+{
+    cout << endl
+         << "=== Huffman interleaved streams round-trip test ===" << endl;
+    const uint size = 200000;
+    vector<kanzi::byte> values(size);
+    vector<kanzi::byte> decoded(size);
+    uint32 state = 1234567U;
+
+    // Chunks of various sizes to cover 4, 8, 16 and 32 streams
+    for (uint i = 0; i < size; i++) {
+        state = (state * 1103515245U) + 12345U;
+        const uint32 val = state >> 16;
+        values[i] = (val % 5 == 0) ? kanzi::byte(val >> 8) : kanzi::byte(val & 31);
+    }
+
+    const uint sizes[] = { 40, 2047, 4100, 9000, 16384, size };
+    int res = 0;
+
+    // Decode with all the kernels available on this host
+    for (int level = CPUFeatures::getSIMDLevel(); level >= CPUFeatures::SCALAR; level--) {
+        CPUFeatures::setMaxSIMDLevel(CPUFeatures::SIMDLevel(level));
+
+        for (int n = 0; n < 6; n++) {
+            stringbuf buffer;
+            iostream ios(&buffer);
+            DefaultOutputBitStream obs(ios, 1 << 15);
+            HuffmanEncoder encoder(obs);
+            encoder.encode(&values[0], 0, sizes[n]);
+            encoder.dispose();
+            obs.close();
+            ios.rdbuf()->pubseekpos(0);
+            DefaultInputBitStream ibs(ios, 1 << 15);
+            HuffmanDecoder decoder(ibs);
+            memset(&decoded[0], 0, size);
+
+            if ((decoder.decode(&decoded[0], 0, sizes[n]) != int(sizes[n])) ||
+                (memcmp(&values[0], &decoded[0], sizes[n]) != 0)) {
+                cout << "Mismatch in Huffman streams round-trip test (";
+                cout << CPUFeatures::getName(CPUFeatures::SIMDLevel(level)) << ", " << sizes[n] << " bytes)" << endl;
+                res = 1;
+            }
+
+            decoder.dispose();
+            ibs.close();
+        }
+    }
+
+    CPUFeatures::setMaxSIMDLevel(CPUFeatures::AVX512);
+
+    if (res == 0)
+        cout << "Huffman interleaved streams round-trip test passed" << endl;
+
+    return res;
+}
+
+int testANSStatesRoundTrip()
+{
+    cout << endl
+         << "=== ANS interleaved states round-trip test ===" << endl;
+    const uint size = 200000;
+    vector<kanzi::byte> values(size);
+    vector<kanzi::byte> decoded(size);
+    uint32 state = 7654321U;
+
+    // Skewed distribution with rare symbols (frequent renormalizations)
+    for (uint i = 0; i < size; i++) {
+        state = (state * 1103515245U) + 12345U;
+        const uint32 val = state >> 16;
+        values[i] = (val % 7 == 0) ? kanzi::byte(val >> 8) : kanzi::byte(val & 3);
+    }
+
+    // Sizes not multiple of the number of states and several chunks
+    const uint sizes[] = { 33, 1000, 16383, 16416, 50001, size };
+    int res = 0;
+
+    // Decode with all the kernels available on this host
+    for (int level = CPUFeatures::getSIMDLevel(); level >= CPUFeatures::SCALAR; level--) {
+        CPUFeatures::setMaxSIMDLevel(CPUFeatures::SIMDLevel(level));
+
+        for (int n = 0; n < 6; n++) {
+            stringbuf buffer;
+            iostream ios(&buffer);
+            DefaultOutputBitStream obs(ios, 1 << 15);
+            ANSRangeEncoder encoder(obs, 0, ANSRangeEncoder::DEFAULT_ANS0_CHUNK_SIZE,
+                                    ANSRangeEncoder::DEFAULT_LOG_RANGE, ANSRangeEncoder::MAX_STATES);
+            encoder.encode(&values[0], 0, sizes[n]);
+            encoder.dispose();
+            obs.close();
+            ios.rdbuf()->pubseekpos(0);
+            DefaultInputBitStream ibs(ios, 1 << 15);
+            ANSRangeDecoder decoder(ibs, 0, ANSRangeDecoder::DEFAULT_ANS0_CHUNK_SIZE, ANSRangeDecoder::MAX_STATES);
+            memset(&decoded[0], 0, size);
+
+            if ((decoder.decode(&decoded[0], 0, sizes[n]) != int(sizes[n])) ||
+                (memcmp(&values[0], &decoded[0], sizes[n]) != 0)) {
+                cout << "Mismatch in ANS states round-trip test (";
+                cout << CPUFeatures::getName(CPUFeatures::SIMDLevel(level)) << ", " << sizes[n] << " bytes)" << endl;
+                res = 1;
+            }
+
+            decoder.dispose();
+            ibs.close();
+        }
+    }
+
+    CPUFeatures::setMaxSIMDLevel(CPUFeatures::AVX512);
+
+    if (res == 0)
+        cout << "ANS interleaved states round-trip test passed" << endl;
+
+    return res;
+}
+
+static string encodeTPAQ(Context& ctx, ModelArena* arena, const kanzi::byte block[], uint size)
+{
+    stringbuf encoded;
+    iostream ios(&encoded);
+    DefaultOutputBitStream obs(ios, 16384);
+    BinaryEntropyEncoder encoder(obs, new TPAQPredictor<false>(&ctx, arena), true);
+    const int res = encoder.encode(block, 0, size);
+    encoder.dispose();
+    obs.close();
+    return (res == int(size)) ? encoded.str() : "";
+}
+
+int testTPAQArenaReuse()
+{
+    cout << endl
+         << "=== TPAQ model arena reuse test ===" << endl;
+    const uint size = 100000;
+    vector<kanzi::byte> values(size);
+    vector<kanzi::byte> decoded(size);
+    uint32 state = 1234567U;
+
+    for (uint i = 0; i < size; i++) {
+        state = (state * 1103515245U) + 12345U;
+        values[i] = kanzi::byte((i & 1) == 0 ? (state >> 24) & 0x0F : 'a' + (i % 13));
+    }
+
+    // Dirty the arena with a bigger model, then encode and decode a smaller
+    // block with the same arena. The output must match a fresh model.
+    ModelArena arena;
+    Context bigCtx;
+    bigCtx.putInt(Context::BLOCK_SIZE, 4 * 1024 * 1024);
+    bigCtx.putInt(Context::SIZE, int(size));
+    Context ctx;
+    ctx.putInt(Context::BLOCK_SIZE, 65536);
+    ctx.putInt(Context::SIZE, 65536);
+    encodeTPAQ(bigCtx, &arena, &values[0], size);
+    const string expected = encodeTPAQ(ctx, nullptr, &values[size - 65536], 65536);
+    const string actual = encodeTPAQ(ctx, &arena, &values[size - 65536], 65536);
+
+    if ((expected.length() == 0) || (expected != actual)) {
+        cout << "Mismatch in TPAQ model arena reuse test (encoding)" << endl;
+        return 1;
+    }
+
+    stringbuf buffer(actual);
+    iostream ios(&buffer);
+    DefaultInputBitStream ibs(ios, 16384);
+    BinaryEntropyDecoder decoder(ibs, new TPAQPredictor<false>(&ctx, &arena), true);
+
+    if ((decoder.decode(&decoded[0], 0, 65536) != 65536) ||
+        (memcmp(&values[size - 65536], &decoded[0], 65536) != 0)) {
+        cout << "Mismatch in TPAQ model arena reuse test (decoding)" << endl;
+        return 1;
+    }
+
+    decoder.dispose();
+    ibs.close();
+    cout << "TPAQ model arena reuse test passed" << endl;
+    return 0;
+}
+
 class ConstantPredictor FINAL : public Predictor
 {
 public:
@@ -394,6 +569,10 @@ static EntropyEncoder* getEncoder(string name, OutputBitStream& obs, Predictor*
     if (name.compare("ANS1") == 0)
         return new ANSRangeEncoder(obs, 1);
 
+    if (name.compare("ANS0X") == 0)
+        return new ANSRangeEncoder(obs, 0, ANSRangeEncoder::DEFAULT_ANS0_CHUNK_SIZE,
+                                   ANSRangeEncoder::DEFAULT_LOG_RANGE, ANSRangeEncoder::MAX_STATES);
+
     if (name.compare("RANGE") == 0)
         return new RangeEncoder(obs);
 
@@ -426,6 +605,9 @@ static EntropyDecoder* getDecoder(string name, InputBitStream& ibs, Predictor* p
     if (name.compare("ANS1") == 0)
         return new ANSRangeDecoder(ibs, 1);
 
+    if (name.compare("ANS0X") == 0)
+        return new ANSRangeDecoder(ibs, 0, ANSRangeDecoder::DEFAULT_ANS0_CHUNK_SIZE, ANSRangeDecoder::MAX_STATES);
+
     if (name.compare("RANGE") == 0)
         return new RangeDecoder(ibs);
 
@@ -717,18 +899,21 @@ int TestEntropyCodec_main(int argc, const char* argv[])
         res |= testDeclaredPayloadConsumption();
         res |= testFPAQZeroDeclaredSize();
         res |= testHuffmanFragmentedRoundTrip();
+        res |= testHuffmanStreamsRoundTrip();
+        res |= testANSStatesRoundTrip();
+        res |= testTPAQArenaReuse();
         vector<string> codecs;
         bool doPerf = true;
 
         if (argc == 1) {
 #if __cplusplus < 201103L
-            string allCodecs[] = { "HUFFMAN", "ANS0", "ANS1", "RANGE", "EXPGOLOMB", "CM", "TPAQ" };
+            string allCodecs[] = { "HUFFMAN", "ANS0", "ANS0X", "ANS1", "RANGE", "EXPGOLOMB", "CM", "TPAQ" };
             const int count = int(sizeof(allCodecs) / sizeof(allCodecs[0]));
 
             for (int i = 0; i < count; i++)
                 codecs.push_back(allCodecs[i]);
 #else
-            codecs = { "HUFFMAN", "ANS0", "ANS1", "RANGE", "EXPGOLOMB", "CM", "TPAQ" };
+            codecs = { "HUFFMAN", "ANS0", "ANS0X", "ANS1", "RANGE", "EXPGOLOMB", "CM", "TPAQ" };
 #endif
         }
         else {
@@ -737,13 +922,13 @@ int TestEntropyCodec_main(int argc, const char* argv[])
 
             if (str == "-TYPE=ALL") {
 #if __cplusplus < 201103L
-               string allCodecs[] = { "HUFFMAN", "ANS0", "ANS1", "RANGE", "EXPGOLOMB", "CM", "TPAQ" };
+               string allCodecs[] = { "HUFFMAN", "ANS0", "ANS0X", "ANS1", "RANGE", "EXPGOLOMB", "CM", "TPAQ" };
                const int count = int(sizeof(allCodecs) / sizeof(allCodecs[0]));
 
                for (int i = 0; i < count; i++)
                    codecs.push_back(allCodecs[i]);
 #else
-               codecs = { "HUFFMAN", "ANS0", "ANS1", "RANGE", "EXPGOLOMB", "CM", "TPAQ" };
+               codecs = { "HUFFMAN", "ANS0", "ANS0X", "ANS1", "RANGE", "EXPGOLOMB", "CM", "TPAQ" };
 #endif
             }
             else {
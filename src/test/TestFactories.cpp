@@ -154,6 +154,8 @@ static int testEntropyFactories()
         "NONE entropy encoder must be case insensitive");
     ASSERT_TRUE(EntropyDecoderFactory::getType("ans0") == EntropyDecoderFactory::ANS0_TYPE,
         "ANS0 entropy decoder must be case insensitive");
+    ASSERT_TRUE(string(EntropyEncoderFactory::getName(EntropyEncoderFactory::ANS0X_TYPE)) == "ANS0X",
+        "Encoder name must round-trip");
     ASSERT_TRUE(string(EntropyEncoderFactory::getName(EntropyEncoderFactory::HUFFMAN_TYPE)) == "HUFFMAN",
         "Encoder name must round-trip");
     ASSERT_TRUE(string(EntropyDecoderFactory::getName(EntropyDecoderFactory::TPAQX_TYPE)) == "TPAQX",
@@ -177,6 +179,7 @@ static int testEntropyFactories()
         EntropyEncoderFactory::newEncoder(obs, ctx, EntropyEncoderFactory::HUFFMAN_TYPE),
         EntropyEncoderFactory::newEncoder(obs, ctx, EntropyEncoderFactory::RANGE_TYPE),
         EntropyEncoderFactory::newEncoder(obs, ctx, EntropyEncoderFactory::ANS0_TYPE),
+        EntropyEncoderFactory::newEncoder(obs, ctx, EntropyEncoderFactory::ANS0X_TYPE),
         EntropyEncoderFactory::newEncoder(obs, ctx, EntropyEncoderFactory::ANS1_TYPE),
         EntropyEncoderFactory::newEncoder(obs, ctx, EntropyEncoderFactory::FPAQ_TYPE),
         EntropyEncoderFactory::newEncoder(obs, ctx, EntropyEncoderFactory::CM_TYPE),
@@ -199,6 +202,7 @@ static int testEntropyFactories()
         EntropyDecoderFactory::newDecoder(ibs, ctx, EntropyDecoderFactory::HUFFMAN_TYPE),
         EntropyDecoderFactory::newDecoder(ibs, ctx, EntropyDecoderFactory::RANGE_TYPE),
         EntropyDecoderFactory::newDecoder(ibs, ctx, EntropyDecoderFactory::ANS0_TYPE),
+        EntropyDecoderFactory::newDecoder(ibs, ctx, EntropyDecoderFactory::ANS0X_TYPE),
         EntropyDecoderFactory::newDecoder(ibs, ctx, EntropyDecoderFactory::ANS1_TYPE),
         EntropyDecoderFactory::newDecoder(ibs, ctx, EntropyDecoderFactory::FPAQ_TYPE),
         EntropyDecoderFactory::newDecoder(ibs, ctx, EntropyDecoderFactory::CM_TYPE),
@@ -97,9 +97,8 @@ static string buildHeader(int type, int bsVersion, uint64 checksumSize, short en
     return buffer.str();
 }
 
-static string buildMalformedBlockStream()
+static string buildMalformedBlockStream(int version)
 {
-    const int version = 6;
     const int type = 0x4B414E5A;
     const int blockSize = 1024;
     const short entropy = EntropyDecoderFactory::NONE_TYPE;
@@ -122,8 +121,15 @@ static string buildMalformedBlockStream()
     iostream io(&buffer);
     DefaultOutputBitStream obs(io, 16384);
     obs.writeBits(reinterpret_cast<const kanzi::byte*>(header.data()), uint(header.size() << 3));
-    obs.writeBits(uint64(5), 5); // 3 + 5 = 8 bits to encode blockBits below
-    obs.writeBits(blockBits, 8);
+    if (version >= 7) {
+        // The header is byte aligned, so is the block
+        obs.writeBits(uint64(block.size()), 32);
+    }
+    else {
+        obs.writeBits(uint64(5), 5); // 3 + 5 = 8 bits to encode blockBits below
+        obs.writeBits(blockBits, 8);
+    }
+
     obs.writeBits(reinterpret_cast<const kanzi::byte*>(block.data()), uint(blockBits));
     obs.close();
     return buffer.str();
@@ -183,7 +189,7 @@ static int expectBlockFailure(const string& name, const string& data,
 
 int main()
 {
-    const int version = 6;
+    const int version = 7;
     const int type = 0x4B414E5A;
     const int blockSize = 1024;
     const short entropy = EntropyDecoderFactory::ANS0_TYPE;
@@ -232,7 +238,13 @@ int main()
     }
 
     if (expectBlockFailure("zero pre-transform length",
-            buildMalformedBlockStream(),
+            buildMalformedBlockStream(version),
+            Error::ERR_READ_FILE, "Invalid compressed block length") != 0) {
+        return 1;
+    }
+
+    if (expectBlockFailure("zero pre-transform length (bsVersion 6)",
+            buildMalformedBlockStream(6),
             Error::ERR_READ_FILE, "Invalid compressed block length") != 0) {
         return 1;
     }
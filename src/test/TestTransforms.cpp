@@ -14,12 +14,16 @@ limitations under the License.
 */
 
 #include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <time.h>
 #include <vector>
+#include "../Dictionary.hpp"
+#include "../Global.hpp"
 #include "../types.hpp"
 #include "../util/strings.hpp"
 #include "../transform/AliasCodec.hpp"
+#include "../transform/BlockStats.hpp"
 #include "../transform/BWT.hpp"
 #include "../transform/BWTS.hpp"
 #include "../transform/EXECodec.hpp"
@@ -29,9 +33,11 @@ limitations under the License.
 #include "../transform/RLT.hpp"
 #include "../transform/ROLZCodec.hpp"
 #include "../transform/SBRT.hpp"
+#include "../transform/SBRTZRLT.hpp"
 #include "../transform/SRT.hpp"
 #include "../transform/TextCodec.hpp"
 #include "../transform/TransformFactory.hpp"
+#include "../transform/UTFCodec.hpp"
 #include "../transform/ZRLT.hpp"
 
 using namespace std;
@@ -368,6 +374,78 @@ static int testTextCodecSelfDescribing()
     return 0;
 }
 
+// The stream reuses its transforms between blocks: a block with a larger
+// dictionary must not overflow the dictionary allocated for a previous block.
+static int testTextCodecReuse()
+{
+    cout << endl
+         << "Correctness for TextCodec reused with growing blocks" << endl;
+    srand(12345);
+    vector<string> words;
+
+    for (int i = 0; i < 40000; i++) {
+        string w;
+        const int len = 4 + rand() % 6;
+
+        for (int j = 0; j < len; j++)
+            w += char('a' + rand() % 26);
+
+        words.push_back(w);
+    }
+
+    for (int encType = 1; encType <= 2; encType++) {
+        Context encCtx;
+        encCtx.putInt("textcodec", encType);
+        encCtx.putInt("bsVersion", 7);
+        encCtx.putInt("blockSize", 4 << 20);
+        Context decCtx(encCtx);
+        TextCodec encoder(encCtx);
+        TextCodec decoder(decCtx);
+
+        // Small vocabulary first, then a block large enough for a bigger dictionary
+        for (int n = 0; n < 2; n++) {
+            string sample;
+            const int vocabulary = (n == 0) ? 100 : int(words.size());
+            const size_t length = (n == 0) ? size_t(65536) : size_t(4 << 20);
+
+            while (sample.size() < length)
+                sample += words[rand() % vocabulary] + " ";
+
+            sample.resize(length);
+            vector<kanzi::byte> data(sample.size());
+
+            for (size_t i = 0; i < sample.size(); i++)
+                data[i] = kanzi::byte(sample[i]);
+
+            vector<kanzi::byte> encoded(encoder.getMaxEncodedLength(int(data.size())), kanzi::byte(0));
+            SliceArray<kanzi::byte> input(&data[0], int(data.size()), 0);
+            SliceArray<kanzi::byte> output(&encoded[0], int(encoded.size()), 0);
+
+            if (encoder.forward(input, output, int(data.size())) == false) {
+                cout << "Encoding error for TextCodec" << encType << endl;
+                return 1;
+            }
+
+            vector<kanzi::byte> decoded(data.size(), kanzi::byte(0));
+            SliceArray<kanzi::byte> encodedInput(&encoded[0], int(encoded.size()), 0);
+            SliceArray<kanzi::byte> reverse(&decoded[0], int(decoded.size()), 0);
+
+            if (decoder.inverse(encodedInput, reverse, output._index) == false) {
+                cout << "Decoding error for TextCodec" << encType << endl;
+                return 1;
+            }
+
+            if ((reverse._index != int(data.size())) || (memcmp(&data[0], &decoded[0], data.size()) != 0)) {
+                cout << "Round-trip mismatch for TextCodec" << encType << endl;
+                return 1;
+            }
+        }
+    }
+
+    cout << "Identical" << endl;
+    return 0;
+}
+
 static int testZRLTMalformed()
 {
     cout << endl
@@ -861,13 +939,623 @@ static Transform<kanzi::byte>* getByteTransform(string name, Context& ctx)
     if (name.compare("NONE") == 0)
         return new NullTransform(ctx);
 
-    if (name.compare("ALIAS") == 0)
+    if ((name.compare("ALIAS") == 0) || (name.compare("PACK") == 0))
+        return new AliasCodec(ctx);
+
+    if (name.compare("DNA") == 0) {
+        ctx.putInt(Context::PACK_ONLY_DNA, 1);
         return new AliasCodec(ctx);
+    }
+
+    if (name.compare("TEXT") == 0)
+        return new TextCodec(ctx);
+
+    if (name.compare("UTF") == 0)
+        return new UTFCodec(ctx);
+
+    if (name.compare("EXE") == 0)
+        return new EXECodec(ctx);
 
     cout << "No such byte transform: " << name << endl;
     return nullptr;
 }
 
+// Small JSON message made of records with the same keys
+static string createJSONMessage(int length)
+{
+    static const char* names[] = { "alice", "bob", "carol", "dave", "erin", "frank" };
+    static const char* states[] = { "pending", "shipped", "delivered", "cancelled" };
+    string msg = "[";
+
+    while (msg.size() < size_t(length)) {
+        char buf[256];
+        snprintf(buf, sizeof(buf), "{\"orderId\": %d, \"customer\": {\"name\": \"%s\", \"email\": \"%s@example.com\"}, "
+            "\"status\": \"%s\", \"amount\": %d.%02d, \"currency\": \"EUR\"},\n",
+            rand() % 1000000, names[rand() % 6], names[rand() % 6], states[rand() % 4], rand() % 1000, rand() % 100);
+        msg += buf;
+    }
+
+    msg.resize(length);
+    return msg;
+}
+
+static int testDictionaryTransforms()
+{
+    cout << endl
+         << "Correctness for transforms with a dictionary" << endl;
+    srand(12345);
+    vector<kanzi::byte> samples;
+    vector<int> sizes;
+
+    for (int i = 0; i < 200; i++) {
+        string msg = createJSONMessage(1024 + rand() % 3072);
+
+        for (size_t j = 0; j < msg.size(); j++)
+            samples.push_back(kanzi::byte(msg[j]));
+        sizes.push_back(int(msg.size()));
+    }
+
+    Dictionary* dict = Dictionary::train(&samples[0], &sizes[0], int(sizes.size()), 16384);
+
+    if (dict == nullptr) {
+        cout << "Dictionary training failed" << endl;
+        return 1;
+    }
+
+    string names[6] = { "LZ", "LZX", "ROLZ", "ROLZX", "TEXT1", "TEXT2" };
+    int res = 0;
+
+    for (int n = 0; (n < 6) && (res == 0); n++) {
+        int sizeWith = 0;
+        int sizeWithout = 0;
+
+        for (int d = 0; (d < 2) && (res == 0); d++) {
+            Context ctx;
+            ctx.putInt("bsVersion", 7);
+            ctx.putString("transform", names[n]);
+            ctx.putInt("textcodec", (names[n] == "TEXT2") ? 2 : 1);
+
+            if (d == 1)
+                ctx.setDictionary(dict);
+
+            Context decCtx(ctx);
+            Transform<kanzi::byte>* encoder;
+            Transform<kanzi::byte>* decoder;
+
+            if (names[n].compare(0, 4, "TEXT") == 0) {
+                encoder = new TextCodec(ctx);
+                decoder = new TextCodec(decCtx);
+            }
+            else {
+                encoder = getByteTransform(names[n], ctx);
+                decoder = getByteTransform(names[n], decCtx);
+            }
+
+            // Several messages with the same transforms. The last ones are
+            // copies of the end of the dictionary: their matches start in
+            // the dictionary prefix, at the distance of the block size.
+            for (int i = 0; i < 10; i++) {
+                vector<kanzi::byte> data;
+
+                if (i < 8) {
+                    string msg = createJSONMessage(1024 << (i & 3));
+
+                    for (size_t j = 0; j < msg.size(); j++)
+                        data.push_back(kanzi::byte(msg[j]));
+                }
+                else {
+                    const int length = min(dict->size(), 1024 << (i & 1));
+                    data.assign(&dict->data()[dict->size() - length], &dict->data()[dict->size()]);
+                }
+
+                vector<kanzi::byte> encoded(encoder->getMaxEncodedLength(int(data.size())), kanzi::byte(0));
+                SliceArray<kanzi::byte> input(&data[0], int(data.size()), 0);
+                SliceArray<kanzi::byte> output(&encoded[0], int(encoded.size()), 0);
+
+                if (encoder->forward(input, output, int(data.size())) == false) {
+                    cout << "Encoding error for " << names[n] << endl;
+                    res = 1;
+                    break;
+                }
+
+                if (d == 0)
+                    sizeWithout += output._index;
+                else
+                    sizeWith += output._index;
+
+                vector<kanzi::byte> decoded(data.size(), kanzi::byte(0));
+                SliceArray<kanzi::byte> encodedInput(&encoded[0], int(encoded.size()), 0);
+                SliceArray<kanzi::byte> reverse(&decoded[0], int(decoded.size()), 0);
+
+                if ((decoder->inverse(encodedInput, reverse, output._index) == false) || (reverse._index != int(data.size())) ||
+                    (memcmp(&data[0], &decoded[0], data.size()) != 0)) {
+                    cout << "Round-trip mismatch for " << names[n] << (d == 1 ? " with" : " without") << " dictionary" << endl;
+                    res = 1;
+                    break;
+                }
+            }
+
+            delete encoder;
+            delete decoder;
+        }
+
+        if (res == 0) {
+            cout << names[n] << ": " << sizeWithout << " => " << sizeWith << " bytes with dictionary" << endl;
+
+            if (sizeWith >= sizeWithout) {
+                cout << "No improvement with the dictionary" << endl;
+                res = 1;
+            }
+        }
+    }
+
+    delete dict;
+
+    if (res == 0)
+        cout << "Identical" << endl;
+
+    return res;
+}
+
+// Large blocks are split into segments processed concurrently. The output
+// must not depend on the number of jobs.
+static int testSegmentedTransforms()
+{
+    cout << endl
+         << "Correctness for transforms of large blocks (segments)" << endl;
+    srand(54321);
+    const string msg = createJSONMessage(48 * 1024 * 1024 + 12345);
+    vector<kanzi::byte> data(msg.size());
+
+    for (size_t j = 0; j < msg.size(); j++)
+        data[j] = kanzi::byte(msg[j]);
+
+    string names[3] = { "LZX", "ROLZ", "ROLZX" };
+    const int count = int(data.size());
+    int res = 0;
+
+    for (int n = 0; (n < 3) && (res == 0); n++) {
+        vector<kanzi::byte> encoded1;
+
+        for (int jobs = 1; (jobs <= 3) && (res == 0); jobs += 2) {
+            Context ctx;
+            ctx.putInt("bsVersion", 7);
+            ctx.putInt("jobs", jobs);
+            ctx.putString("transform", names[n]);
+            Context decCtx(ctx);
+            Transform<kanzi::byte>* encoder = getByteTransform(names[n], ctx);
+            Transform<kanzi::byte>* decoder = getByteTransform(names[n], decCtx);
+            vector<kanzi::byte> encoded(encoder->getMaxEncodedLength(count), kanzi::byte(0));
+            SliceArray<kanzi::byte> input(&data[0], count, 0);
+            SliceArray<kanzi::byte> output(&encoded[0], int(encoded.size()), 0);
+
+            if (encoder->forward(input, output, count) == false) {
+                cout << "Encoding error for " << names[n] << endl;
+                res = 1;
+            }
+            else if (LittleEndian::readInt32(&encoded[0]) != 0) {
+                cout << "Block not segmented for " << names[n] << endl;
+                res = 1;
+            }
+            else {
+                encoded.resize(output._index);
+
+                if (jobs == 1) {
+                    encoded1 = encoded;
+                }
+                else if (encoded != encoded1) {
+                    cout << "Output depends on the number of jobs for " << names[n] << endl;
+                    res = 1;
+                }
+
+                // Padding for the copies past the end of the block
+                vector<kanzi::byte> decoded(data.size() + 64, kanzi::byte(0));
+                encoded.resize(encoded.size() + 64);
+                SliceArray<kanzi::byte> encodedInput(&encoded[0], int(encoded.size()), 0);
+                SliceArray<kanzi::byte> reverse(&decoded[0], count, 0);
+
+                if ((res == 0) && ((decoder->inverse(encodedInput, reverse, output._index) == false) || (reverse._index != count) ||
+                    (memcmp(&data[0], &decoded[0], data.size()) != 0))) {
+                    cout << "Round-trip mismatch for " << names[n] << " with " << jobs << " job(s)" << endl;
+                    res = 1;
+                }
+            }
+
+            if (res == 0)
+                cout << names[n] << " (" << jobs << " job(s)): " << count << " => " << output._index << " bytes" << endl;
+
+            delete encoder;
+            delete decoder;
+        }
+    }
+
+    if (res == 0)
+        cout << "Identical" << endl;
+
+    return res;
+}
+
+static int testLZSearch()
+{
+    cout << endl
+         << "Correctness for LZ match finder search depths and optimal parsing" << endl;
+    srand(12345);
+    const string msg = createJSONMessage(2 * 1024 * 1024);
+    vector<kanzi::byte> data(msg.size());
+
+    for (size_t j = 0; j < msg.size(); j++)
+        data[j] = kanzi::byte(msg[j]);
+
+    string names[2] = { "LZ", "LZX" };
+    // Search depth, optimal parsing (16 is the default depth of the optimal parser)
+    const int configs[5][2] = { { 0, 0 }, { 8, 0 }, { 16, 0 }, { 64, 0 }, { 0, 1 } };
+    const int count = int(data.size());
+    int res = 0;
+
+    for (int n = 0; (n < 2) && (res == 0); n++) {
+        int size0 = 0;
+        int64 greedyCost = 0;
+
+        for (int d = 0; (d < 5) && (res == 0); d++) {
+            Context ctx;
+            ctx.putInt("bsVersion", 7);
+            ctx.putInt("lzSearch", configs[d][0]);
+            ctx.putInt("lzOptimal", configs[d][1]);
+            ctx.putString("transform", names[n]);
+            Context decCtx(ctx);
+            Transform<kanzi::byte>* encoder = getByteTransform(names[n], ctx);
+            Transform<kanzi::byte>* decoder = getByteTransform(names[n], decCtx);
+            vector<kanzi::byte> encoded1;
+
+            // Encode twice with the same instance: the output must not
+            // depend on the state left by the previous block
+            for (int i = 0; (i < 2) && (res == 0); i++) {
+                vector<kanzi::byte> encoded(encoder->getMaxEncodedLength(count), kanzi::byte(0));
+                SliceArray<kanzi::byte> input(&data[0], count, 0);
+                SliceArray<kanzi::byte> output(&encoded[0], int(encoded.size()), 0);
+
+                if (encoder->forward(input, output, count) == false) {
+                    cout << "Encoding error for " << names[n] << endl;
+                    res = 1;
+                    break;
+                }
+
+                encoded.resize(output._index);
+
+                if (i == 0) {
+                    encoded1 = encoded;
+                    continue;
+                }
+
+                if (encoded != encoded1) {
+                    cout << "Output depends on the previous block for " << names[n] << endl;
+                    res = 1;
+                    break;
+                }
+
+                // Padding for the copies past the end of the block
+                vector<kanzi::byte> decoded(data.size() + 64, kanzi::byte(0));
+                encoded.resize(encoded.size() + 64);
+                SliceArray<kanzi::byte> encodedInput(&encoded[0], int(encoded.size()), 0);
+                SliceArray<kanzi::byte> reverse(&decoded[0], count, 0);
+
+                if ((decoder->inverse(encodedInput, reverse, output._index) == false) || (reverse._index != count) ||
+                    (memcmp(&data[0], &decoded[0], data.size()) != 0)) {
+                    cout << "Round-trip mismatch for " << names[n] << " with search depth " << configs[d][0] << endl;
+                    res = 1;
+                    break;
+                }
+
+                cout << names[n] << " (search depth " << configs[d][0] << ((configs[d][1] == 1) ? ", optimal" : "");
+                cout << "): " << count << " => " << output._index << " bytes" << endl;
+
+                // The optimal parser minimizes the entropy coded size, not the size:
+                // compare the order 0 cost with the greedy parse of the same depth
+                uint freqs[256] = { 0 };
+                Global::computeHistogram(&encoded[0], output._index, freqs);
+                const int64 cost = int64(Global::computeFirstOrderEntropy1024(output._index, freqs)) * output._index;
+
+                if (d == 0) {
+                    size0 = output._index;
+                }
+                else if ((configs[d][1] == 0) && (output._index >= size0)) {
+                    cout << "No compression gain with search depth " << configs[d][0] << endl;
+                    res = 1;
+                }
+                else if ((configs[d][1] == 1) && (cost >= greedyCost)) {
+                    cout << "No entropy gain with optimal parsing" << endl;
+                    res = 1;
+                }
+
+                if (configs[d][0] == 16)
+                    greedyCost = cost;
+            }
+
+            delete encoder;
+            delete decoder;
+        }
+    }
+
+    if (res == 0)
+        cout << "Identical" << endl;
+
+    return res;
+}
+
+// Fill 'data' with a BWT like output: runs of symbols from a small alphabet
+// ('runs' true) or random bytes.
+static void fillRankInput(vector<kanzi::byte>& data, bool runs)
+{
+    for (size_t i = 0; i < data.size();) {
+        if (runs == false) {
+            data[i++] = kanzi::byte(rand() & 0xFF);
+            continue;
+        }
+
+        const kanzi::byte b = kanzi::byte((rand() % 8 == 0) ? rand() & 0xFF : rand() & 0x07);
+        const size_t end = min(data.size(), i + 1 + size_t(rand() % 40));
+
+        while (i < end)
+            data[i++] = b;
+    }
+}
+
+static int testFusedTransforms()
+{
+    cout << endl
+         << "Correctness for fused SBRT+ZRLT" << endl;
+    srand(12345);
+    const int modes[2] = { SBRT::MODE_RANK, SBRT::MODE_MTF };
+    const int sizes[4] = { 1, 300, 65536, 1024 * 1024 };
+    int res = 0;
+
+    // The fused transform must produce the same output as SBRT then ZRLT
+    for (int m = 0; (m < 2) && (res == 0); m++) {
+        for (int n = 0; (n < 8) && (res == 0); n++) {
+            const int count = sizes[n >> 1];
+            vector<kanzi::byte> data(count);
+            fillRankInput(data, (n & 1) == 0);
+
+            if (n == 6)
+                memset(&data[0], 0, data.size());
+
+            Context ctx;
+            SBRT sbrt(modes[m], ctx);
+            ZRLT zrlt(ctx);
+            SBRTZRLT fused(modes[m], ctx);
+            vector<kanzi::byte> tmp(count), expected(count), encoded(count), decoded(count);
+            SliceArray<kanzi::byte> sa1(&data[0], count, 0);
+            SliceArray<kanzi::byte> sa2(&tmp[0], count, 0);
+            sbrt.forward(sa1, sa2, count);
+            SliceArray<kanzi::byte> sa3(&tmp[0], count, 0);
+            SliceArray<kanzi::byte> sa4(&expected[0], count, 0);
+            const bool expRes = zrlt.forward(sa3, sa4, count);
+            SliceArray<kanzi::byte> sa5(&data[0], count, 0);
+            SliceArray<kanzi::byte> sa6(&encoded[0], count, 0);
+            const bool fusedRes = fused.forward(sa5, sa6, count);
+
+            if ((fusedRes != expRes) ||
+                ((expRes == true) && ((sa6._index != sa4._index) || (memcmp(&expected[0], &encoded[0], size_t(sa4._index)) != 0)))) {
+                cout << "Fused output mismatch for mode " << modes[m] << " and test " << n << endl;
+                res = 1;
+                break;
+            }
+
+            if (expRes == false)
+                continue;
+
+            SliceArray<kanzi::byte> sa7(&encoded[0], count, 0);
+            SliceArray<kanzi::byte> sa8(&decoded[0], count, 0);
+
+            if ((fused.inverse(sa7, sa8, sa6._index) == false) || (sa8._index != count) ||
+                (memcmp(&data[0], &decoded[0], data.size()) != 0)) {
+                cout << "Fused round-trip mismatch for mode " << modes[m] << " and test " << n << endl;
+                res = 1;
+                break;
+            }
+        }
+    }
+
+    // The fused sequences must produce the same output and skip flags as
+    // the separate transforms
+    const char* chains[3] = { "RANK+ZRLT", "MTFT+ZRLT", "RLT+MTFT+ZRLT" };
+
+    for (int c = 0; (c < 3) && (res == 0); c++) {
+        for (int n = 0; (n < 2) && (res == 0); n++) {
+            const int count = 256 * 1024;
+            vector<kanzi::byte> data(count);
+            fillRankInput(data, n == 0);
+            Context ctx;
+            ctx.putInt("bsVersion", BS_VERSION);
+            const uint64 type = TransformFactory<kanzi::byte>::getType(chains[c]);
+            TransformSequence<kanzi::byte>* seq1 = TransformFactory<kanzi::byte>::newTransform(ctx, type);
+            Transform<kanzi::byte>* transforms[8] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+            const string names = chains[c];
+            size_t start = 0;
+
+            for (int i = 0; start <= names.size(); i++) {
+                size_t end = names.find('+', start);
+
+                if (end == string::npos)
+                    end = names.size();
+
+                transforms[i] = getByteTransform(names.substr(start, end - start), ctx);
+                start = end + 1;
+            }
+
+            TransformSequence<kanzi::byte> seq2(transforms, true);
+            const int length = seq1->getMaxEncodedLength(count);
+            // The sequences may use their input as a work buffer
+            vector<kanzi::byte> data1(data), data2(data);
+            vector<kanzi::byte> out1(length), out2(length), decoded(count);
+            SliceArray<kanzi::byte> in1(&data1[0], count, 0);
+            SliceArray<kanzi::byte> sa1(&out1[0], length, 0);
+            SliceArray<kanzi::byte> in2(&data2[0], count, 0);
+            SliceArray<kanzi::byte> sa2(&out2[0], length, 0);
+            const bool res1 = seq1->forward(in1, sa1, count);
+            const bool res2 = seq2.forward(in2, sa2, count);
+
+            if ((res1 != res2) || (seq1->getSkipFlags() != seq2.getSkipFlags()) || (sa1._index != sa2._index) ||
+                (memcmp(&out1[0], &out2[0], size_t(sa1._index)) != 0)) {
+                cout << "Fused sequence mismatch for " << chains[c] << endl;
+                res = 1;
+            }
+            else {
+                SliceArray<kanzi::byte> sa3(&out1[0], length, 0);
+                SliceArray<kanzi::byte> sa4(&decoded[0], count, 0);
+
+                if ((seq1->inverse(sa3, sa4, sa1._index) == false) || (sa4._index != count) ||
+                    (memcmp(&data[0], &decoded[0], data.size()) != 0)) {
+                    cout << "Fused sequence round-trip mismatch for " << chains[c] << endl;
+                    res = 1;
+                }
+                else {
+                    cout << chains[c] << ": " << count << " => " << sa1._index << " bytes (skip flags ";
+                    cout << int(seq1->getSkipFlags()) << ")" << endl;
+                }
+            }
+
+            delete seq1;
+        }
+    }
+
+    if (res == 0)
+        cout << "Identical" << endl;
+
+    return res;
+}
+
+static int testBlockStats()
+{
+    cout << endl
+         << "Correctness for shared block statistics" << endl;
+    srand(12345);
+    const int count = 256 * 1024;
+    vector<vector<kanzi::byte> > inputs(4, vector<kanzi::byte>(count));
+    const string msg = createJSONMessage(count);
+
+    for (int i = 0; i < count; i++)
+        inputs[0][i] = kanzi::byte(msg[i]);
+
+    // UTF-8 text starting with continuation bytes (truncated symbol)
+    {
+        static const char* words[] = { "\xD0\xBF\xD1\x80\xD0\xB8", "\xE6\x97\xA5\xE6\x9C\xAC", "abc", " ", "\n" };
+        string utf = "\x80\xBF";
+
+        while (utf.size() < size_t(count))
+            utf += words[rand() % 5];
+
+        for (int i = 0; i < count; i++)
+            inputs[1][i] = kanzi::byte(utf[i]);
+    }
+
+    // Binary and DNA
+    for (int i = 0; i < count; i++) {
+        inputs[2][i] = kanzi::byte(rand() & 0xFF);
+        inputs[3][i] = kanzi::byte("ACGT"[rand() & 3]);
+    }
+
+    // The statistics must match a scan of the block (order 0 computed from
+    // the order 1 histogram or directly)
+    for (size_t n = 0; n < inputs.size(); n++) {
+        vector<uint> freqs0(256, 0), freqs1(65536, 0);
+        Global::computeHistogram(&inputs[n][0], count, &freqs0[0]);
+        Global::computeHistogram(&inputs[n][0], count, &freqs1[0], false);
+
+        for (int k = 0; k < 2; k++) {
+            BlockStats stats;
+            stats.reset(&inputs[n][0], count);
+
+            if (k == 1)
+                stats.getHistogram1();
+
+            if ((memcmp(stats.getHistogram(), &freqs0[0], 256 * sizeof(uint)) != 0) ||
+                (memcmp(stats.getHistogram1(), &freqs1[0], 65536 * sizeof(uint)) != 0)) {
+                cout << "Invalid block statistics for input " << n << endl;
+                return 1;
+            }
+        }
+    }
+
+    // Sequences sharing the statistics (factory) must produce the same
+    // output and skip flags as the same transforms without statistics
+    const char* chains[4] = { "TEXT+UTF+PACK+MM+LZX", "EXE+RLT+TEXT+UTF+DNA", "UTF+PACK", "RLT+MM" };
+    const char* entropies[2] = { "TPAQ", "HUFFMAN" };
+    int res = 0;
+
+    for (int c = 0; (c < 4) && (res == 0); c++) {
+        for (int e = 0; (e < 2) && (res == 0); e++) {
+            for (size_t n = 0; (n < inputs.size()) && (res == 0); n++) {
+                Context ctx1;
+                ctx1.putInt("bsVersion", BS_VERSION);
+                ctx1.putString("entropy", entropies[e]);
+                Context ctx2(ctx1);
+                ctx2.putInt(Context::TEXT_CODEC, (e == 0) ? 1 : 2);
+                const uint64 type = TransformFactory<kanzi::byte>::getType(chains[c]);
+                TransformSequence<kanzi::byte>* seq1 = TransformFactory<kanzi::byte>::newTransform(ctx1, type);
+                Transform<kanzi::byte>* transforms[8] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+                const string names = chains[c];
+                size_t start = 0;
+
+                for (int i = 0; start <= names.size(); i++) {
+                    size_t end = names.find('+', start);
+
+                    if (end == string::npos)
+                        end = names.size();
+
+                    transforms[i] = getByteTransform(names.substr(start, end - start), ctx2);
+                    start = end + 1;
+                }
+
+                TransformSequence<kanzi::byte> seq2(transforms, true);
+                const int length = seq1->getMaxEncodedLength(count);
+
+                // The sequences may use their input as a work buffer
+                vector<kanzi::byte> data1(inputs[n]), data2(inputs[n]);
+                // Padding for the decoders that write past the end of the block
+                vector<kanzi::byte> out1(length), out2(length), decoded(count + 64);
+                SliceArray<kanzi::byte> in1(&data1[0], count, 0);
+                SliceArray<kanzi::byte> sa1(&out1[0], length, 0);
+                SliceArray<kanzi::byte> in2(&data2[0], count, 0);
+                SliceArray<kanzi::byte> sa2(&out2[0], length, 0);
+                const bool res1 = seq1->forward(in1, sa1, count);
+                const bool res2 = seq2.forward(in2, sa2, count);
+
+                if ((res1 != res2) || (seq1->getSkipFlags() != seq2.getSkipFlags()) || (sa1._index != sa2._index) ||
+                    (memcmp(&out1[0], &out2[0], size_t(sa1._index)) != 0)) {
+                    cout << "Output mismatch for " << chains[c] << " (" << entropies[e] << ") and input " << n << endl;
+                    res = 1;
+                }
+                else if (ctx1.getBlockStats() != nullptr) {
+                    cout << "Block statistics still shared after " << chains[c] << endl;
+                    res = 1;
+                }
+                else {
+                    SliceArray<kanzi::byte> sa3(&out1[0], length, 0);
+                    SliceArray<kanzi::byte> sa4(&decoded[0], int(decoded.size()), 0);
+
+                    if ((seq1->inverse(sa3, sa4, sa1._index) == false) || (sa4._index != count) ||
+                        (memcmp(&inputs[n][0], &decoded[0], size_t(count)) != 0)) {
+                        cout << "Round-trip mismatch for " << chains[c] << " and input " << n << endl;
+                        res = 1;
+                    }
+                    else {
+                        cout << chains[c] << " (" << entropies[e] << "), input " << n << ": " << count << " => ";
+                        cout << sa1._index << " bytes (skip flags " << int(seq1->getSkipFlags()) << ")" << endl;
+                    }
+                }
+
+                delete seq1;
+            }
+        }
+    }
+
+    if (res == 0)
+        cout << "Identical" << endl;
+
+    return res;
+}
+
 int testTransformsCorrectness(const string& name)
 {
     srand((uint)time(nullptr));
@@ -1314,6 +2002,36 @@ int TestTransforms_main(int argc, const char* argv[])
     try {
         res = testTextCodecSelfDescribing();
 
+        if (res != 0)
+            return res;
+
+        res = testTextCodecReuse();
+
+        if (res != 0)
+            return res;
+
+        res = testDictionaryTransforms();
+
+        if (res != 0)
+            return res;
+
+        res = testSegmentedTransforms();
+
+        if (res != 0)
+            return res;
+
+        res = testLZSearch();
+
+        if (res != 0)
+            return res;
+
+        res = testFusedTransforms();
+
+        if (res != 0)
+            return res;
+
+        res = testBlockStats();
+
         if (res != 0)
             return res;
 
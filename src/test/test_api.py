@@ -215,7 +215,7 @@ def test_headerless():
         blockSize=1 << 15,
         originalSize=len(input_data),
         checksum=0,
-        bsVersion=1,
+        bsVersion=7,
     ) as d:
         out = d.decompress_block(256)
 
@@ -14,10 +14,12 @@ limitations under the License.
 */
 
 #include <algorithm>
+#include <cstring>
 #include <vector>
 #include <stdexcept>
 
 #include "AliasCodec.hpp"
+#include "BlockStats.hpp"
 #include "../Global.hpp"
 #include "../Memory.hpp"
 
@@ -31,7 +33,7 @@ const int AliasCodec::MIN_BLOCK_SIZE = 1024;
 AliasCodec::AliasCodec(Context& ctx) :
           _pCtx(&ctx)
 {
-   _onlyDNA = _pCtx->getInt("packOnlyDNA", 0) != 0;
+   _onlyDNA = _pCtx->getInt(Context::PACK_ONLY_DNA, 0) != 0;
 }
 
 
@@ -55,7 +57,7 @@ bool AliasCodec::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
     Global::DataType dt = Global::UNDEFINED;
 
     if (_pCtx != nullptr) {
-        dt = (Global::DataType) _pCtx->getInt("dataType", Global::UNDEFINED);
+        dt = (Global::DataType) _pCtx->getInt(Context::DATA_TYPE, Global::UNDEFINED);
 
         if ((dt == Global::MULTIMEDIA) || (dt == Global::UTF8))
             return false;
@@ -70,9 +72,16 @@ bool AliasCodec::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
     kanzi::byte* dst = &output._array[output._index];
     const kanzi::byte* src = &input._array[input._index];
 
+    // Reuse the statistics of the block if a previous transform computed them
+    BlockStats* stats = BlockStats::get(_pCtx, src, count);
+
     // Find missing 1-kanzi::byte symbols
     uint freqs0[256] = { 0 };
-    Global::computeHistogram(&src[0], count, freqs0, true);
+
+    if (stats != nullptr)
+        memcpy(&freqs0[0], stats->getHistogram(), sizeof(freqs0));
+    else
+        Global::computeHistogram(&src[0], count, freqs0, true);
     int n0 = 0;
     int absent[256] = { 0 };
 
@@ -88,7 +97,7 @@ bool AliasCodec::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
         dt = Global::detectSimpleType(count, freqs0);
 
         if ((_pCtx != nullptr) && (dt != Global::UNDEFINED))
-            _pCtx->putInt("dataType", dt);
+            _pCtx->putInt(Context::DATA_TYPE, dt);
 
         if ((dt != Global::DNA) && (_onlyDNA == true))
             return false;
@@ -153,9 +162,19 @@ bool AliasCodec::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
 
         {
             // Find missing 2-kanzi::byte symbols
-            uint* freqs1 = new uint[65536];
-            memset(freqs1, 0, 65536 * sizeof(uint));
-            Global::computeHistogram(&src[0], count, freqs1, false);
+            uint* buf = nullptr;
+            const uint* freqs1;
+
+            if (stats != nullptr) {
+                freqs1 = stats->getHistogram1();
+            }
+            else {
+                buf = new uint[65536];
+                memset(buf, 0, 65536 * sizeof(uint));
+                Global::computeHistogram(&src[0], count, buf, false);
+                freqs1 = buf;
+            }
+
             int n1 = 0;
 
             for (uint32 i = 0; i < 65536; i++) {
@@ -172,7 +191,7 @@ bool AliasCodec::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
                 n1++;
             }
 
-            delete[] freqs1;
+            delete[] buf;
 
             if (n1 < n0) {
                 // Fewer distinct 2-kanzi::byte symbols than 1-kanzi::byte symbols
@@ -48,6 +48,8 @@ BWT::BWT(int jobs)
 
     if (jobs < 1)
         throw invalid_argument("The number of jobs must be at least 1");
+
+    _saAlgo.setJobs(jobs);
 #else
     if (jobs != 1)
         throw invalid_argument("The number of jobs is limited to 1 in this version");
@@ -64,13 +66,15 @@ BWT::BWT(Context& ctx)
     _sa = nullptr;
     _bufferSize = 0;
     _saSize = 0;
-    int jobs = ctx.getInt("jobs", 1);
+    int jobs = ctx.getInt(Context::JOBS, 1);
 
 #ifdef CONCURRENCY_ENABLED
     _pool = ctx.getPool(); // can be null
 
     if (jobs < 1)
         throw invalid_argument("The number of jobs must be at least 1");
+
+    _saAlgo.setJobs(jobs, _pool);
 #else
     if (jobs != 1)
         throw invalid_argument("The number of jobs is limited to 1 in this version");
@@ -446,15 +450,25 @@ bool BWT::inverseBiPSIv2(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
                     c += jobsPerTask[j];
                 }
 
-                // Wait for completion of all concurrent tasks
-                for (int j = 0; j < nbTasks; j++)
-                    futures[j].get();
+                // Wait for completion of all concurrent tasks (a pool worker runs
+                // pending tasks meanwhile)
+                for (int j = 0; j < nbTasks; j++) {
+                    if (_pool == nullptr)
+                        futures[j].get();
+                    else
+                        _pool->get(futures[j]);
+                }
             }
             catch (...) {
                 for (uint i = 0; i < futures.size(); i++) {
                     try {
-                        if (futures[i].valid())
+                        if (futures[i].valid() == false)
+                            continue;
+
+                        if (_pool == nullptr)
                             futures[i].wait();
+                        else
+                            _pool->wait(futures[i]);
                     }
                     catch (const exception&) {
                     }
@@ -24,7 +24,7 @@ using namespace kanzi;
 BWTBlockCodec::BWTBlockCodec(Context& ctx)
 {
    _pBWT = new BWT(ctx);
-   _bsVersion = ctx.getInt("bsVersion");
+   _bsVersion = ctx.getInt(Context::BS_VERSION);
 }
 
 // Return true if the compression chain succeeded. In this case, the input data
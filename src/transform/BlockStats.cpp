@@ -0,0 +1,92 @@
+/*
+Copyright 2011-2026 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cstring>
+#include "BlockStats.hpp"
+#include "../Global.hpp"
+#include "../Magic.hpp"
+
+using namespace kanzi;
+
+
+void BlockStats::reset(const byte block[], int count)
+{
+    _block = block;
+    _count = count;
+    _flags = 0;
+}
+
+
+BlockStats* BlockStats::get(const Context* ctx, const byte block[], int count)
+{
+    if (ctx == nullptr)
+        return nullptr;
+
+    BlockStats* stats = ctx->getBlockStats();
+
+    if ((stats == nullptr) || (stats->_block == nullptr) || (stats->_block != block) || (stats->_count != count))
+        return nullptr;
+
+    return stats;
+}
+
+
+uint BlockStats::getMagic()
+{
+    if ((_flags & HAS_MAGIC) == 0) {
+        _magic = Magic::getType(_block);
+        _flags |= HAS_MAGIC;
+    }
+
+    return _magic;
+}
+
+
+const uint* BlockStats::getHistogram()
+{
+    if ((_flags & HAS_HISTO0) != 0)
+        return _freqs0;
+
+    memset(&_freqs0[0], 0, sizeof(_freqs0));
+
+    if ((_flags & HAS_HISTO1) != 0) {
+        // Sum the order 1 histogram rather than scanning the block again
+        for (int i = 0; i < 65536; i += 256) {
+            for (int j = 0; j < 256; j++)
+                _freqs0[j] += _freqs1[i + j];
+        }
+    }
+    else {
+        Global::computeHistogram(_block, _count, _freqs0);
+    }
+
+    _flags |= HAS_HISTO0;
+    return _freqs0;
+}
+
+
+const uint* BlockStats::getHistogram1()
+{
+    if ((_flags & HAS_HISTO1) != 0)
+        return _freqs1;
+
+    if (_freqs1 == nullptr)
+        _freqs1 = new uint[65536];
+
+    memset(&_freqs1[0], 0, 65536 * sizeof(uint));
+    Global::computeHistogram(_block, _count, _freqs1, false);
+    _flags |= HAS_HISTO1;
+    return _freqs1;
+}
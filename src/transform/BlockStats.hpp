@@ -0,0 +1,78 @@
+/*
+Copyright 2011-2026 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef knz_BlockStats
+#define knz_BlockStats
+
+#include "../Context.hpp"
+#include "../types.hpp"
+
+
+namespace kanzi {
+
+   // Statistics of the block given to a sequence of transforms, shared by the
+   // transforms through the context (see TransformSequence). They are computed
+   // on demand, at most once per block: when a transform gives up, the next
+   // ones reuse its scans (EG. TEXT computes the order 1 histogram, then UTF
+   // and PACK only read it).
+   // The statistics describe the input of the sequence. Once a transform has
+   // been applied, the next transforms see other data and get no statistics.
+   class BlockStats {
+   public:
+       BlockStats() : _block(nullptr), _count(0), _flags(0), _magic(0), _freqs1(nullptr) {}
+
+       ~BlockStats() { delete[] _freqs1; }
+
+       // Describe a new block of 'count' bytes
+       void reset(const byte block[], int count);
+
+       // Describe no block
+       void clear() { reset(nullptr, 0); }
+
+       // Return the statistics shared through the context if they describe
+       // the 'count' bytes at 'block', else null.
+       static BlockStats* get(const Context* ctx, const byte block[], int count);
+
+       const byte* getBlock() const { return _block; }
+
+       int getCount() const { return _count; }
+
+       // See Magic::getType
+       uint getMagic();
+
+       // Order 0 histogram (256 entries)
+       const uint* getHistogram();
+
+       // Order 1 histogram (65536 entries, indexed by previous byte * 256 +
+       // current byte, the previous byte of the first byte being 0), same as
+       // Global::computeHistogram
+       const uint* getHistogram1();
+
+   private:
+       static const int HAS_MAGIC = 1;
+       static const int HAS_HISTO0 = 2;
+       static const int HAS_HISTO1 = 4;
+
+       const byte* _block;
+       int _count;
+       int _flags; // statistics computed for the current block
+       uint _magic;
+       uint _freqs0[256];
+       uint* _freqs1; // kept from one block to the next
+   };
+
+}
+#endif
@@ -14,11 +14,17 @@ limitations under the License.
 */
 
 
+#include <algorithm>
 #include <cstring>
 #include "DivSufSort.hpp"
 #include "../Memory.hpp"
 
+#ifdef CONCURRENCY_ENABLED
+#include <future>
+#endif
+
 using namespace kanzi;
+using namespace std;
 
 
 const int DivSufSort::SS_INSERTIONSORT_THRESHOLD = 16;
@@ -27,6 +33,7 @@ const int DivSufSort::SS_MISORT_STACKSIZE = 16;
 const int DivSufSort::SS_SMERGE_STACKSIZE = 32;
 const int DivSufSort::TR_STACKSIZE = 64;
 const int DivSufSort::TR_INSERTIONSORT_THRESHOLD = 16;
+const int DivSufSort::PARALLEL_SORT_THRESHOLD = 1024 * 1024;
 
 const int DivSufSort::SQQ_TABLE[] = {
     0, 16, 22, 27, 32, 35, 39, 42, 45, 48, 50, 53, 55, 57, 59, 61,
@@ -70,6 +77,10 @@ DivSufSort::DivSufSort()
     _ssStack->_index = 0;
     _trStack->_index = 0;
     _mergeStack->_index = 0;
+    _jobs = 1;
+#ifdef CONCURRENCY_ENABLED
+    _pool = nullptr;
+#endif
     memset(&_bucketA[0], 0, sizeof(int) * 256);
     memset(&_bucketB[0], 0, sizeof(int) * 65536);
 }
@@ -79,8 +90,21 @@ DivSufSort::~DivSufSort()
     delete _ssStack;
     delete _trStack;
     delete _mergeStack;
+
+#ifdef CONCURRENCY_ENABLED
+    for (size_t i = 0; i < _workers.size(); i++)
+        delete _workers[i];
+#endif
 }
 
+#ifdef CONCURRENCY_ENABLED
+void DivSufSort::setJobs(int jobs, ThreadPool* pool)
+{
+    _jobs = max(jobs, 1);
+    _pool = pool;
+}
+#endif
+
 void DivSufSort::reset()
 {
     _ssStack->_index = 0;
@@ -373,16 +397,24 @@ int DivSufSort::sortTypeBstar(int bucketA[], int bucketB[], int n)
         const int bufSize = n - m - m;
         c0 = 254;
 
-        for (int j = m; j > 0; c0--) {
-            const int idx = c0 << 8;
+#ifdef CONCURRENCY_ENABLED
+        if ((_jobs > 1) && (n >= PARALLEL_SORT_THRESHOLD)) {
+            ssSortParallel(pab, m, bufSize, n);
+        }
+        else
+#endif
+        {
+            for (int j = m; j > 0; c0--) {
+                const int idx = c0 << 8;
 
-            for (int c1 = 255; c1 > c0; c1--) {
-                const int i = bucketB[idx + c1];
+                for (int c1 = 255; c1 > c0; c1--) {
+                    const int i = bucketB[idx + c1];
 
-                if (j > i + 1)
-                    ssSort(pab, i, j, m, bufSize, 2, n, _sa[i] == m - 1);
+                    if (j > i + 1)
+                        ssSort(pab, i, j, m, bufSize, 2, n, _sa[i] == m - 1);
 
-                j = i;
+                    j = i;
+                }
             }
         }
 
@@ -550,6 +582,124 @@ void DivSufSort::ssSort(const int pa, int first, int last, int buf, int bufSize,
 }
 
 
+#ifdef CONCURRENCY_ENABLED
+// The buckets of type B* substrings (same first two characters) are independent.
+// They are sorted concurrently, each task using a distinct slice of the work
+// buffer (same approach as the OpenMP version of libdivsufsort).
+void DivSufSort::ssSortParallel(int pa, int m, int bufSize, int n)
+{
+    vector<SSSortBucket> buckets;
+
+    for (int c0 = 254, j = m; j > 0; c0--) {
+        const int idx = c0 << 8;
+
+        for (int c1 = 255; c1 > c0; c1--) {
+            const int i = _bucketB[idx + c1];
+
+            if (j > i + 1)
+                buckets.push_back(SSSortBucket(i, j, _sa[i] == m - 1));
+
+            j = i;
+        }
+    }
+
+    if (buckets.size() == 0)
+        return;
+
+    // Largest buckets first to balance the load between tasks
+    sort(buckets.begin(), buckets.end(), [](const SSSortBucket& a, const SSSortBucket& b) {
+        return (a._last - a._first) > (b._last - b._first);
+    });
+
+    const int nbTasks = min(_jobs, int(buckets.size()));
+    const int taskBufSize = bufSize / nbTasks;
+
+    while (int(_workers.size()) < nbTasks)
+        _workers.push_back(new DivSufSort());
+
+    BoundedConcurrentQueue<SSSortBucket> queue(int(buckets.size()), &buckets[0]);
+    vector<SSSortTask<int>*> tasks;
+    vector<future<int> > futures;
+    tasks.reserve(nbTasks);
+    futures.reserve(nbTasks);
+
+    try {
+        for (int t = 0; t < nbTasks; t++) {
+            _workers[t]->_sa = _sa;
+            _workers[t]->_buffer = _buffer;
+            _workers[t]->_ssStack->_index = 0;
+            _workers[t]->_mergeStack->_index = 0;
+            tasks.push_back(new SSSortTask<int>(_workers[t], &queue, pa, m + t * taskBufSize, taskBufSize, n));
+
+            if (_pool == nullptr)
+                futures.push_back(std::async(launch::async, &SSSortTask<int>::run, tasks[t]));
+            else
+                futures.push_back(_pool->schedule(&SSSortTask<int>::run, tasks[t]));
+        }
+
+        // Wait for completion of all concurrent tasks (a pool worker runs
+        // pending tasks meanwhile)
+        for (int t = 0; t < nbTasks; t++) {
+            if (_pool == nullptr)
+                futures[t].get();
+            else
+                _pool->get(futures[t]);
+        }
+    }
+    catch (...) {
+        queue.clear();
+
+        for (size_t t = 0; t < futures.size(); t++) {
+            try {
+                if (futures[t].valid() == false)
+                    continue;
+
+                if (_pool == nullptr)
+                    futures[t].wait();
+                else
+                    _pool->wait(futures[t]);
+            }
+            catch (const exception&) {
+            }
+        }
+
+        for (size_t t = 0; t < tasks.size(); t++)
+            delete tasks[t];
+
+        throw;
+    }
+
+    for (size_t t = 0; t < tasks.size(); t++)
+        delete tasks[t];
+}
+
+
+template <class T>
+SSSortTask<T>::SSSortTask(DivSufSort* algo, BoundedConcurrentQueue<SSSortBucket>* queue,
+    int pa, int buf, int bufSize, int n)
+    : _algo(algo)
+    , _queue(queue)
+    , _pa(pa)
+    , _buf(buf)
+    , _bufSize(bufSize)
+    , _n(n)
+{
+}
+
+
+template <class T>
+T SSSortTask<T>::run()
+{
+    SSSortBucket* b;
+
+    while ((b = _queue->get()) != nullptr)
+        _algo->ssSort(_pa, b->_first, b->_last, _buf, _bufSize, 2, _n, b->_lastSuffix);
+
+    return T(0);
+}
+#endif
+
+
 int DivSufSort::ssCompare(int pa, int pb, int p2, const int depth) const
 {
     int u1 = depth + pa;
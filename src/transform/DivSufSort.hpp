@@ -17,7 +17,8 @@ limitations under the License.
 #ifndef knz_DivSufSort
 #define knz_DivSufSort
 
-#include "../types.hpp"
+#include <vector>
+#include "../concurrent.hpp"
 
 #if __cplusplus >= 201103L
    #include <utility>
@@ -116,8 +117,52 @@ namespace kanzi
 
 
 
+   class DivSufSort;
+
+   // Range of type B* substrings sharing the same first two characters
+   struct SSSortBucket
+   {
+       int _first;
+       int _last;
+       bool _lastSuffix;
+
+       SSSortBucket(int first = 0, int last = 0, bool lastSuffix = false)
+           : _first(first)
+           , _last(last)
+           , _lastSuffix(lastSuffix)
+       {
+       }
+   };
+
+#ifdef CONCURRENCY_ENABLED
+   // A task used to sort buckets of type B* substrings.
+   // Each task uses a distinct slice of the work buffer.
+   template <class T>
+   class SSSortTask FINAL : public Task<T> {
+   private:
+       DivSufSort* _algo;
+       BoundedConcurrentQueue<SSSortBucket>* _queue;
+       int _pa;
+       int _buf;
+       int _bufSize;
+       int _n;
+
+   public:
+       SSSortTask(DivSufSort* algo, BoundedConcurrentQueue<SSSortBucket>* queue,
+           int pa, int buf, int bufSize, int n);
+       ~SSSortTask() {}
+
+       T run();
+   };
+#endif
+
+
    class DivSufSort
    {
+#ifdef CONCURRENCY_ENABLED
+       template <class T> friend class SSSortTask;
+#endif
+
    private:
        static const int SS_INSERTIONSORT_THRESHOLD;
        static const int SS_BLOCKSIZE;
@@ -127,6 +172,7 @@ namespace kanzi
        static const int TR_INSERTIONSORT_THRESHOLD;
        static const int SQQ_TABLE[];
        static const int LOG_TABLE[];
+       static const int PARALLEL_SORT_THRESHOLD;
 
        int* _sa;
        const uint8* _buffer;
@@ -135,6 +181,11 @@ namespace kanzi
        Stack* _mergeStack;
        int _bucketA[256];
        int _bucketB[65536];
+       int _jobs;
+#ifdef CONCURRENCY_ENABLED
+       ThreadPool* _pool;
+       std::vector<DivSufSort*> _workers; // one per concurrent task, own stacks
+#endif
 
 
        void constructSuffixArray(int bucketA[], int bucketB[], int n, int m);
@@ -146,6 +197,10 @@ namespace kanzi
        void ssSort(int pa, int first, int last, int buf, int bufSize,
            int depth, int n, bool lastSuffix);
 
+#ifdef CONCURRENCY_ENABLED
+       void ssSortParallel(int pa, int m, int bufSize, int n);
+#endif
+
        int ssCompare(int pa, int pb, int p2, const int depth) const;
 
        int ssCompare(const int s1[], const int s2[], const int depth) const;
@@ -218,6 +273,11 @@ namespace kanzi
 
        ~DivSufSort();
 
+#ifdef CONCURRENCY_ENABLED
+       // Sort the type B* substrings with up to 'jobs' concurrent tasks
+       void setJobs(int jobs, ThreadPool* pool = nullptr);
+#endif
+
        bool computeSuffixArray(const byte input[], int sa[], int length);
 
        bool computeBWT(const byte input[], byte output[], int sa[], int length, int indexes[], int idxCount = 8);
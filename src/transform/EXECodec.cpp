@@ -78,7 +78,7 @@ bool EXECodec::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>&
         return false;
 
     if (_pCtx != nullptr) {
-        Global::DataType dt = (Global::DataType)_pCtx->getInt("dataType", Global::UNDEFINED);
+        Global::DataType dt = (Global::DataType)_pCtx->getInt(Context::DATA_TYPE, Global::UNDEFINED);
 
         if ((dt != Global::UNDEFINED) && (dt != Global::EXE) && (dt != Global::BIN))
             return false;
@@ -90,7 +90,7 @@ bool EXECodec::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>&
 
     if ((mode & NOT_EXE) != kanzi::byte(0)) {
         if (_pCtx != nullptr)
-            _pCtx->putInt("dataType", Global::DataType(mode & MASK_DT));
+            _pCtx->putInt(Context::DATA_TYPE, Global::DataType(mode & MASK_DT));
 
         return false;
     }
@@ -106,7 +106,7 @@ bool EXECodec::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>&
         return false;
 
     if ((_pCtx != nullptr) && (res == true))
-        _pCtx->putInt("dataType", Global::EXE);
+        _pCtx->putInt(Context::DATA_TYPE, Global::EXE);
 
     return res;
 }
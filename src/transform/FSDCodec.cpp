@@ -15,6 +15,7 @@ limitations under the License.
 
 #include <stdexcept>
 
+#include "BlockStats.hpp"
 #include "FSDCodec.hpp"
 #include "../Global.hpp"
 #include "../Magic.hpp"
@@ -122,7 +123,7 @@ bool FSDCodec::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>&
         return false;
 
     if (_pCtx != nullptr) {
-        Global::DataType dt = (Global::DataType) _pCtx->getInt("dataType", Global::UNDEFINED);
+        Global::DataType dt = (Global::DataType) _pCtx->getInt(Context::DATA_TYPE, Global::UNDEFINED);
 
         if ((dt != Global::UNDEFINED) && (dt != Global::MULTIMEDIA) && (dt != Global::BIN))
             return false;
@@ -130,7 +131,8 @@ bool FSDCodec::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>&
 
     const kanzi::byte* src = &input._array[input._index];
     kanzi::byte* dst = &output._array[output._index];
-    uint magic = Magic::getType(src);
+    BlockStats* stats = BlockStats::get(_pCtx, src, count);
+    uint magic = (stats != nullptr) ? stats->getMagic() : Magic::getType(src);
 
     // Skip detection except for a few candidate types
     switch (magic) {
@@ -198,13 +200,13 @@ bool FSDCodec::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>&
     // If not better, quick exit
     if (ent[minIdx] >= ent[0]) {
         if (_pCtx != nullptr)
-            _pCtx->putInt("dataType", Global::detectSimpleType(3 * count10, histo[0]));
+            _pCtx->putInt(Context::DATA_TYPE, Global::detectSimpleType(3 * count10, histo[0]));
 
         return false;
     }
 
     if (_pCtx != nullptr)
-       _pCtx->putInt("dataType", Global::MULTIMEDIA);
+       _pCtx->putInt(Context::DATA_TYPE, Global::MULTIMEDIA);
 
     const int distances[7] = { 0, 1, 2, 3, 4, 8, 16 };
     const int dist = distances[minIdx];
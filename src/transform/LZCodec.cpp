@@ -14,7 +14,9 @@ limitations under the License.
 */
 
 #include "LZCodec.hpp"
+#include "../Dictionary.hpp"
 #include "../Memory.hpp"
+#include "SegmentedCodec.hpp"
 #include "TransformFactory.hpp"
 
 using namespace kanzi;
@@ -27,7 +29,7 @@ LZCodec::LZCodec()
 
 LZCodec::LZCodec(Context& ctx)
 {
-    const int lzType = ctx.getInt("lz", TransformFactory<kanzi::byte>::LZ_TYPE);
+    const int lzType = ctx.getInt(Context::LZ_TYPE, TransformFactory<kanzi::byte>::LZ_TYPE);
 
     if (lzType == TransformFactory<kanzi::byte>::LZP_TYPE) {
         _delegate = new LZPCodec(ctx);
@@ -68,7 +70,7 @@ const uint LZXCodec<false>::HASH_SEED = 0x1E35A7BD;
 template<>
 const uint LZXCodec<false>::HASH_LOG = 16;
 template<>
-const uint LZXCodec<false>::HASH_RSHIFT = 64 - HASH_LOG;
+const int LZXCodec<false>::MIN_HASH_LOG = 10;
 template<>
 const uint LZXCodec<false>::HASH_LSHIFT = 24;
 template<>
@@ -92,7 +94,7 @@ const uint LZXCodec<true>::HASH_SEED = 0x1E35A7BD;
 template<>
 const uint LZXCodec<true>::HASH_LOG = 19;
 template<>
-const uint LZXCodec<true>::HASH_RSHIFT = 64 - HASH_LOG;
+const int LZXCodec<true>::MIN_HASH_LOG = 10;
 template<>
 const uint LZXCodec<true>::HASH_LSHIFT = 24;
 template<>
@@ -111,6 +113,22 @@ template<>
 const int LZXCodec<true>::MIN_BLOCK_LENGTH = 24;
 template<>
 const int LZXCodec<true>::READ_LENGTH_GUARD = 2;
+template<>
+const int LZXCodec<false>::CHAIN_LOG = 22;
+template<>
+const int LZXCodec<true>::CHAIN_LOG = 22;
+template<>
+const int LZXCodec<false>::OPTIMAL_SEARCH = 16;
+template<>
+const int LZXCodec<true>::OPTIMAL_SEARCH = 16;
+template<>
+const int LZXCodec<false>::PARSE_WINDOW = 1 << 17;
+template<>
+const int LZXCodec<true>::PARSE_WINDOW = 1 << 17;
+template<>
+const int LZXCodec<false>::NICE_MATCH = 128;
+template<>
+const int LZXCodec<true>::NICE_MATCH = 128;
 
 
 
@@ -136,8 +154,20 @@ bool LZXCodec<T>::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte
     if (count < MIN_BLOCK_LENGTH)
         return false;
 
-    if (_hashSize == 0) {
-        const int newSize = 1 << HASH_LOG;
+    // Large blocks are split into segments encoded concurrently
+    if ((_pCtx != nullptr) && (SegmentedCodec::getSegments(count) > 1))
+        return SegmentedCodec::forward<LZXCodec<T> >(*_pCtx, input, output, count);
+
+    const Dictionary* dict = (_pCtx != nullptr) ? _pCtx->getDictionary() : nullptr;
+    const int span = count + ((dict != nullptr) ? dict->size() : 0);
+
+    // Small blocks use a hash table sized to the data (about 4 entries per
+    // position), which is cheap to allocate and to clear
+    const int hashLog = max(min(Global::log2(uint32(span)) + 2, int(HASH_LOG)), MIN_HASH_LOG);
+    _hashShift = 64 - hashLog;
+
+    if (_hashSize < (1 << hashLog)) {
+        const int newSize = 1 << hashLog;
         int32* hashes = new int32[newSize];
         delete[] _hashes;
         _hashes = hashes;
@@ -170,16 +200,74 @@ bool LZXCodec<T>::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte
         _bufferSize = newSize;
     }
 
-    memset(_hashes, 0, sizeof(int32) * _hashSize);
-    const int srcEnd = count - 16 - 2;
+    if (_searchDepth > 0) {
+        // Ring of hash chains: covers the dictionary prefix and the block,
+        // bounded for large blocks
+        const int newSize = 1 << min(Global::log2(uint32(span)) + 1, CHAIN_LOG);
+
+        if (_chainSize < newSize) {
+            int32* chain = new int32[newSize];
+            delete[] _chain;
+            _chain = chain;
+            _chainSize = newSize;
+        }
+
+        if (_optimal == true) {
+            if (_nodes == nullptr) {
+                ParseNode* nodes = new ParseNode[PARSE_WINDOW + 1];
+                int32* parse = nullptr;
+
+                try {
+                    parse = new int32[3 * (PARSE_WINDOW / MIN_MATCH4 + 1)];
+                }
+                catch (...) {
+                    delete[] nodes;
+                    throw;
+                }
+
+                _nodes = nodes;
+                _parse = parse;
+            }
+
+            return forwardOptimal(input, output, count);
+        }
+
+        return encode<true, false>(input, output, count);
+    }
+
+    return encode<false, false>(input, output, count);
+}
+
+
+template <bool T>
+template <bool C, bool O>
+bool LZXCodec<T>::encode(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>& output, int count)
+{
+    memset(_hashes, 0, sizeof(int32) << (64 - _hashShift));
     const kanzi::byte* src = &input._array[input._index];
     kanzi::byte* dst = &output._array[output._index];
-    const int maxDist = (srcEnd < 4 * MAX_DISTANCE1) ? MAX_DISTANCE1 : MAX_DISTANCE2;
+    const int maxDist = (count - 18 < 4 * MAX_DISTANCE1) ? MAX_DISTANCE1 : MAX_DISTANCE2;
     dst[12] = (maxDist == MAX_DISTANCE1) ? kanzi::byte(0) : kanzi::byte(1);
+    const Dictionary* dict = (_pCtx != nullptr) ? _pCtx->getDictionary() : nullptr;
+
+    // With a dictionary, the block is encoded after the dictionary tail
+    // (prefix) and matches may refer to it.
+    const int prefix = (dict != nullptr) ? min(dict->size(), maxDist) : 0;
+
+    if (prefix > 0) {
+        kanzi::byte* buf = loadDictionary(*dict, prefix, count);
+        memcpy(&buf[prefix], src, count);
+        src = buf;
+
+        for (int i = 1; i < prefix; i++)
+            insert<C>(hash(&src[i]), i);
+    }
+
+    const int srcEnd = prefix + count - 16 - 2;
     int mm = MIN_MATCH4;
 
     if (_pCtx != nullptr) {
-        Global::DataType dt = (Global::DataType)_pCtx->getInt("dataType", Global::UNDEFINED);
+        Global::DataType dt = (Global::DataType)_pCtx->getInt(Context::DATA_TYPE, Global::UNDEFINED);
 
         if (dt == Global::DNA) {
             // Longer min match for DNA input
@@ -193,62 +281,94 @@ bool LZXCodec<T>::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte
     // dst[12] = 0000MMMD (4 bits + 3 bits minMatch + 1 bit max distance)
     dst[12] |= kanzi::byte(((mm - 2) & 0x07) << 1); // minMatch in [2..9]
     const int minMatch = mm;
-    int srcIdx = 0;
+    int srcIdx = prefix;
     int dstIdx = 13;
-    int anchor = 0;
+    int anchor = prefix;
     int mIdx = 0;
     int mLenIdx = 0;
     int tkIdx = 0;
-    int repd[] = { count, count };
+    // The initial repeat distances must never match (the decoder starts
+    // with other values), including in the dictionary prefix.
+    int repd[] = { prefix + count, prefix + count };
     int repIdx = 0;
     int srcInc = 0;
+    int parseIdx = 0;
+    int parseSize = 0;
+    int parseEnd = prefix;
 
     while (srcIdx < srcEnd) {
         int bestLen = 0;
-        const int32 h0 = hash(&src[srcIdx]);
-        const int ref0 = _hashes[h0];
-        _hashes[h0] = srcIdx;
-        const int srcIdx1 = srcIdx + 1;
-        int ref = srcIdx1 - repd[repIdx];
-        const int minRef = max(srcIdx - maxDist, 0);
+        int ref;
+
+        if (O == true) {
+            // Next match of the optimal parse, parse the next window if needed
+            if (parseIdx == parseSize) {
+                if (parseEnd >= srcEnd)
+                    break;
+
+                parseSize = parse(src, parseEnd, srcEnd, anchor, minMatch, maxDist, repd[0], repd[1], parseEnd);
+                parseIdx = 0;
+                continue;
+            }
 
-        if ((ref > minRef) && KANZI_MEM_EQ4(&src[srcIdx1], &src[ref])) {
-            // Check repd0 first
-            bestLen = findMatch(src, srcIdx1, ref, min(srcEnd - srcIdx1, MAX_MATCH));
+            srcIdx = _parse[3 * parseIdx];
+            ref = srcIdx - _parse[3 * parseIdx + 1];
+            bestLen = _parse[3 * parseIdx + 2];
+            parseIdx++;
         }
         else {
-            ref = srcIdx1 - repd[repIdx ^ 1];
+            const int32 h0 = hash(&src[srcIdx]);
+            const int ref0 = _hashes[h0];
+            insert<C>(h0, srcIdx);
+            const int srcIdx1 = srcIdx + 1;
+            ref = srcIdx1 - repd[repIdx];
+            const int minRef = max(srcIdx - maxDist, 0);
 
             if ((ref > minRef) && KANZI_MEM_EQ4(&src[srcIdx1], &src[ref])) {
-                // Check repd1 first
+                // Check repd0 first
                 bestLen = findMatch(src, srcIdx1, ref, min(srcEnd - srcIdx1, MAX_MATCH));
             }
-        }
-
-        if (bestLen < minMatch) {
-            // Check match at position in hash table
-            ref = ref0;
+            else {
+                ref = srcIdx1 - repd[repIdx ^ 1];
 
-            if ((ref > minRef) && KANZI_MEM_EQ4(&src[srcIdx], &src[ref])) {
-                bestLen = findMatch(src, srcIdx, ref, min(srcEnd - srcIdx, MAX_MATCH));
+                if ((ref > minRef) && KANZI_MEM_EQ4(&src[srcIdx1], &src[ref])) {
+                    // Check repd1 first
+                    bestLen = findMatch(src, srcIdx1, ref, min(srcEnd - srcIdx1, MAX_MATCH));
+                }
             }
 
-            // No good match ?
             if (bestLen < minMatch) {
-                srcIdx = srcIdx1 + (srcInc >> 6);
-                srcInc++;
-                repIdx = 0;
-                continue;
-            }
+                // Check match at position in hash table
+                ref = ref0;
 
-            if ((srcIdx - ref != repd[0]) && (srcIdx - ref != repd[1])) {
-                // Check if better match at next position
-                const int32 h1 = hash(&src[srcIdx1]);
-                const int ref1 = _hashes[h1];
-                _hashes[h1] = srcIdx1;
+                if (C == true) {
+                    bestLen = findChainMatch(src, srcIdx, ref, minRef, min(srcEnd - srcIdx, MAX_MATCH));
+                }
+                else if ((ref > minRef) && KANZI_MEM_EQ4(&src[srcIdx], &src[ref])) {
+                    bestLen = findMatch(src, srcIdx, ref, min(srcEnd - srcIdx, MAX_MATCH));
+                }
+
+                // No good match ?
+                if (bestLen < minMatch) {
+                    srcIdx = srcIdx1 + (srcInc >> 6);
+                    srcInc++;
+                    repIdx = 0;
+                    continue;
+                }
+
+                if ((srcIdx - ref != repd[0]) && (srcIdx - ref != repd[1])) {
+                    // Check if better match at next position
+                    const int32 h1 = hash(&src[srcIdx1]);
+                    int ref1 = _hashes[h1];
+                    insert<C>(h1, srcIdx1);
+                    int bestLen1 = 0;
 
-                if ((ref1 > minRef + 1) && KANZI_MEM_EQ4(&src[srcIdx1 + bestLen - 3], &src[ref1 + bestLen - 3])) {
-                    const int bestLen1 = findMatch(src, srcIdx1, ref1, min(srcEnd - srcIdx1, MAX_MATCH));
+                    if (C == true) {
+                        bestLen1 = findChainMatch(src, srcIdx1, ref1, minRef + 1, min(srcEnd - srcIdx1, MAX_MATCH));
+                    }
+                    else if ((ref1 > minRef + 1) && KANZI_MEM_EQ4(&src[srcIdx1 + bestLen - 3], &src[ref1 + bestLen - 3])) {
+                        bestLen1 = findMatch(src, srcIdx1, ref1, min(srcEnd - srcIdx1, MAX_MATCH));
+                    }
 
                     // Select best match
                     if (bestLen1 >= bestLen) {
@@ -256,16 +376,20 @@ bool LZXCodec<T>::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte
                         bestLen = bestLen1;
                         srcIdx = srcIdx1;
                     }
-                }
 
-                if (T == true) {
-                   const int srcIdx2 = srcIdx1 + 1;
-                   const int32 h2 = hash(&src[srcIdx2]);
-                   const int ref2 = _hashes[h2];
-                   _hashes[h2] = srcIdx2;
+                    if (T == true) {
+                       const int srcIdx2 = srcIdx1 + 1;
+                       const int32 h2 = hash(&src[srcIdx2]);
+                       int ref2 = _hashes[h2];
+                       insert<C>(h2, srcIdx2);
+                       int bestLen2 = 0;
 
-                   if ((ref2 > minRef + 2) && KANZI_MEM_EQ4(&src[srcIdx2 + bestLen - 3], &src[ref2 + bestLen - 3])) {
-                       const int bestLen2 = findMatch(src, srcIdx2, ref2, min(srcEnd - srcIdx2, MAX_MATCH));
+                       if (C == true) {
+                           bestLen2 = findChainMatch(src, srcIdx2, ref2, minRef + 2, min(srcEnd - srcIdx2, MAX_MATCH));
+                       }
+                       else if ((ref2 > minRef + 2) && KANZI_MEM_EQ4(&src[srcIdx2 + bestLen - 3], &src[ref2 + bestLen - 3])) {
+                           bestLen2 = findMatch(src, srcIdx2, ref2, min(srcEnd - srcIdx2, MAX_MATCH));
+                       }
 
                        // Select best match
                        if (bestLen2 >= bestLen) {
@@ -275,30 +399,30 @@ bool LZXCodec<T>::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte
                        }
                     }
                 }
-            }
 
-            // Extend backwards
-            while ((srcIdx > anchor) && (ref > minRef) && (src[srcIdx - 1] == src[ref - 1])) {
-                bestLen++;
-                ref--;
-                srcIdx--;
-            }
+                // Extend backwards
+                while ((srcIdx > anchor) && (ref > minRef) && (src[srcIdx - 1] == src[ref - 1])) {
+                    bestLen++;
+                    ref--;
+                    srcIdx--;
+                }
 
-            if (bestLen > MAX_MATCH) {
-                ref += (bestLen - MAX_MATCH);
-                srcIdx += (bestLen - MAX_MATCH);
-                bestLen = MAX_MATCH;
-            }
-        }
-        else {
-            if ((bestLen >= MAX_MATCH) || (src[srcIdx] != src[ref - 1])) {
-                srcIdx++;
-                const int32 h1 = hash(&src[srcIdx]);
-                _hashes[h1] = srcIdx;
+                if (bestLen > MAX_MATCH) {
+                    ref += (bestLen - MAX_MATCH);
+                    srcIdx += (bestLen - MAX_MATCH);
+                    bestLen = MAX_MATCH;
+                }
             }
             else {
-                bestLen++;
-                ref--;
+                if ((bestLen >= MAX_MATCH) || (src[srcIdx] != src[ref - 1])) {
+                    srcIdx++;
+                    const int32 h1 = hash(&src[srcIdx]);
+                    insert<C>(h1, srcIdx);
+                }
+                else {
+                    bestLen++;
+                    ref--;
+                }
             }
         }
 
@@ -378,52 +502,54 @@ bool LZXCodec<T>::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte
             dstIdx += litLen;
         }
 
-        if (mIdx >= _bufferSize - 8) {
-            // Expand match buffer
-            kanzi::byte* mBuf = new kanzi::byte[(_bufferSize * 3) / 2];
-            memcpy(&mBuf[0], &_mBuf[0], _bufferSize);
-
-            if ( _mBuf != nullptr)
-                delete[] _mBuf;
-
+        if ((mIdx >= _bufferSize - 8) || (mLenIdx >= _bufferSize - 8) || (tkIdx >= _bufferSize - 8)) {
+            // Expand match, match length and token buffers (all of them,
+            // they share the size)
+            const int newSize = (_bufferSize * 3) / 2;
+            kanzi::byte* mBuf = new kanzi::byte[newSize];
+            memcpy(&mBuf[0], &_mBuf[0], mIdx);
+            delete[] _mBuf;
             _mBuf = mBuf;
-
-            if (mLenIdx >= _bufferSize - 8) {
-                kanzi::byte* mLenBuf = new kanzi::byte[(_bufferSize * 3) / 2];
-                memcpy(&mLenBuf[0], &_mLenBuf[0], _bufferSize);
-
-                if (_mLenBuf != nullptr)
-                   delete[] _mLenBuf;
-
-                _mLenBuf = mLenBuf;
-            }
-
-            _bufferSize = (_bufferSize * 3) / 2;
+            kanzi::byte* mLenBuf = new kanzi::byte[newSize];
+            memcpy(&mLenBuf[0], &_mLenBuf[0], mLenIdx);
+            delete[] _mLenBuf;
+            _mLenBuf = mLenBuf;
+            kanzi::byte* tkBuf = new kanzi::byte[newSize];
+            memcpy(&tkBuf[0], &_tkBuf[0], tkIdx);
+            delete[] _tkBuf;
+            _tkBuf = tkBuf;
+            _bufferSize = newSize;
         }
 
         // Fill _hashes and update positions
         anchor = srcIdx + bestLen;
 
+        if (O == true) {
+            // The parser has already added the positions
+            srcIdx = anchor;
+            continue;
+        }
+
         while (srcIdx + 4 < anchor) {
             srcIdx += 4;
             const int32 hh0 = hash(&src[srcIdx - 3]);
             const int32 hh1 = hash(&src[srcIdx - 2]);
             const int32 hh2 = hash(&src[srcIdx - 1]);
             const int32 hh3 = hash(&src[srcIdx - 0]);
-            _hashes[hh0] = srcIdx - 3;
-            _hashes[hh1] = srcIdx - 2;
-            _hashes[hh2] = srcIdx - 1;
-            _hashes[hh3] = srcIdx - 0;
+            insert<C>(hh0, srcIdx - 3);
+            insert<C>(hh1, srcIdx - 2);
+            insert<C>(hh2, srcIdx - 1);
+            insert<C>(hh3, srcIdx - 0);
         }
 
         while (++srcIdx < anchor) {
             const int32 h = hash(&src[srcIdx]);
-            _hashes[h] = srcIdx;
+            insert<C>(h, srcIdx);
         }
     }
 
     // Emit last literals
-    const int litLen = count - anchor;
+    const int litLen = prefix + count - anchor;
 
     if (dstIdx + litLen + tkIdx + mIdx + mLenIdx >= count)
         return false;
@@ -454,14 +580,329 @@ bool LZXCodec<T>::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte
     return dstIdx <= count - (count / 100);
 }
 
+// Encode the block greedily (hash chains) to get the statistics of the
+// encoded bytes, then parse it again with the prices derived from them.
+// Keep the greedy output if its order 0 entropy is lower.
+template <bool T>
+bool LZXCodec<T>::forwardOptimal(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>& output, int count)
+{
+    const int inIdx = input._index;
+    const int outIdx = output._index;
+    const int bufSize = getMaxEncodedLength(count);
+
+    if (_greedyBufSize < bufSize) {
+        kanzi::byte* buf = new kanzi::byte[bufSize];
+        delete[] _greedyBuf;
+        _greedyBuf = buf;
+        _greedyBufSize = bufSize;
+    }
+
+    kanzi::byte* buf = _greedyBuf;
+    SliceArray<kanzi::byte> greedy(buf, bufSize, 0);
+    uint freqs[256] = { 0 };
+    int64 greedyCost = -1;
+
+    if (encode<true, false>(input, greedy, count) == true) {
+        Global::computeHistogram(buf, greedy._index, freqs);
+        greedyCost = int64(Global::computeFirstOrderEntropy1024(greedy._index, freqs)) * greedy._index;
+    }
+    else {
+        Global::computeHistogram(&input._array[inIdx], count, freqs);
+    }
+
+    setPrices(freqs);
+    input._index = inIdx;
+    const bool res = encode<true, true>(input, output, count);
+
+    if (greedyCost < 0)
+        return res;
+
+    if (res == true) {
+        const int size = output._index - outIdx;
+        memset(freqs, 0, sizeof(freqs));
+        Global::computeHistogram(&output._array[outIdx], size, freqs);
+
+        if (int64(Global::computeFirstOrderEntropy1024(size, freqs)) * size < greedyCost)
+            return true;
+    }
+
+    memcpy(&output._array[outIdx], buf, greedy._index);
+    input._index = inIdx + count;
+    output._index = outIdx + greedy._index;
+    return true;
+}
+
+
+// Prices (1/16 bits) of the byte values from their frequencies
+template <bool T>
+void LZXCodec<T>::setPrices(const uint freqs[])
+{
+    uint32 total = 0;
+
+    for (int i = 0; i < 256; i++)
+        total += freqs[i];
+
+    const int logTotal = Global::log2_1024(max(total, uint32(1)));
+
+    for (int i = 0; i < 256; i++) {
+        const int price = (freqs[i] == 0) ? logTotal + 1024 : logTotal - Global::log2_1024(freqs[i]);
+        _prices[i] = max(price >> 6, 4);
+    }
+}
+
+
+// Price (1/16 bits) of the token, distance and length bytes of a match after
+// 'lits' literals. 'rep' is 1 if the distance is repd0, 2 if it is repd1,
+// else 0.
+template <bool T>
+int32 LZXCodec<T>::getMatchPrice(int lits, int dist, int mLen, int rep) const
+{
+    int token = min(lits, 7) << 5;
+    int mLenTh = 3;
+    int32 price = 0;
+
+    if (rep == 0) {
+        price += _prices[dist & 0xFF];
+
+        if (dist >= 256)
+            price += _prices[(dist >> 8) & 0xFF];
+
+        if (dist >= 65536)
+            price += _prices[dist >> 16];
+
+        token |= ((dist >= 65536) ? 3 : ((dist >= 256) ? 2 : 1)) << 3;
+        mLenTh = 7;
+    }
+    else if (rep == 2) {
+        token |= 0x04;
+    }
+
+    if (mLen >= mLenTh) {
+        token += mLenTh;
+        price += (mLen - mLenTh < 254) ? _prices[mLen - mLenTh] : _prices[0xFE] + 16 * 16;
+    }
+    else {
+        token += mLen;
+    }
+
+    return price + _prices[token];
+}
+
+
+// Find the cheapest sequence of literals and matches for the positions in
+// [start, end) with end = min(start + PARSE_WINDOW, srcEnd). Matches do not
+// cross the end of the window. 'anchor' is the position of the first pending
+// literal and 'repd0', 'repd1' the repeat distances at 'start'.
+// Store the matches (position, distance, length) in _parse and return their
+// number.
+template <bool T>
+int LZXCodec<T>::parse(const kanzi::byte src[], int start, int srcEnd, int anchor, int minMatch, int maxDist,
+                       int repd0, int repd1, int& end)
+{
+    end = min(start + PARSE_WINDOW, srcEnd);
+    const int n = end - start;
+    ParseNode* nodes = _nodes;
+    nodes[0]._price = 0;
+    nodes[0]._len = 0;
+    nodes[0]._dist = 0;
+    nodes[0]._repd0 = repd0;
+    nodes[0]._repd1 = repd1;
+    nodes[0]._lits = start - anchor;
+
+    for (int i = 1; i <= n; i++)
+        nodes[i]._price = 0x7FFFFFFF;
+
+    // Positions inside a long match are not searched (see NICE_MATCH)
+    int skipEnd = start;
+
+    for (int i = 0; i < n; i++) {
+        const int pos = start + i;
+        const ParseNode& node = nodes[i];
+        const int32 h = hash(&src[pos]);
+        const int ref0 = _hashes[h];
+        insert<true>(h, pos);
+
+        // Literal: an extra length byte once the literal run reaches 7
+        {
+            const int32 price = node._price + _prices[int(src[pos])] + ((node._lits == 6) ? _prices[0] : 0);
+            ParseNode& next = nodes[i + 1];
+
+            if (price < next._price) {
+                next._price = price;
+                next._len = 0;
+                next._repd0 = node._repd0;
+                next._repd1 = node._repd1;
+                next._lits = node._lits + 1;
+            }
+        }
+
+        const int maxMatch = min(end - pos, MAX_MATCH);
+
+        if ((pos < skipEnd) || (maxMatch < minMatch))
+            continue;
+
+        const int minRef = max(pos - maxDist, 0);
+        int bestLen = minMatch - 1;
+
+        // Repeat distances first (cheapest), then the hash chain from the
+        // most recent position. Each match length is priced with the first
+        // (closest) candidate reaching it.
+        for (int r = 0; r < 2; r++) {
+            const int dist = (r == 0) ? node._repd0 : node._repd1;
+            const int ref = pos - dist;
+
+            if ((ref <= minRef) || ((r == 1) && (dist == node._repd0)))
+                continue;
+
+            if (KANZI_MEM_EQ4(&src[pos], &src[ref]) == false)
+                continue;
+
+            const int len = findMatch(src, pos, ref, maxMatch);
+
+            for (int l = minMatch; l <= min(len, NICE_MATCH); l++) {
+                const int32 price = node._price + getMatchPrice(node._lits, dist, l - minMatch, r + 1);
+                ParseNode& next = nodes[i + l];
+
+                if (price < next._price) {
+                    next._price = price;
+                    next._len = l;
+                    next._dist = dist;
+                    next._repd0 = dist;
+                    next._repd1 = node._repd0;
+                    next._lits = 0;
+                }
+            }
+
+            if (len > NICE_MATCH) {
+                ParseNode& next = nodes[i + len];
+                next._price = node._price + getMatchPrice(node._lits, dist, len - minMatch, r + 1);
+                next._len = len;
+                next._dist = dist;
+                next._repd0 = dist;
+                next._repd1 = node._repd0;
+                next._lits = 0;
+                skipEnd = pos + len;
+                break;
+            }
+
+            if (len > bestLen)
+                bestLen = len;
+        }
+
+        if ((pos < skipEnd) || (bestLen >= maxMatch))
+            continue;
+
+        const int minPos = max(minRef, pos + 2 - _chainSize);
+        int cand = ref0;
+
+        for (int d = _searchDepth; (d > 0) && (cand > minPos); d--) {
+            if ((src[cand + bestLen] == src[pos + bestLen]) && KANZI_MEM_EQ4(&src[cand], &src[pos])) {
+                const int len = findMatch(src, pos, cand, maxMatch);
+
+                if (len > bestLen) {
+                    const int dist = pos - cand;
+
+                    const int rep = (dist == node._repd0) ? 1 : ((dist == node._repd1) ? 2 : 0);
+
+                    for (int l = bestLen + 1; l <= min(len, NICE_MATCH); l++) {
+                        const int32 price = node._price + getMatchPrice(node._lits, dist, l - minMatch, rep);
+                        ParseNode& next = nodes[i + l];
+
+                        if (price < next._price) {
+                            next._price = price;
+                            next._len = l;
+                            next._dist = dist;
+                            next._repd0 = dist;
+                            next._repd1 = node._repd0;
+                            next._lits = 0;
+                        }
+                    }
+
+                    bestLen = len;
+
+                    if (len > NICE_MATCH) {
+                        // Long match: take it and skip the positions it covers
+                        ParseNode& next = nodes[i + len];
+                        next._price = node._price + getMatchPrice(node._lits, dist, len - minMatch, rep);
+                        next._len = len;
+                        next._dist = dist;
+                        next._repd0 = dist;
+                        next._repd1 = node._repd0;
+                        next._lits = 0;
+                        skipEnd = pos + len;
+                        break;
+                    }
+
+                    if (len >= maxMatch)
+                        break;
+                }
+            }
+
+            const int next = _chain[cand & (_chainSize - 1)];
+
+            if (next >= cand)
+                break;
+
+            cand = next;
+        }
+    }
+
+    // Walk back from the end of the window, then store the matches in order
+    int nbMatches = 0;
+
+    for (int i = n; i > 0; ) {
+        const ParseNode& node = nodes[i];
+
+        if (node._len == 0) {
+            i--;
+            continue;
+        }
+
+        i -= node._len;
+        _parse[3 * nbMatches] = start + i;
+        _parse[3 * nbMatches + 1] = node._dist;
+        _parse[3 * nbMatches + 2] = node._len;
+        nbMatches++;
+    }
+
+    for (int i = 0, j = nbMatches - 1; i < j; i++, j--) {
+        for (int k = 0; k < 3; k++)
+            swap(_parse[3 * i + k], _parse[3 * j + k]);
+    }
+
+    return nbMatches;
+}
+
+
+template <bool T>
+kanzi::byte* LZXCodec<T>::loadDictionary(const Dictionary& dict, int prefix, int length)
+{
+    // Extra room for the 16 byte match copies past the end of the block
+    const int newSize = prefix + length + 32;
+
+    if (_dictBufSize < newSize) {
+        kanzi::byte* buf = new kanzi::byte[newSize];
+        delete[] _dictBuf;
+        _dictBuf = buf;
+        _dictBufSize = newSize;
+    }
+
+    memcpy(&_dictBuf[0], &dict.data()[dict.size() - prefix], prefix);
+    return _dictBuf;
+}
+
 template <bool T>
 bool LZXCodec<T>::inverse(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>& output, int count)
 {
-    int bsVersion = _pCtx == nullptr ? 6 : _pCtx->getInt("bsVersion", 6);
+    int bsVersion = _pCtx == nullptr ? 6 : _pCtx->getInt(Context::BS_VERSION, 6);
 
     if (bsVersion < 6)
        return inverseV5(input, output, count);
 
+    if ((_pCtx != nullptr) && (count > 0) && (SliceArray<kanzi::byte>::isValid(input) == true)
+       && (SegmentedCodec::isSegmented(&input._array[input._index], count) == true))
+       return SegmentedCodec::inverse<LZXCodec<T> >(*_pCtx, input, output, count);
+
     return inverseV6(input, output, count);
 }
 
@@ -488,7 +929,8 @@ bool LZXCodec<T>::inverseV6(SliceArray<kanzi::byte>& input, SliceArray<kanzi::by
        return false;
 
     const int dstEnd = output._length - output._index;
-    kanzi::byte* dst = &output._array[output._index];
+    kanzi::byte* const output0 = &output._array[output._index];
+    kanzi::byte* dst = output0;
     const kanzi::byte* src = &input._array[input._index];
 
     int tkIdx = LittleEndian::readInt32(&src[0]);
@@ -509,6 +951,14 @@ bool LZXCodec<T>::inverseV6(SliceArray<kanzi::byte>& input, SliceArray<kanzi::by
     const int litEnd = tkIdx;
     const int maxDist = ((int(src[12]) & 1) == 0) ? MAX_DISTANCE1 : MAX_DISTANCE2;
     const int minMatch = ((int(src[12]) >> 1) & 0x07) + 2;
+    const Dictionary* dict = (_pCtx != nullptr) ? _pCtx->getDictionary() : nullptr;
+
+    // With a dictionary, decode after the dictionary tail (see forward)
+    const int prefix = (dict != nullptr) ? min(dict->size(), maxDist) : 0;
+
+    if (prefix > 0)
+        dst = &loadDictionary(*dict, prefix, dstEnd)[prefix];
+
     bool res = true;
     int srcIdx = 13;
     int dstIdx = 0;
@@ -569,7 +1019,7 @@ bool LZXCodec<T>::inverseV6(SliceArray<kanzi::byte>& input, SliceArray<kanzi::by
         int ref = dstIdx - dist;
 
         // Sanity check
-        if ((ref < 0) || (dist > maxDist) || (mEnd > dstEnd)) {
+        if ((ref < -prefix) || (dist > maxDist) || (mEnd > dstEnd)) {
             res = false;
             goto exit;
         }
@@ -604,6 +1054,9 @@ bool LZXCodec<T>::inverseV6(SliceArray<kanzi::byte>& input, SliceArray<kanzi::by
     }
 
 exit:
+    if (prefix > 0)
+        memcpy(output0, dst, dstIdx);
+
     output._index += dstIdx;
     input._index += count;
     return res && (srcIdx == srcEnd + 13);
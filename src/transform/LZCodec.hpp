@@ -48,17 +48,40 @@ namespace kanzi {
     };
 
     // Simple byte oriented LZ77 implementation.
+    // By default, the match finder keeps one position per hash (fastest).
+    // With the "lzSearch" context key (1..MAX_SEARCH), it follows hash chains
+    // and tries up to 'lzSearch' earlier positions with the same hash: better
+    // matches at a higher CPU cost. The bitstream does not depend on it.
+    // With the "lzOptimal" context key, the encoder parses windows of the block
+    // by dynamic programming instead of greedily: each position is reached by
+    // the cheapest sequence of literals and matches (hash chains and repeat
+    // distances). Literals, tokens, distances and lengths are priced from the
+    // order 0 statistics of a greedy encoding of the block, as seen by the
+    // downstream Huffman or ANS coder.
     template <bool T>
     class LZXCodec FINAL : public Transform<byte> {
     public:
+        static const int MAX_SEARCH = 256;
+
         LZXCodec()
         {
             _hashes = nullptr;
             _hashSize = 0;
+            _hashShift = 64 - HASH_LOG;
+            _chain = nullptr;
+            _chainSize = 0;
+            _searchDepth = 0;
+            _optimal = false;
+            _nodes = nullptr;
+            _parse = nullptr;
             _tkBuf = nullptr;
             _mLenBuf = nullptr;
             _mBuf = nullptr;
             _bufferSize = 0;
+            _dictBuf = nullptr;
+            _dictBufSize = 0;
+            _greedyBuf = nullptr;
+            _greedyBufSize = 0;
             _pCtx = nullptr;
         }
 
@@ -67,17 +90,41 @@ namespace kanzi {
         {
             _hashes = nullptr;
             _hashSize = 0;
+            _hashShift = 64 - HASH_LOG;
+            _chain = nullptr;
+            _chainSize = 0;
+            _searchDepth = ctx.getInt("lzSearch", 0);
+            _searchDepth = (_searchDepth < 0) ? 0 : ((_searchDepth > MAX_SEARCH) ? MAX_SEARCH : _searchDepth);
+            _optimal = ctx.getInt("lzOptimal", 0) != 0;
+            _nodes = nullptr;
+            _parse = nullptr;
+
+            // The optimal parser needs several match candidates per position
+            if ((_optimal == true) && (_searchDepth == 0))
+                _searchDepth = OPTIMAL_SEARCH;
             _tkBuf = nullptr;
             _mLenBuf = nullptr;
             _mBuf = nullptr;
             _bufferSize = 0;
+            _dictBuf = nullptr;
+            _dictBufSize = 0;
+            _greedyBuf = nullptr;
+            _greedyBufSize = 0;
         }
 
         ~LZXCodec()
         {
             _bufferSize = 0;
             _hashSize = 0;
+            _chainSize = 0;
+            _dictBufSize = 0;
+            _greedyBufSize = 0;
             if (_hashes != nullptr) delete[] _hashes;
+            if (_chain != nullptr) delete[] _chain;
+            if (_nodes != nullptr) delete[] _nodes;
+            if (_parse != nullptr) delete[] _parse;
+            if (_dictBuf != nullptr) delete[] _dictBuf;
+            if (_greedyBuf != nullptr) delete[] _greedyBuf;
             if (_mLenBuf != nullptr) delete[] _mLenBuf;
             if (_mBuf != nullptr) delete[] _mBuf;
             if (_tkBuf != nullptr) delete[] _tkBuf;
@@ -98,7 +145,7 @@ namespace kanzi {
         static const uint HASH_SEED;
         static const uint HASH_LOG;
         static const uint HASH_LSHIFT;
-        static const uint HASH_RSHIFT;
+        static const int MIN_HASH_LOG;
         static const int MAX_DISTANCE1;
         static const int MAX_DISTANCE2;
         static const int MIN_MATCH4;
@@ -107,15 +154,57 @@ namespace kanzi {
         static const int MAX_MATCH;
         static const int MIN_BLOCK_LENGTH;
         static const int READ_LENGTH_GUARD;
+        static const int CHAIN_LOG;
+        static const int OPTIMAL_SEARCH;
+        static const int PARSE_WINDOW;
+        static const int NICE_MATCH;
+
+        // Cheapest way found to reach a position of the parse window
+        struct ParseNode {
+            int32 _price; // 1/16 bits
+            int32 _len; // length of the last match, 0 if the last step is a literal
+            int32 _dist; // distance of the last match
+            int32 _repd0; // repeat distances after the last step
+            int32 _repd1;
+            int32 _lits; // literals since the last match
+        };
 
         int32* _hashes;
         int _hashSize;
+        uint _hashShift; // 64 - log2(hash table entries used by the block)
+        int32* _chain; // previous position with the same hash (ring buffer)
+        int _chainSize;
+        int _searchDepth; // positions tried per hash chain, 0 for no chain
+        bool _optimal;
+        ParseNode* _nodes; // PARSE_WINDOW + 1 nodes
+        int32* _parse; // matches of the parse window (position, distance, length)
+        int32 _prices[256]; // prices of the encoded byte values (1/16 bits)
         byte* _mLenBuf;
         byte* _mBuf;
         byte* _tkBuf;
         int _bufferSize;
+        byte* _dictBuf; // dictionary tail followed by the block
+        int _dictBufSize;
+        byte* _greedyBuf; // greedy encoding of the block (optimal parsing)
+        int _greedyBufSize;
         Context* _pCtx;
 
+        // Copy the last 'prefix' bytes of the dictionary to the start of _dictBuf,
+        // large enough for 'length' more bytes.
+        byte* loadDictionary(const Dictionary& dict, int prefix, int length);
+
+        template <bool C, bool O>
+        bool encode(SliceArray<byte>& src, SliceArray<byte>& dst, int length);
+
+        bool forwardOptimal(SliceArray<byte>& src, SliceArray<byte>& dst, int length);
+
+        int parse(const byte src[], int start, int srcEnd, int anchor, int minMatch, int maxDist,
+                  int repd0, int repd1, int& end);
+
+        void setPrices(const uint freqs[]);
+
+        int32 getMatchPrice(int lits, int dist, int mLen, int rep) const;
+
         bool inverseV6(SliceArray<byte>& src, SliceArray<byte>& dst, int length);
 
         bool inverseV5(SliceArray<byte>& src, SliceArray<byte>& dst, int length);
@@ -128,7 +217,13 @@ namespace kanzi {
 
         static uint readLength(const byte block[], int& pos);
 
-        static int32 hash(const byte* p);
+        int32 hash(const byte* p) const;
+
+        // Add the position to the hash table (and to the hash chains if C)
+        template <bool C>
+        void insert(int32 h, int pos);
+
+        int findChainMatch(const byte src[], int pos, int& ref, int minRef, int maxMatch) const;
     };
 
     class LZPCodec FINAL : public Transform<byte> {
@@ -184,9 +279,61 @@ namespace kanzi {
     }
 
     template <bool T>
-    inline int32 LZXCodec<T>::hash(const byte* p)
+    inline int32 LZXCodec<T>::hash(const byte* p) const
+    {
+        return ((uint64(LittleEndian::readLong64(p)) << HASH_LSHIFT) * HASH_SEED) >> _hashShift;
+    }
+
+    template <bool T>
+    template <bool C>
+    inline void LZXCodec<T>::insert(int32 h, int pos)
+    {
+        if (C == true) {
+            // The position may be added twice (EG. after a lazy match)
+            if (_hashes[h] == pos)
+                return;
+
+            _chain[pos & (_chainSize - 1)] = _hashes[h];
+        }
+
+        _hashes[h] = pos;
+    }
+
+    // Return the length of the longest match at 'pos' among the positions
+    // of the hash chain starting at 'ref' (most recent first) and store its
+    // position in 'ref' (unchanged if no match).
+    // An entry of the ring is valid if no position after it has been added
+    // at the same index: the chain stops at positions too far behind 'pos'
+    // (at most 2 positions after 'pos' have been added).
+    template <bool T>
+    inline int LZXCodec<T>::findChainMatch(const byte src[], int pos, int& ref, int minRef, int maxMatch) const
     {
-        return ((uint64(LittleEndian::readLong64(p)) << HASH_LSHIFT) * HASH_SEED) >> HASH_RSHIFT;
+        const int minPos = (minRef > pos + 2 - _chainSize) ? minRef : pos + 2 - _chainSize;
+        int cand = ref;
+        int bestLen = 0;
+
+        for (int n = _searchDepth; (n > 0) && (cand > minPos); n--) {
+            if ((src[cand + bestLen] == src[pos + bestLen]) && KANZI_MEM_EQ4(&src[cand], &src[pos])) {
+                const int len = findMatch(src, pos, cand, maxMatch);
+
+                if (len > bestLen) {
+                    bestLen = len;
+                    ref = cand;
+
+                    if (len >= maxMatch)
+                        break;
+                }
+            }
+
+            const int next = _chain[cand & (_chainSize - 1)];
+
+            if (next >= cand)
+                break;
+
+            cand = next;
+        }
+
+        return bestLen;
     }
 
     template <bool T>
@@ -17,6 +17,7 @@ limitations under the License.
 #include <cstring>
 #include <stdexcept>
 
+#include "BlockStats.hpp"
 #include "RLT.hpp"
 #include "../Global.hpp"
 #include "../Memory.hpp"
@@ -59,7 +60,7 @@ bool RLT::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>& outpu
     bool findBestEscape = true;
 
     if (_pCtx != nullptr) {
-        dt = (Global::DataType) _pCtx->getInt("dataType", Global::UNDEFINED);
+        dt = (Global::DataType) _pCtx->getInt(Context::DATA_TYPE, Global::UNDEFINED);
 
         if ((dt == Global::DNA) || (dt == Global::BASE64) || (dt == Global::UTF8))
             return false;
@@ -76,14 +77,20 @@ bool RLT::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>& outpu
     kanzi::byte escape = DEFAULT_ESCAPE;
 
     if (findBestEscape == true) {
+        // Reuse the statistics of the block if a previous transform computed them
+        BlockStats* stats = BlockStats::get(_pCtx, src, count);
         uint freqs[256] = { 0 };
-        Global::computeHistogram(&src[0], count, freqs);
+
+        if (stats != nullptr)
+            memcpy(&freqs[0], stats->getHistogram(), sizeof(freqs));
+        else
+            Global::computeHistogram(&src[0], count, freqs);
 
         if (dt == Global::UNDEFINED) {
             dt = Global::detectSimpleType(count, freqs);
 
             if ((_pCtx != nullptr) && (dt != Global::UNDEFINED))
-                _pCtx->putInt("dataType", dt);
+                _pCtx->putInt(Context::DATA_TYPE, dt);
 
             if ((dt == Global::DNA) || (dt == Global::BASE64) || (dt == Global::UTF8))
                 return false;
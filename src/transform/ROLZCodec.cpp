@@ -13,11 +13,13 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <streambuf>
 #include "ROLZCodec.hpp"
+#include "../Dictionary.hpp"
 #include "../Global.hpp"
 #include "../Memory.hpp"
 #include "../bitstream/DefaultInputBitStream.hpp"
@@ -25,6 +27,7 @@ limitations under the License.
 #include "../entropy/ANSRangeDecoder.hpp"
 #include "../entropy/ANSRangeEncoder.hpp"
 #include "../util/fixedbuf.hpp"
+#include "SegmentedCodec.hpp"
 
 using namespace kanzi;
 using namespace std;
@@ -96,6 +99,50 @@ bool ROLZCodec::inverse(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>&
 }
 
 
+Global::DataType ROLZCodec::getDataType(Context& ctx, const kanzi::byte src[], int count)
+{
+    Global::DataType dt = (Global::DataType) ctx.getInt(Context::DATA_TYPE, Global::UNDEFINED);
+
+    if (dt == Global::UNDEFINED) {
+        uint freqs0[256] = { 0 };
+        Global::computeHistogram(&src[0], count, freqs0);
+        dt = Global::detectSimpleType(count, freqs0);
+
+        if (dt != Global::UNDEFINED)
+            ctx.putInt(Context::DATA_TYPE, dt);
+    }
+
+    return dt;
+}
+
+int ROLZCodec::getDictionaryPrefix(const Context* ctx, int count)
+{
+    const Dictionary* dict = (ctx != nullptr) ? ctx->getDictionary() : nullptr;
+
+    // Positions in the dictionary and the block must fit in the position bits
+    if ((dict == nullptr) || (dict->size() < 16) || (count > CHUNK_SIZE - dict->size()))
+        return 0;
+
+    return dict->size();
+}
+
+kanzi::byte* ROLZCodec::loadDictionary(const Dictionary& dict, int prefix, int length, kanzi::byte*& buf, int& bufSize)
+{
+    // Extra room for the 8 byte match copies past the end of the block
+    const int newSize = prefix + length + 16;
+
+    if (bufSize < newSize) {
+        kanzi::byte* newBuf = new kanzi::byte[newSize];
+        delete[] buf;
+        buf = newBuf;
+        bufSize = newSize;
+    }
+
+    memcpy(&buf[0], &dict.data()[dict.size() - prefix], prefix);
+    return buf;
+}
+
+
 const int ROLZCodec1::MIN_MATCH3 = 3;
 const int ROLZCodec1::MIN_MATCH4 = 4;
 const int ROLZCodec1::MIN_MATCH7 = 7;
@@ -118,6 +165,8 @@ ROLZCodec1::ROLZCodec1(uint logPosChecks) :
     _minMatch = MIN_MATCH3;
     _mSize = 0;
     _matches = nullptr;
+    _dictBuf = nullptr;
+    _dictBufSize = 0;
     memset(&_counters[0], 0, sizeof(_counters));
 }
 
@@ -130,6 +179,8 @@ ROLZCodec1::ROLZCodec1(Context& ctx) :
     _minMatch = MIN_MATCH3;
     _mSize = 0;
     _matches = nullptr;
+    _dictBuf = nullptr;
+    _dictBufSize = 0;
     memset(&_counters[0], 0, sizeof(_counters));
 }
 
@@ -185,6 +236,13 @@ bool ROLZCodec1::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
     if (output._length < getMaxEncodedLength(count))
         return false;
 
+    // Large blocks are split into segments encoded concurrently. The data
+    // type is detected once for the whole block.
+    if ((_pCtx != nullptr) && (SegmentedCodec::getSegments(count) > 1)) {
+        ROLZCodec::getDataType(*_pCtx, &input._array[input._index], count);
+        return SegmentedCodec::forward<ROLZCodec1>(*_pCtx, input, output, count);
+    }
+
     const int srcEnd = count - 4;
     const kanzi::byte* src = &input._array[input._index];
     kanzi::byte* dst = &output._array[output._index];
@@ -206,16 +264,7 @@ bool ROLZCodec1::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
     int delta = 2;
 
     if (_pCtx != nullptr) {
-        Global::DataType dt = (Global::DataType) _pCtx->getInt("dataType", Global::UNDEFINED);
-
-        if (dt == Global::UNDEFINED) {
-            uint freqs0[256] = { 0 };
-            Global::computeHistogram(&src[0], count, freqs0);
-            dt = Global::detectSimpleType(count, freqs0);
-
-            if (dt != Global::UNDEFINED)
-                _pCtx->putInt("dataType", dt);
-        }
+        const Global::DataType dt = ROLZCodec::getDataType(*_pCtx, &src[0], count);
 
         if (dt == Global::EXE) {
             delta = 3;
@@ -242,6 +291,10 @@ bool ROLZCodec1::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
     flags |= (_logPosChecks << 4);
     dst[4] = kanzi::byte(flags);
     const bool cond = _minMatch == MIN_MATCH3;
+
+    // With a dictionary, the block (one chunk) is encoded after the dictionary
+    // tail (prefix) and matches may refer to it.
+    const int prefix = ROLZCodec::getDictionaryPrefix(_pCtx, count);
 	
     // Main loop
     while (startChunk < srcEnd) {
@@ -253,22 +306,39 @@ bool ROLZCodec1::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
         const int endChunk = min(startChunk + sizeChunk, srcEnd);
         sizeChunk = endChunk - startChunk;
         const kanzi::byte* buf = &src[startChunk];
-        const kanzi::byte* ref = &src[startChunk - delta];
         int srcIdx = 0;
-        const int n = min(srcEnd - startChunk, 8);
 
-        for (int j = 0; j < n; j++)
-            litBuf._array[litBuf._index++] = buf[srcIdx++];
+        if (prefix > 0) {
+            kanzi::byte* dictBuf = ROLZCodec::loadDictionary(*_pCtx->getDictionary(), prefix, count, _dictBuf, _dictBufSize);
+            memcpy(&dictBuf[prefix], &src[0], size_t(count));
+            buf = dictBuf;
+
+            // Register the dictionary positions
+            for (srcIdx = delta; srcIdx < prefix; srcIdx++) {
+                const uint32 key = (cond == true) ? ROLZCodec::getKey1(&buf[srcIdx - delta]) : ROLZCodec::getKey2(&buf[srcIdx - delta]);
+                uint8* counter = &_counters[key];
+                *counter = (*counter + 1) & _maskChecks;
+                _matches[(key << _logPosChecks) + *counter] = ROLZCodec::hash(&buf[srcIdx]) | int32(srcIdx);
+            }
+        }
+        else {
+            const int n = min(srcEnd - startChunk, 8);
+
+            for (int j = 0; j < n; j++)
+                litBuf._array[litBuf._index++] = buf[srcIdx++];
+        }
 
+        const kanzi::byte* ref = &buf[-delta];
+        const int bufEnd = prefix + sizeChunk;
         int firstLitIdx = srcIdx;
         int srcInc = 0;
 
-        while (srcIdx < sizeChunk) {
+        while (srcIdx < bufEnd) {
             const uint32 key = (cond == true) ? ROLZCodec::getKey1(&ref[srcIdx]): ROLZCodec::getKey2(&ref[srcIdx]);
             uint8* counter = &_counters[key];
             uint32* matches = &_matches[key << _logPosChecks];
             uint32 hash32 = ROLZCodec::hash(&buf[srcIdx]);
-            int match = findMatch(buf, srcIdx, sizeChunk, hash32, matches, counter);
+            int match = findMatch(buf, srcIdx, bufEnd, hash32, matches, counter);
 
             // Register current position
             *counter = (*counter + 1) & _maskChecks;
@@ -287,7 +357,7 @@ bool ROLZCodec1::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
             counter = &_counters[key2];
             matches = &_matches[key2 << _logPosChecks];
             hash32 = ROLZCodec::hash(&buf[srcIdx1]);
-            const int match2 = findMatch(buf, srcIdx1, sizeChunk, hash32, matches, counter);
+            const int match2 = findMatch(buf, srcIdx1, bufEnd, hash32, matches, counter);
 
             if ((match2 >= 0) && ((match2 & 0xFFFF) > (match & 0xFFFF))) {
                 // New match is better
@@ -327,7 +397,7 @@ bool ROLZCodec1::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
         }
 
         // Emit last chunk literals
-        const int litLen = sizeChunk - firstLitIdx;
+        const int litLen = bufEnd - firstLitIdx;
 
         if (tkBuf._index != 0) {
            // At least one match to emit
@@ -367,7 +437,7 @@ bool ROLZCodec1::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
         const int bufSize = int(ios.tellp());
 
         if (dstIdx + bufSize > output._length) {
-            input._index = startChunk + srcIdx;
+            input._index = startChunk + srcIdx - prefix;
             success = false;
             goto End;
         }
@@ -402,6 +472,9 @@ End:
 
 bool ROLZCodec1::inverse(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>& output, int count)
 {
+    if ((_pCtx != nullptr) && (SegmentedCodec::isSegmented(&input._array[input._index], count) == true))
+        return SegmentedCodec::inverse<ROLZCodec1>(*_pCtx, input, output, count);
+
     kanzi::byte* src = &input._array[input._index];
     const int end = BigEndian::readInt32(&src[0]);
 
@@ -464,13 +537,25 @@ bool ROLZCodec1::inverse(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
     memset(&_counters[0], 0, sizeof(_counters));
     bool success = true;
 
+    // With a dictionary, decode after the dictionary tail (see forward)
+    const int prefix = ROLZCodec::getDictionaryPrefix(_pCtx, end);
+
     // Main loop
     while (startChunk < dstEnd) {
         litBuf._index = 0;
         lenBuf._index = 0;
         mIdxBuf._index = 0;
         tkBuf._index = 0;
-        memset(&_matches[0], 0, sizeof(uint32) * size_t(ROLZCodec::HASH_SIZE << _logPosChecks));
+
+        if (prefix == 0) {
+            memset(&_matches[0], 0, sizeof(uint32) * size_t(ROLZCodec::HASH_SIZE << _logPosChecks));
+        }
+        else {
+            // Empty slots refer to the start of the dictionary, as in the encoder
+            uint32* matchesEnd = &_matches[size_t(ROLZCodec::HASH_SIZE << _logPosChecks)];
+            fill(&_matches[0], matchesEnd, uint32(-prefix));
+        }
+
         const int endChunk = min(startChunk + sizeChunk, dstEnd);
         sizeChunk = endChunk - startChunk;
         bool onlyLiterals = false;
@@ -494,7 +579,7 @@ bool ROLZCodec1::inverse(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
             tkLen = int(ibs.readBits(32));
             mLenLen = int(ibs.readBits(32));
             mIdxLen = int(ibs.readBits(32));
-            const int firstLitLen = min(sizeChunk, 8);
+            const int firstLitLen = (prefix == 0) ? min(sizeChunk, 8) : 0;
 
             if ((litLen < 0) || (tkLen < 0) || (mLenLen < 0) || (mIdxLen < 0)) {
                 input._index += srcIdx;
@@ -546,12 +631,29 @@ bool ROLZCodec1::inverse(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
 
         const bool cond = _minMatch == MIN_MATCH3;
         kanzi::byte* buf = &output._array[output._index];
-        const kanzi::byte* refBuf = &output._array[output._index - delta];
         int dstIdx = 0;
-        const int n = min(dstEnd - output._index, 8);
 
-        for (int j = 0; j < n; j++)
-            buf[dstIdx++] = litBuf._array[litBuf._index++];
+        if (prefix > 0) {
+            kanzi::byte* dictBuf = ROLZCodec::loadDictionary(*_pCtx->getDictionary(), prefix, dstEnd, _dictBuf, _dictBufSize);
+
+            // Register the dictionary positions (negative)
+            for (int i = delta; i < prefix; i++) {
+                const uint32 key = (cond == true) ? ROLZCodec::getKey1(&dictBuf[i - delta]) : ROLZCodec::getKey2(&dictBuf[i - delta]);
+                uint8* counter = &_counters[key];
+                *counter = (*counter + 1) & _maskChecks;
+                _matches[(key << _logPosChecks) + *counter] = uint32(i - prefix);
+            }
+
+            buf = &dictBuf[prefix];
+        }
+        else {
+            const int n = min(dstEnd - output._index, 8);
+
+            for (int j = 0; j < n; j++)
+                buf[dstIdx++] = litBuf._array[litBuf._index++];
+        }
+
+        const kanzi::byte* refBuf = &buf[-delta];
 
         // Next chunk
         while (dstIdx < sizeChunk) {
@@ -655,6 +757,9 @@ bool ROLZCodec1::inverse(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
             goto End;
         }
 
+        if (prefix > 0)
+            memcpy(&output._array[output._index], &buf[0], size_t(dstIdx));
+
         startChunk = endChunk;
         output._index += dstIdx;
     }
@@ -844,6 +949,8 @@ ROLZCodec2::ROLZCodec2(uint logPosChecks) :
     _maskChecks = uint8(_posChecks - 1);
     _minMatch = MIN_MATCH3;
     _matches = new uint32[ROLZCodec::HASH_SIZE << _logPosChecks];
+    _dictBuf = nullptr;
+    _dictBufSize = 0;
     memset(&_counters[0], 0, sizeof(_counters));
 }
 
@@ -855,6 +962,8 @@ ROLZCodec2::ROLZCodec2(Context& ctx) :
     _maskChecks = uint8(_posChecks - 1);
     _minMatch = MIN_MATCH3;
     _matches = new uint32[ROLZCodec::HASH_SIZE << _logPosChecks];
+    _dictBuf = nullptr;
+    _dictBufSize = 0;
     memset(&_counters[0], 0, sizeof(_counters));
 }
 
@@ -916,6 +1025,13 @@ bool ROLZCodec2::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
     if (output._length < getMaxEncodedLength(count))
         return false;
 
+    // Large blocks are split into segments encoded concurrently. The data
+    // type is detected once for the whole block.
+    if ((_pCtx != nullptr) && (SegmentedCodec::getSegments(count) > 1)) {
+        ROLZCodec::getDataType(*_pCtx, &input._array[input._index], count);
+        return SegmentedCodec::forward<ROLZCodec2>(*_pCtx, input, output, count);
+    }
+
     const int srcEnd = count - 4;
     const kanzi::byte* src = &input._array[input._index];
     kanzi::byte* dst = &output._array[output._index];
@@ -925,16 +1041,7 @@ bool ROLZCodec2::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
     int delta = 2;
 
     if (_pCtx != nullptr) {
-        Global::DataType dt = (Global::DataType) _pCtx->getInt("dataType", Global::UNDEFINED);
-
-        if (dt == Global::UNDEFINED) {
-            uint freqs0[256] = { 0 };
-            Global::computeHistogram(&src[0], count, freqs0);
-            dt = Global::detectSimpleType(count, freqs0);
-
-            if (dt != Global::UNDEFINED)
-                _pCtx->putInt("dataType", dt);
-        }
+        const Global::DataType dt = ROLZCodec::getDataType(*_pCtx, &src[0], count);
 
         if (dt == Global::EXE) {
             delta = 3;
@@ -956,6 +1063,10 @@ bool ROLZCodec2::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
     ROLZEncoder re(9, _logPosChecks, &dst[0], dstIdx);
     memset(&_counters[0], 0, sizeof(_counters));
 
+    // With a dictionary, the block (one chunk) is encoded after the dictionary
+    // tail (prefix) and matches may refer to it.
+    const int prefix = ROLZCodec::getDictionaryPrefix(_pCtx, count);
+
     while (startChunk < srcEnd) {
         memset(&_matches[0], 0, sizeof(uint32) * size_t(ROLZCodec::HASH_SIZE << _logPosChecks));
         const int endChunk = min(startChunk + sizeChunk, srcEnd);
@@ -964,19 +1075,35 @@ bool ROLZCodec2::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
         src = &input._array[startChunk];
         srcIdx = 0;
 
-        // First literals
-        const int n = min(srcEnd - startChunk, 8);
-        re.setContext(LITERAL_CTX, kanzi::byte(0));
+        if (prefix > 0) {
+            kanzi::byte* dictBuf = ROLZCodec::loadDictionary(*_pCtx->getDictionary(), prefix, count, _dictBuf, _dictBufSize);
+            memcpy(&dictBuf[prefix], &src[0], size_t(count));
+            src = dictBuf;
+
+            // Register the dictionary positions
+            for (srcIdx = dt; srcIdx < prefix; srcIdx++) {
+                const uint32 key = (cond == true) ? ROLZCodec::getKey1(&src[srcIdx - dt]) : ROLZCodec::getKey2(&src[srcIdx - dt]);
+                _counters[key] = (_counters[key] + 1) & _maskChecks;
+                _matches[(key << _logPosChecks) + _counters[key]] = ROLZCodec::hash(&src[srcIdx]) | int32(srcIdx);
+            }
+        }
+        else {
+            // First literals
+            const int n = min(srcEnd - startChunk, 8);
+            re.setContext(LITERAL_CTX, kanzi::byte(0));
 
-        for (int j = 0; j < n; j++) {
-            re.encode9Bits((LITERAL_FLAG << 8) | int(src[srcIdx]));
-            srcIdx++;
+            for (int j = 0; j < n; j++) {
+                re.encode9Bits((LITERAL_FLAG << 8) | int(src[srcIdx]));
+                srcIdx++;
+            }
         }
 
-        while (srcIdx < sizeChunk) {
+        const int srcEnd2 = prefix + sizeChunk;
+
+        while (srcIdx < srcEnd2) {
             re.setContext(LITERAL_CTX, src[srcIdx - 1]);
             uint32 key = (cond == true) ? ROLZCodec::getKey1(&src[srcIdx - dt]) : ROLZCodec::getKey2(&src[srcIdx - dt]);
-            const int match = findMatch(src, srcIdx, sizeChunk, key);
+            const int match = findMatch(src, srcIdx, srcEnd2, key);
 
             if (match < 0) {
                 // Emit one literal
@@ -1004,7 +1131,7 @@ bool ROLZCodec2::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
     }
 
     re.dispose();
-    input._index = startChunk - sizeChunk + srcIdx;
+    input._index = startChunk - sizeChunk + srcIdx - prefix;
     output._index = dstIdx;
     return (input._index == count) && (output._index < count);
 }
@@ -1017,6 +1144,9 @@ bool ROLZCodec2::inverse(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
     if (input._array == output._array)
         return false;
 
+    if ((_pCtx != nullptr) && (SegmentedCodec::isSegmented(&input._array[input._index], count) == true))
+        return SegmentedCodec::inverse<ROLZCodec2>(*_pCtx, input, output, count);
+
     kanzi::byte* src = &input._array[input._index];
     const int dstEnd = BigEndian::readInt32(&src[0]);
 
@@ -1041,31 +1171,53 @@ bool ROLZCodec2::inverse(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
     ROLZDecoder rd(9, _logPosChecks, &src[0], srcIdx);
     memset(&_counters[0], 0, sizeof(_counters));
 
+    // With a dictionary, decode after the dictionary tail (see forward)
+    const int prefix = ROLZCodec::getDictionaryPrefix(_pCtx, dstEnd);
+
     while (startChunk < dstEnd) {
-        memset(&_matches[0], 0, sizeof(uint32) * (ROLZCodec::HASH_SIZE << _logPosChecks));
         const int endChunk = min(startChunk + sizeChunk, dstEnd);
         sizeChunk = endChunk - startChunk;
         rd.reset();
         kanzi::byte* dst = &output._array[output._index];
-        kanzi::byte* refBuf = &output._array[output._index - delta];
         int dstIdx = 0;
 
-        // First literals
-        rd.setContext(LITERAL_CTX, kanzi::byte(0));
-        const int n = min(dstEnd - output._index, 8);
+        if (prefix > 0) {
+            // Empty slots refer to the start of the dictionary, as in the encoder
+            uint32* matchesEnd = &_matches[size_t(ROLZCodec::HASH_SIZE << _logPosChecks)];
+            fill(&_matches[0], matchesEnd, uint32(-prefix));
+            kanzi::byte* dictBuf = ROLZCodec::loadDictionary(*_pCtx->getDictionary(), prefix, dstEnd, _dictBuf, _dictBufSize);
+
+            // Register the dictionary positions (negative)
+            for (int i = delta; i < prefix; i++) {
+                const uint32 key = (cond == true) ? ROLZCodec::getKey1(&dictBuf[i - delta]) : ROLZCodec::getKey2(&dictBuf[i - delta]);
+                _counters[key] = (_counters[key] + 1) & _maskChecks;
+                _matches[(key << _logPosChecks) + _counters[key]] = uint32(i - prefix);
+            }
 
-        for (int j = 0; j < n; j++) {
-            int val = rd.decode9Bits();
+            dst = &dictBuf[prefix];
+        }
+        else {
+            memset(&_matches[0], 0, sizeof(uint32) * (ROLZCodec::HASH_SIZE << _logPosChecks));
 
-            // Sanity check
-            if ((val >> 8) == MATCH_FLAG) {
-                output._index += dstIdx;
-                return false;
-            }
+            // First literals
+            rd.setContext(LITERAL_CTX, kanzi::byte(0));
+            const int n = min(dstEnd - output._index, 8);
 
-            dst[dstIdx++] = kanzi::byte(val);
+            for (int j = 0; j < n; j++) {
+                int val = rd.decode9Bits();
+
+                // Sanity check
+                if ((val >> 8) == MATCH_FLAG) {
+                    output._index += dstIdx;
+                    return false;
+                }
+
+                dst[dstIdx++] = kanzi::byte(val);
+            }
         }
 
+        const kanzi::byte* refBuf = &dst[-delta];
+
         // Next chunk
         while (dstIdx < sizeChunk) {
             const int savedIdx = dstIdx;
@@ -1099,6 +1251,9 @@ bool ROLZCodec2::inverse(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>
             matches[_counters[key] & _maskChecks] = savedIdx;
         }
 
+        if (prefix > 0)
+            memcpy(&output._array[output._index], &dst[0], size_t(dstIdx));
+
         startChunk = endChunk;
         output._index += dstIdx;
     }
@@ -18,6 +18,7 @@ limitations under the License.
 #define knz_ROLZCodec
 
 #include "../Context.hpp"
+#include "../Global.hpp"
 #include "../Memory.hpp"
 #include "../Transform.hpp"
 
@@ -115,7 +116,11 @@ namespace kanzi {
 
        ROLZCodec1(Context& ctx);
 
-       ~ROLZCodec1() { if (_matches != nullptr) delete[] _matches; }
+       ~ROLZCodec1()
+       {
+           if (_matches != nullptr) delete[] _matches;
+           if (_dictBuf != nullptr) delete[] _dictBuf;
+       }
 
        bool forward(SliceArray<byte>& src, SliceArray<byte>& dst, int length);
 
@@ -141,7 +146,9 @@ namespace kanzi {
        int _posChecks;
        Context* _pCtx;
        int _minMatch;
-       uint8 _maskChecks;	   
+       uint8 _maskChecks;
+       byte* _dictBuf; // dictionary tail followed by the block
+       int _dictBufSize;
 
        int findMatch(const byte buf[], int pos, int end, uint32 hash32, const uint32* matches, const uint8* counter) const;
 
@@ -158,7 +165,11 @@ namespace kanzi {
 
        ROLZCodec2(Context& ctx);
 
-       ~ROLZCodec2() { if (_matches != nullptr) delete[] _matches; }
+       ~ROLZCodec2()
+       {
+           if (_matches != nullptr) delete[] _matches;
+           if (_dictBuf != nullptr) delete[] _dictBuf;
+       }
 
        bool forward(SliceArray<byte>& src, SliceArray<byte>& dst, int length);
 
@@ -189,6 +200,8 @@ namespace kanzi {
        Context* _pCtx;
        int _minMatch;
        int _posChecks;
+       byte* _dictBuf; // dictionary tail followed by the block
+       int _dictBufSize;
 
        int findMatch(const byte buf[], int pos, int end, uint32 key);
    };
@@ -240,6 +253,18 @@ namespace kanzi {
        }
 
        static int emitCopy(byte dst[], int dstIdx, int ref, int matchLen);
+
+       // Return the data type of the block in the context, detected and saved
+       // in the context if undefined.
+       static Global::DataType getDataType(Context& ctx, const byte src[], int count);
+
+       // Number of dictionary bytes used as history for a block of 'count' bytes.
+       // The dictionary is used only if it fits in one chunk with the block.
+       static int getDictionaryPrefix(const Context* ctx, int count);
+
+       // Copy the last 'prefix' bytes of the dictionary to the start of 'buf'
+       // (reallocated if smaller than prefix + length + padding).
+       static byte* loadDictionary(const Dictionary& dict, int prefix, int length, byte*& buf, int& bufSize);
    };
 
    inline int ROLZCodec1::emitLength(byte block[], int length) const
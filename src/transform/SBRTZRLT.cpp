@@ -0,0 +1,278 @@
+/*
+Copyright 2011-2026 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cstring>
+#include <stdexcept>
+#include "../Global.hpp"
+#include "SBRT.hpp"
+#include "SBRTZRLT.hpp"
+
+using namespace kanzi;
+using namespace std;
+
+
+SBRTZRLT::SBRTZRLT(int mode) :
+	  _mask1((mode == SBRT::MODE_TIMESTAMP) ? 0 : -1)
+	, _mask2((mode == SBRT::MODE_MTF) ? 0 : -1)
+	, _shift((mode == SBRT::MODE_RANK) ? 1 : 0)
+{
+    if ((mode != SBRT::MODE_MTF) && (mode != SBRT::MODE_RANK) && (mode != SBRT::MODE_TIMESTAMP))
+        throw invalid_argument("Invalid mode parameter");
+}
+
+SBRTZRLT::SBRTZRLT(int mode, Context&) :
+	  _mask1((mode == SBRT::MODE_TIMESTAMP) ? 0 : -1)
+	, _mask2((mode == SBRT::MODE_MTF) ? 0 : -1)
+	, _shift((mode == SBRT::MODE_RANK) ? 1 : 0)
+{
+    if ((mode != SBRT::MODE_MTF) && (mode != SBRT::MODE_RANK) && (mode != SBRT::MODE_TIMESTAMP))
+        throw invalid_argument("Invalid mode parameter");
+}
+
+// Write a run of zeros like ZRLT: every bit of (length + 1) as a byte,
+// except the most significant one
+inline bool SBRTZRLT::emitRun(kanzi::byte dst[], uint& dstIdx, uint dstEnd, uint runLength)
+{
+    runLength++;
+    int log = Global::_log2(uint32(runLength));
+
+    if (uint(log) > dstEnd - dstIdx)
+        return false;
+
+    while (log > 0) {
+        log--;
+        dst[dstIdx++] = kanzi::byte((runLength >> log) & 1);
+    }
+
+    return true;
+}
+
+bool SBRTZRLT::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>& output, int count)
+{
+    if (count == 0)
+        return true;
+
+    if (!SliceArray<kanzi::byte>::isValid(input))
+        throw invalid_argument("SBRTZRLT: Invalid input block");
+
+    if (!SliceArray<kanzi::byte>::isValid(output))
+        throw invalid_argument("SBRTZRLT: Invalid output block");
+
+    if ((count < 0) ||
+        (count > input._length - input._index) ||
+        (count > output._length - output._index))
+        return false;
+
+    // Aliasing
+    const kanzi::byte* src = &input._array[input._index];
+    kanzi::byte* dst = &output._array[output._index];
+    int p[256] = { 0 };
+    int q[256] = { 0 };
+    uint8 s2r[256];
+    uint8 r2s[256];
+
+    for (int i = 0; i < 256; i++) {
+        s2r[i] = uint8(i);
+        r2s[i] = uint8(i);
+    }
+
+    // The output must not grow
+    const uint dstEnd = uint(count);
+    uint dstIdx = 0;
+    uint runLength = 0;
+
+    for (int i = 0; i < count; i++) {
+        const uint8 c = uint8(src[i]);
+        int r = int(s2r[c]);
+
+        // ZRLT: count the zero ranks, escape the ranks 0xFE and 0xFF
+        if (r == 0) {
+            runLength++;
+        }
+        else {
+            if (runLength > 0) {
+                if (emitRun(dst, dstIdx, dstEnd, runLength) == false)
+                    return false;
+
+                runLength = 0;
+            }
+
+            if (r >= 0xFE) {
+                if (dstIdx + 2 > dstEnd)
+                    return false;
+
+                dst[dstIdx] = kanzi::byte(0xFF);
+                dst[dstIdx + 1] = kanzi::byte(r - 0xFE);
+                dstIdx += 2;
+            }
+            else {
+                if (dstIdx >= dstEnd)
+                    return false;
+
+                dst[dstIdx++] = kanzi::byte(r + 1);
+            }
+        }
+
+        // SBRT: update the rank of the symbol
+        const int qc = ((i & _mask1) + (p[c] & _mask2)) >> _shift;
+        p[c] = i;
+        q[c] = qc;
+
+        // Move up symbol to correct rank
+        while ((r > 0) && (q[r2s[r - 1]] <= qc)) {
+            r2s[r] = r2s[r - 1];
+            s2r[r2s[r]] = uint8(r);
+            r--;
+        }
+
+        r2s[r] = c;
+        s2r[c] = uint8(r);
+    }
+
+    if ((runLength > 0) && (emitRun(dst, dstIdx, dstEnd, runLength) == false))
+        return false;
+
+    input._index += count;
+    output._index += int(dstIdx);
+    return true;
+}
+
+bool SBRTZRLT::inverse(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>& output, int length)
+{
+    if (length < 0)
+       return false;
+
+    if (length == 0)
+        return true;
+
+    if (length > input._length - input._index)
+        return false;
+
+    if (!SliceArray<kanzi::byte>::isValid(input))
+        throw invalid_argument("SBRTZRLT: Invalid input block");
+
+    if (!SliceArray<kanzi::byte>::isValid(output))
+        throw invalid_argument("SBRTZRLT: Invalid output block");
+
+    const kanzi::byte* src = &input._array[input._index];
+    kanzi::byte* dst = &output._array[output._index];
+    uint srcIdx = 0;
+    uint dstIdx = 0;
+    const uint srcEnd = uint(length);
+    const uint dstEnd = uint(output._length - output._index);
+    uint runLength = 0;
+    int p[256] = { 0 };
+    int q[256] = { 0 };
+    uint8 r2s[256];
+
+    for (int i = 0; i < 256; i++)
+        r2s[i] = uint8(i);
+
+    while (true) {
+        uint val = uint(src[srcIdx]);
+
+        if (val <= 1) {
+            // Generate the run length bit by bit (but force MSB)
+            runLength = 1;
+
+            do {
+                runLength += (runLength + val);
+                srcIdx++;
+
+                if (srcIdx >= srcEnd)
+                    goto End;
+
+                val = uint(src[srcIdx]);
+            }
+            while (val <= 1);
+
+            runLength--;
+
+            if (runLength > 0) {
+                if (runLength >= dstEnd - dstIdx)
+                    goto End;
+
+                // Run of rank 0: the first symbol is repeated, only its
+                // last two positions matter for its rank
+                const uint8 c = r2s[0];
+                const int last = int(dstIdx + runLength - 1);
+                const int prv = (runLength == 1) ? p[c] : last - 1;
+                memset(&dst[dstIdx], int(c), size_t(runLength));
+                q[c] = ((last & _mask1) + (prv & _mask2)) >> _shift;
+                p[c] = last;
+                dstIdx += runLength;
+                runLength = 0;
+                continue;
+            }
+        }
+
+        // Regular data processing
+        if (dstIdx >= dstEnd)
+            return false;
+
+        int r;
+
+        if (val == 0xFF) {
+            srcIdx++;
+
+            if (srcIdx >= srcEnd)
+                return false;
+
+            r = (0xFE + int(src[srcIdx])) & 0xFF;
+        }
+        else {
+            r = int(val - 1);
+        }
+
+        // Inverse SBRT
+        const uint8 c = r2s[r];
+        const int i = int(dstIdx);
+        dst[dstIdx] = kanzi::byte(c);
+        const int qc = ((i & _mask1) + (p[c] & _mask2)) >> _shift;
+        p[c] = i;
+        q[c] = qc;
+
+        // Move up symbol to correct rank
+        while ((r > 0) && (q[r2s[r - 1]] <= qc)) {
+            r2s[r] = r2s[r - 1];
+            r--;
+        }
+
+        r2s[r] = c;
+        srcIdx++;
+        dstIdx++;
+
+        if ((srcIdx >= srcEnd) || (dstIdx >= dstEnd))
+            break;
+    }
+
+End:
+    if (runLength > 0) {
+        runLength--;
+
+        // If runLength is not 1, add trailing 0s
+        if (runLength > dstEnd - dstIdx)
+            return false;
+
+        if (runLength > 0) {
+            memset(&dst[dstIdx], int(r2s[0]), size_t(runLength));
+            dstIdx += runLength;
+        }
+    }
+
+    input._index += srcIdx;
+    output._index += dstIdx;
+    return srcIdx == srcEnd;
+}
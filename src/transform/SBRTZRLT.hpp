@@ -0,0 +1,56 @@
+/*
+Copyright 2011-2026 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef knz_SBRTZRLT
+#define knz_SBRTZRLT
+
+#include "../Context.hpp"
+#include "../Transform.hpp"
+
+namespace kanzi
+{
+   // SBRT (MTFT or RANK mode) followed by ZRLT in a single pass over the block:
+   // the ranks are run length coded as they are produced (and decoded ranks
+   // are mapped back to symbols as they are read), so the intermediate rank
+   // block is never written. The output is the output of ZRLT applied to the
+   // output of SBRT. Unlike ZRLT, the forward transform fails if the output
+   // is larger than the input.
+   // TransformFactory installs it in the sequences with a RANK+ZRLT or
+   // MTFT+ZRLT chain (see TransformSequence::setFusedTransform).
+   class SBRTZRLT FINAL : public Transform<byte>
+   {
+   public:
+       SBRTZRLT(int mode);
+       SBRTZRLT(int mode, Context&);
+       ~SBRTZRLT() {}
+
+       bool forward(SliceArray<byte>& input, SliceArray<byte>& output, int length);
+
+       bool inverse(SliceArray<byte>& input, SliceArray<byte>& output, int length);
+
+       int getMaxEncodedLength(int srcLen) const { return srcLen; }
+
+   private:
+
+       const int _mask1;
+       const int _mask2;
+       const int _shift;
+
+       static bool emitRun(byte dst[], uint& dstIdx, uint dstEnd, uint runLength);
+   };
+
+}
+#endif
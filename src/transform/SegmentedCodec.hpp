@@ -0,0 +1,365 @@
+/*
+Copyright 2011-2026 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef knz_SegmentedCodec
+#define knz_SegmentedCodec
+
+#include <cstring>
+#include <vector>
+#include "../concurrent.hpp"
+#include "../Context.hpp"
+#include "../Global.hpp"
+#include "../Memory.hpp"
+#include "../SliceArray.hpp"
+
+#ifdef CONCURRENCY_ENABLED
+#include <future>
+#endif
+
+
+namespace kanzi {
+
+   // Split a large block into independent segments encoded (and decoded) by
+   // concurrent instances of an LZ codec. The number of segments depends only
+   // on the block size, so the output does not depend on the number of jobs.
+   // Matches cannot cross segment boundaries: the loss is small with 16 MB
+   // segments (ROLZ already resets its match tables every 16 MB chunk).
+   //
+   // Encoded layout: 0 (32 bits), number of segments (8 bits), then the decoded
+   // and encoded sizes of each segment (32 bits each, little endian), then the
+   // encoded segments. The first 32 bits are never 0 in the regular LZX and
+   // ROLZ formats, so decoders can tell both formats apart.
+   class SegmentedCodec {
+   public:
+       static const int SEGMENT_SIZE = 16 * 1024 * 1024;
+       static const int MAX_SEGMENTS = 64;
+
+       // Return the number of segments for a block of 'count' bytes (1 if the
+       // block must not be segmented).
+       static int getSegments(int count)
+       {
+           return (count < 2 * SEGMENT_SIZE) ? 1 : std::min(count / SEGMENT_SIZE, MAX_SEGMENTS);
+       }
+
+       static bool isSegmented(const byte src[], int count)
+       {
+           return (count >= HEADER_SIZE) && (LittleEndian::readInt32(&src[0]) == 0);
+       }
+
+       // Encode the block with one instance of C per segment. Return false if
+       // a segment cannot be encoded or if the block does not shrink.
+       template <class C>
+       static bool forward(Context& ctx, SliceArray<byte>& input, SliceArray<byte>& output, int count);
+
+       template <class C>
+       static bool inverse(Context& ctx, SliceArray<byte>& input, SliceArray<byte>& output, int count);
+
+   private:
+       static const int HEADER_SIZE = 5;
+
+       // Bytes written past the end of a segment by the decoders (16-byte copies)
+       static const int OVERRUN = 32;
+
+       struct Segment {
+           byte* _src;
+           int _srcLength; // bytes readable from _src
+           int _count; // bytes to encode or decode
+           byte* _dst;
+           int _dstLength; // bytes writable to _dst
+           int _result; // bytes produced or -1 on failure
+       };
+
+       template <class C>
+       class SegmentTask FINAL : public Task<int> {
+       public:
+           SegmentTask(const Context& ctx, Segment* segments, const int indexes[], int first, int last, bool forward) :
+               _ctx(ctx), _segments(segments), _indexes(indexes), _first(first), _last(last), _forward(forward)
+           {
+           }
+
+           ~SegmentTask() {}
+
+           int run();
+
+       private:
+           const Context& _ctx;
+           Segment* _segments;
+           const int* _indexes;
+           int _first;
+           int _last;
+           bool _forward;
+       };
+
+       template <class C>
+       static void process(Context& ctx, Segment segments[], const int indexes[], int count, bool forward);
+   };
+
+
+   template <class C>
+   inline int SegmentedCodec::SegmentTask<C>::run()
+   {
+       for (int i = _first; i < _last; i++) {
+           Segment& s = _segments[_indexes[i]];
+
+           // A new context per segment: codecs may store block properties
+           // (EG. the data type) in the context.
+           Context ctx(_ctx);
+           C codec(ctx);
+           SliceArray<byte> in(s._src, s._srcLength, 0);
+           SliceArray<byte> out(s._dst, s._dstLength, 0);
+           const bool res = (_forward == true) ? codec.forward(in, out, s._count) :
+               codec.inverse(in, out, s._count);
+           s._result = (res == true) ? out._index : -1;
+       }
+
+       return 0;
+   }
+
+
+   // Process the segments with the given indexes, concurrently if jobs are available.
+   template <class C>
+   inline void SegmentedCodec::process(Context& ctx, Segment segments[], const int indexes[], int count, bool forward)
+   {
+       const int jobs = ctx.getInt(Context::JOBS, 1);
+       const int nbTasks = (jobs < count) ? jobs : count;
+
+       if (nbTasks <= 1) {
+           SegmentTask<C> task(ctx, segments, indexes, 0, count, forward);
+           task.run();
+           return;
+       }
+
+#ifdef CONCURRENCY_ENABLED
+       ThreadPool* pool = ctx.getPool(); // can be null
+       int jobsPerTask[MAX_SEGMENTS];
+       Global::computeJobsPerTask(jobsPerTask, count, nbTasks);
+       std::vector<SegmentTask<C>*> tasks;
+       std::vector<std::future<int> > futures;
+       tasks.reserve(nbTasks);
+       futures.reserve(nbTasks);
+
+       try {
+           // Each task processes jobsPerTask[j] segments
+           for (int j = 0, first = 0; j < nbTasks; j++) {
+               tasks.push_back(new SegmentTask<C>(ctx, segments, indexes, first, first + jobsPerTask[j], forward));
+
+               if (pool == nullptr)
+                   futures.push_back(std::async(std::launch::async, &SegmentTask<C>::run, tasks[j]));
+               else
+                   futures.push_back(pool->schedule(&SegmentTask<C>::run, tasks[j]));
+
+               first += jobsPerTask[j];
+           }
+
+           for (int j = 0; j < nbTasks; j++) {
+               if (pool == nullptr)
+                   futures[j].get();
+               else
+                   pool->get(futures[j]);
+           }
+       }
+       catch (...) {
+           for (size_t i = 0; i < futures.size(); i++) {
+               try {
+                   if (futures[i].valid() == false)
+                       continue;
+
+                   if (pool == nullptr)
+                       futures[i].wait();
+                   else
+                       pool->wait(futures[i]);
+               }
+               catch (const std::exception&) {
+               }
+           }
+
+           for (size_t i = 0; i < tasks.size(); i++)
+               delete tasks[i];
+
+           throw;
+       }
+
+       for (size_t i = 0; i < tasks.size(); i++)
+           delete tasks[i];
+#else
+       // nbTasks > 1 but concurrency is not enabled (should never happen)
+       throw std::invalid_argument("Segmented codec: concurrency not supported");
+#endif
+   }
+
+
+   template <class C>
+   inline bool SegmentedCodec::forward(Context& ctx, SliceArray<byte>& input, SliceArray<byte>& output, int count)
+   {
+       const int n = getSegments(count);
+
+       if (n < 2)
+           return false;
+
+       const int segSize = (count + n - 1) / n;
+       const int headerSize = HEADER_SIZE + 8 * n;
+       const byte* src = &input._array[input._index];
+       Segment segments[MAX_SEGMENTS];
+       int indexes[MAX_SEGMENTS];
+       bool res = true;
+
+       for (int i = 0; i < n; i++) {
+           const int start = i * segSize;
+           segments[i]._src = const_cast<byte*>(&src[start]);
+           segments[i]._srcLength = input._length - input._index - start;
+           segments[i]._count = (i == n - 1) ? count - start : segSize;
+           segments[i]._dst = nullptr;
+           segments[i]._result = -1;
+           indexes[i] = i;
+       }
+
+       try {
+           {
+               C codec(ctx);
+
+               for (int i = 0; i < n; i++) {
+                   segments[i]._dstLength = codec.getMaxEncodedLength(segments[i]._count);
+                   segments[i]._dst = new byte[segments[i]._dstLength];
+               }
+           }
+
+           process<C>(ctx, segments, indexes, n, true);
+           int dstIdx = headerSize;
+
+           for (int i = 0; i < n; i++) {
+               if (segments[i]._result <= 0) {
+                   res = false;
+                   break;
+               }
+
+               dstIdx += segments[i]._result;
+           }
+
+           // Stitch the segments if the block shrinks
+           if ((res == true) && (dstIdx < count) && (dstIdx <= output._length - output._index)) {
+               byte* dst = &output._array[output._index];
+               LittleEndian::writeInt32(&dst[0], 0);
+               dst[4] = byte(n);
+               dstIdx = headerSize;
+
+               for (int i = 0; i < n; i++) {
+                   LittleEndian::writeInt32(&dst[HEADER_SIZE + 8 * i], segments[i]._count);
+                   LittleEndian::writeInt32(&dst[HEADER_SIZE + 8 * i + 4], segments[i]._result);
+                   memcpy(&dst[dstIdx], &segments[i]._dst[0], size_t(segments[i]._result));
+                   dstIdx += segments[i]._result;
+               }
+
+               input._index += count;
+               output._index += dstIdx;
+           }
+           else {
+               res = false;
+           }
+       }
+       catch (...) {
+           for (int i = 0; i < n; i++)
+               delete[] segments[i]._dst;
+
+           throw;
+       }
+
+       for (int i = 0; i < n; i++)
+           delete[] segments[i]._dst;
+
+       return res;
+   }
+
+
+   template <class C>
+   inline bool SegmentedCodec::inverse(Context& ctx, SliceArray<byte>& input, SliceArray<byte>& output, int count)
+   {
+       if (count < HEADER_SIZE)
+           return false;
+
+       const byte* src = &input._array[input._index];
+       const int n = int(src[4]);
+
+       if ((n < 2) || (n > MAX_SEGMENTS) || (count < HEADER_SIZE + 8 * n))
+           return false;
+
+       const int headerSize = HEADER_SIZE + 8 * n;
+       const int srcLength = input._length - input._index;
+       const int dstLength = output._length - output._index;
+       byte* dst = &output._array[output._index];
+       Segment segments[MAX_SEGMENTS];
+       int64 srcIdx = headerSize;
+       int64 dstIdx = 0;
+
+       for (int i = 0; i < n; i++) {
+           const int decSize = LittleEndian::readInt32(&src[HEADER_SIZE + 8 * i]);
+           const int encSize = LittleEndian::readInt32(&src[HEADER_SIZE + 8 * i + 4]);
+
+           if ((decSize <= 0) || (encSize <= 0) || (srcIdx + encSize > count) || (dstIdx + decSize > dstLength))
+               return false;
+
+           // The decoders may read past the end of the encoded segment (the
+           // next segments act as padding) and write past the end of the
+           // decoded segment (see OVERRUN).
+           segments[i]._src = const_cast<byte*>(&src[srcIdx]);
+           segments[i]._srcLength = int(srcLength - srcIdx);
+           segments[i]._count = encSize;
+           segments[i]._dst = &dst[dstIdx];
+           segments[i]._dstLength = (i == n - 1) ? int(dstLength - dstIdx) : decSize;
+           segments[i]._result = -1;
+           srcIdx += encSize;
+           dstIdx += decSize;
+       }
+
+       if (srcIdx != count)
+           return false;
+
+       // Decode even segments, then odd segments. The bytes written past the
+       // end of an odd segment overwrite the start of an even segment: they
+       // are saved before and restored after the second pass.
+       int indexes[MAX_SEGMENTS];
+       int nbEven = 0;
+
+       for (int i = 0; i < n; i += 2)
+           indexes[nbEven++] = i;
+
+       for (int i = 1; i < n; i += 2)
+           indexes[nbEven + i / 2] = i;
+
+       process<C>(ctx, segments, &indexes[0], nbEven, false);
+       byte saved[MAX_SEGMENTS / 2][OVERRUN];
+
+       for (int i = 2; i < n; i += 2)
+           memcpy(&saved[i / 2][0], segments[i]._dst, size_t(std::min(OVERRUN, segments[i]._dstLength)));
+
+       process<C>(ctx, segments, &indexes[nbEven], n - nbEven, false);
+
+       for (int i = 2; i < n; i += 2)
+           memcpy(segments[i]._dst, &saved[i / 2][0], size_t(std::min(OVERRUN, segments[i]._dstLength)));
+
+       for (int i = 0; i < n; i++) {
+           // Each segment must be fully decoded (the last one may not fill its buffer)
+           const int decSize = LittleEndian::readInt32(&src[HEADER_SIZE + 8 * i]);
+
+           if (segments[i]._result != decSize)
+               return false;
+       }
+
+       input._index += count;
+       output._index += int(dstIdx);
+       return true;
+   }
+}
+#endif
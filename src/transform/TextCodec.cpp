@@ -15,7 +15,9 @@ limitations under the License.
 
 #include <cstring>
 #include <stdexcept>
+#include "BlockStats.hpp"
 #include "TextCodec.hpp"
+#include "../Dictionary.hpp"
 #include "../Global.hpp"
 #include "../Magic.hpp"
 
@@ -212,6 +214,49 @@ int TextCodec::createDictionary(char words[], int dictSize, DictEntry dict[], in
     return nbWords;
 }
 
+// Add the words (4 to MAX_WORD_LENGTH letters) found in a pre-trained
+// dictionary. Duplicates and words colliding in the hash map are skipped.
+int TextCodec::addDictionaryWords(const Dictionary& dict, DictEntry list[], DictEntry* map[], int hashMask, int nbWords)
+{
+    const int maxWords = nbWords + 4096;
+    const byte* src = dict.data();
+    const int srcEnd = dict.size();
+
+    for (int i = 0; i < nbWords; i++)
+        map[list[i]._hash & hashMask] = &list[i];
+
+    int i = 0;
+
+    while ((i < srcEnd) && (nbWords < maxWords)) {
+        if (getType(src[i]) != 0) {
+            i++;
+            continue;
+        }
+
+        const int start = i;
+
+        while ((i < srcEnd) && (getType(src[i]) == 0))
+            i++;
+
+        const int length = i - start;
+
+        // Words at the end of the dictionary may be truncated
+        if ((length < 4) || (length > MAX_WORD_LENGTH) || (i == srcEnd))
+            continue;
+
+        const uint h = computeWordHash(&src[start], length);
+
+        if (map[h & hashMask] != nullptr)
+            continue;
+
+        list[nbWords] = DictEntry(&src[start], h, nbWords, length);
+        map[h & hashMask] = &list[nbWords];
+        nbWords++;
+    }
+
+    return nbWords;
+}
+
 // Analyze the block and return an 8-bit status (see MASK flags constants)
 // The goal is to detect text data amenable to pre-processing.
 byte TextCodec::computeStats(const byte block[], int count, uint freqs0[], bool strict)
@@ -259,6 +304,22 @@ byte TextCodec::computeStats(const byte block[], int count, uint freqs0[], bool
         freqs0[i] += (f0[i] + f1[i] + f2[i] + f3[i]);
     }
 
+    const byte res = computeMode(freqs0, freqs1, count, strict);
+    delete[] freqs1;
+    return res;
+}
+
+byte TextCodec::computeStats(BlockStats& stats, bool strict)
+{
+    if ((strict == false) && (stats.getMagic() != Magic::NO_MAGIC))
+        return TextCodec::MASK_NOT_TEXT;
+
+    const uint* freqs1 = stats.getHistogram1();
+    return computeMode(stats.getHistogram(), freqs1, stats.getCount(), strict);
+}
+
+byte TextCodec::computeMode(const uint freqs0[], const uint freqs1[], int count, bool strict)
+{
     const int cr = int(CR);
     const int lf = int(LF);
     int nbTextChars = freqs0[cr] + freqs0[lf];
@@ -287,11 +348,8 @@ byte TextCodec::computeStats(const byte block[], int count, uint freqs0[], bool
 
     byte res = byte(0);
 
-    if (notText == true) {
-        res = detectType(freqs0, freqs1, count);
-        delete[] freqs1;
-        return res;
-    }
+    if (notText == true)
+        return detectType(freqs0, freqs1, count);
 
     if (nbBinChars <= count - count / 10) {
         // Check if likely XML/HTML
@@ -336,7 +394,6 @@ byte TextCodec::computeStats(const byte block[], int count, uint freqs0[], bool
         }
     }
 
-    delete[] freqs1;
     return res;
 }
 
@@ -441,8 +498,8 @@ TextCodec::TextCodec(Context& ctx)
     _delegate = nullptr;
     _pCtx = &ctx;
     _encodingType = 0;
-    _bsVersion = ctx.getInt("bsVersion", 7);
-    setEncodingType(ctx.getInt("textcodec", 1));
+    _bsVersion = ctx.getInt(Context::BS_VERSION, 7);
+    setEncodingType(ctx.getInt(Context::TEXT_CODEC, 1));
 }
 
 void TextCodec::setEncodingType(int encodingType)
@@ -521,6 +578,8 @@ TextCodec1::TextCodec1()
 {
     _logHashSize = TextCodec::LOG_HASHES_SIZE;
     _dictSize = 1 << 13;
+    _dictCapacity = 0;
+    _userDict = nullptr;
     _dictMap = nullptr;
     _dictList = nullptr;
     _hashMask = (1 << _logHashSize) - 1;
@@ -534,10 +593,12 @@ TextCodec1::TextCodec1()
 TextCodec1::TextCodec1(Context& ctx)
 {
     // Actual block size
-    const int blockSize = ctx.getInt("blockSize", 0);
+    const int blockSize = ctx.getInt(Context::BLOCK_SIZE, 0);
     const int log = blockSize >= 8 ? max(min(Global::log2(uint32(blockSize / 8)), 26), 13) : 13;
     _logHashSize = ctx.getString("entropy") == "TPAQX" ? log + 1 : log;
     _dictSize = 1 << 13;
+    _dictCapacity = 0;
+    _userDict = nullptr;
     _dictMap = nullptr;
     _dictList = nullptr;
     _hashMask = (1 << _logHashSize) - 1;
@@ -561,8 +622,20 @@ void TextCodec1::reset(int count)
     for (int i = 0; i < mapSize; i++)
         _dictMap[i] = nullptr;
 
-    if (_dictList == nullptr) {
-        _dictList = new DictEntry[_dictSize];
+    // The codec may be reused for a larger block
+    if (_dictCapacity < _dictSize) {
+        delete[] _dictList;
+        _dictList = nullptr;
+    }
+
+    const Dictionary* dict = (_pCtx != nullptr) ? _pCtx->getDictionary() : nullptr;
+
+    if ((_dictList == nullptr) || (dict != _userDict)) {
+        if (_dictList == nullptr) {
+            _dictList = new DictEntry[_dictSize];
+            _dictCapacity = _dictSize;
+        }
+
 #if __cplusplus >= 201103L
         memcpy(&_dictList[0], &TextCodec::STATIC_DICTIONARY[0], sizeof(TextCodec::STATIC_DICTIONARY));
 #else
@@ -570,8 +643,13 @@ void TextCodec1::reset(int count)
             _dictList[i] = TextCodec::STATIC_DICTIONARY[i];
 #endif
 
-        // Add special entries at end of static dictionary
         _staticDictSize = TextCodec::STATIC_DICT_WORDS;
+        _userDict = dict;
+
+        if (dict != nullptr)
+            _staticDictSize = TextCodec::addDictionaryWords(*dict, _dictList, _dictMap, _hashMask, _staticDictSize);
+
+        // Add special entries at end of static dictionary
         _dictList[_staticDictSize] = DictEntry(&_escapes[0], 0, _staticDictSize, 1);
         _dictList[_staticDictSize + 1] = DictEntry(&_escapes[1], 0, _staticDictSize + 1, 1);
         _staticDictSize += 2;
@@ -596,26 +674,29 @@ bool TextCodec1::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
     int dstIdx = 0;
 
     if (_pCtx != nullptr) {
-        Global::DataType dt = (Global::DataType) _pCtx->getInt("dataType", Global::UNDEFINED);
+        Global::DataType dt = (Global::DataType) _pCtx->getInt(Context::DATA_TYPE, Global::UNDEFINED);
 
         // Filter out most types. Still check binaries which may contain significant parts of text
         if ((dt != Global::UNDEFINED) && (dt != Global::TEXT) && (dt != Global::BIN))
             return false;
     }
 
+    // Reuse the statistics of the block if a previous transform computed them
+    BlockStats* stats = BlockStats::get(_pCtx, &src[srcIdx], count);
     uint freqs[256] = { 0 };
-    byte mode = TextCodec::computeStats(&src[srcIdx], count, freqs, true);
+    byte mode = (stats != nullptr) ? TextCodec::computeStats(*stats, true) :
+        TextCodec::computeStats(&src[srcIdx], count, freqs, true);
 
     // Not text ?
     if ((mode & TextCodec::MASK_NOT_TEXT) != byte(0)) {
         if (_pCtx != nullptr)
-            _pCtx->putInt("dataType", Global::DataType(mode & TextCodec::MASK_DT));
+            _pCtx->putInt(Context::DATA_TYPE, Global::DataType(mode & TextCodec::MASK_DT));
 
         return false;
     }
 
     if (_pCtx != nullptr)
-       _pCtx->putInt("dataType", Global::TEXT);
+       _pCtx->putInt(Context::DATA_TYPE, Global::TEXT);
 
     reset(count);
     const int srcEnd = count;
@@ -773,6 +854,7 @@ bool TextCodec1::expandDictionary()
     }
 
     _dictSize <<= 1;
+    _dictCapacity = _dictSize;
     return true;
 }
 
@@ -1018,6 +1100,8 @@ TextCodec2::TextCodec2()
 {
     _logHashSize = TextCodec::LOG_HASHES_SIZE;
     _dictSize = 1 << 13;
+    _dictCapacity = 0;
+    _userDict = nullptr;
     _dictMap = nullptr;
     _dictList = nullptr;
     _hashMask = (1 << _logHashSize) - 1;
@@ -1029,17 +1113,19 @@ TextCodec2::TextCodec2()
 
 TextCodec2::TextCodec2(Context& ctx)
 {
-    const int blockSize = ctx.getInt("blockSize", 0);
+    const int blockSize = ctx.getInt(Context::BLOCK_SIZE, 0);
     const int log = blockSize >= 32 ? max(min(Global::log2(uint32(blockSize / 32)), 24), 13) : 13;
     _logHashSize = ctx.getString("entropy") == "TPAQX" ? log + 1 : log;
     _dictSize = 1 << 13;
+    _dictCapacity = 0;
+    _userDict = nullptr;
     _dictMap = nullptr;
     _dictList = nullptr;
     _hashMask = (1 << _logHashSize) - 1;
     _staticDictSize = TextCodec::STATIC_DICT_WORDS;
     _isCRLF = false;
     _pCtx = &ctx;
-    _bsVersion = ctx.getInt("bsVersion");
+    _bsVersion = ctx.getInt(Context::BS_VERSION);
 }
 
 void TextCodec2::reset(int count)
@@ -1055,14 +1141,32 @@ void TextCodec2::reset(int count)
     for (int i = 0; i < mapSize; i++)
         _dictMap[i] = nullptr;
 
-    if (_dictList == nullptr) {
-        _dictList = new DictEntry[_dictSize];
+    // The codec may be reused for a larger block
+    if (_dictCapacity < _dictSize) {
+        delete[] _dictList;
+        _dictList = nullptr;
+    }
+
+    const Dictionary* dict = (_pCtx != nullptr) ? _pCtx->getDictionary() : nullptr;
+
+    if ((_dictList == nullptr) || (dict != _userDict)) {
+        if (_dictList == nullptr) {
+            _dictList = new DictEntry[_dictSize];
+            _dictCapacity = _dictSize;
+        }
+
 #if __cplusplus >= 201103L
         memcpy(&_dictList[0], &TextCodec::STATIC_DICTIONARY[0], sizeof(TextCodec::STATIC_DICTIONARY));
 #else
         for (int i = 0; i < TextCodec::STATIC_DICT_WORDS; i++)
             _dictList[i] = TextCodec::STATIC_DICTIONARY[i];
 #endif
+
+        _staticDictSize = TextCodec::STATIC_DICT_WORDS;
+        _userDict = dict;
+
+        if (dict != nullptr)
+            _staticDictSize = TextCodec::addDictionaryWords(*dict, _dictList, _dictMap, _hashMask, _staticDictSize);
     }
 
     for (int i = 0; i < _staticDictSize; i++)
@@ -1082,26 +1186,29 @@ bool TextCodec2::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
     byte* dst = &output._array[output._index];
 
     if (_pCtx != nullptr) {
-        Global::DataType dt = (Global::DataType) _pCtx->getInt("dataType", Global::UNDEFINED);
+        Global::DataType dt = (Global::DataType) _pCtx->getInt(Context::DATA_TYPE, Global::UNDEFINED);
 
         // Filter out most types. Still check binaries which may contain significant parts of text
         if ((dt != Global::UNDEFINED) && (dt != Global::TEXT) && (dt != Global::BIN))
             return false;
     }
 
+    // Reuse the statistics of the block if a previous transform computed them
+    BlockStats* stats = BlockStats::get(_pCtx, &src[0], count);
     uint freqs[256] = { 0 };
-    byte mode = TextCodec::computeStats(&src[0], count, freqs, false);
+    byte mode = (stats != nullptr) ? TextCodec::computeStats(*stats, false) :
+        TextCodec::computeStats(&src[0], count, freqs, false);
 
     // Not text ?
     if ((mode & TextCodec::MASK_NOT_TEXT) != byte(0)) {
         if (_pCtx != nullptr)
-            _pCtx->putInt("dataType", Global::DataType(mode & TextCodec::MASK_DT));
+            _pCtx->putInt(Context::DATA_TYPE, Global::DataType(mode & TextCodec::MASK_DT));
 
         return false;
     }
 
     if (_pCtx != nullptr)
-       _pCtx->putInt("dataType", Global::TEXT);
+       _pCtx->putInt(Context::DATA_TYPE, Global::TEXT);
 
     reset(count);
     const int srcEnd = count;
@@ -1263,6 +1370,7 @@ bool TextCodec2::expandDictionary()
     }
 
     _dictSize <<= 1;
+    _dictCapacity = _dictSize;
     return true;
 }
 
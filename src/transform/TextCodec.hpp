@@ -80,6 +80,8 @@ namespace kanzi {
        byte _escapes[2];
        int _staticDictSize;
        int _dictSize;
+       int _dictCapacity; // number of entries allocated in _dictList
+       const Dictionary* _userDict; // pre-trained dictionary in the static entries
        int _logHashSize;
        int _hashMask;
        bool _isCRLF; // EOL = CR + LF
@@ -120,6 +122,8 @@ namespace kanzi {
        DictEntry* _dictList;
        int _staticDictSize;
        int _dictSize;
+       int _dictCapacity; // number of entries allocated in _dictList
+       const Dictionary* _userDict; // pre-trained dictionary in the static entries
        int _logHashSize;
        int _hashMask;
        int _bsVersion;
@@ -206,6 +210,10 @@ namespace kanzi {
 
        static byte computeStats(const byte block[], int count, uint freqs[], bool strict);
 
+       static byte computeStats(BlockStats& stats, bool strict);
+
+       static byte computeMode(const uint freqs0[], const uint freqs1[], int count, bool strict);
+
        static byte detectType(const uint freqs0[], const uint freqs1[], int count);
        
        // Common English words.
@@ -216,6 +224,10 @@ namespace kanzi {
        static int createDictionary(char words[], int dictSize, DictEntry dict[], int maxWords, int startWord);
        static const int STATIC_DICT_WORDS;
 
+       // Add the words of a pre-trained dictionary to the static entries
+       // (from index 'nbWords'). Return the new number of static entries.
+       static int addDictionaryWords(const Dictionary& dict, DictEntry list[], DictEntry* map[], int hashMask, int nbWords);
+
        void setEncodingType(int encodingType);
 
        Transform<byte>* _delegate;
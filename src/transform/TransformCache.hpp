@@ -0,0 +1,94 @@
+/*
+Copyright 2011-2026 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef knz_TransformCache
+#define knz_TransformCache
+
+#include <string>
+#include "../Context.hpp"
+#include "TransformFactory.hpp"
+
+
+namespace kanzi {
+
+   // Keeps a transform sequence (and the work buffers owned by its transforms:
+   // suffix arrays, hash tables, dictionaries, ...) alive between blocks.
+   // One instance per block task slot. It must not be shared by concurrent tasks.
+   // Transforms are stateless between calls to forward/inverse (see Transform),
+   // so reusing an instance yields the same output as creating a new one.
+   template <class T>
+   class TransformCache FINAL {
+   public:
+       TransformCache() : _transform(nullptr), _type(0) {}
+
+       ~TransformCache() { clear(); }
+
+       // Load the block parameters into the cached context and return it.
+       // The transforms keep a pointer to this context, so its address never changes.
+       Context& reset(const Context& ctx);
+
+       // Return a transform sequence for 'type'. A new sequence is created only
+       // when the type or the entropy codec ("entropy" in the context, some
+       // transforms depend on it) differs from the cached ones.
+       TransformSequence<T>* get(uint64 type);
+
+       // Release the cached transforms and their buffers.
+       void clear();
+
+   private:
+       Context _ctx;
+       TransformSequence<T>* _transform;
+       uint64 _type;
+       std::string _entropy;
+   };
+
+
+   template <class T>
+   inline Context& TransformCache<T>::reset(const Context& ctx)
+   {
+       _ctx = ctx;
+       return _ctx;
+   }
+
+   template <class T>
+   TransformSequence<T>* TransformCache<T>::get(uint64 type)
+   {
+       const std::string entropy = _ctx.getString("entropy", "");
+
+       if ((_transform != nullptr) && (_type == type) && (_entropy == entropy)) {
+           _transform->setSkipFlags(byte(0));
+           return _transform;
+       }
+
+       TransformSequence<T>* transform = TransformFactory<T>::newTransform(_ctx, type); // may throw
+       clear();
+       _transform = transform;
+       _type = type;
+       _entropy = entropy;
+       return _transform;
+   }
+
+   template <class T>
+   void TransformCache<T>::clear()
+   {
+       if (_transform != nullptr)
+           delete _transform;
+
+       _transform = nullptr;
+       _type = 0;
+   }
+}
+#endif
@@ -33,6 +33,7 @@ limitations under the License.
 #include "ROLZCodec.hpp"
 #include "RLT.hpp"
 #include "SBRT.hpp"
+#include "SBRTZRLT.hpp"
 #include "SRT.hpp"
 #include "TextCodec.hpp"
 #include "TransformSequence.hpp"
@@ -208,17 +209,40 @@ namespace kanzi {
     TransformSequence<T>* TransformFactory<T>::newTransform(Context& ctx, uint64 functionType)
     {
         Transform<T>* transforms[8];
+        uint64 types[8];
         int nbtr = 0;
 
         for (int i = 0; i < 8; i++) {
             transforms[i] = nullptr;
             const uint64 t = (functionType >> (MAX_SHIFT - ONE_SHIFT * i)) & MASK;
 
-            if ((t != NONE_TYPE) || (i == 0))
+            if ((t != NONE_TYPE) || (i == 0)) {
+                types[nbtr] = t;
                 transforms[nbtr++] = newToken(ctx, t);
+            }
+        }
+
+        TransformSequence<T>* seq = new TransformSequence<T>(transforms, true);
+
+        try {
+            // The transforms share the statistics of the input block
+            seq->setBlockStats(ctx);
+
+            // One pass for the rank + zero run chains that follow a BWT
+            for (int i = 0; i + 1 < nbtr; i++) {
+                if ((types[i + 1] != ZRLT_TYPE) || ((types[i] != RANK_TYPE) && (types[i] != MTFT_TYPE)))
+                    continue;
+
+                const int mode = (types[i] == RANK_TYPE) ? SBRT::MODE_RANK : SBRT::MODE_MTF;
+                seq->setFusedTransform(i, new SBRTZRLT(mode, ctx));
+            }
+        }
+        catch (...) {
+            delete seq;
+            throw;
         }
 
-        return new TransformSequence<T>(transforms, true);
+        return seq;
     }
 
     template <class T>
@@ -238,7 +262,7 @@ namespace kanzi {
                     textCodecType = 2;
             }
 
-            ctx.putInt("textcodec", textCodecType);
+            ctx.putInt(Context::TEXT_CODEC, textCodecType);
             return new TextCodec(ctx);
         }
 
@@ -255,15 +279,15 @@ namespace kanzi {
             return new BWTS(ctx);
 
         case LZX_TYPE:
-            ctx.putInt("lz", LZX_TYPE);
+            ctx.putInt(Context::LZ_TYPE, LZX_TYPE);
             return new LZCodec(ctx);
 
         case LZ_TYPE:
-            ctx.putInt("lz", LZ_TYPE);
+            ctx.putInt(Context::LZ_TYPE, LZ_TYPE);
             return new LZCodec(ctx);
 
         case LZP_TYPE:
-            ctx.putInt("lz", LZP_TYPE);
+            ctx.putInt(Context::LZ_TYPE, LZP_TYPE);
             return new LZCodec(ctx);
 
         case RANK_TYPE:
@@ -291,7 +315,7 @@ namespace kanzi {
             return new AliasCodec(ctx);
 
         case DNA_TYPE:
-            ctx.putInt("packOnlyDNA", 1);
+            ctx.putInt(Context::PACK_ONLY_DNA, 1);
             return new AliasCodec(ctx);
 
         case MM_TYPE:
@@ -19,7 +19,9 @@ limitations under the License.
 
 #include <cstring>
 #include <stdexcept>
+#include "../Context.hpp"
 #include "../Transform.hpp"
+#include "BlockStats.hpp"
 
 #define SKIP_MASK  byte(0xFF)
 
@@ -47,12 +49,25 @@ namespace kanzi {
 
        int getNbTransforms() const { return _length; }
 
+       // Process the transforms at 'index' and 'index' + 1 with 'fused' (one
+       // pass, same output) when both apply. If the fused forward transform
+       // fails, both transforms are applied separately: the skip flags and the
+       // output do not change. The sequence owns 'fused'.
+       void setFusedTransform(int index, Transform<T>* fused);
+
+       // Share the statistics of each input block (see BlockStats) with the
+       // transforms through 'ctx', the context given to the transforms.
+       void setBlockStats(Context& ctx);
+
    private:
 
        Transform<T>* _transforms[8]; // transforms or functions
+       Transform<T>* _fused[8]; // fused transforms (index of the first one)
        bool _deallocate; // deallocate memory for transforms ?
        int _length; // number of transforms
        byte _skipFlags; // skip transforms
+       Context* _pCtx; // context of the transforms (for the block statistics)
+       BlockStats* _stats; // statistics of the input block or null
    };
 
    template <class T>
@@ -61,9 +76,12 @@ namespace kanzi {
        _deallocate = deallocate;
        _length = 8;
        _skipFlags = byte(0);
+       _pCtx = nullptr;
+       _stats = nullptr;
 
        for (int i = 7; i >= 0; i--) {
            _transforms[i] = transforms[i];
+           _fused[i] = nullptr;
 
            if (_transforms[i] == nullptr)
                _length = i;
@@ -82,6 +100,36 @@ namespace kanzi {
                    delete _transforms[i];
            }
        }
+
+       for (int i = 0; i < 8; i++) {
+           if (_fused[i] != nullptr)
+               delete _fused[i];
+       }
+
+       delete _stats;
+   }
+
+   template <class T>
+   void TransformSequence<T>::setFusedTransform(int index, Transform<T>* fused)
+   {
+       if ((index < 0) || (index + 1 >= _length)) {
+           delete fused;
+           throw std::invalid_argument("Invalid index of fused transform");
+       }
+
+       if (_fused[index] != nullptr)
+           delete _fused[index];
+
+       _fused[index] = fused;
+   }
+
+   template <class T>
+   void TransformSequence<T>::setBlockStats(Context& ctx)
+   {
+       if (_stats == nullptr)
+           _stats = new BlockStats();
+
+       _pCtx = &ctx;
    }
 
    template <class T>
@@ -108,6 +156,11 @@ namespace kanzi {
        const int requiredSize = getMaxEncodedLength(blockSize);
        int swaps = 0;
 
+       if (_stats != nullptr) {
+           _stats->reset(&input._array[input._index], count);
+           _pCtx->setBlockStats(_stats);
+       }
+
        // Process transforms sequentially
        for (int i = 0; i < _length; i++) {
            if (_transforms[i] == nullptr)
@@ -128,6 +181,29 @@ namespace kanzi {
            const int savedIIdx = in->_index;
            const int savedOIdx = out->_index;
 
+           // Fused pass with the next transform. The next transform would write
+           // to 'in' (or to the buffer if 'in' is too small): it must have room
+           // for 'count' bytes, as the separate transforms require.
+           if ((_fused[i] != nullptr) && (_transforms[i + 1] != nullptr) &&
+               ((in->_length < requiredSize) || (in->_length - in->_index >= count))) {
+               if (_fused[i]->forward(*in, *out, count) == true) {
+                   if (_stats != nullptr)
+                       _stats->clear();
+
+                   _skipFlags &= ~byte(3 << (6 - i));
+                   count = out->_index - savedOIdx;
+                   in->_index = savedIIdx;
+                   out->_index = savedOIdx;
+                   std::swap(in, out);
+                   swaps++;
+                   i++;
+                   continue;
+               }
+
+               in->_index = savedIIdx;
+               out->_index = savedOIdx;
+           }
+
            // Apply forward transform
            if (_transforms[i]->forward(*in, *out, count) == false) {
                // Transform failed. Either it does not apply to this type
@@ -137,6 +213,10 @@ namespace kanzi {
                continue;
            }
 
+           // The next transforms do not see the input block anymore
+           if (_stats != nullptr)
+               _stats->clear();
+
            _skipFlags &= ~byte(1 << (7 - i));
            count = out->_index - savedOIdx;
            in->_index = savedIIdx;
@@ -155,6 +235,11 @@ namespace kanzi {
            }
        }
 
+       if (_stats != nullptr) {
+           _stats->clear();
+           _pCtx->setBlockStats(nullptr);
+       }
+
        input._index += blockSize;
        output._index += count;
        delete[] buffer._array;
@@ -217,13 +302,21 @@ namespace kanzi {
            const int savedIIdx = in->_index;
            const int savedOIdx = out->_index;
 
+           // Fused pass with the previous transform if both were applied
+           const bool fused = (i > 0) && (_fused[i - 1] != nullptr) &&
+               ((_skipFlags & byte(3 << (7 - i))) == byte(0));
+
            // Apply inverse transform
-           res = _transforms[i]->inverse(*in, *out, count);
+           res = (fused == true) ? _fused[i - 1]->inverse(*in, *out, count) :
+               _transforms[i]->inverse(*in, *out, count);
 
            // All inverse transforms must succeed
            if (res == false)
                break;
 
+           if (fused == true)
+               i--;
+
            count = out->_index - savedOIdx;
            in->_index = savedIIdx;
            out->_index = savedOIdx;
@@ -18,6 +18,7 @@ limitations under the License.
 #include <stdexcept>
 #include <vector>
 
+#include "BlockStats.hpp"
 #include "UTFCodec.hpp"
 #include "../Global.hpp"
 #include "../types.hpp"
@@ -67,7 +68,7 @@ bool UTFCodec::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>&
     bool mustValidate = true;
 
     if (_pCtx != nullptr) {
-        Global::DataType dt = (Global::DataType)_pCtx->getInt("dataType", Global::UNDEFINED);
+        Global::DataType dt = (Global::DataType)_pCtx->getInt(Context::DATA_TYPE, Global::UNDEFINED);
 
         if ((dt != Global::UNDEFINED) && (dt != Global::UTF8))
             return false;
@@ -87,11 +88,18 @@ bool UTFCodec::forward(SliceArray<kanzi::byte>& input, SliceArray<kanzi::byte>&
             start++;
     }
 
-    if ((mustValidate == true) && (validate(&src[start], count - start - 4)) == false)
-        return false;
+    if (mustValidate == true) {
+        // Reuse the statistics of the block if a previous transform computed them
+        BlockStats* stats = BlockStats::get(_pCtx, src, count);
+        const bool valid = (stats != nullptr) ? validate(*stats, start, count - start - 4) :
+            validate(&src[start], count - start - 4);
+
+        if (valid == false)
+            return false;
+    }
 
     if (_pCtx != nullptr)
-        _pCtx->putInt("dataType", Global::UTF8);
+        _pCtx->putInt(Context::DATA_TYPE, Global::UTF8);
 
     // 1-3 bit size + (7 or 11 or 16 or 21) bit payload
     // 3 MSBs indicate symbol size (limit map size to 22 bits)
@@ -312,7 +320,6 @@ bool UTFCodec::validate(const kanzi::byte block[], int count)
     uint8 prv = 0;
     const uint8* data = reinterpret_cast<const uint8*>(&block[0]);
     const int count4 = count & -4;
-    bool res = true;
 
     // Unroll loop
     for (int i = 0; i < count4; i += 4) {
@@ -341,6 +348,50 @@ bool UTFCodec::validate(const kanzi::byte block[], int count)
         freqs0[i] += (f0[i] + f1[i] + f2[i] + f3[i]);
     }
 
+    const bool res = validate(freqs0, freqs1, count);
+    delete[] freqs1;
+    return res;
+}
+
+// Validate the 'count' bytes at 'start' in the block described by 'stats'
+bool UTFCodec::validate(BlockStats& stats, int start, int count)
+{
+    if (count <= 0)
+        return validate(&stats.getBlock()[start], count);
+
+    // Histograms of the range: remove the bytes outside of the range (and
+    // the pairs that end there) from the histograms of the block
+    const uint8* data = reinterpret_cast<const uint8*>(stats.getBlock());
+    const int end = start + count;
+    const int length = stats.getCount();
+    uint freqs0[256];
+    uint* freqs1 = new uint[65536];
+    memcpy(&freqs1[0], stats.getHistogram1(), 65536 * sizeof(uint));
+    memcpy(&freqs0[0], stats.getHistogram(), sizeof(freqs0));
+
+    for (int i = 0; i < start; i++)
+        freqs0[data[i]]--;
+
+    for (int i = end; i < length; i++)
+        freqs0[data[i]]--;
+
+    freqs1[data[0]]--;
+
+    for (int i = 1; i <= start; i++)
+        freqs1[(data[i - 1] * 256) + data[i]]--;
+
+    for (int i = end; i < length; i++)
+        freqs1[(data[i - 1] * 256) + data[i]]--;
+
+    // The previous byte of the first byte of the range is 0
+    freqs1[data[start]]++;
+    const bool res = validate(freqs0, freqs1, count);
+    delete[] freqs1;
+    return res;
+}
+
+bool UTFCodec::validate(const uint freqs0[], const uint freqs1[], int count)
+{
     // Valid UTF-8 sequences
     // See Unicode 16 Standard - UTF-8 Table 3.7
     // U+0000..U+007F          00..7F
@@ -360,10 +411,8 @@ bool UTFCodec::validate(const kanzi::byte block[], int count)
     for (int i = 0xF5; i <= 0xFF; i++)
         sum += freqs0[i];
 
-    if (sum != 0) {
-        res = false;
-        goto end;
-    }
+    if (sum != 0)
+        return false;
 
     // Check rules for first 2 bytes
     for (int i = 0; i < 256; i++) {
@@ -408,15 +457,10 @@ bool UTFCodec::validate(const kanzi::byte block[], int count)
             sum2 += freqs0[i];
         }
 
-        if (sum != 0) {
-            res = false;
-            break;
-        }
+        if (sum != 0)
+            return false;
     }
 
-end:
-    delete[] freqs1;
-
     // Ad-hoc threshold
-    return (res == true) && (sum2 >= uint(count / 8));
+    return sum2 >= uint(count / 8);
 }
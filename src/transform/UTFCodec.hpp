@@ -62,6 +62,10 @@ namespace kanzi
        
         static bool validate(const byte block[], int count);
 
+        static bool validate(BlockStats& stats, int start, int count);
+
+        static bool validate(const uint freqs0[], const uint freqs1[], int count);
+
         static int pack(const byte in[], uint32& out);
 
         static int unpack(uint32 in, byte out[]);
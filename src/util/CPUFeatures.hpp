@@ -0,0 +1,128 @@
+/*
+Copyright 2011-2026 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef knz_CPUFeatures
+#define knz_CPUFeatures
+
+#include "../types.hpp"
+
+// Vectorized kernels are compiled with per function target attributes and
+// selected at runtime, so they do not depend on the compiler flags (eg.
+// -march=native).
+#if !defined(NO_INTRINSICS) && (defined(__x86_64__) || defined(_M_X64))
+   #if defined(_MSC_VER) && !defined(__clang__)
+      #include <immintrin.h>
+      #define KANZI_SIMD_DISPATCH
+      #define KANZI_TARGET_AVX2
+      #define KANZI_TARGET_AVX512
+   #elif defined(__clang__) || (defined(__GNUC__) && (__GNUC__ >= 5))
+      #include <immintrin.h>
+      #define KANZI_SIMD_DISPATCH
+      #define KANZI_TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+      #define KANZI_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx2,popcnt")))
+   #endif
+#endif
+
+
+namespace kanzi {
+
+   // Instruction sets available on the host (detected once)
+   class CPUFeatures {
+   public:
+       enum SIMDLevel { SCALAR = 0, AVX2 = 1, AVX512 = 2 };
+
+       // Best instruction set supported by both the host and the build,
+       // capped by setMaxSIMDLevel()
+       static SIMDLevel getSIMDLevel();
+
+       // Restrict the kernels used (eg. to test the fallbacks). Not thread safe,
+       // call before creating the codecs.
+       static void setMaxSIMDLevel(SIMDLevel level) { maxLevel() = level; }
+
+       static const char* getName(SIMDLevel level);
+
+   private:
+       static SIMDLevel detect();
+
+       static SIMDLevel& maxLevel() { static SIMDLevel level = AVX512; return level; }
+   };
+
+
+   inline CPUFeatures::SIMDLevel CPUFeatures::getSIMDLevel()
+   {
+       static const SIMDLevel level = detect();
+       return (level < maxLevel()) ? level : maxLevel();
+   }
+
+
+   inline const char* CPUFeatures::getName(SIMDLevel level)
+   {
+       switch (level) {
+       case AVX512:
+           return "AVX512";
+
+       case AVX2:
+           return "AVX2";
+
+       default:
+           return "SCALAR";
+       }
+   }
+
+
+   inline CPUFeatures::SIMDLevel CPUFeatures::detect()
+   {
+#if defined(KANZI_SIMD_DISPATCH) && defined(_MSC_VER) && !defined(__clang__)
+       int regs[4];
+       __cpuid(regs, 0);
+
+       if (regs[0] < 7)
+           return SCALAR;
+
+       __cpuid(regs, 1);
+
+       // OSXSAVE and AVX, then check that the OS saves the YMM (and ZMM) registers
+       if ((regs[2] & (1 << 27)) == 0 || (regs[2] & (1 << 28)) == 0)
+           return SCALAR;
+
+       const uint64 xcr0 = uint64(_xgetbv(0));
+
+       if ((xcr0 & 0x06) != 0x06)
+           return SCALAR;
+
+       __cpuidex(regs, 7, 0);
+
+       if ((regs[1] & (1 << 5)) == 0) // AVX2
+           return SCALAR;
+
+       const bool avx512 = ((regs[1] & (1 << 16)) != 0) && ((regs[1] & (1 << 30)) != 0); // AVX512F, AVX512BW
+       return ((avx512 == true) && ((xcr0 & 0xE0) == 0xE0)) ? AVX512 : AVX2;
+#elif defined(KANZI_SIMD_DISPATCH)
+       __builtin_cpu_init();
+
+       if (__builtin_cpu_supports("avx2") == 0)
+           return SCALAR;
+
+       if ((__builtin_cpu_supports("avx512f") != 0) && (__builtin_cpu_supports("avx512bw") != 0))
+           return AVX512;
+
+       return AVX2;
+#else
+       return SCALAR;
+#endif
+   }
+}
+#endif